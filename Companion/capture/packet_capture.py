@@ -1,29 +1,76 @@
 """
 Packet Capture Module
 Captures packets on the test interface for validation and analysis.
+Frames are counted per DUT: the IPv4 (or ARP) peer address that is
+not the companion's own.
+
+On Linux the capture runs from a PACKET_MMAP TPACKET_V3 block ring:
+the kernel fills whole blocks of frames, the event loop is woken once
+per retired block and walks it in place, merging the counters under a
+single lock acquisition. A classic BPF filter attached to the socket
+keeps only frames to/from the DUT MACs (when configured) and trims
+them to the snap length, so more frames fit in a block. Frames can be
+written to a pcap file straight from the ring (buffered, no syscall
+per frame). Kernel drops are read from PACKET_STATISTICS.
+Without ring support the socket mode (one recv per frame) is used.
 """
 
+import ctypes
 import logging
+import mmap
 import socket
 import struct
 import threading
 import time
 
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ
+
 logger = logging.getLogger("capture")
 
 ETH_P_ALL = 0x0003
+RX_BATCH = 256                  # frames drained per readiness event
 
+# linux/if_packet.h
+SOL_PACKET = 263
+PACKET_RX_RING = 5
+PACKET_STATISTICS = 6
+PACKET_VERSION = 10
+TPACKET_V3 = 2
+TP_STATUS_KERNEL = 0
+TP_STATUS_USER = 1
+SO_ATTACH_FILTER = 26
 
-class PacketCapture:
-    """Packet capture and statistics collector."""
+RING_BLOCK_SIZE = 1 << 20       # multiple of the page size
+RING_FRAME_SIZE = 2048
+RING_RETIRE_MS = 10             # hand partially filled blocks over after this
+SNAPLEN_COUNT = 128             # enough for Ethernet + IPv4/ARP headers
+SNAPLEN_PCAP = 65535
 
-    def __init__(self, interface):
-        self.interface = interface
-        self.sock = None
-        self.thread = None
-        self.running = False
+# tpacket_req3, tpacket_hdr_v1 (inside tpacket_block_desc), tpacket3_hdr
+TPACKET_REQ3 = struct.Struct("7I")
+BLOCK_HDR = struct.Struct("4I")         # block_status, num_pkts, first, blk_len
+BLOCK_HDR_OFFSET = 8                    # after version, offset_to_priv
+FRAME_HDR = struct.Struct("6IH")        # next, sec, nsec, snaplen, len, status, mac
+STATS = struct.Struct("2I")             # packets, drops (+ freeze_q_cnt on V3)
 
-        # Statistics
+# Nanosecond-resolution pcap, Ethernet link type
+PCAP_HEADER = struct.pack("IHHiIII", 0xA1B23C4D, 2, 4, 0, 0, SNAPLEN_PCAP, 1)
+PCAP_RECORD = struct.Struct("IIII")
+PCAP_BUFFER = 1 << 20
+
+# Classic BPF opcodes
+BPF_LD_H_ABS = 0x28
+BPF_LD_W_ABS = 0x20
+BPF_JEQ_K = 0x15
+BPF_RET_K = 0x06
+SOCK_FILTER = struct.Struct("HBBI")
+
+
+class _CaptureDutStats:
+    """Frame counters of one DUT."""
+
+    def __init__(self):
         self.total_packets = 0
         self.total_bytes = 0
         self.arp_count = 0
@@ -32,89 +79,282 @@ class PacketCapture:
         self.udp_count = 0
         self.other_count = 0
 
+
+def _mac_bytes(mac):
+    return bytes(int(b, 16) for b in mac.split(":"))
+
+
+def build_mac_filter(macs, snaplen):
+    """Classic BPF program accepting frames whose destination or source
+    MAC is one of macs (every frame if there are none), trimmed to
+    snaplen bytes. Returns (code, instruction count)."""
+    prog = []
+    for mac in macs:
+        hi, lo = struct.unpack("!HI", _mac_bytes(mac))
+        # Destination MAC at offset 0, source at offset 6
+        for base in (0, 6):
+            prog += [[BPF_LD_H_ABS, 0, 0, base],
+                     [BPF_JEQ_K, 0, 2, hi],          # miss: next comparison
+                     [BPF_LD_W_ABS, 0, 0, base + 2],
+                     [BPF_JEQ_K, None, 0, lo]]       # hit: accept
+    if macs:
+        prog.append([BPF_RET_K, 0, 0, 0])
+    accept = len(prog)
+    prog.append([BPF_RET_K, 0, 0, snaplen])
+
+    code = b""
+    for idx, (op, jt, jf, k) in enumerate(prog):
+        if jt is None:
+            jt = accept - idx - 1
+        code += SOCK_FILTER.pack(op, jt, jf, k)
+    return code, len(prog)
+
+
+class PacketCapture:
+    """Packet capture and statistics collector."""
+
+    per_dut = True
+
+    def __init__(self, loop, interface, local_ip=None, mode="ring",
+                 dut_macs=(), pcap_path=None, ring_mb=64):
+        self.loop = loop
+        self.interface = interface
+        self.local_ip = socket.inet_aton(local_ip) if local_ip else None
+        self.mode = mode
+        self.dut_macs = [m.strip().lower() for m in dut_macs if m.strip()]
+        self.pcap_path = pcap_path or None
+        self.ring_blocks = max(2, ring_mb * (1 << 20) // RING_BLOCK_SIZE)
+        self.sock = None
+        self.ring = None
+        self.block = 0
+        self.pcap = None
+        self.filter = None            # kept alive while attached
+        self.running = False
+
+        # Statistics
+        self.stats = DutTable(_CaptureDutStats)
+        self.kernel_drops = 0
+
         self.lock = threading.Lock()
 
-    def prepare(self, test, args):
+    def prepare(self, test, args, dut=None):
         return True, "OK"
 
-    def stop_test(self):
-        self.reset_stats()
+    def stop_test(self, dut=None):
+        self.reset_stats(dut)
 
-    def get_result(self):
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        self._read_kernel_stats()
+        st = self.stats.get(dut)
         with self.lock:
-            return (f"total={self.total_packets},"
-                    f"arp={self.arp_count},"
-                    f"icmp={self.icmp_count},"
-                    f"tcp={self.tcp_count},"
-                    f"udp={self.udp_count}")
+            return (f"total={st.total_packets},"
+                    f"arp={st.arp_count},"
+                    f"icmp={st.icmp_count},"
+                    f"tcp={st.tcp_count},"
+                    f"udp={st.udp_count},"
+                    f"drops={self.kernel_drops}")
 
     def start(self):
         """Start packet capture."""
         try:
-            self.sock = socket.socket(
-                socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETH_P_ALL))
-            self.sock.bind((self.interface, 0))
-            self.sock.settimeout(1.0)
+            if self.mode == "ring":
+                try:
+                    self._open(True)
+                except PermissionError:
+                    raise
+                except OSError as e:
+                    logger.warning("Capture ring unavailable (%s), using socket mode", e)
+                    self._close_socket()
+                    self.mode = "socket"
+            if self.mode != "ring":
+                self._open(False)
         except PermissionError:
             logger.warning("Packet capture needs root - skipping")
+            self._close_socket()
             return
         except OSError as e:
             logger.warning("Capture socket error: %s", e)
+            self._close_socket()
             return
 
+        if self.pcap_path:
+            try:
+                self.pcap = open(self.pcap_path, "wb", buffering=PCAP_BUFFER)
+                self.pcap.write(PCAP_HEADER)
+            except OSError as e:
+                logger.warning("Cannot write pcap %s: %s", self.pcap_path, e)
+                self.pcap = None
+
         self.running = True
-        self.thread = threading.Thread(target=self._capture_loop, daemon=True)
-        self.thread.start()
-        logger.info("Packet capture started on %s", self.interface)
+        handler = self._on_ring_ready if self.ring else self._on_readable
+        self.loop.add(self.sock, EVENT_READ, handler)
+        if self.ring:
+            logger.info("Packet capture started on %s (TPACKET_V3 ring %d x %d KB, "
+                        "DUT MAC filter: %s%s)", self.interface, self.ring_blocks,
+                        RING_BLOCK_SIZE >> 10, ",".join(self.dut_macs) or "none",
+                        f", pcap {self.pcap_path}" if self.pcap else "")
+        else:
+            logger.info("Packet capture started on %s", self.interface)
 
     def stop(self):
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
         if self.sock:
+            self.loop.run_in_loop(self._teardown, self.sock, self.ring, self.pcap)
+            self.sock = None
+            self.ring = None
+            self.pcap = None
+
+    def _teardown(self, sock, ring, pcap):
+        self.loop.close(sock)
+        if ring is not None:
+            ring.close()
+        if pcap is not None:
+            pcap.close()
+
+    def reset_stats(self, dut=None):
+        """Reset the counters of one DUT."""
+        self.stats.reset(dut)
+
+    def _open(self, ring):
+        """Open the capture socket, filtered before it is bound."""
+        self.sock = socket.socket(
+            socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETH_P_ALL))
+        # The ring keeps the wire length apart from the captured bytes;
+        # a plain socket only sees what the filter leaves
+        trim = ring and not self.pcap_path
+        self._attach_filter(SNAPLEN_COUNT if trim else SNAPLEN_PCAP)
+        if ring:
+            self._setup_ring()
+        self.sock.bind((self.interface, 0))
+
+    def _close_socket(self):
+        if self.ring is not None:
+            self.ring.close()
+            self.ring = None
+        if self.sock is not None:
             self.sock.close()
             self.sock = None
 
-    def reset_stats(self):
-        """Reset all counters."""
+    def _attach_filter(self, snaplen):
+        """Attach the DUT MAC / snap length BPF program to the socket."""
+        code, count = build_mac_filter(self.dut_macs, snaplen)
+        self.filter = ctypes.create_string_buffer(code, len(code))
+        # struct sock_fprog { unsigned short len; struct sock_filter *filter; }
+        fprog = struct.pack("HL", count, ctypes.addressof(self.filter))
+        self.sock.setsockopt(socket.SOL_SOCKET, SO_ATTACH_FILTER, fprog)
+
+    def _setup_ring(self):
+        """Switch the socket to TPACKET_V3 and map its RX block ring."""
+        self.sock.setsockopt(SOL_PACKET, PACKET_VERSION, TPACKET_V3)
+        req = TPACKET_REQ3.pack(
+            RING_BLOCK_SIZE, self.ring_blocks, RING_FRAME_SIZE,
+            RING_BLOCK_SIZE // RING_FRAME_SIZE * self.ring_blocks,
+            RING_RETIRE_MS, 0, 0)
+        self.sock.setsockopt(SOL_PACKET, PACKET_RX_RING, req)
+        self.ring = mmap.mmap(self.sock.fileno(), RING_BLOCK_SIZE * self.ring_blocks,
+                              mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+        self.block = 0
+
+    def _read_kernel_stats(self):
+        """Accumulate kernel drops (PACKET_STATISTICS resets on read)."""
+        sock = self.sock
+        if sock is None:
+            return
+        try:
+            raw = sock.getsockopt(SOL_PACKET, PACKET_STATISTICS, 12)
+        except OSError:
+            return
+        if len(raw) < STATS.size:
+            return
+        _, drops = STATS.unpack_from(raw)
         with self.lock:
-            self.total_packets = 0
-            self.total_bytes = 0
-            self.arp_count = 0
-            self.icmp_count = 0
-            self.tcp_count = 0
-            self.udp_count = 0
-            self.other_count = 0
-
-    def _capture_loop(self):
-        """Capture packets and update statistics."""
-        while self.running:
+            self.kernel_drops += drops
+
+    def _peer(self, src, dst):
+        """DUT side of a frame: whichever address is not ours."""
+        return socket.inet_ntoa(dst if src == self.local_ip else src)
+
+    def _classify(self, data, length, batch):
+        """Add one frame (data may be truncated, length is on the wire)."""
+        if len(data) < 14:
+            return
+        ether_type = (data[12] << 8) | data[13]
+        if ether_type == 0x0806 and len(data) >= 42:
+            peer = self._peer(data[28:32], data[38:42])
+            kind = 2
+        elif ether_type == 0x0800 and len(data) >= 34:
+            peer = self._peer(data[26:30], data[30:34])
+            kind = {1: 3, 6: 4, 17: 5}.get(data[23], 6)
+        else:
+            peer = None
+            kind = 6
+
+        counts = batch.get(peer)
+        if counts is None:
+            counts = batch[peer] = [0] * 7
+        counts[0] += 1
+        counts[1] += length
+        counts[kind] += 1
+
+    def _merge(self, batch):
+        """Fold a batch of per-DUT counts into the DUT tables."""
+        states = [(self.stats.get(peer), c) for peer, c in batch.items()]
+        with self.lock:
+            for st, c in states:
+                st.total_packets += c[0]
+                st.total_bytes += c[1]
+                st.arp_count += c[2]
+                st.icmp_count += c[3]
+                st.tcp_count += c[4]
+                st.udp_count += c[5]
+                st.other_count += c[6]
+
+    def _on_ring_ready(self, sock, mask):
+        """Walk every block the kernel has handed over, then return them."""
+        ring = self.ring
+        if ring is None:
+            return
+        batch = {}
+        pcap = self.pcap
+        for _ in range(self.ring_blocks):
+            base = self.block * RING_BLOCK_SIZE
+            status, count, first, _ = BLOCK_HDR.unpack_from(
+                ring, base + BLOCK_HDR_OFFSET)
+            if not status & TP_STATUS_USER:
+                break
+
+            off = base + first
+            for _ in range(count):
+                nxt, sec, nsec, snap, length, _, mac = FRAME_HDR.unpack_from(ring, off)
+                data = ring[off + mac:off + mac + snap]
+                self._classify(data, length, batch)
+                if pcap is not None:
+                    pcap.write(PCAP_RECORD.pack(sec, nsec, snap, length))
+                    pcap.write(data)
+                off += nxt
+
+            struct.pack_into("I", ring, base + BLOCK_HDR_OFFSET, TP_STATUS_KERNEL)
+            self.block = (self.block + 1) % self.ring_blocks
+        if batch:
+            self._merge(batch)
+
+    def _on_readable(self, sock, mask):
+        """Count the pending frames (socket mode)."""
+        batch = {}
+        pcap = self.pcap
+        for _ in range(RX_BATCH):
             try:
-                data = self.sock.recv(65535)
-            except socket.timeout:
-                continue
+                data = sock.recv(65535)
             except OSError:
                 break
-
-            if len(data) < 14:
-                continue
-
-            with self.lock:
-                self.total_packets += 1
-                self.total_bytes += len(data)
-
-                ether_type = struct.unpack("!H", data[12:14])[0]
-                if ether_type == 0x0806:
-                    self.arp_count += 1
-                elif ether_type == 0x0800 and len(data) >= 24:
-                    protocol = data[23]
-                    if protocol == 1:
-                        self.icmp_count += 1
-                    elif protocol == 6:
-                        self.tcp_count += 1
-                    elif protocol == 17:
-                        self.udp_count += 1
-                    else:
-                        self.other_count += 1
-                else:
-                    self.other_count += 1
+            self._classify(data, len(data), batch)
+            if pcap is not None:
+                now = time.time_ns()
+                pcap.write(PCAP_RECORD.pack(now // 1000000000, now % 1000000000,
+                                            len(data), len(data)))
+                pcap.write(data)
+        if batch:
+            self._merge(batch)
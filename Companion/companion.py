@@ -6,8 +6,9 @@ Linux-side companion application for the DDTSoft EFI Network Test & OSI Analyzer
 Coordinates with the EFI application via UDP control channel (port 9999).
 
 Protocol:
-  Commands (EFI -> Companion): HELLO, PREPARE, START, STOP, RESULT, DONE, GETREPORT
-  Responses (Companion -> EFI): ACK, READY, ERROR, REPORT, CONFIRM
+  Commands (EFI -> Companion): HELLO, PREPARE, START, STOP, RESULT, DONE, GETREPORT, TIME
+  Responses (Companion -> EFI): ACK, READY, ERROR, REPORT, CONFIRM, TIME
+  HELLO with "proto=2" switches the session to pipelined, framed messages.
 
 Usage:
   sudo python3 companion.py [--config CONFIG] [--interface IFACE] [--ip IP]
@@ -24,6 +25,8 @@ import threading
 import time
 
 from services.control_server import ControlServer
+from services.event_loop import EventLoop
+from services.lowlat import LowLatencyReflector
 from services.link_control import LinkControl
 from services.arp_responder import ArpResponder
 from services.icmp_handler import IcmpHandler
@@ -32,7 +35,9 @@ from services.udp_echo import UdpEcho
 from services.dhcp_manager import DhcpManager
 from services.dns_manager import DnsManager
 from services.http_server import HttpServer
+from services.tftp_server import TftpServer
 from services.frame_generator import FrameGenerator
+from services.reflect_driver import ReflectDriver
 from capture.packet_capture import PacketCapture
 
 APP_NAME = "DDTSoft Test Companion"
@@ -55,6 +60,9 @@ class CompanionApp:
             self.config["local_ip"] = local_ip
 
         self.running = False
+        self.stopped = threading.Event()
+        self.loop = EventLoop()
+        self.reflector = None
         self.services = {}
         self.control = None
 
@@ -72,10 +80,27 @@ class CompanionApp:
             "dhcp_domain": "test.ddtsoft.local",
             "dns_port": "53",
             "dns_domain": "test.ddtsoft.local",
+            "dns_wildcard": "bench",
+            "dns_ttl": "300",
             "http_port": "80",
+            "https_port": "443",
+            "https_cert_dir": os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                           "certs"),
+            "https_key": "rsa",
+            "tftp_port": "69",
             "tcp_ports": "80,443,8080,22",
+            "tcp_sink_port": "5201",
+            "tcp_source_port": "5202",
             "udp_echo_port": "5000",
             "udp_ports": "5000,5001,5002",
+            "capture_mode": "ring",
+            "capture_dut_mac": "",
+            "capture_pcap": "",
+            "capture_ring_mb": "64",
+            "echo_low_latency": "no",
+            "echo_cpu": "",
+            "echo_busy_poll_us": "50",
+            "echo_hw_timestamps": "no",
             "command_timeout": "10",
         }
 
@@ -147,21 +172,50 @@ class CompanionApp:
         """Initialize all service modules."""
         iface = self.config["interface"]
         ip = self.config["local_ip"]
+        loop = self.loop
 
         self.services["link_control"] = LinkControl(iface)
-        self.services["arp_responder"] = ArpResponder(iface, ip)
-        self.services["icmp_handler"] = IcmpHandler(iface, ip)
+        self.services["arp_responder"] = ArpResponder(loop, iface, ip)
+        self.services["icmp_handler"] = IcmpHandler(loop, iface, ip)
         self.services["frame_generator"] = FrameGenerator(iface, ip)
-        self.services["packet_capture"] = PacketCapture(iface)
+        self.services["reflect_driver"] = ReflectDriver(ip)
+        self.services["packet_capture"] = PacketCapture(
+            loop, iface, ip,
+            mode=self.config["capture_mode"],
+            dut_macs=self.config["capture_dut_mac"].split(","),
+            pcap_path=self.config["capture_pcap"],
+            ring_mb=int(self.config["capture_ring_mb"]),
+        )
+
+        if self._enabled("echo_low_latency"):
+            cpu = self.config["echo_cpu"].strip()
+            self.reflector = LowLatencyReflector(
+                cpu=int(cpu) if cpu else None,
+                busy_poll_us=int(self.config["echo_busy_poll_us"]),
+                interface=iface,
+                hw_timestamps=self._enabled("echo_hw_timestamps"),
+            )
+            self.reflector.start()
 
-        tcp_ports = [int(p) for p in self.config["tcp_ports"].split(",")]
-        self.services["tcp_listener"] = TcpListener(ip, tcp_ports)
+        # The HTTP server owns http_port and https_port; the TCP listener
+        # would take them first
+        http_port = int(self.config["http_port"])
+        https_port = int(self.config["https_port"])
+        tcp_ports = [int(p) for p in self.config["tcp_ports"].split(",")
+                     if int(p) not in (http_port, https_port)]
+        self.services["tcp_listener"] = TcpListener(
+            loop, ip, tcp_ports,
+            sink_port=int(self.config["tcp_sink_port"]),
+            source_port=int(self.config["tcp_source_port"]),
+            reflector=self.reflector,
+        )
 
         udp_port = int(self.config["udp_echo_port"])
-        self.services["udp_echo"] = UdpEcho(ip, udp_port)
+        self.services["udp_echo"] = UdpEcho(loop, ip, udp_port,
+                                            reflector=self.reflector)
 
         self.services["dhcp_manager"] = DhcpManager(
-            iface, ip,
+            loop, iface, ip,
             self.config["dhcp_pool_start"],
             self.config["dhcp_pool_end"],
             int(self.config["dhcp_lease_time"]),
@@ -169,20 +223,30 @@ class CompanionApp:
         )
 
         self.services["dns_manager"] = DnsManager(
-            ip,
+            loop, ip,
             int(self.config["dns_port"]),
             self.config["dns_domain"],
+            self.config["dns_wildcard"],
+            int(self.config["dns_ttl"]),
         )
 
-        http_port = int(self.config["http_port"])
-        self.services["http_server"] = HttpServer(ip, http_port)
+        self.services["http_server"] = HttpServer(
+            ip, http_port,
+            https_port=https_port,
+            cert_dir=self.config["https_cert_dir"],
+            key_type=self.config["https_key"].strip().lower(),
+        )
+
+        self.services["tftp_server"] = TftpServer(loop, ip, int(self.config["tftp_port"]))
 
         logger.info("All services initialized")
 
     def _start_services(self):
         """Start background services that run continuously."""
         for name in ("arp_responder", "icmp_handler", "tcp_listener",
-                     "udp_echo", "dhcp_manager", "dns_manager", "http_server"):
+                     "udp_echo", "dhcp_manager", "dns_manager", "http_server",
+                     "tftp_server", "packet_capture", "frame_generator",
+                     "reflect_driver"):
             svc = self.services.get(name)
             if svc:
                 try:
@@ -200,35 +264,49 @@ class CompanionApp:
             except Exception:
                 pass
 
-    def _handle_prepare(self, layer, test, args):
+    def _enabled(self, key):
+        return self.config[key].strip().lower() in ("yes", "true", "on", "1")
+
+    @staticmethod
+    def _dut_args(svc, dut):
+        """Per-DUT services get the DUT address, shared ones do not."""
+        return {"dut": dut} if getattr(svc, "per_dut", False) else {}
+
+    def _prepare_service(self, svc, dut, test, args):
+        return svc.prepare(test, args, **self._dut_args(svc, dut))
+
+    def _handle_prepare(self, dut, layer, test, args):
         """Handle PREPARE command from EFI."""
-        logger.info("PREPARE layer=%s test=%s args=%s", layer, test, args)
+        logger.info("PREPARE dut=%s layer=%s test=%s args=%s", dut, layer, test, args)
 
         layer_upper = layer.upper()
 
         if layer_upper == "L1":
             lc = self.services.get("link_control")
             if lc:
-                return lc.prepare(test, args)
+                return self._prepare_service(lc, dut, test, args)
         elif layer_upper == "L2":
             if "ARP" in test.upper():
                 svc = self.services.get("arp_responder")
                 if svc:
-                    return svc.prepare(test, args)
+                    return self._prepare_service(svc, dut, test, args)
             fg = self.services.get("frame_generator")
             if fg:
-                return fg.prepare(test, args)
+                return self._prepare_service(fg, dut, test, args)
         elif layer_upper == "L3":
-            svc = self.services.get("icmp_handler")
+            if "REFLECT" in test.upper():
+                svc = self.services.get("reflect_driver")
+            else:
+                svc = self.services.get("icmp_handler")
             if svc:
-                return svc.prepare(test, args)
+                return self._prepare_service(svc, dut, test, args)
         elif layer_upper == "L4":
             if "UDP" in test.upper():
                 svc = self.services.get("udp_echo")
             else:
                 svc = self.services.get("tcp_listener")
             if svc:
-                return svc.prepare(test, args)
+                return self._prepare_service(svc, dut, test, args)
         elif layer_upper == "L7":
             if "DHCP" in test.upper():
                 svc = self.services.get("dhcp_manager")
@@ -236,40 +314,52 @@ class CompanionApp:
                 svc = self.services.get("dns_manager")
             elif "HTTP" in test.upper():
                 svc = self.services.get("http_server")
+            elif "TFTP" in test.upper():
+                svc = self.services.get("tftp_server")
             else:
                 return False, "Unknown L7 test"
             if svc:
-                return svc.prepare(test, args)
+                return self._prepare_service(svc, dut, test, args)
 
         return True, "OK"
 
-    def _handle_start(self):
-        """Handle START command."""
-        logger.info("START received")
+    def _handle_start(self, dut):
+        """Handle START command: fire runs armed by PREPARE."""
+        logger.info("START received from %s", dut)
+        for svc in self.services.values():
+            start_test = getattr(svc, "start_test", None)
+            if start_test:
+                start_test(**self._dut_args(svc, dut))
         return True
 
-    def _handle_stop(self):
+    def _handle_stop(self, dut):
         """Handle STOP command."""
-        logger.info("STOP received")
+        logger.info("STOP received from %s", dut)
         for svc in self.services.values():
             try:
-                svc.stop_test()
+                svc.stop_test(**self._dut_args(svc, dut))
             except AttributeError:
                 pass
         return True
 
-    def _handle_result(self):
-        """Handle RESULT command, collect results from services."""
+    def _handle_result(self, dut):
+        """Handle RESULT command, collect the DUT's results from services."""
         results = []
         for name, svc in self.services.items():
             try:
-                r = svc.get_result()
+                r = svc.get_result(**self._dut_args(svc, dut))
                 if r:
                     results.append(f"{name}={r}")
             except AttributeError:
                 pass
         return ";".join(results) if results else "OK"
 
+    def _handle_session_end(self, dut):
+        """DONE (or idle expiry): drop the DUT's per-service state."""
+        for svc in self.services.values():
+            if getattr(svc, "per_dut", False):
+                svc.end_session(dut)
+
     def run(self):
         """Main run loop."""
         print(f"\n  {'=' * 56}")
@@ -285,22 +375,32 @@ class CompanionApp:
         print(f"    ICMP  : Kernel echo reply (ID=0xDD50 tracking)")
         print(f"    UDP   : Echo on port {self.config['udp_echo_port']}")
         print(f"    TCP   : Echo on ports {self.config['tcp_ports']}")
+        print(f"    BULK  : TCP sink {self.config['tcp_sink_port']}, "
+              f"source {self.config['tcp_source_port']}")
+        print(f"    CAPT  : {self.config['capture_mode']} mode, DUT MAC filter "
+              f"{self.config['capture_dut_mac'] or 'off'}")
+        if self._enabled("echo_low_latency"):
+            print(f"    LOWLAT: UDP/TCP echo on busy-polling reflector, CPU "
+                  f"{self.config['echo_cpu'] or 'any'}")
         print(f"  {'=' * 56}\n")
 
         if not self._ensure_interface_ip():
             print("  [!] Cannot continue without interface IP. Exiting.")
             return
 
+        self.loop.start()
         self._init_services()
         self._start_services()
 
         self.control = ControlServer(
+            loop=self.loop,
             local_ip=self.config["local_ip"],
             port=int(self.config["control_port"]),
             on_prepare=self._handle_prepare,
             on_start=self._handle_start,
             on_stop=self._handle_stop,
             on_result=self._handle_result,
+            on_session_end=self._handle_session_end,
         )
 
         self.running = True
@@ -308,6 +408,7 @@ class CompanionApp:
         def signal_handler(sig, frame):
             logger.info("Shutdown signal received")
             self.running = False
+            self.stopped.set()
 
         signal.signal(signal.SIGINT, signal_handler)
         signal.signal(signal.SIGTERM, signal_handler)
@@ -319,14 +420,16 @@ class CompanionApp:
 
         try:
             self.control.start()
-            while self.running:
-                time.sleep(0.5)
+            self.stopped.wait()
         except KeyboardInterrupt:
             pass
         finally:
             logger.info("Shutting down...")
             self.control.stop()
             self._stop_services()
+            if self.reflector:
+                self.reflector.stop()
+            self.loop.stop()
             self._cleanup_interface_ip()
             print("\n  [*] DDTSoft Test Companion stopped.")
 
@@ -10,21 +10,25 @@ import struct
 import threading
 import time
 
+from services.event_loop import EVENT_READ
+
 logger = logging.getLogger("arp")
 
 ETH_P_ARP = 0x0806
 ARP_OP_REQUEST = 1
 ARP_OP_REPLY = 2
+RX_BATCH = 64                   # frames drained per readiness event
 
 
 class ArpResponder:
     """Responds to ARP requests directed at the companion IP."""
 
-    def __init__(self, interface, local_ip):
+    def __init__(self, loop, interface, local_ip):
+        self.loop = loop
         self.interface = interface
         self.local_ip = local_ip
+        self.target_ip = socket.inet_aton(local_ip)
         self.sock = None
-        self.thread = None
         self.running = False
         self.mac = None
         # Probe tracking
@@ -50,7 +54,6 @@ class ArpResponder:
             self.sock = socket.socket(
                 socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETH_P_ARP))
             self.sock.bind((self.interface, 0))
-            self.sock.settimeout(1.0)
             self.mac = self.sock.getsockname()[4]
         except PermissionError:
             logger.warning("ARP responder needs root - skipping")
@@ -60,30 +63,25 @@ class ArpResponder:
             return
 
         self.running = True
-        self.thread = threading.Thread(target=self._respond_loop, daemon=True)
-        self.thread.start()
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
         logger.info("ARP responder started on %s (probe tracking enabled)",
                      self.interface)
 
     def stop(self):
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
         if self.sock:
-            self.sock.close()
+            self.loop.close(self.sock)
             self.sock = None
 
-    def _respond_loop(self):
-        """Listen for ARP requests and respond."""
-        target_ip = socket.inet_aton(self.local_ip)
+    def _on_readable(self, sock, mask):
+        """Answer the pending ARP requests for our address."""
+        target_ip = self.target_ip
 
-        while self.running:
+        for _ in range(RX_BATCH):
             try:
-                frame = self.sock.recv(65535)
-            except socket.timeout:
-                continue
+                frame = sock.recv(65535)
             except OSError:
-                break
+                return
 
             if len(frame) < 42:
                 continue
@@ -110,7 +108,7 @@ class ArpResponder:
             # Build ARP reply
             reply = self._build_arp_reply(sender_mac, sender_ip, target_ip)
             try:
-                self.sock.send(reply)
+                sock.send(reply)
                 with self.lock:
                     self.reply_count += 1
                     self.reply_last_time = time.time()
@@ -1,60 +1,126 @@
 """
 Control Channel Server - UDP port 9999
-Handles the text-based protocol between EFI app and companion.
+Handles the protocol between EFI app and companion.
 
 Protocol:
-  EFI -> Companion: HELLO, PREPARE <layer> <test> [args], START, STOP, RESULT, DONE, GETREPORT
-  Companion -> EFI: ACK, READY, ERROR, REPORT, CONFIRM
+  EFI -> Companion: HELLO, PREPARE <layer> <test> [args], START, STOP, RESULT, DONE, GETREPORT,
+                    TIME <seq>
+  Companion -> EFI: ACK, READY, ERROR, REPORT, CONFIRM, TIME
+
+TIME is the clock-offset exchange of the one-way delay test: the reply
+"TIME seq=<n> rx=<ns> tx=<ns>" carries the CLOCK_MONOTONIC arrival time
+of the request (kernel RX timestamp when available) and the time just
+before the reply is sent. It is sent as plain text even in a framed
+session, so no queueing or retransmission sits between the stamps.
+
+Framed mode (HELLO ... proto=2 -> ACK ... proto=2):
+  The same command/response text travels behind a 12-byte header
+  (magic 0xDD, flags, msg id, frag index, frag count, length, frag ack).
+  Requests are executed in msg id order, so the EFI side can pipeline
+  them; duplicates are answered from a response cache (only the
+  fragments not yet acknowledged), and responses larger than one
+  datagram are split into FRAG_PAYLOAD-byte fragments.
+
+Sessions are kept per DUT IPv4 address. Each session has its own
+worker thread, so a slow PREPARE on one DUT does not hold up the
+others, and a HELLO only (re)starts the session of the DUT sending it.
+Datagrams are received on the shared event loop and handed to the
+session workers; the loop also sweeps idle sessions.
 """
 
+import collections
 import logging
+import queue
 import socket
+import struct
 import threading
+import time
+
+from services.event_loop import EVENT_READ
+from services.lowlat import CMSG_SPACE, enable_timestamps, rx_monotonic_ns
 
 logger = logging.getLogger("control")
 
+FRAME_MAGIC = 0xDD
+FLAG_RESPONSE = 0x01
+FRAME_HDR = struct.Struct("!BBHHHHH")
+FRAG_PAYLOAD = 1400
+MAX_FRAGS = 16          # frag ack is a 16-bit mask
+CACHE_SIZE = 64         # responses kept for retransmitted requests
+MAX_HELD = 64           # out-of-order requests waiting for a gap
+SESSION_IDLE_S = 300    # ended/idle sessions are forgotten after this
+RX_BATCH = 64           # datagrams drained per readiness event
+
+
+class _Session:
+    """Control channel state of one DUT."""
+
+    def __init__(self, dut):
+        self.dut = dut
+        self.addr = None
+        self.connected = False
+        self.last_seen = time.monotonic()
+        # Framed state (reset on every HELLO)
+        self.framed = False
+        self.next_id = 1
+        self.rx_ns = 0              # arrival of the request being handled
+        self.held = {}
+        self.cache = collections.OrderedDict()
+        # Requests of this DUT, executed in arrival order by its worker
+        self.inbox = queue.Queue()
+        self.thread = None
+
 
 class ControlServer:
     """UDP control channel server for EFI <-> Companion coordination."""
 
-    def __init__(self, local_ip, port, on_prepare, on_start, on_stop, on_result):
+    def __init__(self, loop, local_ip, port, on_prepare, on_start, on_stop,
+                 on_result, on_session_end=None):
+        self.loop = loop
         self.local_ip = local_ip
         self.port = port
         self.on_prepare = on_prepare
         self.on_start = on_start
         self.on_stop = on_stop
         self.on_result = on_result
+        self.on_session_end = on_session_end
 
         self.sock = None
-        self.thread = None
+        self.sweep = None
         self.running = False
-        self.connected = False
-        self.dut_addr = None
+        self.sessions = {}        # DUT IP -> _Session
+        self.sessions_lock = threading.Lock()
 
     def start(self):
         """Start listening on the control channel."""
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
         self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
         self.sock.bind((self.local_ip, self.port))
-        self.sock.settimeout(1.0)
+        enable_timestamps(self.sock)
 
         self.running = True
-        self.thread = threading.Thread(target=self._listen_loop, daemon=True)
-        self.thread.start()
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
+        self.sweep = self.loop.call_every(1.0, self._expire_sessions)
         logger.info("Control server listening on %s:%d", self.local_ip, self.port)
 
     def stop(self):
         """Stop the control server."""
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
+        if self.sweep:
+            self.sweep.cancel()
+            self.sweep = None
+        with self.sessions_lock:
+            sessions = list(self.sessions.values())
+            self.sessions.clear()
+        for sess in sessions:
+            sess.inbox.put(None)
         if self.sock:
-            self.sock.close()
+            self.loop.close(self.sock)
             self.sock = None
         logger.info("Control server stopped")
 
     def _send(self, message, addr):
-        """Send a response to the EFI application."""
+        """Send a text response to the EFI application."""
         if self.sock and addr:
             try:
                 data = message.encode("ascii")
@@ -63,107 +129,223 @@ class ControlServer:
             except Exception as e:
                 logger.error("Send failed: %s", e)
 
-    def _listen_loop(self):
-        """Main receive loop."""
-        while self.running:
+    def _send_frame(self, frame, addr):
+        """Send one response frame to the EFI application."""
+        if self.sock and addr:
             try:
-                data, addr = self.sock.recvfrom(4096)
-            except socket.timeout:
-                continue
-            except OSError:
+                self.sock.sendto(frame, addr)
+            except Exception as e:
+                logger.error("Frame send failed: %s", e)
+
+    def _on_readable(self, sock, mask):
+        """Hand each pending datagram to its DUT's session."""
+        for _ in range(RX_BATCH):
+            try:
+                data, anc, _, addr = sock.recvmsg(4096, CMSG_SPACE)
+            except BlockingIOError:
+                return
+            except OSError as e:
                 if self.running:
-                    logger.error("Socket error in listen loop")
+                    logger.error("Socket error on control channel: %s", e)
+                return
+
+            if data:
+                self._session(addr[0]).inbox.put((data, addr, rx_monotonic_ns(anc)))
+
+    def _session(self, dut):
+        """Return the session of a DUT, starting its worker if needed."""
+        with self.sessions_lock:
+            sess = self.sessions.get(dut)
+            if sess is None:
+                sess = self.sessions[dut] = _Session(dut)
+                sess.thread = threading.Thread(
+                    target=self._session_loop, args=(sess,), daemon=True)
+                sess.thread.start()
+            sess.last_seen = time.monotonic()
+            return sess
+
+    def _expire_sessions(self):
+        """Forget sessions that have been quiet for SESSION_IDLE_S."""
+        now = time.monotonic()
+        with self.sessions_lock:
+            expired = [s for s in self.sessions.values()
+                       if now - s.last_seen > SESSION_IDLE_S]
+            for sess in expired:
+                del self.sessions[sess.dut]
+        for sess in expired:
+            sess.inbox.put(None)
+            if sess.connected:
+                self._end_session(sess)
+            logger.info("Session %s expired", sess.dut)
+
+    def _end_session(self, sess):
+        """Release per-DUT state held by the services."""
+        if self.on_session_end:
+            try:
+                self.on_session_end(sess.dut)
+            except Exception as e:
+                logger.error("Session end handler error: %s", e)
+
+    def _session_loop(self, sess):
+        """Execute the requests of one DUT in order."""
+        while True:
+            item = sess.inbox.get()
+            if item is None:
                 break
+            data, addr, sess.rx_ns = item
+
+            if data[0] == FRAME_MAGIC:
+                self._handle_frame(sess, data, addr)
+                continue
 
             msg = data.decode("ascii", errors="replace").strip()
             if not msg:
                 continue
 
             logger.debug("RX <- %s: %s", addr, msg)
-            self._handle_command(msg, addr)
+            self._send(self._handle_command(sess, msg, addr), addr)
+
+    def _handle_frame(self, sess, data, addr):
+        """Sequence, deduplicate and execute a framed request."""
+        if len(data) < FRAME_HDR.size:
+            return
+        _, flags, msg_id, _, _, length, ack = FRAME_HDR.unpack_from(data)
+        if flags & FLAG_RESPONSE:
+            return
+
+        # Retransmitted request: resend only the fragments the DUT lacks
+        cached = sess.cache.get(msg_id)
+        if cached is not None:
+            logger.debug("RX <- %s: dup #%d (ack=0x%04x)", addr, msg_id, ack)
+            for idx, frame in enumerate(cached):
+                if not ack & (1 << idx):
+                    self._send_frame(frame, addr)
+            return
+
+        if not sess.framed:
+            logger.warning("Framed request #%d outside a framed session", msg_id)
+            return
+
+        msg = data[FRAME_HDR.size:FRAME_HDR.size + length].decode(
+            "ascii", errors="replace").strip()
+        logger.debug("RX <- %s: #%d %s", addr, msg_id, msg)
+
+        # Serial-number distance: ahead of the next id means a gap
+        ahead = (msg_id - sess.next_id) & 0xFFFF
+        if ahead >= 0x8000:
+            return
+        if ahead > 0:
+            if len(sess.held) < MAX_HELD:
+                sess.held[msg_id] = msg
+            return
+
+        self._execute_frame(sess, msg_id, msg, addr)
+        while sess.next_id in sess.held:
+            self._execute_frame(sess, sess.next_id, sess.held.pop(sess.next_id), addr)
+
+    def _execute_frame(self, sess, msg_id, msg, addr):
+        """Run one framed request, cache and send its fragmented response."""
+        sess.next_id = (msg_id + 1) & 0xFFFF
+        payload = self._handle_command(sess, msg, addr).encode("ascii", errors="replace")
 
-    def _handle_command(self, msg, addr):
-        """Parse and dispatch a command."""
+        if len(payload) > FRAG_PAYLOAD * MAX_FRAGS:
+            logger.warning("Response #%d truncated from %d bytes", msg_id, len(payload))
+            payload = payload[:FRAG_PAYLOAD * MAX_FRAGS]
+
+        count = max(1, (len(payload) + FRAG_PAYLOAD - 1) // FRAG_PAYLOAD)
+        frames = []
+        for idx in range(count):
+            chunk = payload[idx * FRAG_PAYLOAD:(idx + 1) * FRAG_PAYLOAD]
+            frames.append(FRAME_HDR.pack(FRAME_MAGIC, FLAG_RESPONSE, msg_id,
+                                         idx, count, len(chunk), 0) + chunk)
+
+        sess.cache[msg_id] = frames
+        while len(sess.cache) > CACHE_SIZE:
+            sess.cache.popitem(last=False)
+
+        for frame in frames:
+            self._send_frame(frame, addr)
+        logger.debug("TX -> %s: #%d %d bytes in %d frags", addr, msg_id, len(payload), count)
+
+    def _handle_command(self, sess, msg, addr):
+        """Parse and dispatch a command, returning the response text."""
         parts = msg.split()
         cmd = parts[0].upper() if parts else ""
 
         if cmd == "HELLO":
-            self.dut_addr = addr
-            self.connected = True
-            version = " ".join(parts[1:]) if len(parts) > 1 else "unknown"
-            logger.info("HELLO from %s (version: %s)", addr, version)
-            self._send("ACK DDTSoft Companion 1.0\n", addr)
+            sess.addr = addr
+            sess.connected = True
+            sess.framed = "proto=2" in parts[1:]
+            sess.next_id = 1
+            sess.held.clear()
+            sess.cache.clear()
+            version = " ".join(p for p in parts[1:] if not p.startswith("proto="))
+            logger.info("HELLO from %s (version: %s, %s protocol)", addr,
+                        version or "unknown", "framed" if sess.framed else "text")
             logger.info("ACK sent to %s:%d", addr[0], addr[1])
+            if sess.framed:
+                return "ACK DDTSoft Companion 1.0 proto=2\n"
+            return "ACK DDTSoft Companion 1.0\n"
 
         elif cmd == "PREPARE":
-            if not self.connected:
-                self._send("ERROR Not connected\n", addr)
-                return
+            if not sess.connected:
+                return "ERROR Not connected\n"
 
             layer = parts[1] if len(parts) > 1 else ""
             test = parts[2] if len(parts) > 2 else ""
             args = " ".join(parts[3:]) if len(parts) > 3 else ""
 
             try:
-                ok, detail = self.on_prepare(layer, test, args)
+                ok, detail = self.on_prepare(sess.dut, layer, test, args)
                 if ok:
-                    self._send(f"READY {detail}\n", addr)
-                else:
-                    self._send(f"ERROR {detail}\n", addr)
+                    return f"READY {detail}\n"
+                return f"ERROR {detail}\n"
             except Exception as e:
                 logger.error("PREPARE handler error: %s", e)
-                self._send(f"ERROR {e}\n", addr)
+                return f"ERROR {e}\n"
 
         elif cmd == "START":
-            if not self.connected:
-                self._send("ERROR Not connected\n", addr)
-                return
+            if not sess.connected:
+                return "ERROR Not connected\n"
             try:
-                if self.on_start():
-                    self._send("ACK\n", addr)
-                else:
-                    self._send("ERROR Start failed\n", addr)
+                if self.on_start(sess.dut):
+                    return "ACK\n"
+                return "ERROR Start failed\n"
             except Exception as e:
-                self._send(f"ERROR {e}\n", addr)
+                return f"ERROR {e}\n"
 
         elif cmd == "STOP":
-            if not self.connected:
-                self._send("ERROR Not connected\n", addr)
-                return
+            if not sess.connected:
+                return "ERROR Not connected\n"
             try:
-                if self.on_stop():
-                    self._send("ACK\n", addr)
-                else:
-                    self._send("ERROR Stop failed\n", addr)
+                if self.on_stop(sess.dut):
+                    return "ACK\n"
+                return "ERROR Stop failed\n"
             except Exception as e:
-                self._send(f"ERROR {e}\n", addr)
+                return f"ERROR {e}\n"
 
-        elif cmd == "RESULT":
-            if not self.connected:
-                self._send("ERROR Not connected\n", addr)
-                return
+        elif cmd in ("RESULT", "GETREPORT"):
+            if not sess.connected:
+                return "ERROR Not connected\n"
             try:
-                result = self.on_result()
-                self._send(f"REPORT {result}\n", addr)
+                result = self.on_result(sess.dut)
+                return f"REPORT {result}\n"
             except Exception as e:
-                self._send(f"ERROR {e}\n", addr)
+                return f"ERROR {e}\n"
 
-        elif cmd == "GETREPORT":
-            if not self.connected:
-                self._send("ERROR Not connected\n", addr)
-                return
-            try:
-                result = self.on_result()
-                self._send(f"REPORT {result}\n", addr)
-            except Exception as e:
-                self._send(f"ERROR {e}\n", addr)
+        elif cmd == "TIME":
+            if not sess.connected:
+                return "ERROR Not connected\n"
+            seq = parts[1] if len(parts) > 1 else "0"
+            return f"TIME seq={seq} rx={sess.rx_ns} tx={time.monotonic_ns()}\n"
 
         elif cmd == "DONE":
             logger.info("DONE from %s - session ending", addr)
-            self._send("CONFIRM\n", addr)
-            self.connected = False
-            self.dut_addr = None
+            sess.connected = False
+            sess.framed = False
+            self._end_session(sess)
+            return "CONFIRM\n"
 
         else:
             logger.warning("Unknown command: %s", cmd)
-            self._send(f"ERROR Unknown command: {cmd}\n", addr)
+            return f"ERROR Unknown command: {cmd}\n"
@@ -2,15 +2,24 @@
 DHCP Manager - L7 Application Layer
 Minimal DHCP server for testing DHCP discovery and lease operations.
 Uses dnsmasq if available, otherwise provides a stub DHCP via raw UDP.
+
+The built-in server keeps a lease per client hardware address over the
+whole pool: a DISCOVER is offered the client's lease (or the next free
+address), a REQUEST is ACKed when it asks for that address and NAKed
+otherwise, a RELEASE returns the address to the pool. Its counters are
+what the EFI "DHCP Load" test compares against; a DHCP_LOAD PREPARE
+resets them.
 """
 
+import collections
 import logging
 import os
 import signal
 import socket
 import struct
 import subprocess
-import threading
+
+from services.event_loop import EVENT_READ
 
 logger = logging.getLogger("dhcp")
 
@@ -22,13 +31,21 @@ DHCP_DISCOVER = 1
 DHCP_OFFER = 2
 DHCP_REQUEST = 3
 DHCP_ACK = 5
+DHCP_NAK = 6
+DHCP_RELEASE = 7
+
+OPT_REQUESTED_IP = 50
+OPT_MSG_TYPE = 53
+
+RX_BATCH = 64                   # requests drained per readiness event
 
 
 class DhcpManager:
     """DHCP server manager - uses dnsmasq or built-in minimal server."""
 
-    def __init__(self, interface, local_ip, pool_start, pool_end,
+    def __init__(self, loop, interface, local_ip, pool_start, pool_end,
                  lease_time, domain):
+        self.loop = loop
         self.interface = interface
         self.local_ip = local_ip
         self.pool_start = pool_start
@@ -37,20 +54,41 @@ class DhcpManager:
         self.domain = domain
         self.dnsmasq_proc = None
         self.sock = None
-        self.thread = None
         self.running = False
+        self.leases = {}            # chaddr -> address
+        self.free = collections.deque(self._pool())
+        self._reset_counters()
+
+    def _reset_counters(self):
         self.offers_sent = 0
-        self._next_ip_offset = 0
+        self.acks_sent = 0
+        self.naks_sent = 0
+        self.releases = 0
+        self.exhausted = 0          # DISCOVERs left unanswered: pool empty
 
     def prepare(self, test, args):
         logger.info("DHCP prepare: %s", test)
+        if "LOAD" in test.upper():
+            self._reset_counters()
         return True, "OK"
 
     def stop_test(self):
         pass
 
     def get_result(self):
-        return f"offers={self.offers_sent}"
+        return (f"offers={self.offers_sent},"
+                f"dhcp_acks={self.acks_sent},"
+                f"dhcp_naks={self.naks_sent},"
+                f"dhcp_releases={self.releases},"
+                f"dhcp_exhausted={self.exhausted},"
+                f"dhcp_leases={len(self.leases)},"
+                f"dhcp_server={'dnsmasq' if self.dnsmasq_proc else 'builtin'}")
+
+    def _pool(self):
+        """Every address from pool_start to pool_end."""
+        first = struct.unpack("!I", socket.inet_aton(self.pool_start))[0]
+        last = struct.unpack("!I", socket.inet_aton(self.pool_end))[0]
+        return [socket.inet_ntoa(struct.pack("!I", a)) for a in range(first, last + 1)]
 
     def start(self):
         """Start DHCP server (try dnsmasq first, fall back to built-in)."""
@@ -73,10 +111,8 @@ class DhcpManager:
             self.dnsmasq_proc = None
             logger.info("dnsmasq stopped")
 
-        if self.thread:
-            self.thread.join(timeout=3)
         if self.sock:
-            self.sock.close()
+            self.loop.close(self.sock)
             self.sock = None
 
     def _start_dnsmasq(self):
@@ -120,38 +156,37 @@ class DhcpManager:
             self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
             self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
             self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
-            self.sock.settimeout(1.0)
             self.sock.bind(("0.0.0.0", DHCP_SERVER_PORT))
         except OSError as e:
             logger.warning("DHCP bind failed (need root?): %s", e)
             return
 
         self.running = True
-        self.thread = threading.Thread(target=self._dhcp_loop, daemon=True)
-        self.thread.start()
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
         logger.info("Built-in DHCP server started on port %d", DHCP_SERVER_PORT)
 
-    def _dhcp_loop(self):
-        """Handle DHCP requests."""
-        while self.running:
+    def _on_readable(self, sock, mask):
+        """Answer the pending DHCP requests."""
+        for _ in range(RX_BATCH):
             try:
-                data, addr = self.sock.recvfrom(4096)
-            except socket.timeout:
-                continue
+                data, addr = sock.recvfrom(4096)
             except OSError:
-                break
+                return
 
             if len(data) < 240:
                 continue
 
-            msg_type = self._get_dhcp_msg_type(data)
+            msg_type = self._get_option(data, OPT_MSG_TYPE)
+            msg_type = msg_type[0] if msg_type else 0
             if msg_type == DHCP_DISCOVER:
                 self._send_offer(data, addr)
             elif msg_type == DHCP_REQUEST:
                 self._send_ack(data, addr)
+            elif msg_type == DHCP_RELEASE:
+                self._release(data)
 
-    def _get_dhcp_msg_type(self, data):
-        """Extract DHCP message type from options."""
+    def _get_option(self, data, code):
+        """Return the value of a DHCP option, None if absent."""
         # Options start at offset 240
         i = 240
         while i < len(data) - 2:
@@ -162,43 +197,61 @@ class DhcpManager:
                 i += 1
                 continue
             length = data[i + 1]
-            if opt == 53 and length == 1:
-                return data[i + 2]
+            if opt == code:
+                return data[i + 2:i + 2 + length]
             i += 2 + length
-        return 0
-
-    def _next_offer_ip(self):
-        """Get next IP from pool."""
-        parts = self.pool_start.split(".")
-        base = int(parts[3])
-        ip = f"{parts[0]}.{parts[1]}.{parts[2]}.{base + self._next_ip_offset}"
-        self._next_ip_offset = (self._next_ip_offset + 1) % 100
+        return None
+
+    def _lease_for(self, chaddr):
+        """The client's address, allocating one on first contact."""
+        ip = self.leases.get(chaddr)
+        if ip is None and self.free:
+            ip = self.leases[chaddr] = self.free.popleft()
         return ip
 
-    def _send_offer(self, request, addr):
-        """Send DHCP OFFER."""
-        offer_ip = self._next_offer_ip()
-        response = self._build_dhcp_response(request, offer_ip, DHCP_OFFER)
+    def _reply(self, response):
         try:
             self.sock.sendto(response, ("255.255.255.255", DHCP_CLIENT_PORT))
+            return True
+        except OSError:
+            return False
+
+    def _send_offer(self, request, addr):
+        """Send DHCP OFFER."""
+        offer_ip = self._lease_for(bytes(request[28:34]))
+        if offer_ip is None:
+            self.exhausted += 1
+            logger.debug("DHCP pool exhausted")
+            return
+        if self._reply(self._build_dhcp_response(request, offer_ip, DHCP_OFFER)):
             self.offers_sent += 1
             logger.debug("DHCP OFFER: %s", offer_ip)
-        except OSError:
-            pass
 
     def _send_ack(self, request, addr):
-        """Send DHCP ACK."""
-        offer_ip = self._next_offer_ip()
-        response = self._build_dhcp_response(request, offer_ip, DHCP_ACK)
-        try:
-            self.sock.sendto(response, ("255.255.255.255", DHCP_CLIENT_PORT))
-            logger.debug("DHCP ACK: %s", offer_ip)
-        except OSError:
-            pass
+        """Send DHCP ACK for the client's lease, NAK for any other address."""
+        lease_ip = self.leases.get(bytes(request[28:34]))
+        wanted = self._get_option(request, OPT_REQUESTED_IP)
+        wanted = socket.inet_ntoa(wanted) if wanted and len(wanted) == 4 else \
+            socket.inet_ntoa(request[12:16])            # ciaddr (renewing)
+        if lease_ip is not None and wanted == lease_ip:
+            if self._reply(self._build_dhcp_response(request, lease_ip, DHCP_ACK)):
+                self.acks_sent += 1
+                logger.debug("DHCP ACK: %s", lease_ip)
+        elif self._reply(self._build_dhcp_response(request, "0.0.0.0", DHCP_NAK)):
+            self.naks_sent += 1
+            logger.debug("DHCP NAK: %s (lease %s)", wanted, lease_ip)
+
+    def _release(self, request):
+        """Return a released address to the pool."""
+        ip = self.leases.pop(bytes(request[28:34]), None)
+        if ip is not None:
+            self.free.append(ip)
+            self.releases += 1
 
     def _build_dhcp_response(self, request, offer_ip, msg_type):
         """Build a minimal DHCP response packet."""
         xid = request[4:8]
+        flags = request[10:12]          # keep the client's broadcast bit
         client_mac = request[28:34]
 
         resp = bytearray(300)
@@ -207,6 +260,7 @@ class DhcpManager:
         resp[2] = 6           # HW addr len
         resp[3] = 0           # Hops
         resp[4:8] = xid
+        resp[10:12] = flags
         resp[16:20] = socket.inet_aton(offer_ip)      # yiaddr
         resp[20:24] = socket.inet_aton(self.local_ip)  # siaddr
         resp[28:34] = client_mac
@@ -222,6 +276,9 @@ class DhcpManager:
         # Server identifier
         resp[i:i+6] = bytes([54, 4]) + socket.inet_aton(self.local_ip)
         i += 6
+        if msg_type == DHCP_NAK:
+            resp[i] = 0xFF
+            return bytes(resp)
         # Lease time
         resp[i:i+6] = bytes([51, 4]) + struct.pack("!I", self.lease_time)
         i += 6
@@ -2,12 +2,23 @@
 DNS Manager - L7 Application Layer
 Minimal DNS server that resolves test domain names.
 Responds to A (forward) and PTR (reverse) queries.
+
+Wildcard synthetic records: any name under <wildcard>.<domain> (the EFI
+"DNS Benchmark" takes it from the dns_suffix= of the PREPARE reply;
+bench.test.ddtsoft.local by default) resolves without a table
+entry, so a DUT can generate as many distinct - never cached - names as
+it likes. A first label written as an address ("10-0-0-7.bench...")
+resolves to that address; any other label maps to a stable address in
+198.18.0.0/15, the benchmark range of RFC 2544.
 """
 
 import logging
 import socket
 import struct
-import threading
+import zlib
+
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ
 
 logger = logging.getLogger("dns")
 
@@ -17,18 +28,35 @@ DNS_CLASS_IN = 1
 DNS_FLAG_RESPONSE = 0x8000
 DNS_FLAG_AA = 0x0400
 
+RX_BATCH = 64                   # queries drained per readiness event
+SYNTH_NET = 0xC6120000          # 198.18.0.0/15
+SYNTH_MASK = 0x0001FFFF
+
+
+class _DnsStats:
+    """Query counters of one DUT."""
+
+    def __init__(self):
+        self.queries = 0
+        self.wildcard = 0           # answered from the wildcard records
+        self.nxdomain = 0
+
 
 class DnsManager:
     """Minimal DNS server for test domain resolution."""
 
-    def __init__(self, local_ip, port, domain):
+    per_dut = True
+
+    def __init__(self, loop, local_ip, port, domain, wildcard="bench", ttl=300):
+        self.loop = loop
         self.local_ip = local_ip
         self.port = port
         self.domain = domain
+        self.ttl = ttl
+        self.wildcard = f".{wildcard}.{domain}" if wildcard else None
         self.sock = None
-        self.thread = None
         self.running = False
-        self.query_count = 0
+        self.stats = DutTable(_DnsStats)
 
         # Static records
         self.records = {
@@ -38,63 +66,69 @@ class DnsManager:
             domain: local_ip,
         }
 
-    def prepare(self, test, args):
+    def prepare(self, test, args, dut=None):
         logger.info("DNS prepare: %s", test)
+        if "BENCH" in test.upper():
+            self.stats.reset(dut)
+            if self.wildcard:
+                # The DUT generates its names under this suffix
+                return True, f"OK dns_suffix={self.wildcard[1:]}"
         return True, "OK"
 
-    def stop_test(self):
+    def stop_test(self, dut=None):
         pass
 
-    def get_result(self):
-        return f"queries={self.query_count}"
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        st = self.stats.get(dut)
+        return (f"queries={st.queries},"
+                f"dns_wildcard={st.wildcard},"
+                f"dns_nxdomain={st.nxdomain}")
 
     def start(self):
         """Start DNS server."""
         try:
             self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
             self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-            self.sock.settimeout(1.0)
             self.sock.bind((self.local_ip, self.port))
         except OSError as e:
             logger.warning("DNS bind %s:%d failed: %s", self.local_ip, self.port, e)
             return
 
         self.running = True
-        self.thread = threading.Thread(target=self._dns_loop, daemon=True)
-        self.thread.start()
-        logger.info("DNS server on %s:%d (domain: %s)",
-                     self.local_ip, self.port, self.domain)
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
+        logger.info("DNS server on %s:%d (domain: %s, wildcard: *%s)",
+                     self.local_ip, self.port, self.domain, self.wildcard or " off")
 
     def stop(self):
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
         if self.sock:
-            self.sock.close()
+            self.loop.close(self.sock)
             self.sock = None
 
-    def _dns_loop(self):
-        """Handle DNS queries."""
-        while self.running:
+    def _on_readable(self, sock, mask):
+        """Answer the pending DNS queries."""
+        for _ in range(RX_BATCH):
             try:
-                data, addr = self.sock.recvfrom(4096)
-            except socket.timeout:
-                continue
+                data, addr = sock.recvfrom(4096)
             except OSError:
-                break
+                return
 
             if len(data) < 12:
                 continue
 
-            self.query_count += 1
-            response = self._handle_query(data)
+            st = self.stats.get(addr[0])
+            st.queries += 1
+            response = self._handle_query(data, st)
             if response:
                 try:
-                    self.sock.sendto(response, addr)
+                    sock.sendto(response, addr)
                 except OSError:
                     pass
 
-    def _handle_query(self, data):
+    def _handle_query(self, data, st):
         """Parse DNS query and build response."""
         # Header: ID(2) + Flags(2) + QDCount(2) + ANCount(2) + NSCount(2) + ARCount(2)
         if len(data) < 12:
@@ -118,12 +152,16 @@ class DnsManager:
         logger.debug("DNS query: %s type=%d", qname, qtype)
 
         if qtype == DNS_TYPE_A:
-            return self._build_a_response(txn_id, data[12:offset+4], qname)
+            response = self._build_a_response(txn_id, data[12:offset+4], qname, st)
         elif qtype == DNS_TYPE_PTR:
-            return self._build_ptr_response(txn_id, data[12:offset+4], qname)
+            response = self._build_ptr_response(txn_id, data[12:offset+4], qname)
+        else:
+            # Return NXDOMAIN for unsupported types
+            response = self._build_nxdomain(txn_id, data[12:offset+4])
 
-        # Return NXDOMAIN for unsupported types
-        return self._build_nxdomain(txn_id, data[12:offset+4])
+        if response[3] & 0x0F == 3:
+            st.nxdomain += 1
+        return response
 
     def _decode_name(self, data, offset):
         """Decode a DNS name from the packet."""
@@ -153,15 +191,30 @@ class DnsManager:
         result += b"\x00"
         return result
 
-    def _build_a_response(self, txn_id, question, qname):
+    def _synthesize(self, qname):
+        """Address of a wildcard name: its first label as an IPv4
+        address when it is one, else a stable hash into SYNTH_NET."""
+        label = qname.split(".", 1)[0]
+        try:
+            return socket.inet_ntoa(socket.inet_aton(label.replace("-", ".")))
+        except OSError:
+            pass
+        return socket.inet_ntoa(struct.pack(
+            "!I", SYNTH_NET | (zlib.crc32(label.encode()) & SYNTH_MASK)))
+
+    def _build_a_response(self, txn_id, question, qname, st):
         """Build DNS A record response."""
         qname_lower = qname.lower().rstrip(".")
         ip = self.records.get(qname_lower)
 
+        if ip is None and self.wildcard and qname_lower.endswith(self.wildcard):
+            ip = self._synthesize(qname_lower)
+            st.wildcard += 1
+
         if ip is None:
-            # Try partial match
+            # Any other name in the domain resolves to the companion
             for domain, addr in self.records.items():
-                if qname_lower.endswith(domain):
+                if qname_lower.endswith("." + domain):
                     ip = addr
                     break
 
@@ -175,7 +228,7 @@ class DnsManager:
 
         # Answer: name pointer + type + class + TTL + rdlength + rdata
         answer = b"\xC0\x0C"  # Name pointer to question
-        answer += struct.pack("!HHI", DNS_TYPE_A, DNS_CLASS_IN, 300)
+        answer += struct.pack("!HHI", DNS_TYPE_A, DNS_CLASS_IN, self.ttl)
         answer += struct.pack("!H", 4)
         answer += socket.inet_aton(ip)
 
@@ -209,7 +262,7 @@ class DnsManager:
         # Answer
         ptr_data = self._encode_name(hostname)
         answer = b"\xC0\x0C"
-        answer += struct.pack("!HHI", DNS_TYPE_PTR, DNS_CLASS_IN, 300)
+        answer += struct.pack("!HHI", DNS_TYPE_PTR, DNS_CLASS_IN, self.ttl)
         answer += struct.pack("!H", len(ptr_data))
         answer += ptr_data
 
@@ -0,0 +1,41 @@
+"""
+Per-DUT state table shared by the companion services.
+Services that count DUT traffic keep one state object per DUT IPv4
+address, so several DUTs can be tested through one companion at once
+without their counters mixing.
+"""
+
+import threading
+
+
+class DutTable:
+    """State objects keyed by DUT IP, created on first use."""
+
+    def __init__(self, factory):
+        self._factory = factory
+        self._states = {}
+        self._lock = threading.Lock()
+
+    def get(self, dut):
+        """Return the state of a DUT, creating it if needed."""
+        with self._lock:
+            state = self._states.get(dut)
+            if state is None:
+                state = self._states[dut] = self._factory()
+            return state
+
+    def reset(self, dut):
+        """Replace the state of a DUT with a fresh one and return it."""
+        with self._lock:
+            state = self._states[dut] = self._factory()
+            return state
+
+    def drop(self, dut):
+        """Forget a DUT (session ended)."""
+        with self._lock:
+            self._states.pop(dut, None)
+
+    def duts(self):
+        """DUT addresses with state."""
+        with self._lock:
+            return list(self._states)
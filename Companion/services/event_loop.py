@@ -0,0 +1,227 @@
+"""
+Event Loop - shared I/O loop of the companion services.
+One thread multiplexes every service socket through selectors (epoll on
+Linux). Sockets are non-blocking and are served when ready, so no
+service sits in a timed recv and stop() takes effect at once.
+
+Registration and socket teardown may be requested from any thread;
+they are carried out on the loop thread, which is woken through a
+socketpair instead of waiting for a poll timeout.
+"""
+
+import collections
+import heapq
+import itertools
+import logging
+import selectors
+import socket
+import threading
+import time
+
+logger = logging.getLogger("event_loop")
+
+EVENT_READ = selectors.EVENT_READ
+EVENT_WRITE = selectors.EVENT_WRITE
+
+
+class _Timer:
+    """Handle of a scheduled callback; cancel() prevents it from running."""
+
+    def __init__(self, when, fn, args):
+        self.when = when
+        self.fn = fn
+        self.args = args
+        self.cancelled = False
+
+    def cancel(self):
+        self.cancelled = True
+
+
+class EventLoop:
+    """Single-threaded selector loop with timers and cross-thread calls."""
+
+    def __init__(self):
+        self.selector = selectors.DefaultSelector()
+        self.thread = None
+        self.running = False
+        self._tid = None
+        self._pending = collections.deque()
+        self._pending_lock = threading.Lock()
+        self._timers = []
+        self._seq = itertools.count()
+        self._wake_r, self._wake_w = socket.socketpair()
+        self._wake_r.setblocking(False)
+        self._wake_w.setblocking(False)
+        self.selector.register(self._wake_r, EVENT_READ, self._drain_wakeup)
+
+    def start(self):
+        """Run the loop on its own thread."""
+        self.running = True
+        self.thread = threading.Thread(target=self._run, name="event-loop",
+                                       daemon=True)
+        self.thread.start()
+        logger.info("Event loop started (%s)", type(self.selector).__name__)
+
+    def stop(self):
+        """Stop the loop and close every socket still registered."""
+        self.running = False
+        self._wakeup()
+        if self.thread and self.thread is not threading.current_thread():
+            self.thread.join(timeout=2)
+        for key in list(self.selector.get_map().values()):
+            if key.fileobj is not self._wake_r:
+                try:
+                    key.fileobj.close()
+                except OSError:
+                    pass
+        self.selector.close()
+        self._wake_r.close()
+        self._wake_w.close()
+
+    def in_loop(self):
+        """True when called on the loop thread."""
+        return threading.get_ident() == self._tid
+
+    #
+    # Callbacks and timers
+    #
+
+    def call_soon(self, fn, *args):
+        """Run fn(*args) on the loop thread (safe from any thread)."""
+        with self._pending_lock:
+            self._pending.append((fn, args))
+        if not self.in_loop():
+            self._wakeup()
+
+    def call_later(self, delay, fn, *args):
+        """Run fn(*args) on the loop thread after delay seconds."""
+        timer = _Timer(time.monotonic() + delay, fn, args)
+        self.call_soon(self._push_timer, timer)
+        return timer
+
+    def call_every(self, interval, fn, *args):
+        """Run fn(*args) every interval seconds until the handle is cancelled."""
+        handle = _Timer(0, fn, args)
+
+        def tick():
+            if handle.cancelled:
+                return
+            fn(*args)
+            handle.when = time.monotonic() + interval
+            self._push_timer(_Timer(handle.when, tick, ()))
+
+        self.call_later(interval, tick)
+        return handle
+
+    def _push_timer(self, timer):
+        heapq.heappush(self._timers, (timer.when, next(self._seq), timer))
+
+    #
+    # Socket registration
+    #
+
+    def add(self, sock, events, callback):
+        """Serve sock: callback(sock, mask) runs when it becomes ready."""
+        sock.setblocking(False)
+        self.run_in_loop(self._add, sock, events, callback)
+
+    def modify(self, sock, events, callback):
+        """Change the events (and callback) sock is waiting for."""
+        self.run_in_loop(self._modify, sock, events, callback)
+
+    def remove(self, sock):
+        """Stop serving sock (it stays open)."""
+        self.run_in_loop(self._remove, sock)
+
+    def close(self, sock):
+        """Stop serving sock and close it."""
+        self.run_in_loop(self._close, sock)
+
+    def run_in_loop(self, fn, *args):
+        """Run fn(*args) now if on the loop thread (or stopped), else soon."""
+        if self.in_loop() or not self.running:
+            fn(*args)
+        else:
+            self.call_soon(fn, *args)
+
+    def _add(self, sock, events, callback):
+        try:
+            self.selector.register(sock, events, callback)
+        except (KeyError, ValueError, OSError) as e:
+            logger.warning("Cannot register socket: %s", e)
+
+    def _modify(self, sock, events, callback):
+        try:
+            self.selector.modify(sock, events, callback)
+        except (KeyError, ValueError, OSError):
+            pass
+
+    def _remove(self, sock):
+        try:
+            self.selector.unregister(sock)
+        except (KeyError, ValueError, OSError):
+            pass
+
+    def _close(self, sock):
+        self._remove(sock)
+        try:
+            sock.close()
+        except OSError:
+            pass
+
+    #
+    # Loop
+    #
+
+    def _wakeup(self):
+        try:
+            self._wake_w.send(b"\0")
+        except OSError:
+            pass
+
+    def _drain_wakeup(self, sock, mask):
+        try:
+            while sock.recv(4096):
+                pass
+        except OSError:
+            pass
+
+    def _run_pending(self):
+        with self._pending_lock:
+            batch, self._pending = self._pending, collections.deque()
+        for fn, args in batch:
+            self._invoke(fn, args)
+
+    def _run_timers(self):
+        now = time.monotonic()
+        while self._timers and self._timers[0][0] <= now:
+            _, _, timer = heapq.heappop(self._timers)
+            if not timer.cancelled:
+                self._invoke(timer.fn, timer.args)
+
+    def _timeout(self):
+        if self._pending:
+            return 0
+        if not self._timers:
+            return None
+        return max(0.0, self._timers[0][0] - time.monotonic())
+
+    def _invoke(self, fn, args):
+        try:
+            fn(*args)
+        except Exception:
+            logger.exception("Event loop callback %r failed", fn)
+
+    def _run(self):
+        self._tid = threading.get_ident()
+        while self.running:
+            self._run_pending()
+            self._run_timers()
+            try:
+                events = self.selector.select(self._timeout())
+            except OSError as e:
+                logger.error("select failed: %s", e)
+                break
+            for key, mask in events:
+                self._invoke(key.data, (key.fileobj, mask))
+        self._tid = None
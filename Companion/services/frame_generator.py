@@ -1,37 +1,264 @@
 """
 Frame Generator - L2 Data Link Layer
 Generates raw Ethernet frames for L2 testing.
+
+Generator mode (EFI "RX Capacity" test): PREPARE arms a run for the
+DUT (run id, rate, size, duration, destination), START fires it. The
+run (after an optional delay_ms, so the DUT is receiving by then)
+blasts pre-built, sequence-numbered frames (EtherType 0x88B5) or
+UDP datagrams in sendmmsg() batches, paced per batch, and reports what
+it put on the wire so the DUT can compare with what it received.
+
+Bidirectional mode (EFI "Bidirectional" test): PREPARE "L2 BIDIR" arms
+the same frame run and also opens a counter for the DUT's own stream
+(magic DDTDUTTX) coming the other way. Both directions run at once, so
+the DUT sees per-direction loss; the counter reports what arrived here
+and how many frames the kernel dropped before they could be counted.
 """
 
+import ctypes
+import errno
 import logging
 import socket
 import struct
 import threading
+import time
+
+from services.dut_state import DutTable
 
 logger = logging.getLogger("frame_gen")
 
 ETH_P_ALL = 0x0003
 
+# Generator frame: Ethernet header, then the sequence header (big-endian)
+GEN_ETHERTYPE = 0x88B5          # IEEE 802 local experimental
+GEN_MAGIC = b"DDTRXGEN"
+GEN_HEADER = struct.Struct("!8sII")
+GEN_SEQ_OFFSET = 12             # within GEN_HEADER
+GEN_MIN_FRAME = 60              # Ethernet minimum without FCS
+GEN_MAX_FRAME = 9014            # jumbo
+GEN_MAX_BATCH = 64
+GEN_MAX_MS = 60000
+GEN_MAX_DELAY_MS = 2000         # START ACK to first frame (DUT enters its loop)
+GEN_SNDBUF = 4 * 1024 * 1024
+SOL_PACKET = 263
+PACKET_STATISTICS = 6
+PACKET_QDISC_BYPASS = 20
+PACKET_IGNORE_OUTGOING = 23
+TPACKET_STATS = struct.Struct("II")     # tp_packets, tp_drops
+
+# Bidirectional mode: the DUT's stream, same header with its own magic
+BIDIR_MAGIC = b"DDTDUTTX"
+BIDIR_MAX_SEQ = 1 << 26         # caps the seen-bitmap at 8 MB
+BIDIR_GRACE_S = 0.5             # DUT frames still in flight after the run
+BIDIR_RCVBUF = 8 * 1024 * 1024
+
+
+class _Iovec(ctypes.Structure):
+    _fields_ = [("iov_base", ctypes.c_void_p),
+                ("iov_len", ctypes.c_size_t)]
+
+
+class _Msghdr(ctypes.Structure):
+    _fields_ = [("msg_name", ctypes.c_void_p),
+                ("msg_namelen", ctypes.c_uint32),
+                ("msg_iov", ctypes.POINTER(_Iovec)),
+                ("msg_iovlen", ctypes.c_size_t),
+                ("msg_control", ctypes.c_void_p),
+                ("msg_controllen", ctypes.c_size_t),
+                ("msg_flags", ctypes.c_int)]
+
+
+class _Mmsghdr(ctypes.Structure):
+    _fields_ = [("msg_hdr", _Msghdr),
+                ("msg_len", ctypes.c_uint)]
+
+
+try:
+    _libc = ctypes.CDLL(None, use_errno=True)
+    _sendmmsg = _libc.sendmmsg
+    _sendmmsg.argtypes = [ctypes.c_int, ctypes.POINTER(_Mmsghdr),
+                          ctypes.c_uint, ctypes.c_int]
+    _sendmmsg.restype = ctypes.c_int
+except (OSError, AttributeError):
+    _sendmmsg = None
+
+
+class _MmsgBatch:
+    """Pre-built datagrams sent with one sendmmsg() per batch; only the
+    sequence field of each slot is rewritten between batches."""
+
+    def __init__(self, template, count, seq_offset):
+        self.size = len(template)
+        self.count = count
+        self.seq_offset = seq_offset
+        self.buf = bytearray(template * count)
+        self.cbuf = (ctypes.c_char * len(self.buf)).from_buffer(self.buf)
+        base = ctypes.addressof(self.cbuf)
+        self.iov = (_Iovec * count)()
+        self.msgs = (_Mmsghdr * count)()
+        for i in range(count):
+            self.iov[i].iov_base = base + i * self.size
+            self.iov[i].iov_len = self.size
+            self.msgs[i].msg_hdr.msg_iov = ctypes.pointer(self.iov[i])
+            self.msgs[i].msg_hdr.msg_iovlen = 1
+
+    def stamp(self, first_seq, count):
+        for i in range(count):
+            struct.pack_into("!I", self.buf, i * self.size + self.seq_offset,
+                             (first_seq + i) & 0xFFFFFFFF)
+
+    def send(self, sock, count, start=0):
+        """Send slots start..count-1; returns how many went out, -errno on error."""
+        if _sendmmsg is None:
+            for i in range(start, count):
+                try:
+                    sock.send(memoryview(self.buf)[i * self.size:(i + 1) * self.size])
+                except OSError as e:
+                    return i - start if i > start else -(e.errno or errno.EIO)
+            return count - start
+        sent = _sendmmsg(sock.fileno(), ctypes.byref(self.msgs[start]),
+                         count - start, 0)
+        if sent < 0:
+            return -ctypes.get_errno()
+        return sent
+
+
+class _GenRun:
+    """One armed/finished generator run of a DUT."""
+
+    def __init__(self):
+        self.run_id = None
+        self.mode = "frame"
+        self.size = 64
+        self.rate = 0               # packets/s, 0 = unpaced
+        self.ms = 5000
+        self.delay_ms = 0           # hold the first frame after START
+        self.dst_mac = None
+        self.dst_port = 0
+        self.sent = 0
+        self.batches = 0
+        self.stalls = 0             # ENOBUFS/EAGAIN back-offs
+        self.errors = 0
+        self.elapsed_us = 0
+        self.thread = None
+        self.stop = threading.Event()
+        # Bidirectional mode: counter of the DUT's stream
+        self.bidir = False
+        self.rx_sock = None
+        self.rx_thread = None
+        self.rx_frames = 0
+        self.rx_dup = 0
+        self.rx_reorder = 0
+        self.rx_bytes = 0
+        self.rx_drops = 0           # kernel drops on the counter socket
+        self.rx_first = None
+        self.rx_last = None
+
 
 class FrameGenerator:
     """Raw frame generator for L2 data link layer testing."""
 
+    per_dut = True
+
     def __init__(self, interface, local_ip):
         self.interface = interface
         self.local_ip = local_ip
         self.sock = None
         self.mac = None
         self.running = False
+        self.runs = DutTable(_GenRun)
+        self.lock = threading.Lock()
 
-    def prepare(self, test, args):
-        logger.info("Frame prepare: %s", test)
+    def prepare(self, test, args, dut=None):
+        logger.info("Frame prepare: %s %s", test, args)
+        bidir = "BIDIR" in test.upper()
+        if "RX_CAPACITY" not in test.upper() and not bidir:
+            return True, "OK"
+
+        self._halt(dut)
+        opts = dict(a.split("=", 1) for a in args.split() if "=" in a)
+        run = self.runs.reset(dut)
+        try:
+            run.run_id = int(opts.get("run", "0"))
+            run.mode = opts.get("mode", "frame")
+            run.size = int(opts.get("size", "64"))
+            run.rate = int(opts.get("rate", "0"))
+            run.ms = min(int(opts.get("ms", "5000")), GEN_MAX_MS)
+            run.delay_ms = min(int(opts.get("delay_ms", "0")), GEN_MAX_DELAY_MS)
+            run.dst_port = int(opts.get("port", "0"))
+            if "mac" in opts:
+                run.dst_mac = bytes(int(b, 16) for b in opts["mac"].split(":"))
+        except ValueError:
+            return False, "bad generator arguments"
+
+        if bidir and run.mode != "frame":
+            return False, "bidirectional runs are frame mode only"
+        if run.mode == "frame":
+            if run.dst_mac is None or len(run.dst_mac) != 6:
+                return False, "frame mode needs mac="
+            if self.mac is None:
+                return False, "no raw socket (need root)"
+            run.size = max(GEN_MIN_FRAME, min(run.size, GEN_MAX_FRAME))
+        elif run.mode == "udp":
+            if dut is None or run.dst_port == 0:
+                return False, "udp mode needs a DUT address and port="
+            run.size = max(GEN_HEADER.size, min(run.size, 65507))
+        else:
+            return False, f"unknown generator mode {run.mode}"
+
+        if bidir:
+            # Open now: the DUT starts sending as soon as START is acknowledged
+            try:
+                run.rx_sock = self._open_rx()
+            except OSError as e:
+                return False, f"bidirectional counter: {e}"
+            run.bidir = True
+
+        logger.info("Generator run %d armed for %s: %s %d B at %s pps for %d ms",
+                    run.run_id, dut, run.mode, run.size,
+                    run.rate or "max", run.ms)
         return True, "OK"
 
-    def stop_test(self):
-        pass
+    def start_test(self, dut=None):
+        run = self.runs.get(dut)
+        if run.run_id is None or run.thread is not None:
+            return
+        run.thread = threading.Thread(target=self._blast, args=(run, dut),
+                                      daemon=True)
+        run.thread.start()
+        if run.bidir:
+            run.rx_thread = threading.Thread(target=self._count, args=(run, dut),
+                                             daemon=True)
+            run.rx_thread.start()
+
+    def stop_test(self, dut=None):
+        self._halt(dut)
 
-    def get_result(self):
-        return None
+    def end_session(self, dut):
+        self._halt(dut)
+        self.runs.drop(dut)
+
+    def get_result(self, dut=None):
+        run = self.runs.get(dut)
+        if run.run_id is None:
+            return None
+        with self.lock:
+            report = (f"gen_run={run.run_id},"
+                      f"gen_sent={run.sent},"
+                      f"gen_us={run.elapsed_us},"
+                      f"gen_batches={run.batches},"
+                      f"gen_stalls={run.stalls},"
+                      f"gen_errors={run.errors}")
+            if run.bidir:
+                span = run.rx_last - run.rx_first if run.rx_first is not None else 0
+                report += (f",bidir_rx={run.rx_frames},"
+                           f"bidir_rx_dup={run.rx_dup},"
+                           f"bidir_rx_reorder={run.rx_reorder},"
+                           f"bidir_rx_bytes={run.rx_bytes},"
+                           f"bidir_rx_us={int(span * 1e6)},"
+                           f"bidir_rx_drops={run.rx_drops}")
+            return report
 
     def start(self):
         """Initialize raw socket for frame generation."""
@@ -40,17 +267,183 @@ class FrameGenerator:
                 socket.AF_PACKET, socket.SOCK_RAW, socket.htons(ETH_P_ALL))
             self.sock.bind((self.interface, 0))
             self.mac = self.sock.getsockname()[4]
-            logger.info("Frame generator ready on %s", self.interface)
+            logger.info("Frame generator ready on %s (sendmmsg %s)", self.interface,
+                        "available" if _sendmmsg else "unavailable")
         except PermissionError:
             logger.warning("Frame generator needs root - skipping")
         except OSError as e:
             logger.warning("Frame generator socket error: %s", e)
 
     def stop(self):
+        for dut in self.runs.duts():
+            self._halt(dut)
         if self.sock:
             self.sock.close()
             self.sock = None
 
+    def _halt(self, dut):
+        run = self.runs.get(dut)
+        if run.thread is not None:
+            run.stop.set()
+            run.thread.join(timeout=2)
+        if run.rx_thread is not None:
+            run.stop.set()
+            run.rx_thread.join(timeout=2)
+        if run.rx_sock is not None and run.rx_thread is None:
+            run.rx_sock.close()         # armed but never started
+            run.rx_sock = None
+
+    def _open_tx(self, run, dut):
+        """Send-only socket for a run (protocol 0: never receives)."""
+        if run.mode == "frame":
+            sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW, 0)
+            try:
+                sock.setsockopt(SOL_PACKET, PACKET_QDISC_BYPASS, 1)
+            except OSError:
+                pass
+            sock.bind((self.interface, 0))
+            template = (run.dst_mac + self.mac + struct.pack("!H", GEN_ETHERTYPE) +
+                        GEN_HEADER.pack(GEN_MAGIC, run.run_id, 0))
+            seq_offset = 14 + GEN_SEQ_OFFSET
+        else:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            sock.connect((dut, run.dst_port))
+            template = GEN_HEADER.pack(GEN_MAGIC, run.run_id, 0)
+            seq_offset = GEN_SEQ_OFFSET
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, GEN_SNDBUF)
+        template += bytes(i & 0xFF for i in range(len(template), run.size))
+        return sock, template, seq_offset
+
+    def _open_rx(self):
+        """Counter socket for the DUT's stream: generator EtherType only."""
+        sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW,
+                             socket.htons(GEN_ETHERTYPE))
+        try:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, BIDIR_RCVBUF)
+            try:
+                # Our own generator frames would otherwise be looped back here
+                sock.setsockopt(SOL_PACKET, PACKET_IGNORE_OUTGOING, 1)
+            except OSError:
+                pass
+            sock.bind((self.interface, GEN_ETHERTYPE))
+            sock.settimeout(0.05)
+        except OSError:
+            sock.close()
+            raise
+        return sock
+
+    def _count(self, run, dut):
+        """Count the DUT's frames until the run ends and the link is quiet."""
+        sock = run.rx_sock
+        seen = bytearray(BIDIR_MAX_SEQ // 8)
+        next_seq = 0
+        hdr_at = 14
+        try:
+            while True:
+                try:
+                    frame = sock.recv(GEN_MAX_FRAME)
+                except socket.timeout:
+                    frame = None
+                now = time.perf_counter()
+                if frame is not None and len(frame) >= hdr_at + GEN_HEADER.size:
+                    magic, run_id, seq = GEN_HEADER.unpack_from(frame, hdr_at)
+                    if magic == BIDIR_MAGIC and run_id == run.run_id and seq < BIDIR_MAX_SEQ:
+                        with self.lock:
+                            if seen[seq >> 3] & (1 << (seq & 7)):
+                                run.rx_dup += 1
+                            else:
+                                seen[seq >> 3] |= 1 << (seq & 7)
+                                run.rx_frames += 1
+                                run.rx_bytes += len(frame)
+                                if seq < next_seq:
+                                    run.rx_reorder += 1
+                                next_seq = max(next_seq, seq + 1)
+                                if run.rx_first is None:
+                                    run.rx_first = now
+                                run.rx_last = now
+                        continue
+                # The generator thread has finished: wait out the DUT's tail
+                if run.stop.is_set() or (not run.thread.is_alive() and
+                                         now - (run.rx_last or 0) > BIDIR_GRACE_S):
+                    break
+        except OSError as e:
+            logger.error("Bidirectional counter for run %d: %s", run.run_id, e)
+        finally:
+            try:
+                _, drops = TPACKET_STATS.unpack(
+                    sock.getsockopt(SOL_PACKET, PACKET_STATISTICS, TPACKET_STATS.size))
+            except OSError:
+                drops = 0
+            sock.close()
+            with self.lock:
+                run.rx_drops = drops
+                run.rx_sock = None
+        logger.info("Bidirectional run %d from %s: %d frames (%d dup, %d reordered, "
+                    "%d kernel drops)", run.run_id, dut, run.rx_frames, run.rx_dup,
+                    run.rx_reorder, run.rx_drops)
+
+    def _blast(self, run, dut):
+        """Send the run: batches of up to GEN_MAX_BATCH, paced per batch."""
+        if run.delay_ms and run.stop.wait(run.delay_ms / 1000.0):
+            return
+        try:
+            sock, template, seq_offset = self._open_tx(run, dut)
+        except OSError as e:
+            logger.error("Generator run %d: %s", run.run_id, e)
+            with self.lock:
+                run.errors += 1
+            return
+
+        # Keep one batch within ~1 ms of traffic so pacing stays smooth
+        batch_n = GEN_MAX_BATCH if run.rate == 0 else \
+            max(1, min(GEN_MAX_BATCH, run.rate // 1000))
+        batch = _MmsgBatch(template, batch_n, seq_offset)
+        interval = batch_n / run.rate if run.rate else 0.0
+
+        seq = 0
+        start = time.perf_counter()
+        end = start + run.ms / 1000.0
+        due = start
+        try:
+            while not run.stop.is_set():
+                now = time.perf_counter()
+                if now >= end:
+                    break
+                if interval:
+                    if now < due:
+                        if due - now > 0.002:
+                            time.sleep(due - now - 0.001)
+                        continue
+                    due += interval
+
+                batch.stamp(seq, batch_n)
+                done = 0
+                while done < batch_n and not run.stop.is_set():
+                    sent = batch.send(sock, batch_n, done)
+                    if sent < 0:
+                        if -sent in (errno.ENOBUFS, errno.EAGAIN):
+                            run.stalls += 1
+                            time.sleep(0.00005)
+                            continue
+                        run.errors += 1
+                        break
+                    done += sent
+                seq += done
+                with self.lock:
+                    run.sent = seq
+                    run.batches += 1
+                if done < batch_n and not run.stop.is_set():
+                    break
+        finally:
+            elapsed = time.perf_counter() - start
+            sock.close()
+            with self.lock:
+                run.sent = seq
+                run.elapsed_us = int(elapsed * 1e6)
+        logger.info("Generator run %d to %s: %d %s x %d B in %.2fs (%.0f pps, %d stalls)",
+                    run.run_id, dut, seq, "frames" if run.mode == "frame" else "datagrams",
+                    run.size, elapsed, seq / max(elapsed, 1e-6), run.stalls)
+
     def send_frame(self, dst_mac, ether_type, payload):
         """Send a raw Ethernet frame."""
         if not self.sock or not self.mac:
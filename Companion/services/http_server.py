@@ -1,32 +1,134 @@
 """
 HTTP Server - L7 Application Layer
 Mini HTTP server for testing HTTP GET, status codes, and basic connectivity.
+/bytes/<N> (N may end in K, M or G) streams an N-byte pattern body for
+the EFI download throughput test; the body is written from one shared
+chunk, so any size is served without being held in memory.
+
+HTTP/1.1 with keep-alive, one thread per connection, so the EFI load
+test can run many children in parallel over reused connections. The
+connections and requests of each DUT are counted (connection reuse).
+
+HTTPS listener (https_port): the same handler behind TLS, with a
+certificate signed by the companion's test CA (tls_certs), served at
+/ca.der for enrollment. Per DUT it counts TLS handshakes, how many
+resumed a session and the server-side time spent in full and resumed
+handshakes, for the EFI HTTPS test.
 """
 
 import logging
+import re
+import socket
+import ssl
 import threading
-from http.server import HTTPServer, BaseHTTPRequestHandler
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from services.dut_state import DutTable
+from services.tls_certs import TlsCerts
 
 logger = logging.getLogger("http")
 
+BYTES_PATH = re.compile(r"^/bytes/(\d+)([KMG]?)$", re.IGNORECASE)
+BYTES_UNITS = {"": 1, "K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+BYTES_MAX = 64 << 30
+BYTES_CHUNK = memoryview(bytes(i & 0xFF for i in range(1 << 20)))
+BYTES_SNDBUF = 4 * 1024 * 1024
+LISTEN_BACKLOG = 1024
+KEEPALIVE_IDLE_S = 30           # idle keep-alive connections are closed
+
+
+def parse_bytes_path(path):
+    """Body size requested by a /bytes/<N>[K|M|G] path, or None."""
+    m = BYTES_PATH.match(path.split("?", 1)[0])
+    if not m:
+        return None
+    size = int(m.group(1)) * BYTES_UNITS[m.group(2).upper()]
+    return size if size <= BYTES_MAX else None
+
+
+class _HttpDutStats:
+    """HTTP counters of one DUT."""
+
+    def __init__(self):
+        self.connections = 0
+        self.requests = 0
+        self.open = 0
+        self.max_open = 0
+        self.tls_handshakes = 0
+        self.tls_resumed = 0
+        self.tls_failures = 0
+        self.tls_full_us = 0
+        self.tls_resumed_us = 0
+        self.tls_version = "none"
+        self.tls_cipher = "none"
+
+
+class _Httpd(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = LISTEN_BACKLOG
+
+
+class _Httpsd(_Httpd):
+    """HTTPS listener: the handshake runs on the connection's own thread."""
+
+    def __init__(self, address, handler, context):
+        super().__init__(address, handler)
+        self.context = context
+
+    def finish_request(self, request, client_address):
+        request.settimeout(KEEPALIVE_IDLE_S)
+        start = time.perf_counter()
+        try:
+            tls = self.context.wrap_socket(request, server_side=True)
+        except (ssl.SSLError, OSError) as e:
+            self.owner.tls_failed(client_address[0], e)
+            return
+        self.owner.tls_done(client_address[0], tls, time.perf_counter() - start)
+        try:
+            super().finish_request(tls, client_address)
+        finally:
+            tls.close()
+
 
 class _DDTSoftHandler(BaseHTTPRequestHandler):
     """HTTP request handler for DDTSoft companion."""
 
     server_version = "DDTSoft-Companion/1.0"
+    protocol_version = "HTTP/1.1"
+    timeout = KEEPALIVE_IDLE_S
 
     def log_message(self, format, *args):
         logger.debug("HTTP %s", format % args)
 
+    def setup(self):
+        super().setup()
+        # Header and body go out in separate writes; without NODELAY a
+        # keep-alive request waits for the peer's delayed ACK
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.server.owner.conn_opened(self.client_address[0])
+
+    def finish(self):
+        try:
+            super().finish()
+        finally:
+            self.server.owner.conn_closed(self.client_address[0])
+
     def do_GET(self):
         path = self.path
+        self.server.owner.count_request(self.client_address[0])
 
-        if path == "/" or path == "/index.html":
+        size = parse_bytes_path(path)
+        if size is not None:
+            self._stream_bytes(size)
+        elif path == "/" or path == "/index.html":
             self._respond(200, "DDTSoft Test Companion OK\n")
         elif "404" in path or "nonexistent" in path:
             self._respond(404, "Not Found\n")
         elif path == "/status":
             self._respond(200, "status=running\nversion=1.0\n")
+        elif path == "/ca.der" and self.server.owner.ca_der:
+            self._respond(200, self.server.owner.ca_der, "application/pkix-cert")
         elif path == "/health":
             self._respond(200, "healthy\n")
         elif path == "/echo":
@@ -35,7 +137,44 @@ class _DDTSoftHandler(BaseHTTPRequestHandler):
             self._respond(200, f"DDTSoft Companion: {path}\n")
 
     def do_HEAD(self):
-        self._respond(200, "", send_body=False)
+        self.server.owner.count_request(self.client_address[0])
+        size = parse_bytes_path(self.path)
+        if size is not None:
+            self._stream_bytes(size, send_body=False)
+        else:
+            self._respond(200, "", send_body=False)
+
+    def _stream_bytes(self, size, send_body=True):
+        """Send size pattern bytes, chunk by chunk."""
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(size))
+        self.send_header("Server", self.server_version)
+        self.end_headers()
+        if not send_body:
+            return
+
+        try:
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, BYTES_SNDBUF)
+        except OSError:
+            pass
+        self.wfile.flush()
+        sent = 0
+        start = time.monotonic()
+        chunk = len(BYTES_CHUNK)
+        try:
+            while sent < size:
+                n = min(chunk, size - sent)
+                self.connection.sendall(BYTES_CHUNK[:n])
+                sent += n
+        except OSError as e:
+            logger.info("HTTP /bytes/%d to %s aborted after %d bytes: %s",
+                        size, self.client_address[0], sent, e)
+            self.close_connection = True
+            return
+        elapsed = max(time.monotonic() - start, 1e-6)
+        logger.info("HTTP /bytes/%d to %s in %.2fs (%.1f Mbps)",
+                    size, self.client_address[0], elapsed, sent * 8 / elapsed / 1e6)
 
     def _respond(self, code, body, content_type="text/plain", send_body=True):
         self.send_response(code)
@@ -44,54 +183,162 @@ class _DDTSoftHandler(BaseHTTPRequestHandler):
         self.send_header("Server", self.server_version)
         self.end_headers()
         if send_body and body:
-            self.wfile.write(body.encode("utf-8"))
+            self.wfile.write(body if isinstance(body, bytes) else body.encode("utf-8"))
 
 
 class HttpServer:
     """HTTP server for L7 application layer testing."""
 
-    def __init__(self, local_ip, port):
+    per_dut = True
+
+    def __init__(self, local_ip, port, https_port=0, cert_dir=None, key_type="rsa"):
         self.local_ip = local_ip
         self.port = port
+        self.https_port = https_port
+        self.certs = TlsCerts(cert_dir, local_ip, key_type) if https_port and cert_dir else None
+        self.ca_der = None
         self.httpd = None
+        self.httpsd = None
         self.thread = None
+        self.https_thread = None
         self.running = False
+        self.stats = DutTable(_HttpDutStats)
+        self.lock = threading.Lock()
 
-    def prepare(self, test, args):
-        logger.info("HTTP prepare: %s", test)
+    def prepare(self, test, args, dut=None):
+        logger.info("HTTP prepare: %s (%s)", test, dut)
+        if "LOAD" in test.upper() or "HTTPS" in test.upper():
+            st = self.stats.get(dut)
+            with self.lock:
+                # Connections already open stay counted as open
+                st.connections = 0
+                st.requests = 0
+                st.max_open = st.open
+                st.tls_handshakes = 0
+                st.tls_resumed = 0
+                st.tls_failures = 0
+                st.tls_full_us = 0
+                st.tls_resumed_us = 0
+        if "HTTPS" in test.upper() and self.httpsd is None:
+            return False, "HTTPS listener not running"
         return True, "OK"
 
-    def stop_test(self):
+    def stop_test(self, dut=None):
         pass
 
-    def get_result(self):
-        return "running" if self.running else "stopped"
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        if not self.running:
+            return "stopped"
+        st = self.stats.get(dut)
+        with self.lock:
+            return (f"http_conns={st.connections},"
+                    f"http_requests={st.requests},"
+                    f"http_max_open={st.max_open},"
+                    f"tls_handshakes={st.tls_handshakes},"
+                    f"tls_resumed={st.tls_resumed},"
+                    f"tls_failures={st.tls_failures},"
+                    f"tls_full_us={st.tls_full_us},"
+                    f"tls_resumed_us={st.tls_resumed_us},"
+                    f"tls_version={st.tls_version},"
+                    f"tls_cipher={st.tls_cipher}")
+
+    def conn_opened(self, dut):
+        st = self.stats.get(dut)
+        with self.lock:
+            st.connections += 1
+            st.open += 1
+            st.max_open = max(st.max_open, st.open)
+
+    def conn_closed(self, dut):
+        st = self.stats.get(dut)
+        with self.lock:
+            st.open = max(st.open - 1, 0)
+
+    def tls_done(self, dut, tls, seconds):
+        st = self.stats.get(dut)
+        us = int(seconds * 1e6)
+        cipher = tls.cipher()
+        with self.lock:
+            st.tls_handshakes += 1
+            if tls.session_reused:
+                st.tls_resumed += 1
+                st.tls_resumed_us += us
+            else:
+                st.tls_full_us += us
+            st.tls_version = tls.version() or "none"
+            st.tls_cipher = cipher[0] if cipher else "none"
+
+    def tls_failed(self, dut, error):
+        logger.info("TLS handshake with %s failed: %s", dut, error)
+        st = self.stats.get(dut)
+        with self.lock:
+            st.tls_failures += 1
+
+    def count_request(self, dut):
+        st = self.stats.get(dut)
+        with self.lock:
+            st.requests += 1
 
     def start(self):
         """Start HTTP server."""
         try:
-            self.httpd = HTTPServer(
-                (self.local_ip, self.port), _DDTSoftHandler)
-            self.httpd.timeout = 1.0
+            self.httpd = _Httpd((self.local_ip, self.port), _DDTSoftHandler)
         except OSError as e:
             logger.warning("HTTP bind %s:%d failed: %s",
                            self.local_ip, self.port, e)
             return
 
+        self.httpd.owner = self
         self.running = True
         self.thread = threading.Thread(target=self._serve_loop, daemon=True)
         self.thread.start()
-        logger.info("HTTP server on %s:%d", self.local_ip, self.port)
+        logger.info("HTTP server on %s:%d (HTTP/1.1 keep-alive, threaded)",
+                    self.local_ip, self.port)
+        if self.certs:
+            self._start_https()
+
+    def _start_https(self):
+        """Start the HTTPS listener with the test CA's server certificate."""
+        if not self.certs.ensure():
+            return
+        try:
+            context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+            context.minimum_version = ssl.TLSVersion.TLSv1_2
+            context.load_cert_chain(self.certs.server_pem, self.certs.server_key)
+            self.ca_der = self.certs.ca_bytes()
+            self.httpsd = _Httpsd((self.local_ip, self.https_port), _DDTSoftHandler,
+                                  context)
+        except (OSError, ssl.SSLError) as e:
+            logger.warning("HTTPS on %s:%d failed: %s",
+                           self.local_ip, self.https_port, e)
+            return
+
+        self.httpsd.owner = self
+        self.https_thread = threading.Thread(
+            target=self.httpsd.serve_forever, kwargs={"poll_interval": 0.1},
+            daemon=True)
+        self.https_thread.start()
+        logger.info("HTTPS server on %s:%d (CA %s, served at /ca.der)",
+                    self.local_ip, self.https_port, self.certs.ca_pem)
 
     def stop(self):
         self.running = False
         if self.httpd:
             self.httpd.shutdown()
+            self.httpd.server_close()
             self.httpd = None
+        if self.httpsd:
+            self.httpsd.shutdown()
+            self.httpsd.server_close()
+            self.httpsd = None
         if self.thread:
             self.thread.join(timeout=3)
+        if self.https_thread:
+            self.https_thread.join(timeout=3)
 
     def _serve_loop(self):
-        """Serve HTTP requests."""
-        while self.running:
-            self.httpd.handle_request()
+        """Serve HTTP requests until shutdown()."""
+        self.httpd.serve_forever(poll_interval=0.1)
@@ -3,7 +3,8 @@ ICMP Handler - L3 Network Layer
 Handles ICMP echo requests (ping) and provides custom TTL responses.
 The kernel normally handles ICMP, but this module enables monitoring
 and custom behavior when needed.
-Tracks probe statistics including DDTECHO identifier detection.
+Tracks probe statistics including DDTECHO identifier detection,
+separately for every DUT (source IPv4 address).
 """
 
 import logging
@@ -13,6 +14,9 @@ import struct
 import threading
 import time
 
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ
+
 logger = logging.getLogger("icmp")
 
 ICMP_ECHO_REQUEST = 8
@@ -22,57 +26,80 @@ ETH_P_IP = 0x0800
 # DDTECHO ICMP probe uses Identifier = 0xDD50
 DDTECHO_ICMP_ID = 0xDD50
 
+RX_BATCH = 64                   # packets drained per readiness event
 
-class IcmpHandler:
-    """Monitors and optionally handles ICMP traffic."""
 
-    def __init__(self, interface, local_ip):
-        self.interface = interface
-        self.local_ip = local_ip
-        self.running = False
-        self.thread = None
+class _IcmpDutStats:
+    """ICMP counters of one DUT."""
+
+    def __init__(self):
         self.echo_count = 0
         self.custom_ttl = None
         # Probe tracking
         self.probe_count = 0
         self.probe_last_seq = None
         self.probe_last_time = None
-        self.probe_sources = {}   # src_ip -> count
+
+
+class IcmpHandler:
+    """Monitors and optionally handles ICMP traffic."""
+
+    per_dut = True
+
+    def __init__(self, loop, interface, local_ip):
+        self.loop = loop
+        self.interface = interface
+        self.local_ip = local_ip
+        self.running = False
+        self.sock = None
+        self.stats = DutTable(_IcmpDutStats)
         self.lock = threading.Lock()
 
-    def prepare(self, test, args):
+    def prepare(self, test, args, dut=None):
         """Prepare for an ICMP test."""
         test_upper = test.upper()
+        st = self.stats.get(dut)
         if "TTL" in test_upper and args:
             try:
-                self.custom_ttl = int(args.split()[0])
-                logger.info("Custom TTL set to %d", self.custom_ttl)
+                st.custom_ttl = int(args.split()[0])
+                logger.info("Custom TTL for %s set to %d", dut, st.custom_ttl)
             except (ValueError, IndexError):
-                self.custom_ttl = None
+                st.custom_ttl = None
         return True, "OK"
 
-    def stop_test(self):
-        self.custom_ttl = None
+    def stop_test(self, dut=None):
+        self.stats.get(dut).custom_ttl = None
+
+    def end_session(self, dut):
+        self.stats.drop(dut)
 
-    def get_result(self):
+    def get_result(self, dut=None):
+        st = self.stats.get(dut)
         with self.lock:
-            return f"echo_count={self.echo_count},probes={self.probe_count}"
+            return f"echo_count={st.echo_count},probes={st.probe_count}"
 
     def start(self):
         """Enable kernel ICMP reply and start monitoring."""
         self._set_kernel_icmp(True)
         self.running = True
-        self.echo_count = 0
-        self.probe_count = 0
-        self.thread = threading.Thread(target=self._monitor_loop, daemon=True)
-        self.thread.start()
+        try:
+            self.sock = socket.socket(
+                socket.AF_INET, socket.SOCK_RAW, socket.IPPROTO_ICMP)
+        except PermissionError:
+            logger.warning("ICMP monitor needs root - skipping")
+            return
+        except OSError as e:
+            logger.warning("ICMP socket error: %s", e)
+            return
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
         logger.info("ICMP handler started (kernel replies enabled, "
                      "DDTECHO ID=0x%04X tracking)", DDTECHO_ICMP_ID)
 
     def stop(self):
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
+        if self.sock:
+            self.loop.close(self.sock)
+            self.sock = None
 
     def _set_kernel_icmp(self, enable):
         """Enable/disable kernel ICMP echo replies."""
@@ -85,26 +112,13 @@ class IcmpHandler:
         except FileNotFoundError:
             pass
 
-    def _monitor_loop(self):
-        """Monitor ICMP traffic for statistics."""
-        try:
-            sock = socket.socket(
-                socket.AF_INET, socket.SOCK_RAW, socket.IPPROTO_ICMP)
-            sock.settimeout(1.0)
-        except PermissionError:
-            logger.warning("ICMP monitor needs root - skipping")
-            return
-        except OSError as e:
-            logger.warning("ICMP socket error: %s", e)
-            return
-
-        while self.running:
+    def _on_readable(self, sock, mask):
+        """Account the pending ICMP packets."""
+        for _ in range(RX_BATCH):
             try:
                 data, addr = sock.recvfrom(65535)
-            except socket.timeout:
-                continue
             except OSError:
-                break
+                return
 
             if len(data) < 28:
                 continue
@@ -116,7 +130,9 @@ class IcmpHandler:
 
             icmp_type = data[ihl]
             if icmp_type == ICMP_ECHO_REQUEST:
-                self.echo_count += 1
+                st = self.stats.get(addr[0])
+                with self.lock:
+                    st.echo_count += 1
 
                 # Parse ICMP Identifier and Sequence Number
                 icmp_id = struct.unpack("!H", data[ihl + 4:ihl + 6])[0]
@@ -125,11 +141,9 @@ class IcmpHandler:
                 # Check if this is a DDTECHO probe
                 if icmp_id == DDTECHO_ICMP_ID:
                     with self.lock:
-                        self.probe_count += 1
-                        self.probe_last_seq = icmp_seq
-                        self.probe_last_time = time.time()
-                        self.probe_sources[addr[0]] = \
-                            self.probe_sources.get(addr[0], 0) + 1
+                        st.probe_count += 1
+                        st.probe_last_seq = icmp_seq
+                        st.probe_last_time = time.time()
 
                     # Check for DDTECHO payload
                     payload_info = ""
@@ -144,10 +158,8 @@ class IcmpHandler:
 
                     logger.info(
                         "ICMP PROBE seq=%d from %s (total: %d)%s",
-                        icmp_seq, addr[0], self.probe_count, payload_info)
+                        icmp_seq, addr[0], st.probe_count, payload_info)
                 else:
                     logger.debug("ICMP echo request from %s id=0x%04X "
                                  "seq=%d (#%d)",
-                                 addr[0], icmp_id, icmp_seq, self.echo_count)
-
-        sock.close()
+                                 addr[0], icmp_id, icmp_seq, st.echo_count)
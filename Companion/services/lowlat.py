@@ -0,0 +1,262 @@
+"""
+Low-Latency Reflector - L4 Transport Layer
+Dedicated echo thread for sub-100 us RTT measurements.
+
+The shared event loop adds a scheduler wakeup (and the latency of every
+other service it serves) to each echo. In low-latency mode the UDP echo
+socket and the TCP echo connections are served by this reflector
+instead: one thread, optionally pinned to an isolated CPU, spins on
+non-blocking sockets that have SO_BUSY_POLL set, so a request is picked
+up straight from the NIC queue without a wakeup. The spinning thread
+keeps its CPU at 100%; pin it to a core reserved with isolcpus.
+
+Sockets get SO_TIMESTAMPING (software, and hardware when the NIC has
+it enabled) so each echo's residence time - kernel RX timestamp to just
+before the reply is sent - can be handed back to the DUT, and the TX
+timestamp from the error queue gives the full RX-to-wire time.
+"""
+
+import collections
+import ctypes
+import fcntl
+import logging
+import os
+import selectors
+import socket
+import struct
+import threading
+import time
+
+logger = logging.getLogger("lowlat")
+
+# <linux/net_tstamp.h>, <asm-generic/socket.h>
+SO_BUSY_POLL = 46
+SO_TIMESTAMPING = 37
+SCM_TIMESTAMPING = SO_TIMESTAMPING
+SOF_TIMESTAMPING_TX_HARDWARE = 1 << 0
+SOF_TIMESTAMPING_TX_SOFTWARE = 1 << 1
+SOF_TIMESTAMPING_RX_HARDWARE = 1 << 2
+SOF_TIMESTAMPING_RX_SOFTWARE = 1 << 3
+SOF_TIMESTAMPING_SOFTWARE = 1 << 4
+SOF_TIMESTAMPING_RAW_HARDWARE = 1 << 6
+SOF_TIMESTAMPING_OPT_ID = 1 << 7
+SOF_TIMESTAMPING_OPT_TSONLY = 1 << 11
+RX_TS_FLAGS = (SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+               SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RAW_HARDWARE)
+TX_TS_FLAGS = (SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_TX_SOFTWARE |
+               SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY)
+
+SIOCSHWTSTAMP = 0x89B0
+HWTSTAMP_TX_ON = 1
+HWTSTAMP_FILTER_ALL = 1
+IP_RECVERR = 11
+MSG_ERRQUEUE = 0x2000
+
+TIMESPEC3 = struct.Struct("qqqqqq")     # software, legacy, raw hardware
+SOCK_EXTENDED_ERR = struct.Struct("IBBBBII")
+CMSG_SPACE = socket.CMSG_SPACE(TIMESPEC3.size) + socket.CMSG_SPACE(SOCK_EXTENDED_ERR.size)
+TX_PENDING_MAX = 4096           # echoes awaiting their TX timestamp
+
+
+def enable_hw_timestamps(interface):
+    """Turn on NIC hardware timestamping (all RX, TX on); False if unsupported."""
+    cfg = ctypes.create_string_buffer(struct.pack("iii", 0, HWTSTAMP_TX_ON,
+                                                  HWTSTAMP_FILTER_ALL))
+    ifr = struct.pack("16sP", interface.encode()[:15], ctypes.addressof(cfg))
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        fcntl.ioctl(sock.fileno(), SIOCSHWTSTAMP, ifr)
+        return True
+    except OSError as e:
+        logger.info("Hardware timestamping unavailable on %s: %s", interface, e)
+        return False
+    finally:
+        sock.close()
+
+
+def enable_timestamps(sock, tx=False):
+    """Request SO_TIMESTAMPING RX (and optionally TX) stamps; False if refused."""
+    try:
+        sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPING,
+                        RX_TS_FLAGS | (TX_TS_FLAGS if tx else 0))
+        return True
+    except OSError as e:
+        logger.debug("SO_TIMESTAMPING refused: %s", e)
+        return False
+
+
+def parse_timestamps(ancdata):
+    """Return (software ns, raw hardware ns) from SCM_TIMESTAMPING; None if absent."""
+    for level, ctype, data in ancdata:
+        if level == socket.SOL_SOCKET and ctype == SCM_TIMESTAMPING and \
+                len(data) >= TIMESPEC3.size:
+            sw_s, sw_ns, _, _, hw_s, hw_ns = TIMESPEC3.unpack_from(data)
+            return ((sw_s * 1000000000 + sw_ns) if sw_s or sw_ns else None,
+                    (hw_s * 1000000000 + hw_ns) if hw_s or hw_ns else None)
+    return None, None
+
+
+def parse_tx_id(ancdata):
+    """Return the OPT_ID counter of a TX timestamp error-queue message."""
+    for level, ctype, data in ancdata:
+        if level == socket.IPPROTO_IP and ctype == IP_RECVERR and \
+                len(data) >= SOCK_EXTENDED_ERR.size:
+            return SOCK_EXTENDED_ERR.unpack_from(data)[6]
+    return None
+
+
+class LowLatencyReflector:
+    """Pinned, busy-polling thread serving echo sockets."""
+
+    def __init__(self, cpu=None, busy_poll_us=50, interface=None, hw_timestamps=False):
+        self.cpu = cpu
+        self.busy_poll_us = busy_poll_us
+        self.interface = interface
+        self.hw_timestamps = hw_timestamps
+        self.selector = selectors.DefaultSelector()
+        self.thread = None
+        self.running = False
+        self._calls = collections.deque()   # registration requests from other threads
+
+    def start(self):
+        if self.hw_timestamps and self.interface:
+            self.hw_timestamps = enable_hw_timestamps(self.interface)
+        self.running = True
+        self.thread = threading.Thread(target=self._spin, name="lowlat", daemon=True)
+        self.thread.start()
+        logger.info("Low-latency reflector started (cpu %s, busy poll %d us, %s timestamps)",
+                    "any" if self.cpu is None else self.cpu, self.busy_poll_us,
+                    "hardware" if self.hw_timestamps else "software")
+
+    def stop(self):
+        self.running = False
+        if self.thread:
+            self.thread.join(timeout=2)
+            self.thread = None
+        for key in list(self.selector.get_map().values()):
+            try:
+                key.fileobj.close()
+            except OSError:
+                pass
+        self.selector.close()
+
+    def tune(self, sock, tx_timestamps=False):
+        """Non-blocking, busy-polled, timestamped socket.
+
+        TX timestamps queue on the socket's error queue, which the owner
+        must drain (TxStampTracker) or the socket stays readable forever.
+        """
+        sock.setblocking(False)
+        try:
+            sock.setsockopt(socket.SOL_SOCKET, SO_BUSY_POLL, self.busy_poll_us)
+        except OSError as e:
+            logger.debug("SO_BUSY_POLL refused: %s", e)
+        if sock.type == socket.SOCK_STREAM:
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        return enable_timestamps(sock, tx_timestamps)
+
+    def add(self, sock, callback):
+        """Serve sock on the reflector: callback(sock) runs when it is readable."""
+        self._calls.append((self._add, sock, callback))
+
+    def close(self, sock):
+        """Stop serving sock and close it."""
+        if threading.current_thread() is self.thread:
+            self._close(sock)
+        else:
+            self._calls.append((self._close, sock, None))
+
+    def _add(self, sock, callback):
+        try:
+            self.selector.register(sock, selectors.EVENT_READ, callback)
+        except (KeyError, ValueError, OSError) as e:
+            logger.warning("Cannot register socket: %s", e)
+
+    def _close(self, sock, _=None):
+        try:
+            self.selector.unregister(sock)
+        except (KeyError, ValueError, OSError):
+            pass
+        try:
+            sock.close()
+        except OSError:
+            pass
+
+    def _pin(self):
+        if self.cpu is None:
+            return
+        try:
+            os.sched_setaffinity(0, {self.cpu})     # 0 = calling thread
+        except (OSError, AttributeError) as e:
+            logger.warning("Cannot pin reflector to CPU %d: %s", self.cpu, e)
+
+    def _spin(self):
+        """Poll without blocking until stopped; never yields the CPU."""
+        self._pin()
+        select = self.selector.select
+        calls = self._calls
+        while self.running:
+            while calls:
+                fn, sock, cb = calls.popleft()
+                fn(sock, cb)
+            for key, _ in select(0):
+                try:
+                    key.data(key.fileobj)
+                except Exception:
+                    logger.exception("Reflector callback failed")
+
+
+class TxStampTracker:
+    """Matches error-queue TX timestamps to the echoes that caused them.
+
+    RX and TX times are only compared within one clock: the NIC's (raw
+    hardware) when hardware timestamping is on, the kernel's otherwise.
+    """
+
+    def __init__(self, hardware=False):
+        self.hardware = hardware
+        self.next_id = 0                # OPT_ID of the next send on the socket
+        self.pending = collections.OrderedDict()
+
+    def sent(self, rx_stamps, sink):
+        """Record one send whose RX-to-TX time should go to sink(ns)."""
+        rx_ns = rx_stamps[1] if self.hardware else rx_stamps[0]
+        if rx_ns is not None:
+            self.pending[self.next_id] = (rx_ns, sink)
+            while len(self.pending) > TX_PENDING_MAX:
+                self.pending.popitem(last=False)
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+
+    def drain(self, sock):
+        """Read every queued TX timestamp of sock."""
+        while True:
+            try:
+                _, anc, _, _ = sock.recvmsg(1, CMSG_SPACE, MSG_ERRQUEUE)
+            except OSError:
+                return
+            sw_ns, hw_ns = parse_timestamps(anc)
+            tx_ns = hw_ns if self.hardware else sw_ns
+            if tx_ns is None:
+                continue                # the other clock's report of the same send
+            entry = self.pending.pop(parse_tx_id(anc), None)
+            if entry is not None:
+                rx_ns, sink = entry
+                sink(tx_ns - rx_ns)
+
+
+def now_ns():
+    """CLOCK_REALTIME in ns, the clock software socket timestamps use."""
+    return time.clock_gettime_ns(time.CLOCK_REALTIME)
+
+
+def rx_monotonic_ns(ancdata):
+    """Arrival time on CLOCK_MONOTONIC: the kernel RX stamp, else now.
+
+    Clock offset estimates against the DUT use the monotonic clock, which
+    NTP cannot step; the realtime software stamp is moved onto it.
+    """
+    mono = time.monotonic_ns()
+    sw_ns, _ = parse_timestamps(ancdata)
+    if sw_ns is None:
+        return mono
+    return sw_ns - (now_ns() - mono)
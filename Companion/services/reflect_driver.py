@@ -0,0 +1,334 @@
+"""
+Reflect Driver - L3/L4
+Drives the EFI "Reflector" test: the DUT sits in a tight SNP receive
+loop and bounces ICMP echo requests and UDP datagrams straight back, so
+the traffic originates here and the DUT's slow polling loops are not
+part of what is measured.
+
+PREPARE "L3 REFLECT run=<id> port=<n> size=<n> probes=<n> ms=<n>
+window=<n>" arms a run, START fires it:
+
+  1. ICMP latency: <probes> echo requests one at a time (raw socket,
+     needs root; skipped otherwise). The reply's IP and ICMP checksums
+     are verified here, since the DUT patches them incrementally.
+  2. UDP latency: <probes> datagrams to DUT port <port>, one at a time.
+  3. UDP rate: <ms> of datagrams with <window> in flight; the reflected
+     rate is the DUT's maximum reflect rate for <size>-byte payloads.
+
+RTTs run from just before the send to the kernel RX timestamp, so the
+companion's receive wakeup is not included: what is left is the wire
+both ways plus the DUT's RX-to-TX turnaround.
+"""
+
+import logging
+import os
+import select
+import socket
+import struct
+import threading
+import time
+
+from services.dut_state import DutTable
+from services.lowlat import CMSG_SPACE, enable_timestamps, now_ns, parse_timestamps
+
+logger = logging.getLogger("reflect")
+
+RFL_MAGIC = b"DDTRFLCT"
+RFL_HEADER = struct.Struct("!8sII")      # magic, run id, sequence
+RFL_ICMP_ID = 0xDD48
+RFL_START_DELAY_S = 0.2         # the DUT enters its loop after the START ACK
+RFL_TIMEOUT_S = 0.2             # per probe / per in-flight datagram
+RFL_MAX_PROBES = 100000
+RFL_MAX_MS = 60000
+RFL_MAX_WINDOW = 256
+ICMP_ECHO_REQUEST = 8
+ICMP_ECHO_REPLY = 0
+
+
+def _checksum(data):
+    """RFC 1071 Internet checksum."""
+    if len(data) & 1:
+        data += b"\0"
+    total = sum(struct.unpack(f"!{len(data) // 2}H", data))
+    while total >> 16:
+        total = (total & 0xFFFF) + (total >> 16)
+    return ~total & 0xFFFF
+
+
+def _percentile(sorted_ns, pct):
+    if not sorted_ns:
+        return 0
+    return sorted_ns[min(len(sorted_ns) - 1, len(sorted_ns) * pct // 100)]
+
+
+class _RflRun:
+    """One armed/finished reflect run of a DUT."""
+
+    def __init__(self):
+        self.run_id = None
+        self.port = 7
+        self.size = 64
+        self.probes = 1000
+        self.ms = 3000
+        self.window = 32
+        # ICMP latency phase (icmp_n = -1: no raw socket)
+        self.icmp_n = 0
+        self.icmp_lost = 0
+        self.icmp_bad = 0
+        self.icmp_rtt = []
+        # UDP latency phase
+        self.udp_n = 0
+        self.udp_lost = 0
+        self.udp_bad = 0
+        self.udp_rtt = []
+        # UDP rate phase
+        self.rate_sent = 0
+        self.rate_recv = 0
+        self.rate_us = 0
+        self.done = False
+        self.thread = None
+        self.stop = threading.Event()
+
+
+class ReflectDriver:
+    """Traffic source for the DUT-side ICMP/UDP reflector."""
+
+    per_dut = True
+
+    def __init__(self, local_ip):
+        self.local_ip = local_ip
+        self.runs = DutTable(_RflRun)
+        self.lock = threading.Lock()
+
+    def prepare(self, test, args, dut=None):
+        logger.info("Reflect prepare: %s %s", test, args)
+        self._halt(dut)
+        opts = dict(a.split("=", 1) for a in args.split() if "=" in a)
+        run = self.runs.reset(dut)
+        try:
+            run.run_id = int(opts.get("run", "0"))
+            run.port = int(opts.get("port", "7"))
+            run.size = max(RFL_HEADER.size, min(int(opts.get("size", "64")), 1472))
+            run.probes = min(int(opts.get("probes", "1000")), RFL_MAX_PROBES)
+            run.ms = min(int(opts.get("ms", "3000")), RFL_MAX_MS)
+            run.window = max(1, min(int(opts.get("window", "32")), RFL_MAX_WINDOW))
+        except ValueError:
+            return False, "bad reflect arguments"
+        if dut is None:
+            return False, "reflect needs a DUT address"
+        return True, "OK"
+
+    def start_test(self, dut=None):
+        run = self.runs.get(dut)
+        if run.run_id is None or run.thread is not None:
+            return
+        run.thread = threading.Thread(target=self._drive, args=(run, dut), daemon=True)
+        run.thread.start()
+
+    def stop_test(self, dut=None):
+        self._halt(dut)
+
+    def end_session(self, dut):
+        self._halt(dut)
+        self.runs.drop(dut)
+
+    def get_result(self, dut=None):
+        run = self.runs.get(dut)
+        if run.run_id is None:
+            return None
+        with self.lock:
+            icmp = sorted(run.icmp_rtt)
+            udp = sorted(run.udp_rtt)
+            return (f"rfl_run={run.run_id},"
+                    f"rfl_done={int(run.done)},"
+                    f"rfl_icmp_n={max(run.icmp_n, 0)},"
+                    f"rfl_icmp_raw={int(run.icmp_n >= 0)},"
+                    f"rfl_icmp_lost={run.icmp_lost},"
+                    f"rfl_icmp_bad={run.icmp_bad},"
+                    f"rfl_icmp_min_ns={_percentile(icmp, 0)},"
+                    f"rfl_icmp_p50_ns={_percentile(icmp, 50)},"
+                    f"rfl_icmp_p99_ns={_percentile(icmp, 99)},"
+                    f"rfl_udp_n={run.udp_n},"
+                    f"rfl_udp_lost={run.udp_lost},"
+                    f"rfl_udp_bad={run.udp_bad},"
+                    f"rfl_udp_min_ns={_percentile(udp, 0)},"
+                    f"rfl_udp_p50_ns={_percentile(udp, 50)},"
+                    f"rfl_udp_p99_ns={_percentile(udp, 99)},"
+                    f"rfl_rate_sent={run.rate_sent},"
+                    f"rfl_rate_recv={run.rate_recv},"
+                    f"rfl_rate_us={run.rate_us}")
+
+    def start(self):
+        logger.info("Reflect driver ready (ICMP %s)",
+                    "available" if os.geteuid() == 0 else "needs root")
+
+    def stop(self):
+        for dut in self.runs.duts():
+            self._halt(dut)
+
+    def _halt(self, dut):
+        run = self.runs.get(dut)
+        if run.thread is not None:
+            run.stop.set()
+            run.thread.join(timeout=RFL_MAX_MS / 1000.0 + 5)
+
+    def _drive(self, run, dut):
+        time.sleep(RFL_START_DELAY_S)
+        try:
+            self._icmp_latency(run, dut)
+            if not run.stop.is_set():
+                self._udp_latency(run, dut)
+            if not run.stop.is_set():
+                self._udp_rate(run, dut)
+        except OSError as e:
+            logger.error("Reflect run %d to %s: %s", run.run_id, dut, e)
+        with self.lock:
+            run.done = True
+        logger.info("Reflect run %d to %s: ICMP %d (%d lost), UDP %d (%d lost), "
+                    "rate %d/%d in %.2fs", run.run_id, dut,
+                    max(run.icmp_n, 0), run.icmp_lost, run.udp_n, run.udp_lost,
+                    run.rate_recv, run.rate_sent, run.rate_us / 1e6)
+
+    def _payload(self, run, seq):
+        body = RFL_HEADER.pack(RFL_MAGIC, run.run_id, seq)
+        return body + bytes(i & 0xFF for i in range(len(body), run.size))
+
+    @staticmethod
+    def _wait(sock, deadline):
+        """Receive one datagram before deadline: (data, rx ns) or None."""
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([sock], [], [], left)[0]:
+                return None
+            try:
+                data, anc, _, _ = sock.recvmsg(2048, CMSG_SPACE)
+            except BlockingIOError:
+                continue
+            rx_ns = parse_timestamps(anc)[0]
+            return data, (rx_ns if rx_ns is not None else now_ns())
+
+    def _icmp_latency(self, run, dut):
+        """Echo requests one at a time; checks the patched checksums."""
+        try:
+            sock = socket.socket(socket.AF_INET, socket.SOCK_RAW, socket.IPPROTO_ICMP)
+        except PermissionError:
+            logger.info("Reflect: ICMP phase skipped (raw socket needs root)")
+            run.icmp_n = -1
+            return
+        try:
+            sock.setblocking(False)
+            enable_timestamps(sock)
+            for seq in range(run.probes):
+                if run.stop.is_set():
+                    break
+                payload = self._payload(run, seq)
+                req = struct.pack("!BBHHH", ICMP_ECHO_REQUEST, 0, 0, RFL_ICMP_ID, seq & 0xFFFF)
+                req = req[:2] + struct.pack("!H", _checksum(req + payload)) + req[4:] + payload
+                sent_ns = now_ns()
+                sock.sendto(req, (dut, 0))
+                deadline = time.monotonic() + RFL_TIMEOUT_S
+                while True:
+                    got = self._wait(sock, deadline)
+                    if got is None:
+                        run.icmp_lost += 1
+                        break
+                    data, rx_ns = got
+                    ihl = (data[0] & 0x0F) * 4
+                    if len(data) < ihl + 8 or socket.inet_ntoa(data[12:16]) != dut:
+                        continue
+                    icmp = data[ihl:]
+                    typ, _, _, ident, rseq = struct.unpack_from("!BBHHH", icmp)
+                    if typ != ICMP_ECHO_REPLY or ident != RFL_ICMP_ID or rseq != seq & 0xFFFF:
+                        continue
+                    with self.lock:
+                        if _checksum(data[:ihl]) != 0 or _checksum(icmp) != 0 or \
+                                icmp[8:] != payload:
+                            run.icmp_bad += 1
+                        run.icmp_n += 1
+                        run.icmp_rtt.append(max(rx_ns - sent_ns, 0))
+                    break
+        finally:
+            sock.close()
+
+    def _udp_socket(self, run, dut):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.bind((self.local_ip, 0))
+        sock.connect((dut, run.port))
+        sock.setblocking(False)
+        enable_timestamps(sock)
+        return sock
+
+    def _udp_latency(self, run, dut):
+        """Datagrams one at a time."""
+        sock = self._udp_socket(run, dut)
+        try:
+            for seq in range(run.probes):
+                if run.stop.is_set():
+                    break
+                payload = self._payload(run, seq)
+                sent_ns = now_ns()
+                sock.send(payload)
+                deadline = time.monotonic() + RFL_TIMEOUT_S
+                while True:
+                    got = self._wait(sock, deadline)
+                    if got is None:
+                        run.udp_lost += 1
+                        break
+                    data, rx_ns = got
+                    if len(data) < RFL_HEADER.size:
+                        continue
+                    _, run_id, rseq = RFL_HEADER.unpack_from(data)
+                    if run_id != run.run_id or rseq != seq:
+                        continue
+                    with self.lock:
+                        if data != payload:
+                            run.udp_bad += 1
+                        run.udp_n += 1
+                        run.udp_rtt.append(max(rx_ns - sent_ns, 0))
+                    break
+        finally:
+            sock.close()
+
+    def _udp_rate(self, run, dut):
+        """Keep <window> datagrams in flight for <ms>; count what comes back."""
+        sock = self._udp_socket(run, dut)
+        pending = {}                    # seq -> send time (monotonic)
+        seq = 0
+        start = time.monotonic()
+        end = start + run.ms / 1000.0
+        last_rx = None
+        try:
+            while not run.stop.is_set():
+                now = time.monotonic()
+                if now >= end and not pending:
+                    break
+                while now < end and len(pending) < run.window:
+                    try:
+                        sock.send(self._payload(run, seq))
+                    except BlockingIOError:
+                        break
+                    pending[seq] = now
+                    seq += 1
+
+                if select.select([sock], [], [], 0.01)[0]:
+                    while True:
+                        try:
+                            data = sock.recv(2048)
+                        except BlockingIOError:
+                            break
+                        if len(data) >= RFL_HEADER.size:
+                            _, run_id, rseq = RFL_HEADER.unpack_from(data)
+                            if run_id == run.run_id and pending.pop(rseq, None) is not None:
+                                run.rate_recv += 1
+                                last_rx = time.monotonic()
+
+                # In-flight datagrams past the timeout are lost
+                now = time.monotonic()
+                for old in [s for s, t in pending.items() if now - t > RFL_TIMEOUT_S]:
+                    del pending[old]
+        finally:
+            with self.lock:
+                run.rate_sent = seq
+                # Up to the last reflection: the final timeout wait is not traffic
+                run.rate_us = int(((last_rx or time.monotonic()) - start) * 1e6)
+            sock.close()
@@ -3,45 +3,159 @@ TCP Listener - L4 Transport Layer
 Multi-port TCP listener for connection testing.
 Accepts connections and optionally echoes data.
 Recognizes DDTECHO probe messages and tracks probe statistics.
+Bulk sink/source ports serve the EFI TCP throughput test: the sink
+discards everything it reads, the source streams until the DUT closes.
+PREPARE answers with the two ports, and a prepare resets the bulk
+counters, so the DUT never reads the numbers of an earlier run.
+All counters are kept per DUT (peer IPv4 address).
+Connections are non-blocking and served by the shared event loop, so
+the accept rate is not bounded by thread creation; the peak accepted
+connections per second is reported per DUT (max_cps).
+With a LowLatencyReflector, echo connections are handed to its pinned,
+busy-polling thread (TCP_NODELAY) and echo every segment until the DUT
+closes; the residence time of each echo is reported (tcp_res_ns_*).
 """
 
 import logging
 import socket
+import struct
 import threading
 import time
 
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ, EVENT_WRITE
+from services.lowlat import CMSG_SPACE, now_ns, parse_timestamps
+
 logger = logging.getLogger("tcp")
 
 DDTECHO_PREFIX = b"DDTECHO|"
 
+BULK_CHUNK = 65536
+BULK_MAX_SECONDS = 120
+BULK_SOCK_BUF = 4 * 1024 * 1024
+BULK_BATCH = 16                 # bulk reads/writes per readiness event
+BULK_VIEW = memoryview(bytes(i & 0xFF for i in range(BULK_CHUNK)))
 
-class TcpListener:
-    """Multi-port TCP server for L4 transport layer testing."""
+LISTEN_BACKLOG = 4096           # capped by net.core.somaxconn
+ACCEPT_BATCH = 64               # accepts per readiness event
+IDLE_TIMEOUT = 5.0              # echo / HTTP connections
+BULK_IDLE_TIMEOUT = 10.0
+SWEEP_INTERVAL = 0.5
 
-    def __init__(self, local_ip, ports):
-        self.local_ip = local_ip
-        self.ports = ports
-        self.servers = {}
-        self.threads = []
-        self.running = False
+
+class _AcceptRate:
+    """Accepted connections per one-second window and the peak seen."""
+
+    def __init__(self):
+        self.window = None
+        self.in_window = 0
+        self.max_cps = 0
+
+    def count(self, now):
+        if self.window is None or now - self.window >= 1.0:
+            self.window = now
+            self.in_window = 0
+        self.in_window += 1
+        if self.in_window > self.max_cps:
+            self.max_cps = self.in_window
+
+
+class _TcpDutStats:
+    """TCP counters of one DUT."""
+
+    def __init__(self):
         self.connection_count = 0
+        self.accepts = _AcceptRate()
         # Probe tracking
         self.probe_count = 0
         self.probe_last_id = None
         self.probe_last_time = None
+        # Bulk transfer tracking (last completed session per direction)
+        self.sink_bytes = 0
+        self.sink_mbps = 0.0
+        self.sink_us = 0
+        self.source_bytes = 0
+        self.source_mbps = 0.0
+        self.source_us = 0
+        self.source_retrans = 0
+        # Low-latency echo residence (RX stamp -> send)
+        self.ll_echoes = 0
+        self.ll_res_sum = 0
+        self.ll_res_max = 0
+
+
+class _TcpConn:
+    """State of one accepted, non-blocking connection."""
+
+    def __init__(self, sock, addr, port, mode, timeout):
+        self.sock = sock
+        self.addr = addr
+        self.port = port
+        self.mode = mode            # "echo", "http", "sink" or "source"
+        self.timeout = timeout
+        self.out = b""              # pending echo/HTTP response
+        self.total = 0              # bulk bytes moved
+        self.start = time.monotonic()
+        self.deadline = self.start + timeout
+
+
+class TcpListener:
+    """Multi-port TCP server for L4 transport layer testing."""
+
+    per_dut = True
+
+    def __init__(self, loop, local_ip, ports, sink_port=None, source_port=None,
+                 reflector=None):
+        self.loop = loop
+        self.reflector = reflector
+        self.local_ip = local_ip
+        self.sink_port = sink_port
+        self.source_port = source_port
+        self.ports = list(ports) + [p for p in (sink_port, source_port)
+                                    if p and p not in ports]
+        self.servers = {}
+        self.conns = set()          # loop thread only
+        self.ll_conns = {}          # socket -> _TcpConn served by the reflector
+        self.sweep = None
+        self.running = False
+        self.stats = DutTable(_TcpDutStats)
+        self.accepts = _AcceptRate()
         self.lock = threading.Lock()
 
-    def prepare(self, test, args):
-        logger.info("TCP prepare: %s", test)
-        return True, "OK"
+    def prepare(self, test, args, dut=None):
+        logger.info("TCP prepare: %s (%s)", test, dut)
+        if not (self.sink_port and self.source_port):
+            return True, "OK"
+        st = self.stats.get(dut)
+        with self.lock:
+            st.sink_bytes = st.source_bytes = 0
+            st.sink_mbps = st.source_mbps = 0.0
+            st.sink_us = st.source_us = 0
+            st.source_retrans = 0
+        return True, f"OK sink_port={self.sink_port},source_port={self.source_port}"
 
-    def stop_test(self):
+    def stop_test(self, dut=None):
         pass
 
-    def get_result(self):
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        st = self.stats.get(dut)
         with self.lock:
-            return (f"connections={self.connection_count},"
-                    f"probes={self.probe_count}")
+            return (f"connections={st.connection_count},"
+                    f"max_cps={st.accepts.max_cps},"
+                    f"probes={st.probe_count},"
+                    f"sink_bytes={st.sink_bytes},"
+                    f"sink_mbps={st.sink_mbps:.1f},"
+                    f"sink_us={st.sink_us},"
+                    f"source_bytes={st.source_bytes},"
+                    f"source_mbps={st.source_mbps:.1f},"
+                    f"source_us={st.source_us},"
+                    f"source_retrans={st.source_retrans},"
+                    f"tcp_ll_echoes={st.ll_echoes},"
+                    f"tcp_res_ns_avg={st.ll_res_sum // max(st.ll_echoes, 1)},"
+                    f"tcp_res_ns_max={st.ll_res_max}")
 
     def start(self):
         """Start TCP listeners on all configured ports."""
@@ -50,50 +164,102 @@ class TcpListener:
             try:
                 srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
                 srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-                srv.settimeout(1.0)
+                if port in (self.sink_port, self.source_port):
+                    # Must be set before listen() to be inherited and to
+                    # allow a large window scale in the SYN-ACK
+                    srv.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, BULK_SOCK_BUF)
+                    srv.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, BULK_SOCK_BUF)
                 srv.bind((self.local_ip, port))
-                srv.listen(5)
+                srv.listen(LISTEN_BACKLOG)
                 self.servers[port] = srv
-
-                t = threading.Thread(
-                    target=self._accept_loop, args=(srv, port), daemon=True)
-                t.start()
-                self.threads.append(t)
+                self.loop.add(srv, EVENT_READ,
+                              lambda s, m, port=port: self._on_accept(s, port))
                 logger.info("TCP listening on %s:%d", self.local_ip, port)
             except OSError as e:
                 logger.warning("TCP bind %d failed: %s", port, e)
+        self.sweep = self.loop.call_every(SWEEP_INTERVAL, self._expire_conns)
 
     def stop(self):
-        """Stop all TCP listeners."""
+        """Stop all TCP listeners and drop open connections."""
         self.running = False
-        for port, srv in self.servers.items():
-            try:
-                srv.close()
-            except OSError:
-                pass
+        if self.sweep:
+            self.sweep.cancel()
+            self.sweep = None
+        for srv in self.servers.values():
+            self.loop.close(srv)
         self.servers.clear()
-        for t in self.threads:
-            t.join(timeout=2)
-        self.threads.clear()
+        self.loop.run_in_loop(self._close_all)
+        logger.info("TCP peak accept rate: %d connections/s", self.accepts.max_cps)
+
+    def _close_all(self):
+        for conn in list(self.conns):
+            self._close(conn)
+        for conn in list(self.ll_conns.values()):
+            self._ll_close(conn)
 
-    def _accept_loop(self, server, port):
-        """Accept incoming TCP connections."""
-        while self.running:
+    def _on_accept(self, server, port):
+        """Accept the pending connections of one listening port."""
+        for _ in range(ACCEPT_BATCH):
             try:
                 client, addr = server.accept()
-            except socket.timeout:
-                continue
             except OSError:
-                break
+                return
 
+            now = time.monotonic()
+            st = self.stats.get(addr[0])
             with self.lock:
-                self.connection_count += 1
+                st.connection_count += 1
+                st.accepts.count(now)
+                self.accepts.count(now)
             logger.debug("TCP connection from %s on port %d", addr, port)
 
-            t = threading.Thread(
-                target=self._handle_client, args=(client, addr, port),
-                daemon=True)
-            t.start()
+            if port == self.sink_port:
+                conn = _TcpConn(client, addr, port, "sink", BULK_IDLE_TIMEOUT)
+                events = EVENT_READ
+            elif port == self.source_port:
+                conn = _TcpConn(client, addr, port, "source", BULK_IDLE_TIMEOUT)
+                events = EVENT_READ | EVENT_WRITE
+            elif port not in (80, 8080) and self.reflector:
+                conn = _TcpConn(client, addr, port, "echo", IDLE_TIMEOUT)
+                self.reflector.tune(client)
+                self.ll_conns[client] = conn
+                self.reflector.add(client, self._ll_echo)
+                continue
+            else:
+                # Port 80/8080 answer with minimal HTTP, the rest echo
+                mode = "http" if port in (80, 8080) else "echo"
+                conn = _TcpConn(client, addr, port, mode, IDLE_TIMEOUT)
+                events = EVENT_READ
+            self.conns.add(conn)
+            self.loop.add(client, events,
+                          lambda s, m, conn=conn: self._on_conn(conn, m))
+
+    def _on_conn(self, conn, mask):
+        """Readiness on an accepted connection."""
+        conn.deadline = time.monotonic() + conn.timeout
+        if conn.mode == "sink":
+            self._sink_ready(conn)
+        elif conn.mode == "source":
+            self._source_ready(conn, mask)
+        elif conn.out:
+            self._flush(conn)
+        else:
+            self._request_ready(conn)
+
+    def _expire_conns(self):
+        """Close idle connections and bulk sources past their time limit."""
+        now = time.monotonic()
+        for conn in list(self.conns):
+            if now > conn.deadline or (conn.mode == "source" and
+                                       now - conn.start >= BULK_MAX_SECONDS):
+                self._finish(conn)
+        for conn in list(self.ll_conns.values()):
+            if now > conn.deadline:
+                self._ll_close(conn)
+
+    def _close(self, conn):
+        self.conns.discard(conn)
+        self.loop.close(conn.sock)
 
     def _parse_probe(self, data):
         """Parse DDTECHO probe payload.
@@ -117,64 +283,194 @@ class TcpListener:
         except Exception:
             return None
 
-    def _handle_client(self, client, addr, port):
-        """Handle a single TCP connection with echo behavior."""
-        client.settimeout(5.0)
+    def _request_ready(self, conn):
+        """Read the one request of an echo/HTTP connection and answer it."""
+        client, addr, port = conn.sock, conn.addr, conn.port
         try:
-            # For port 80/8080 - respond with minimal HTTP
-            if port in (80, 8080):
-                try:
-                    request = client.recv(4096)
-                    req_str = request.decode("ascii", errors="replace")
-
-                    if "GET" in req_str:
-                        path = req_str.split()[1] if len(req_str.split()) > 1 else "/"
-                        status, body = self._http_response(path)
-                        response = (
-                            f"HTTP/1.1 {status}\r\n"
-                            f"Content-Length: {len(body)}\r\n"
-                            f"Content-Type: text/plain\r\n"
-                            f"Server: DDTSoft-Companion/1.0\r\n"
-                            f"Connection: close\r\n"
-                            f"\r\n"
-                            f"{body}"
-                        )
-                        client.sendall(response.encode("ascii"))
-                except (socket.timeout, ConnectionResetError):
-                    pass
+            data = client.recv(4096)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b""
+        if not data:
+            self._close(conn)
+            return
+
+        if conn.mode == "http":
+            req_str = data.decode("ascii", errors="replace")
+            if "GET" not in req_str:
+                self._close(conn)
+                return
+            path = req_str.split()[1] if len(req_str.split()) > 1 else "/"
+            status, body = self._http_response(path, addr[0])
+            response = (
+                f"HTTP/1.1 {status}\r\n"
+                f"Content-Length: {len(body)}\r\n"
+                f"Content-Type: text/plain\r\n"
+                f"Server: DDTSoft-Companion/1.0\r\n"
+                f"Connection: close\r\n"
+                f"\r\n"
+                f"{body}"
+            )
+            conn.out = response.encode("ascii")
+        else:
+            # Echo mode for other ports (22, 443, etc.)
+            probe = self._parse_probe(data)
+            if probe is not None:
+                seq_id, ts = probe
+                st = self.stats.get(addr[0])
+                with self.lock:
+                    st.probe_count += 1
+                    st.probe_last_id = seq_id
+                    st.probe_last_time = time.time()
+                logger.info(
+                    "TCP PROBE #%s from %s:%d port %d (total: %d)",
+                    seq_id, addr[0], addr[1], port, st.probe_count)
             else:
-                # Echo mode for other ports (22, 443, etc.)
+                logger.debug("TCP echo %d bytes from %s port %d",
+                             len(data), addr, port)
+            conn.out = data
+        self._flush(conn)
+
+    def _flush(self, conn):
+        """Send the pending response; close once it is out."""
+        try:
+            while conn.out:
+                conn.out = conn.out[conn.sock.send(conn.out):]
+        except BlockingIOError:
+            self.loop.modify(conn.sock, EVENT_WRITE,
+                             lambda s, m, conn=conn: self._on_conn(conn, m))
+            return
+        except OSError:
+            pass
+        self._close(conn)
+
+    def _ll_close(self, conn):
+        if self.ll_conns.pop(conn.sock, None) is not None:
+            self.reflector.close(conn.sock)
+
+    def _ll_echo(self, sock):
+        """Reflector thread: echo what arrived right away (RFC 862)."""
+        conn = self.ll_conns.get(sock)
+        if conn is None:
+            return
+        try:
+            data, anc, _, _ = sock.recvmsg(65536, CMSG_SPACE)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b""
+        if not data:
+            self._ll_close(conn)
+            return
+
+        rx_ns = parse_timestamps(anc)[0]
+        view = memoryview(data)
+        try:
+            while view:
+                try:
+                    view = view[sock.send(view):]
+                except BlockingIOError:
+                    continue            # spin: the reflector owns this CPU
+        except OSError:
+            self._ll_close(conn)
+            return
+
+        conn.deadline = time.monotonic() + conn.timeout
+        res = max(now_ns() - rx_ns, 0) if rx_ns is not None else None
+        st = self.stats.get(conn.addr[0])
+        with self.lock:
+            if data.startswith(DDTECHO_PREFIX):
+                st.probe_count += 1
+                st.probe_last_time = time.time()
+            if res is not None:
+                st.ll_echoes += 1
+                st.ll_res_sum += res
+                st.ll_res_max = max(st.ll_res_max, res)
+
+    def _sink_ready(self, conn):
+        """Read and discard; the DUT closing ends the session."""
+        for _ in range(BULK_BATCH):
+            try:
+                data = conn.sock.recv(BULK_CHUNK)
+            except BlockingIOError:
+                return
+            except OSError:
+                data = b""
+            if not data:
+                self._finish(conn)
+                return
+            conn.total += len(data)
+
+    def _source_ready(self, conn, mask):
+        """Stream the pattern until the DUT closes or the time limit hits."""
+        if mask & EVENT_READ:
+            try:
+                if not conn.sock.recv(4096):
+                    self._finish(conn)
+                    return
+            except BlockingIOError:
+                pass
+            except OSError:
+                self._finish(conn)
+                return
+        if mask & EVENT_WRITE:
+            for _ in range(BULK_BATCH):
                 try:
-                    data = client.recv(4096)
-                    if data:
-                        # Check for DDTECHO probe
-                        probe = self._parse_probe(data)
-                        if probe is not None:
-                            seq_id, ts = probe
-                            with self.lock:
-                                self.probe_count += 1
-                                self.probe_last_id = seq_id
-                                self.probe_last_time = time.time()
-                            logger.info(
-                                "TCP PROBE #%s from %s:%d port %d (total: %d)",
-                                seq_id, addr[0], addr[1], port,
-                                self.probe_count)
-                        else:
-                            logger.debug("TCP echo %d bytes from %s port %d",
-                                         len(data), addr, port)
-                        client.sendall(data)
-                except (socket.timeout, ConnectionResetError):
-                    pass
-        finally:
-            client.close()
-
-    def _http_response(self, path):
+                    conn.total += conn.sock.send(
+                        BULK_VIEW[conn.total % BULK_CHUNK:])
+                except BlockingIOError:
+                    return
+                except OSError:
+                    self._finish(conn)
+                    return
+
+    def _finish(self, conn):
+        """Close a connection; bulk sessions record their goodput."""
+        if conn not in self.conns:
+            return
+        elapsed = max(time.monotonic() - conn.start, 1e-6)
+        addr, total = conn.addr, conn.total
+        mbps = total * 8 / elapsed / 1e6
+        if conn.mode == "sink":
+            self._close(conn)
+            st = self.stats.get(addr[0])
+            with self.lock:
+                st.sink_bytes = total
+                st.sink_mbps = mbps
+                st.sink_us = int(elapsed * 1e6)
+            logger.info("TCP sink from %s: %d bytes in %.2fs (%.1f Mbps)",
+                        addr[0], total, elapsed, mbps)
+        elif conn.mode == "source":
+            retrans = self._tcp_total_retrans(conn.sock)
+            self._close(conn)
+            st = self.stats.get(addr[0])
+            with self.lock:
+                st.source_bytes = total
+                st.source_mbps = mbps
+                st.source_us = int(elapsed * 1e6)
+                st.source_retrans = retrans
+            logger.info("TCP source to %s: %d bytes in %.2fs (%.1f Mbps, %d retrans)",
+                        addr[0], total, elapsed, mbps, retrans)
+        else:
+            self._close(conn)
+
+    @staticmethod
+    def _tcp_total_retrans(sock):
+        """Read tcpi_total_retrans from TCP_INFO (Linux), -1 if unavailable."""
+        try:
+            info = sock.getsockopt(socket.IPPROTO_TCP, socket.TCP_INFO, 104)
+            return struct.unpack("8B24I", info[:104])[-1]
+        except (OSError, AttributeError, struct.error):
+            return -1
+
+    def _http_response(self, path, dut):
         """Generate HTTP response based on path."""
         if path == "/" or path == "/index.html":
             return "200 OK", "DDTSoft Test Companion OK"
         elif "404" in path or "nonexistent" in path:
             return "404 Not Found", "Not Found"
         elif "status" in path:
-            return "200 OK", f"connections={self.connection_count}"
+            return "200 OK", f"connections={self.stats.get(dut).connection_count}"
         else:
             return "200 OK", f"Path: {path}"
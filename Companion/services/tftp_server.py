@@ -0,0 +1,339 @@
+"""
+TFTP Server - L7 Application Layer
+Read-only TFTP server (RFC 1350) for the EFI MTFTP4 throughput test.
+
+Supports the blksize (RFC 2348), timeout and tsize (RFC 2349) and
+windowsize (RFC 7440) options. Files are virtual: bytes/<N>[K|M|G] is
+an N-byte pattern body, the same as HTTP /bytes/<N>, so no file store
+is needed. Block numbers roll over past 65535, so any size fits.
+
+The well-known port is served on the shared event loop. Each transfer
+runs on its own thread with its own socket (its TID): it sends a window
+of blocks and waits for the ACK of the last block received in order,
+resuming from there. On timeout it resends the unacknowledged window.
+The last transfer of each DUT is reported with the options it ran with.
+"""
+
+import logging
+import socket
+import struct
+import threading
+import time
+
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ
+from services.http_server import parse_bytes_path
+
+logger = logging.getLogger("tftp")
+
+OP_RRQ = 1
+OP_WRQ = 2
+OP_DATA = 3
+OP_ACK = 4
+OP_ERROR = 5
+OP_OACK = 6
+
+ERR_NOT_FOUND = 1
+ERR_ACCESS = 2
+ERR_ILLEGAL = 4
+ERR_OPTION = 8
+
+DEFAULT_BLKSIZE = 512
+MIN_BLKSIZE = 8
+MAX_BLKSIZE = 65464             # largest that fits one IPv4 UDP datagram
+MAX_WINDOW = 65535
+DEFAULT_TIMEOUT_S = 1
+MAX_TRIES = 5                   # sends of one window before giving up
+RX_BATCH = 64
+PATTERN = bytes(i & 0xFF for i in range(MAX_BLKSIZE + 256))
+
+
+class _TftpStats:
+    """Transfer counters of one DUT."""
+
+    def __init__(self):
+        self.transfers = 0
+        self.completed = 0
+        self.failed = 0
+        self.bytes = 0
+        self.retransmits = 0
+        # Last transfer
+        self.last_blksize = 0
+        self.last_window = 0
+        self.last_retx = 0
+        self.last_us = 0
+
+
+def _parse_rrq(data):
+    """Return (filename, mode, {option: value}) of an RRQ/WRQ body."""
+    fields = data[2:].split(b"\0")
+    if len(fields) < 3:
+        raise ValueError("truncated request")
+    name = fields[0].decode("ascii", errors="replace")
+    mode = fields[1].decode("ascii", errors="replace").lower()
+    opts = {}
+    for i in range(2, len(fields) - 1, 2):
+        if fields[i]:
+            opts[fields[i].decode("ascii", errors="replace").lower()] = \
+                fields[i + 1].decode("ascii", errors="replace")
+    return name, mode, opts
+
+
+def _error(code, message):
+    return struct.pack("!HH", OP_ERROR, code) + message.encode("ascii") + b"\0"
+
+
+class TftpServer:
+    """Read-only TFTP server with the RFC 2348/2349/7440 options."""
+
+    per_dut = True
+
+    def __init__(self, loop, local_ip, port):
+        self.loop = loop
+        self.local_ip = local_ip
+        self.port = port
+        self.sock = None
+        self.running = False
+        self.stats = DutTable(_TftpStats)
+        self.lock = threading.Lock()
+        self.active = set()             # client (ip, port) with a transfer running
+
+    def prepare(self, test, args, dut=None):
+        logger.info("TFTP prepare: %s (%s)", test, dut)
+        if self.sock is None:
+            return False, "TFTP server not running"
+        self.stats.reset(dut)
+        return True, "OK"
+
+    def stop_test(self, dut=None):
+        pass
+
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        st = self.stats.get(dut)
+        with self.lock:
+            return (f"tftp_transfers={st.transfers},"
+                    f"tftp_completed={st.completed},"
+                    f"tftp_failed={st.failed},"
+                    f"tftp_bytes={st.bytes},"
+                    f"tftp_retx={st.retransmits},"
+                    f"tftp_last_blksize={st.last_blksize},"
+                    f"tftp_last_window={st.last_window},"
+                    f"tftp_last_retx={st.last_retx},"
+                    f"tftp_last_us={st.last_us}")
+
+    def start(self):
+        """Start TFTP server."""
+        try:
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            self.sock.bind((self.local_ip, self.port))
+        except OSError as e:
+            logger.warning("TFTP bind %s:%d failed: %s", self.local_ip, self.port, e)
+            self.sock = None
+            return
+
+        self.running = True
+        self.loop.add(self.sock, EVENT_READ, self._on_readable)
+        logger.info("TFTP server on %s:%d (bytes/<N>, blksize/tsize/timeout/windowsize)",
+                    self.local_ip, self.port)
+
+    def stop(self):
+        self.running = False
+        if self.sock:
+            self.loop.close(self.sock)
+            self.sock = None
+
+    def _on_readable(self, sock, mask):
+        """Start a transfer thread for each pending read request."""
+        for _ in range(RX_BATCH):
+            try:
+                data, addr = sock.recvfrom(4096)
+            except OSError:
+                return
+            if len(data) < 4:
+                continue
+
+            opcode = struct.unpack("!H", data[:2])[0]
+            if opcode == OP_WRQ:
+                self._reply(sock, _error(ERR_ACCESS, "read-only server"), addr)
+                continue
+            if opcode != OP_RRQ:
+                continue
+            try:
+                name, mode, opts = _parse_rrq(data)
+            except ValueError:
+                self._reply(sock, _error(ERR_ILLEGAL, "malformed request"), addr)
+                continue
+
+            size = parse_bytes_path("/" + name.lstrip("/"))
+            if size is None:
+                self._reply(sock, _error(ERR_NOT_FOUND, "only bytes/<N> files"), addr)
+                continue
+            if mode != "octet":
+                self._reply(sock, _error(ERR_ILLEGAL, "octet mode only"), addr)
+                continue
+
+            # A retransmitted RRQ must not start a second transfer
+            with self.lock:
+                if addr in self.active:
+                    continue
+                self.active.add(addr)
+            threading.Thread(target=self._transfer, args=(addr, name, size, opts),
+                             daemon=True).start()
+
+    @staticmethod
+    def _reply(sock, packet, addr):
+        try:
+            sock.sendto(packet, addr)
+        except OSError:
+            pass
+
+    @staticmethod
+    def _negotiate(opts, size):
+        """Accepted options (None if one is invalid): blksize, window, timeout, OACK."""
+        blksize, window, timeout = DEFAULT_BLKSIZE, 1, DEFAULT_TIMEOUT_S
+        oack = {}
+        try:
+            if "blksize" in opts:
+                blksize = min(int(opts["blksize"]), MAX_BLKSIZE)
+                if blksize < MIN_BLKSIZE:
+                    return None
+                oack["blksize"] = blksize
+            if "windowsize" in opts:
+                window = min(int(opts["windowsize"]), MAX_WINDOW)
+                if window < 1:
+                    return None
+                oack["windowsize"] = window
+            if "timeout" in opts:
+                timeout = int(opts["timeout"])
+                if not 1 <= timeout <= 255:
+                    return None
+                oack["timeout"] = timeout
+            if "tsize" in opts:
+                oack["tsize"] = size
+        except ValueError:
+            return None
+        return blksize, window, timeout, oack
+
+    def _transfer(self, addr, name, size, opts):
+        """Serve one RRQ from a new socket until the last block is ACKed."""
+        dut = addr[0]
+        st = self.stats.get(dut)
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        try:
+            sock.bind((self.local_ip, 0))
+            sock.connect(addr)
+            negotiated = self._negotiate(opts, size)
+            if negotiated is None:
+                sock.send(_error(ERR_OPTION, "bad option value"))
+                return
+            blksize, window, timeout, oack = negotiated
+            sock.settimeout(timeout)
+
+            with self.lock:
+                st.transfers += 1
+            start = time.perf_counter()
+            retx = 0
+            ok = False
+            try:
+                if oack:
+                    body = b"".join(k.encode() + b"\0" + str(v).encode() + b"\0"
+                                    for k, v in oack.items())
+                    retx += self._send_window(sock, [struct.pack("!H", OP_OACK) + body], 0,
+                                              timeout)
+                ok, sent_retx = self._send_file(sock, size, blksize, window)
+                retx += sent_retx
+            except OSError as e:
+                logger.info("TFTP %s to %s aborted: %s", name, dut, e)
+            elapsed = time.perf_counter() - start
+
+            with self.lock:
+                st.retransmits += retx
+                st.last_blksize = blksize
+                st.last_window = window
+                st.last_retx = retx
+                st.last_us = int(elapsed * 1e6)
+                if ok:
+                    st.completed += 1
+                    st.bytes += size
+                else:
+                    st.failed += 1
+            if ok:
+                logger.info("TFTP %s to %s: blksize %d window %d in %.2fs (%.1f Mbps, %d resent)",
+                            name, dut, blksize, window, elapsed,
+                            size * 8 / max(elapsed, 1e-6) / 1e6, retx)
+        except OSError as e:
+            logger.warning("TFTP transfer to %s failed: %s", dut, e)
+        finally:
+            sock.close()
+            with self.lock:
+                self.active.discard(addr)
+
+    @staticmethod
+    def _send_window(sock, packets, ack_block, timeout):
+        """Send packets until ACK ack_block arrives; returns the resends."""
+        for tries in range(MAX_TRIES):
+            for pkt in packets:
+                sock.send(pkt)
+            deadline = time.monotonic() + timeout
+            while time.monotonic() < deadline:
+                try:
+                    data = sock.recv(516)
+                except socket.timeout:
+                    break
+                if len(data) >= 4:
+                    opcode, block = struct.unpack("!HH", data[:4])
+                    if opcode == OP_ERROR:
+                        raise OSError(f"client error {block}")
+                    if opcode == OP_ACK and block == ack_block:
+                        return tries * len(packets)
+        raise socket.timeout(f"no ACK {ack_block}")
+
+    @staticmethod
+    def _send_file(sock, size, blksize, window):
+        """Windowed DATA send (RFC 7440); returns (completed, resent blocks)."""
+        last = size // blksize + 1          # a final short (maybe empty) block
+        base = 1                            # first unacknowledged block
+        tries = 0
+        retx = 0
+        timeout = sock.gettimeout()
+        while base <= last:
+            end = min(base + window - 1, last)
+            for blk in range(base, end + 1):
+                offset = (blk - 1) * blksize
+                n = min(blksize, size - offset)
+                pos = offset & 0xFF
+                sock.send(struct.pack("!HH", OP_DATA, blk & 0xFFFF) + PATTERN[pos:pos + n])
+            if tries:
+                retx += end - base + 1
+
+            # ACK of the last block in order; older ACKs are stale
+            acked = None
+            deadline = time.monotonic() + timeout
+            while acked is None and time.monotonic() < deadline:
+                try:
+                    data = sock.recv(516)
+                except socket.timeout:
+                    break
+                if len(data) < 4:
+                    continue
+                opcode, num = struct.unpack("!HH", data[:4])
+                if opcode == OP_ERROR:
+                    return False, retx
+                if opcode == OP_ACK:
+                    ahead = (num - (base - 1)) & 0xFFFF
+                    if 0 < ahead <= end - base + 1:
+                        acked = base - 1 + ahead
+            if acked is None:
+                tries += 1
+                if tries >= MAX_TRIES:
+                    return False, retx
+                continue
+            # The client saw a gap: the rest of the window goes again
+            retx += end - acked
+            tries = 0
+            base = acked + 1
+        return True, retx
@@ -0,0 +1,112 @@
+"""
+TLS Certificates - L7 Application Layer
+Test CA and server certificate of the companion HTTPS endpoint.
+
+The companion signs its own server certificate with a locally
+generated, self-signed CA, made with the openssl command-line tool the
+first time HTTPS is enabled and reused afterwards. The server
+certificate carries the companion IP as subjectAltName, so firmware TLS
+stacks that check the host name accept it once the CA is trusted.
+
+The CA is also written in DER form (ca.der). HTTP serves it at /ca.der
+so the EFI side can enroll it in the TlsCaCertificate variable. It is a
+test CA: never enroll it on a machine outside the lab.
+"""
+
+import logging
+import os
+import secrets
+import shutil
+import subprocess
+
+logger = logging.getLogger("tls_certs")
+
+CA_SUBJECT = "/O=DDTSoft/CN=DDTSoft Companion Test CA"
+CA_DAYS = 3650
+SERVER_DAYS = 825               # longest lifetime TLS clients accept
+KEY_ARGS = {
+    "rsa": ["-newkey", "rsa:2048"],
+    "ec": ["-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1"],
+}
+
+
+class TlsCerts:
+    """Paths of the CA and the server certificate for one companion IP."""
+
+    def __init__(self, cert_dir, ip, key_type="rsa"):
+        self.cert_dir = cert_dir
+        self.ip = ip
+        self.key_type = key_type if key_type in KEY_ARGS else "rsa"
+        self.ca_key = os.path.join(cert_dir, "ca.key")
+        self.ca_pem = os.path.join(cert_dir, "ca.pem")
+        self.ca_der = os.path.join(cert_dir, "ca.der")
+        name = f"server-{ip}-{self.key_type}"
+        self.server_key = os.path.join(cert_dir, name + ".key")
+        self.server_pem = os.path.join(cert_dir, name + ".pem")
+
+    def ensure(self):
+        """Create whatever is missing; False if the certificates are unavailable."""
+        if self._have(self.server_pem, self.server_key, self.ca_der):
+            return True
+        if shutil.which("openssl") is None:
+            logger.warning("openssl not found - cannot create HTTPS certificates")
+            return False
+        try:
+            os.makedirs(self.cert_dir, mode=0o700, exist_ok=True)
+            if not self._have(self.ca_pem, self.ca_key):
+                self._make_ca()
+            if not self._have(self.ca_der):
+                self._openssl("x509", "-in", self.ca_pem, "-outform", "DER",
+                              "-out", self.ca_der)
+            self._make_server()
+        except (OSError, subprocess.CalledProcessError) as e:
+            logger.error("Certificate generation failed: %s", e)
+            return False
+        return True
+
+    def ca_bytes(self):
+        """DER encoding of the CA certificate."""
+        with open(self.ca_der, "rb") as f:
+            return f.read()
+
+    @staticmethod
+    def _have(*paths):
+        return all(os.path.exists(p) for p in paths)
+
+    @staticmethod
+    def _openssl(*args):
+        subprocess.run(["openssl", *args], check=True,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+
+    def _make_ca(self):
+        self._openssl("req", "-x509", "-nodes", *KEY_ARGS[self.key_type],
+                      "-keyout", self.ca_key, "-out", self.ca_pem,
+                      "-days", str(CA_DAYS), "-subj", CA_SUBJECT,
+                      "-addext", "basicConstraints=critical,CA:TRUE",
+                      "-addext", "keyUsage=critical,keyCertSign,cRLSign")
+        os.chmod(self.ca_key, 0o600)
+        logger.info("Created test CA %s", self.ca_pem)
+
+    def _make_server(self):
+        csr = self.server_pem + ".csr"
+        ext = self.server_pem + ".ext"
+        with open(ext, "w") as f:
+            f.write(f"subjectAltName=IP:{self.ip}\n"
+                    "basicConstraints=critical,CA:FALSE\n"
+                    "keyUsage=critical,digitalSignature,keyEncipherment\n"
+                    "extendedKeyUsage=serverAuth\n")
+        try:
+            self._openssl("req", "-new", "-nodes", *KEY_ARGS[self.key_type],
+                          "-keyout", self.server_key, "-out", csr,
+                          "-subj", f"/O=DDTSoft/CN={self.ip}")
+            os.chmod(self.server_key, 0o600)
+            self._openssl("x509", "-req", "-in", csr, "-CA", self.ca_pem,
+                          "-CAkey", self.ca_key,
+                          "-set_serial", str(secrets.randbits(63)),
+                          "-days", str(SERVER_DAYS), "-sha256",
+                          "-extfile", ext, "-out", self.server_pem)
+        finally:
+            for path in (csr, ext):
+                if os.path.exists(path):
+                    os.remove(path)
+        logger.info("Created %s server certificate for %s", self.key_type, self.ip)
@@ -2,72 +2,186 @@
 UDP Echo Server - L4 Transport Layer
 Echoes back UDP packets for testing.
 Recognizes DDTECHO probe messages and tracks probe statistics.
+Sequence-numbered DDTUDPT datagrams (EFI "UDP Throughput" test) are
+accounted for instead of echoed: received, gaps, reordering, duplicates.
+DDTLATE| latency probes are echoed with the companion's residence time
+(kernel RX timestamp to reply send, in ns) written into the reply, so
+the DUT can subtract it from its RTT.
+DDTOWDP| one-way delay probes are echoed with their CLOCK_MONOTONIC
+arrival and departure times; with the clock offset the DUT estimates
+over the control channel (TIME) it splits the RTT into both directions.
+All counters are kept per DUT (source IPv4 address).
+With a LowLatencyReflector the socket is served by its pinned,
+busy-polling thread instead of the shared event loop.
 """
 
 import logging
 import socket
+import struct
 import threading
 import time
 
+from services.dut_state import DutTable
+from services.event_loop import EVENT_READ
+from services.lowlat import CMSG_SPACE, TxStampTracker, enable_timestamps, \
+    now_ns, parse_timestamps, rx_monotonic_ns
+
 logger = logging.getLogger("udp_echo")
 
 DDTECHO_PREFIX = b"DDTECHO|"
 
+# Throughput datagram header: magic, run id, sequence (big-endian)
+UDPT_MAGIC = b"DDTUDPT|"
+UDPT_HEADER = struct.Struct("!8sII")
+UDPT_MAX_SEQ = 1 << 26          # caps the seen-bitmap at 8 MB
+UDPT_RCVBUF = 8 * 1024 * 1024
+RX_BATCH = 256                  # datagrams drained per readiness event
 
-class UdpEcho:
-    """UDP echo server for L4 transport layer testing."""
+# Latency probe: magic, sequence, residence ns (zero from the DUT, filled
+# in by the companion), big-endian
+LAT_MAGIC = b"DDTLATE|"
+LAT_HEADER = struct.Struct("!8sII")
+LAT_RES_OFFSET = 12
 
-    def __init__(self, local_ip, port):
-        self.local_ip = local_ip
-        self.port = port
-        self.sock = None
-        self.thread = None
-        self.running = False
+# One-way delay probe: magic, sequence, reserved, DUT send time (us, DUT
+# clock), companion arrival and departure (CLOCK_MONOTONIC ns), big-endian
+OWD_MAGIC = b"DDTOWDP|"
+OWD_HEADER = struct.Struct("!8sIIQQQ")
+OWD_RX_OFFSET = 24
+
+
+class _UdpDutStats:
+    """UDP counters of one DUT."""
+
+    def __init__(self):
         self.packet_count = 0
         self.bytes_received = 0
         # Probe tracking
         self.probe_count = 0
         self.probe_last_id = None
         self.probe_last_time = None
-        self.probe_sources = {}   # addr -> count
+        # Latency probes: residence (RX stamp -> send) and RX stamp -> TX stamp
+        self.lat_echoes = 0
+        self.lat_res_sum = 0
+        self.lat_res_max = 0
+        self.lat_wire_count = 0
+        self.lat_wire_sum = 0
+        self.lat_wire_max = 0
+        # One-way delay probes
+        self.owd_echoes = 0
+        # Sequenced throughput run
+        self.udpt_reset(None)
+
+    def udpt_reset(self, run_id):
+        """Start accounting for a new throughput run (caller holds lock)."""
+        self.udpt_run = run_id
+        self.udpt_seen = bytearray()
+        self.udpt_rx = 0
+        self.udpt_bytes = 0
+        self.udpt_next = 0        # highest sequence seen + 1
+        self.udpt_gaps = 0
+        self.udpt_reorder = 0
+        self.udpt_dup = 0
+        self.udpt_stale = 0       # other run ids / out-of-range sequences
+        self.udpt_first = None
+        self.udpt_last = None
+
+
+class UdpEcho:
+    """UDP echo server for L4 transport layer testing."""
+
+    per_dut = True
+
+    def __init__(self, loop, local_ip, port, reflector=None):
+        self.loop = loop
+        self.local_ip = local_ip
+        self.port = port
+        self.reflector = reflector
+        self.tx_stamps = None
+        self.sock = None
+        self.running = False
+        self.stats = DutTable(_UdpDutStats)
         self.lock = threading.Lock()
 
-    def prepare(self, test, args):
-        logger.info("UDP prepare: %s", test)
+    def prepare(self, test, args, dut=None):
+        logger.info("UDP prepare: %s %s", test, args)
+        if "OWD" in test.upper():
+            st = self.stats.get(dut)
+            with self.lock:
+                st.owd_echoes = 0
+        if "THROUGHPUT" in test.upper():
+            opts = dict(a.split("=", 1) for a in args.split() if "=" in a)
+            try:
+                run_id = int(opts.get("run", "0"))
+            except ValueError:
+                return False, "bad run id"
+            st = self.stats.get(dut)
+            with self.lock:
+                st.udpt_reset(run_id)
+            logger.info("UDP throughput run %d armed for %s (size=%s)",
+                        run_id, dut, opts.get("size", "?"))
         return True, "OK"
 
-    def stop_test(self):
+    def stop_test(self, dut=None):
         pass
 
-    def get_result(self):
+    def end_session(self, dut):
+        self.stats.drop(dut)
+
+    def get_result(self, dut=None):
+        st = self.stats.get(dut)
         with self.lock:
-            return (f"packets={self.packet_count},"
-                    f"bytes={self.bytes_received},"
-                    f"probes={self.probe_count}")
+            span_us = 0
+            if st.udpt_first is not None:
+                span_us = int((st.udpt_last - st.udpt_first) * 1e6)
+            return (f"packets={st.packet_count},"
+                    f"bytes={st.bytes_received},"
+                    f"probes={st.probe_count},"
+                    f"udpt_rx={st.udpt_rx},"
+                    f"udpt_bytes={st.udpt_bytes},"
+                    f"udpt_lost={st.udpt_next - st.udpt_rx},"
+                    f"udpt_gaps={st.udpt_gaps},"
+                    f"udpt_reorder={st.udpt_reorder},"
+                    f"udpt_dup={st.udpt_dup},"
+                    f"udpt_us={span_us},"
+                    f"lat_echoes={st.lat_echoes},"
+                    f"lat_res_ns_avg={st.lat_res_sum // max(st.lat_echoes, 1)},"
+                    f"lat_res_ns_max={st.lat_res_max},"
+                    f"lat_wire_ns_avg={st.lat_wire_sum // max(st.lat_wire_count, 1)},"
+                    f"lat_wire_ns_max={st.lat_wire_max},"
+                    f"owd_echoes={st.owd_echoes}")
 
     def start(self):
         """Start UDP echo server."""
         try:
             self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
             self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-            self.sock.settimeout(1.0)
+            # Throughput runs arrive far faster than the echo path drains
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, UDPT_RCVBUF)
             self.sock.bind((self.local_ip, self.port))
         except OSError as e:
             logger.warning("UDP bind %d failed: %s", self.port, e)
             return
 
         self.running = True
-        self.thread = threading.Thread(target=self._echo_loop, daemon=True)
-        self.thread.start()
-        logger.info("UDP echo server on %s:%d (DDTECHO probe aware)",
-                     self.local_ip, self.port)
+        if self.reflector:
+            if self.reflector.tune(self.sock, tx_timestamps=True):
+                self.tx_stamps = TxStampTracker(self.reflector.hw_timestamps)
+            self.reflector.add(self.sock, self._on_readable)
+        else:
+            enable_timestamps(self.sock)
+            self.loop.add(self.sock, EVENT_READ, self._on_readable)
+        logger.info("UDP echo server on %s:%d (DDTECHO probe aware, %s)",
+                     self.local_ip, self.port,
+                     "low-latency reflector" if self.reflector else "event loop")
 
     def stop(self):
         self.running = False
-        if self.thread:
-            self.thread.join(timeout=3)
         if self.sock:
-            self.sock.close()
+            if self.reflector:
+                self.reflector.close(self.sock)
+            else:
+                self.loop.close(self.sock)
             self.sock = None
 
     def _parse_probe(self, data):
@@ -92,38 +206,126 @@ class UdpEcho:
         except Exception:
             return None
 
-    def _echo_loop(self):
-        """Receive and echo back UDP packets."""
-        while self.running:
+    def _account_sequenced(self, st, data):
+        """Record one DDTUDPT datagram against the DUT's armed run."""
+        if len(data) < UDPT_HEADER.size:
+            return
+        _, run_id, seq = UDPT_HEADER.unpack_from(data)
+        now = time.monotonic()
+        with self.lock:
+            if st.udpt_run is None:
+                # No PREPARE (e.g. older EFI build): adopt the first run seen
+                st.udpt_reset(run_id)
+            if run_id != st.udpt_run or seq >= UDPT_MAX_SEQ:
+                st.udpt_stale += 1
+                return
+
+            idx, bit = seq >> 3, 1 << (seq & 7)
+            if idx >= len(st.udpt_seen):
+                grow = max(idx + 1 - len(st.udpt_seen), len(st.udpt_seen))
+                st.udpt_seen.extend(bytes(grow))
+            if st.udpt_seen[idx] & bit:
+                st.udpt_dup += 1
+                return
+            st.udpt_seen[idx] |= bit
+
+            st.udpt_rx += 1
+            st.udpt_bytes += len(data)
+            if seq >= st.udpt_next:
+                if seq > st.udpt_next:
+                    st.udpt_gaps += 1
+                st.udpt_next = seq + 1
+            else:
+                st.udpt_reorder += 1
+            if st.udpt_first is None:
+                st.udpt_first = now
+            st.udpt_last = now
+
+    def _stamp_residence(self, st, data, stamps):
+        """Latency probe reply: write the residence time into it."""
+        reply = bytearray(data)
+        res = 0
+        if stamps[0] is not None:
+            res = min(max(now_ns() - stamps[0], 0), 0xFFFFFFFF)
+        struct.pack_into("!I", reply, LAT_RES_OFFSET, res)
+        with self.lock:
+            st.lat_echoes += 1
+            st.lat_res_sum += res
+            st.lat_res_max = max(st.lat_res_max, res)
+        return reply
+
+    def _stamp_owd(self, st, data, anc):
+        """One-way delay probe reply: write arrival and departure times."""
+        reply = bytearray(data)
+        rx_ns = rx_monotonic_ns(anc)
+        with self.lock:
+            st.owd_echoes += 1
+        struct.pack_into("!QQ", reply, OWD_RX_OFFSET, rx_ns, time.monotonic_ns())
+        return reply
+
+    def _wire_sink(self, st):
+        def record(ns):
+            with self.lock:
+                st.lat_wire_count += 1
+                st.lat_wire_sum += ns
+                st.lat_wire_max = max(st.lat_wire_max, ns)
+        return record
+
+    def _on_readable(self, sock, mask=None):
+        """Receive and echo back the pending UDP packets."""
+        if self.tx_stamps:
+            self.tx_stamps.drain(sock)
+        for _ in range(RX_BATCH):
             try:
-                data, addr = self.sock.recvfrom(65535)
-            except socket.timeout:
-                continue
+                data, anc, _, addr = sock.recvmsg(65535, CMSG_SPACE)
             except OSError:
-                break
+                return
 
+            st = self.stats.get(addr[0])
             with self.lock:
-                self.packet_count += 1
-                self.bytes_received += len(data)
+                st.packet_count += 1
+                st.bytes_received += len(data)
+
+            if data.startswith(LAT_MAGIC) and len(data) >= LAT_HEADER.size:
+                stamps = parse_timestamps(anc)
+                try:
+                    sock.sendto(self._stamp_residence(st, data, stamps), addr)
+                except OSError:
+                    continue
+                if self.tx_stamps:
+                    self.tx_stamps.sent(stamps, self._wire_sink(st))
+                continue
+
+            if data.startswith(OWD_MAGIC) and len(data) >= OWD_HEADER.size:
+                try:
+                    sock.sendto(self._stamp_owd(st, data, anc), addr)
+                except OSError:
+                    continue
+                if self.tx_stamps:
+                    self.tx_stamps.sent((None, None), None)
+                continue
+
+            if data.startswith(UDPT_MAGIC):
+                self._account_sequenced(st, data)
+                continue
 
             # Check for DDTECHO probe
             probe = self._parse_probe(data)
             if probe is not None:
                 seq_id, ts = probe
                 with self.lock:
-                    self.probe_count += 1
-                    self.probe_last_id = seq_id
-                    self.probe_last_time = time.time()
-                    src_key = addr[0]
-                    self.probe_sources[src_key] = \
-                        self.probe_sources.get(src_key, 0) + 1
+                    st.probe_count += 1
+                    st.probe_last_id = seq_id
+                    st.probe_last_time = time.time()
 
                 logger.info("UDP PROBE #%s from %s:%d (total: %d)",
-                            seq_id, addr[0], addr[1], self.probe_count)
+                            seq_id, addr[0], addr[1], st.probe_count)
             else:
                 logger.debug("UDP echo %d bytes to %s", len(data), addr)
 
             try:
-                self.sock.sendto(data, addr)
+                sock.sendto(data, addr)
             except OSError:
-                pass
+                continue
+            if self.tx_stamps:
+                self.tx_stamps.sent((None, None), None)
@@ -31,6 +31,7 @@
 #include <Protocol/Dhcp4.h>
 #include <Protocol/Dns4.h>
 #include <Protocol/Http.h>
+#include <Protocol/Mtftp4.h>
 #include <Protocol/ServiceBinding.h>
 
 //
@@ -194,6 +195,9 @@ VOID   UtilFormatMac       (IN CONST UINT8 *MacAddr, OUT CHAR16 *OutStr);
 VOID   UtilFormatIpv4      (IN CONST UINT8 *Ip, OUT CHAR16 *OutStr);
 VOID   UtilStallMs         (IN UINTN Ms);
 UINT64 UtilGetTimestamp     (VOID);
+UINT64 UtilGetTimeUs        (VOID);
+VOID   UtilSortUint32      (IN OUT UINT32 *Array, IN UINTN Count);
+UINT32 UtilPercentile      (IN CONST UINT32 *Sorted, IN UINTN Count, IN UINTN Percent);
 VOID   UtilAsciiToUnicode  (IN CONST CHAR8 *Ascii, OUT CHAR16 *Unicode, IN UINTN MaxLen);
 VOID   UtilSafeStrCpy      (OUT CHAR16 *Dest, IN CONST CHAR16 *Src, IN UINTN MaxLen);
 
@@ -207,6 +211,62 @@ typedef enum {
   COMPANION_ERROR
 } COMPANION_STATE;
 
+//
+// Companion message buffer size
+//
+#define COMPANION_MAX_MSG_SIZE   512
+#define COMPANION_DEFAULT_TIMEOUT 5000
+
+//
+// Framed control protocol (negotiated in HELLO with "proto=2").
+// Requests carry a message id and may be pipelined; responses larger
+// than one datagram come back in fragments.
+//
+#define COMPANION_PROTO_TEXT        1
+#define COMPANION_PROTO_FRAMED      2
+#define COMPANION_FRAME_HDR_SIZE    12
+#define COMPANION_FRAG_PAYLOAD      1400
+#define COMPANION_MAX_FRAGS         16     // FragAck is a 16-bit mask
+#define COMPANION_MAX_RESPONSE      (COMPANION_FRAG_PAYLOAD * COMPANION_MAX_FRAGS)
+#define COMPANION_REPORT_SIZE       (COMPANION_MAX_RESPONSE + 1)  // response buffer incl. NUL
+#define COMPANION_MAX_OUTSTANDING   8
+#define COMPANION_RTO_INIT_MS       200
+#define COMPANION_RTO_MIN_MS        10
+#define COMPANION_RTO_MAX_MS        2000
+#define COMPANION_MAX_RETRIES       6
+
+//
+// Outstanding framed request
+//
+typedef struct {
+  BOOLEAN                      InUse;
+  BOOLEAN                      Done;
+  EFI_STATUS                   Status;           // EFI_TIMEOUT after the last retry
+  UINT16                       MsgId;
+  UINT16                       FragCount;        // 0 until the first fragment arrives
+  UINT16                       FragMask;         // fragments received
+  UINTN                        Retries;
+  UINT32                       RtoMs;            // per-request, doubled on retransmit
+  UINT64                       SentUs;           // last (re)transmission
+  UINTN                        Length;           // reassembled response bytes
+  CHAR8                        *Buffer;          // COMPANION_MAX_RESPONSE bytes
+  UINTN                        FrameLen;
+  UINT8                        Frame[COMPANION_FRAME_HDR_SIZE + COMPANION_MAX_MSG_SIZE];
+} COMPANION_REQUEST;
+
+//
+// Receives the frames the control channel reads from SNP but does not
+// own, so a test counting raw traffic while it talks to the companion
+// does not lose them
+//
+typedef
+VOID
+(EFIAPI *COMPANION_RX_TAP)(
+  IN VOID         *Context,
+  IN CONST UINT8  *Frame,
+  IN UINTN        Length
+  );
+
 //
 // Companion link context
 //
@@ -224,20 +284,27 @@ typedef struct {
   UINT32                       TimeoutMs;
   UINT32                       MessageId;
   CHAR16                       StatusMsg[128];
+  UINT8                        Protocol;         // COMPANION_PROTO_*
+  UINT16                       NextMsgId;
+  UINT32                       SrttUs;           // RFC 6298 estimator, 0 = no sample yet
+  UINT32                       RttVarUs;
+  UINT32                       RtoMs;
+  UINTN                        Retransmits;
+  COMPANION_REQUEST            Requests[COMPANION_MAX_OUTSTANDING];
+  CHAR8                        ReadyDetail[COMPANION_MAX_MSG_SIZE];  // after "READY " of the last PREPARE
+  COMPANION_RX_TAP             RxTap;            // non-control frames, NULL = dropped
+  VOID                         *RxTapContext;
+  CHAR8                        *Report;          // last RESULT, COMPANION_REPORT_SIZE bytes
 } COMPANION_LINK;
 
-//
-// Companion message buffer size
-//
-#define COMPANION_MAX_MSG_SIZE   512
-#define COMPANION_DEFAULT_TIMEOUT 5000
-
 //
 // CompanionLink functions (CompanionLink.c)
 //
 EFI_STATUS CompanionInit            (IN OUT COMPANION_LINK *Link, IN EFI_HANDLE NicHandle,
                                      IN EFI_IPv4_ADDRESS *LocalIp, IN EFI_IPv4_ADDRESS *CompanionIp,
                                      IN EFI_IPv4_ADDRESS *SubnetMask OPTIONAL);
+EFI_STATUS CompanionAttach          (IN OUT COMPANION_LINK *Link, IN EFI_HANDLE NicHandle,
+                                     IN EFI_IPv4_ADDRESS *CompanionIp);
 EFI_STATUS CompanionConnect         (IN OUT COMPANION_LINK *Link);
 EFI_STATUS CompanionDisconnect      (IN OUT COMPANION_LINK *Link);
 EFI_STATUS CompanionDestroy         (IN OUT COMPANION_LINK *Link);
@@ -248,7 +315,21 @@ EFI_STATUS CompanionPrepare         (IN OUT COMPANION_LINK *Link, IN CONST CHAR8
                                      IN CONST CHAR8 *Test, IN CONST CHAR8 *Args OPTIONAL);
 EFI_STATUS CompanionStart           (IN OUT COMPANION_LINK *Link);
 EFI_STATUS CompanionStop            (IN OUT COMPANION_LINK *Link);
-EFI_STATUS CompanionGetResult       (IN OUT COMPANION_LINK *Link, OUT CHAR8 *Result,
-                                     IN UINTN ResultSize);
+EFI_STATUS CompanionGetResult       (IN OUT COMPANION_LINK *Link, OUT CONST CHAR8 **Report);
+EFI_STATUS CompanionPrepareStart    (IN OUT COMPANION_LINK *Link, IN CONST CHAR8 *Layer,
+                                     IN CONST CHAR8 *Test, IN CONST CHAR8 *Args OPTIONAL);
+EFI_STATUS CompanionStopResult      (IN OUT COMPANION_LINK *Link, OUT CONST CHAR8 **Report);
+EFI_STATUS CompanionResultValue     (IN CONST CHAR8 *Report, IN CONST CHAR8 *Key,
+                                     OUT UINT64 *Value);
+EFI_STATUS CompanionResultString    (IN CONST CHAR8 *Report, IN CONST CHAR8 *Key,
+                                     OUT CHAR8 *Value, IN UINTN ValueSize);
+EFI_STATUS CompanionSubmit          (IN OUT COMPANION_LINK *Link, IN CONST CHAR8 *Command,
+                                     OUT UINT16 *MsgId);
+EFI_STATUS CompanionWait            (IN OUT COMPANION_LINK *Link, IN UINT16 MsgId,
+                                     OUT CHAR8 *Response, IN UINTN ResponseSize,
+                                     IN UINT32 TimeoutMs);
+EFI_STATUS CompanionTimeSample      (IN OUT COMPANION_LINK *Link, IN UINT32 Seq, IN UINT32 TimeoutMs,
+                                     OUT UINT64 *SendUs, OUT UINT64 *RecvUs,
+                                     OUT UINT64 *PeerRxNs, OUT UINT64 *PeerTxNs);
 
 #endif // DDTSOFT_NET_TEST_H_
@@ -55,11 +55,18 @@ typedef struct {
   EFI_IPv4_ADDRESS    SubnetMask;
   EFI_IPv4_ADDRESS    Gateway;
   UINT32              TimeoutMs;
-  UINT32              Iterations;
+  UINT32              Iterations;       // 0 = test default; above a test's cap also selects it
   UINT16              TargetPort;
   BOOLEAN             UseCompanion;
   EFI_IPv4_ADDRESS    CompanionIp;
   UINT16              CompanionPort;
+  UINT16              PortRangeStart;   // 0 = test default port set
+  UINT16              PortRangeEnd;
+  UINT32              DurationMs;       // 0 = test default (throughput tests)
+  UINT16              DatagramSize;     // 0 = test default (UDP throughput, RX capacity frames)
+  UINT32              RatePps;          // 0 = unpaced (RX capacity generator)
+  UINT64              TransferBytes;    // 0 = test default (HTTP download size)
+  BOOLEAN             TrustCompanionCa; // HTTPS: enroll the CA served at TargetIp, unverified
 } TEST_CONFIG;
 
 //
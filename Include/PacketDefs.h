@@ -1,6 +1,6 @@
 /** @file
   Network packet structure definitions.
-  Ethernet, IP, TCP, UDP, ARP, ICMP headers.
+  Ethernet, IP, TCP, UDP, ARP, ICMP, DHCP headers.
   Byte order macros, parsed packet structure, builder/parser declarations.
 **/
 
@@ -9,6 +9,8 @@
 
 #include <Uefi.h>
 #include <Library/BaseLib.h>
+#include <Protocol/SimpleNetwork.h>
+#include <Protocol/ManagedNetwork.h>
 
 //
 // Byte order conversion (x86_64 is little-endian, network is big-endian)
@@ -97,6 +99,8 @@ typedef struct {
 #define ICMP_TYPE_ECHO_REQUEST    8
 #define ICMP_TYPE_TIME_EXCEEDED   11
 
+#define ICMP_CODE_FRAG_NEEDED     4     // Dest Unreach: DF set, next-hop MTU in SequenceNumber
+
 //
 // TCP header (20 bytes minimum)
 //
@@ -132,6 +136,49 @@ typedef struct {
   UINT16    Checksum;
 } UDP_HEADER;
 
+//
+// DHCP message, fixed BOOTP part + magic cookie (240 bytes), options follow
+//
+typedef struct {
+  UINT8     Op;
+  UINT8     HwType;
+  UINT8     HwLen;
+  UINT8     Hops;
+  UINT32    Xid;
+  UINT16    Secs;
+  UINT16    Flags;
+  UINT8     CiAddr[4];
+  UINT8     YiAddr[4];
+  UINT8     SiAddr[4];
+  UINT8     GiAddr[4];
+  UINT8     ChAddr[16];
+  UINT8     SName[64];
+  UINT8     File[128];
+  UINT32    MagicCookie;
+} DHCP_HEADER;
+
+#define BOOTP_SERVER_PORT      67
+#define BOOTP_CLIENT_PORT      68
+#define BOOTP_OP_REQUEST       1
+#define BOOTP_OP_REPLY         2
+#define BOOTP_FLAG_BROADCAST   0x8000
+#define BOOTP_MIN_SIZE         300      // DHCP messages are padded to this
+
+#define DHCP_MAGIC_COOKIE      0x63825363
+
+#define DHCP_OPT_PAD           0
+#define DHCP_OPT_REQUESTED_IP  50
+#define DHCP_OPT_MSG_TYPE      53
+#define DHCP_OPT_SERVER_ID     54
+#define DHCP_OPT_END           255
+
+#define DHCP_MSG_DISCOVER      1
+#define DHCP_MSG_OFFER         2
+#define DHCP_MSG_REQUEST       3
+#define DHCP_MSG_ACK           5
+#define DHCP_MSG_NAK           6
+#define DHCP_MSG_RELEASE       7
+
 #pragma pack()
 
 //
@@ -147,6 +194,7 @@ typedef struct {
 #define TCP_MIN_HEADER_SIZE      20
 #define UDP_HEADER_SIZE          8
 #define ARP_HEADER_SIZE          28
+#define DHCP_HEADER_SIZE         240
 
 //
 // Broadcast MAC
@@ -198,6 +246,11 @@ typedef struct {
 //
 UINT16 PktChecksum    (IN CONST UINT8 *Data, IN UINTN Length);
 
+//
+// Incremental checksum update for one changed word (RFC 1624)
+//
+UINT16 PktChecksumAdjust (IN UINT16 Checksum, IN UINT16 OldWord, IN UINT16 NewWord);
+
 //
 // Pseudo-header checksum for TCP/UDP
 //
@@ -318,4 +371,89 @@ CONST CHAR16 * PktGetIpProtocolName (IN UINT8 Protocol);
 CONST CHAR16 * PktGetIcmpTypeName   (IN UINT8 Type);
 CONST CHAR16 * PktGetTcpFlagsStr    (IN UINT8 Flags, OUT CHAR16 *Buffer, IN UINTN BufferSize);
 
+//
+// ============================================================
+// PacketIo functions (PacketIo.c)
+// ============================================================
+//
+
+//
+// Raw frame I/O context: SNP transmit, private MNP child receive
+//
+typedef struct {
+  EFI_HANDLE                            NicHandle;
+  EFI_SIMPLE_NETWORK_PROTOCOL           *Snp;
+  EFI_SERVICE_BINDING_PROTOCOL          *MnpSb;
+  EFI_HANDLE                            MnpChild;
+  EFI_MANAGED_NETWORK_PROTOCOL          *Mnp;        // NULL: receive via SNP
+  EFI_MANAGED_NETWORK_COMPLETION_TOKEN  RxToken;
+  BOOLEAN                               RxQueued;
+  UINT8                                 SrcMac[6];
+  UINT64                                TxFrames;
+  UINT64                                TxBusy;      // TX queue-full retries
+  UINT64                                RxFrames;
+} PKT_IO;
+
+EFI_STATUS PktIoOpen    (OUT PKT_IO *Io, IN EFI_HANDLE NicHandle, IN EFI_SIMPLE_NETWORK_PROTOCOL *Snp);
+VOID       PktIoClose   (IN OUT PKT_IO *Io);
+EFI_STATUS PktIoSend    (IN OUT PKT_IO *Io, IN CONST UINT8 *Frame, IN UINTN Length);
+EFI_STATUS PktIoReceive (IN OUT PKT_IO *Io, OUT UINT8 *Buffer, IN OUT UINTN *Length);
+
+EFI_STATUS PktIoResolveMac (
+  IN OUT PKT_IO       *Io,
+  IN     CONST UINT8  *SrcIp,
+  IN     CONST UINT8  *TargetIp,
+  OUT    UINT8        *TargetMac,
+  IN     UINTN        TimeoutMs
+  );
+
+EFI_STATUS PktIoResolveNextHop (
+  IN OUT PKT_IO       *Io,
+  IN     CONST UINT8  *LocalIp,
+  IN     CONST UINT8  *SubnetMask,
+  IN     CONST UINT8  *Gateway,
+  IN     CONST UINT8  *DstIp,
+  OUT    UINT8        *NextHopMac
+  );
+
+//
+// MAC-swap loopback: receive matching frames through SNP, swap the
+// MAC addresses in place and send them back from the same buffer
+//
+#define PKT_LOOP_TX_SLOTS   64        // looped frames SNP may still own
+#define PKT_LOOP_SLOT_SIZE  1536
+#define PKT_LOOP_DRAIN_SIZE 16384     // frames above a slot (jumbo) are drained here
+#define PKT_LOOP_RX_BATCH   32        // frames received per TX reclaim
+
+typedef struct {
+  UINT16     EtherType;                 // 0 = any
+  BOOLEAN    MatchDstMac;               // only frames addressed to DstMac
+  UINT8      DstMac[6];
+} PKT_LOOP_FILTER;
+
+typedef struct {
+  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
+  PKT_LOOP_FILTER              Filter;
+  UINT8                        OwnMac[6];
+  UINT32                       OldFilters;   // receive filters to restore
+  UINT8                        *Slots;
+  UINT8                        *Drain;       // PKT_LOOP_DRAIN_SIZE bytes
+  BOOLEAN                      Busy[PKT_LOOP_TX_SLOTS];
+  UINTN                        InUse;
+  UINTN                        Next;
+  UINT64                       RxFrames;
+  UINT64                       Looped;
+  UINT64                       LoopedBytes;
+  UINT64                       Filtered;     // received, not matching the filter
+  UINT64                       NoSlot;       // dropped: every TX slot in flight
+  UINT64                       Oversize;     // dropped: larger than a TX slot
+  UINT64                       TxBusy;       // dropped: SNP transmit queue full
+  UINT64                       TxErrors;
+} PKT_LOOP;
+
+EFI_STATUS PktLoopOpen  (OUT PKT_LOOP *Loop, IN EFI_SIMPLE_NETWORK_PROTOCOL *Snp,
+                         IN CONST PKT_LOOP_FILTER *Filter);
+UINT64     PktLoopRun   (IN OUT PKT_LOOP *Loop, IN UINT64 BudgetUs);
+VOID       PktLoopClose (IN OUT PKT_LOOP *Loop);
+
 #endif // PACKET_DEFS_H_
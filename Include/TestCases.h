@@ -26,6 +26,9 @@ EFI_STATUS TestL2BroadcastFrame   (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT
 EFI_STATUS TestL2FrameTxRx        (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL2MtuDetection     (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL2ReceiveFilter    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL2HostDiscovery    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL2RxCapacity       (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL2Bidirectional    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 
 //
 // Layer 3 - Network tests
@@ -40,6 +43,7 @@ EFI_STATUS TestL3Ipv6Nd           (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT
 EFI_STATUS TestL3IpHeaderValid    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL3RoutingTable     (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL3DuplicateIp      (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL3Reflector        (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 
 //
 // Layer 4 - Transport tests
@@ -52,6 +56,11 @@ EFI_STATUS TestL4UdpSendReceive   (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT
 EFI_STATUS TestL4UdpMultiPort     (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL4PortScan         (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL4TcpStress        (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL4SynRate          (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL4TcpThroughput    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL4UdpThroughput    (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL4UdpLatency       (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL4OneWayDelay      (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 
 //
 // Layer 7 - Application tests
@@ -62,5 +71,12 @@ EFI_STATUS TestL7DnsResolve       (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT
 EFI_STATUS TestL7DnsReverse       (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL7HttpGet          (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 EFI_STATUS TestL7HttpStatusCodes  (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7HttpDownload     (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7HttpLoad         (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7DnsBench         (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7DhcpBench        (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7DhcpLoad         (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7Https            (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
+EFI_STATUS TestL7TftpSweep        (IN NIC_INFO *Nic, IN TEST_CONFIG *Config, OUT TEST_RESULT_DATA *Result);
 
 #endif // TEST_CASES_H_
@@ -3,9 +3,22 @@
   Implements handshake protocol and command/response messaging
   between DDTSoft EFI app and the DDTSoft Test Companion.
 
-  Protocol: text-based messages on UDP port 9999.
-  Commands (EFI -> Companion): HELLO, PREPARE, START, STOP, RESULT, DONE, GETREPORT
-  Responses (Companion -> EFI): ACK, READY, ERROR, REPORT, CONFIRM
+  Protocol: ASCII command/response text on UDP port 9999.
+  Commands (EFI -> Companion): HELLO, PREPARE, START, STOP, RESULT, DONE, GETREPORT, TIME
+  Responses (Companion -> EFI): ACK, READY, ERROR, REPORT, CONFIRM, TIME
+
+  HELLO offers "proto=2"; a companion that answers "ACK ... proto=2"
+  switches the session to framed messages (a companion without framing
+  keeps the plain text session, one request at a time). Each frame
+  carries the same command/response text behind a 12-byte header with
+  a message id, so several requests can be outstanding, lost ones are
+  retransmitted on an RFC 6298 style RTO, and responses larger than one
+  datagram are split into fragments. The companion executes requests
+  in message id order and answers duplicates from a response cache.
+  CompanionPrepareStart and CompanionStopResult use this to pipeline
+  the PREPARE+START and STOP+RESULT pairs of a test in one round trip.
+  TIME is always sent as plain text, outside the framed queue; it
+  exchanges timestamps for the one-way delay test's clock offset.
 **/
 
 #include <DDTSoftNetTest.h>
@@ -26,28 +39,58 @@ UdpNotifyStub (
   // No-op: we poll Token.Status directly
 }
 
+//
+// Frame header (big-endian):
+//   [0] magic  [1] flags  [2-3] message id  [4-5] fragment index
+//   [6-7] fragment count  [8-9] payload length  [10-11] fragment ack mask
+// The ack mask in a (re)transmitted request lists the response fragments
+// already held, so the companion only resends the missing ones.
+//
+#define COMPANION_FRAME_MAGIC          0xDD
+#define COMPANION_FRAME_FLAG_RESPONSE  0x01
+
+#define COMPANION_RX_POLL_US           10     // CompanionReceiveResponse poll period
+#define COMPANION_PUMP_BUDGET          64     // frames per CompanionPump pass
+
+#define COMPANION_GET16(Buf, Off)  (UINT16)(((Buf)[Off] << 8) | (Buf)[(Off) + 1])
+
+STATIC
+VOID
+CompanionPut16 (
+  OUT UINT8   *Buf,
+  IN  UINTN   Offset,
+  IN  UINT16  Value
+  )
+{
+  Buf[Offset]     = (UINT8)(Value >> 8);
+  Buf[Offset + 1] = (UINT8)Value;
+}
+
 /**
-  Initialize the companion link by creating a UDP4 child instance.
-  Creates a child via UDP4 service binding and configures it with
-  the specified local/remote IP and control channel port.
+  Common body of CompanionInit and CompanionAttach.
 
   @param[in,out]  Link         Companion link context to initialize.
   @param[in]      NicHandle    Handle of the NIC to use.
-  @param[in]      LocalIp      Local IPv4 address.
+  @param[in]      LocalIp      Local IPv4 address (static address to set).
   @param[in]      CompanionIp  Companion IPv4 address.
   @param[in]      SubnetMask   Subnet mask (optional, defaults to 255.255.255.0).
+  @param[in]      SetAddress   TRUE to switch the NIC to LocalIp; FALSE to
+                               use the address it already has.
 
   @retval EFI_SUCCESS           Link initialized successfully.
   @retval EFI_INVALID_PARAMETER Link, LocalIp, or CompanionIp is NULL.
+  @retval EFI_NO_MAPPING        SetAddress is FALSE and the NIC has no address.
   @retval other                 UDP4 setup failure.
 **/
+STATIC
 EFI_STATUS
-CompanionInit (
+CompanionInitLink (
   IN OUT COMPANION_LINK    *Link,
   IN     EFI_HANDLE        NicHandle,
   IN     EFI_IPv4_ADDRESS  *LocalIp,
   IN     EFI_IPv4_ADDRESS  *CompanionIp,
-  IN     EFI_IPv4_ADDRESS  *SubnetMask  OPTIONAL
+  IN     EFI_IPv4_ADDRESS  *SubnetMask  OPTIONAL,
+  IN     BOOLEAN           SetAddress
   )
 {
   EFI_STATUS                    Status;
@@ -56,6 +99,7 @@ CompanionInit (
   EFI_IP4_CONFIG2_PROTOCOL      *Ip4Cfg2;
   EFI_IP4_CONFIG2_POLICY        Policy;
   EFI_IP4_CONFIG2_MANUAL_ADDRESS ManualAddr;
+  EFI_IP4_CONFIG2_INTERFACE_INFO *IfInfo;
   UINTN                         DataSize;
 
   if (Link == NULL || LocalIp == NULL || CompanionIp == NULL) {
@@ -68,6 +112,8 @@ CompanionInit (
   Link->Port      = CONTROL_CHANNEL_PORT;
   Link->TimeoutMs = COMPANION_DEFAULT_TIMEOUT;
   Link->MessageId = 0;
+  Link->Protocol  = COMPANION_PROTO_TEXT;
+  Link->RtoMs     = COMPANION_RTO_INIT_MS;
 
   CopyMem (&Link->LocalIp, LocalIp, sizeof (EFI_IPv4_ADDRESS));
   CopyMem (&Link->CompanionIp, CompanionIp, sizeof (EFI_IPv4_ADDRESS));
@@ -99,6 +145,36 @@ CompanionInit (
     return Status;
   }
 
+  //
+  // Attach mode: keep whatever address the NIC already has (DHCP or
+  // static) and skip the policy/address writes and their settle time.
+  //
+  if (!SetAddress) {
+    DataSize = 0;
+    IfInfo   = NULL;
+    Status = Ip4Cfg2->GetData (Ip4Cfg2, Ip4Config2DataTypeInterfaceInfo, &DataSize, NULL);
+    if (Status == EFI_BUFFER_TOO_SMALL && DataSize > 0) {
+      IfInfo = AllocatePool (DataSize);
+    }
+    if (IfInfo != NULL) {
+      Status = Ip4Cfg2->GetData (Ip4Cfg2, Ip4Config2DataTypeInterfaceInfo, &DataSize, IfInfo);
+      if (!EFI_ERROR (Status)) {
+        CopyMem (&Link->LocalIp, &IfInfo->StationAddress, sizeof (EFI_IPv4_ADDRESS));
+        CopyMem (&Link->SubnetMask, &IfInfo->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+      }
+      FreePool (IfInfo);
+    }
+
+    if (Link->LocalIp.Addr[0] == 0 && Link->LocalIp.Addr[1] == 0 &&
+        Link->LocalIp.Addr[2] == 0 && Link->LocalIp.Addr[3] == 0) {
+      UtilSafeStrCpy (Link->StatusMsg, L"NIC has no IPv4 address", 128);
+      Link->State = COMPANION_ERROR;
+      return EFI_NO_MAPPING;
+    }
+
+    goto OpenUdp;
+  }
+
   //
   // Set policy to static (overrides DHCP if active)
   //
@@ -150,6 +226,7 @@ CompanionInit (
   //
   // Step 2: Open UDP4 Service Binding
   //
+OpenUdp:
   Status = gBS->HandleProtocol (
                   NicHandle,
                   &gEfiUdp4ServiceBindingProtocolGuid,
@@ -246,14 +323,17 @@ CompanionInit (
   }
 
   //
-  // Warm up: poll to let ARP/IP4 process any pending frames
+  // Warm up: poll to let ARP/IP4 process any pending frames. An address
+  // that was already in place has nothing left to settle.
   //
-  {
+  if (SetAddress) {
     UINTN  WarmUp;
     for (WarmUp = 0; WarmUp < 5; WarmUp++) {
       Link->Udp4->Poll (Link->Udp4);
       gBS->Stall (100000);  // 100ms
     }
+  } else {
+    Link->Udp4->Poll (Link->Udp4);
   }
 
   //
@@ -322,36 +402,85 @@ CompanionInit (
 }
 
 /**
-  Send a raw ASCII command over the UDP control channel.
+  Initialize the companion link by creating a UDP4 child instance.
+  Switches the NIC to the given static address via IP4Config2, then
+  creates a UDP4 child on the control channel port.
 
-  @param[in,out]  Link     Companion link context.
-  @param[in]      Command  ASCII command string to send.
+  @param[in,out]  Link         Companion link context to initialize.
+  @param[in]      NicHandle    Handle of the NIC to use.
+  @param[in]      LocalIp      Local IPv4 address.
+  @param[in]      CompanionIp  Companion IPv4 address.
+  @param[in]      SubnetMask   Subnet mask (optional, defaults to 255.255.255.0).
 
-  @retval EFI_SUCCESS  Command sent successfully.
+  @retval EFI_SUCCESS           Link initialized successfully.
+  @retval EFI_INVALID_PARAMETER Link, LocalIp, or CompanionIp is NULL.
+  @retval other                 UDP4 setup failure.
+**/
+EFI_STATUS
+CompanionInit (
+  IN OUT COMPANION_LINK    *Link,
+  IN     EFI_HANDLE        NicHandle,
+  IN     EFI_IPv4_ADDRESS  *LocalIp,
+  IN     EFI_IPv4_ADDRESS  *CompanionIp,
+  IN     EFI_IPv4_ADDRESS  *SubnetMask  OPTIONAL
+  )
+{
+  return CompanionInitLink (Link, NicHandle, LocalIp, CompanionIp, SubnetMask, TRUE);
+}
+
+/**
+  Initialize the companion link on the NIC's current IPv4 address.
+  Used by tests: unlike CompanionInit it never changes the IP4Config2
+  policy or address, so a DHCP lease survives the test run, and it
+  skips the settle delays that only a fresh address needs.
+
+  @param[in,out]  Link         Companion link context to initialize.
+  @param[in]      NicHandle    Handle of the NIC to use.
+  @param[in]      CompanionIp  Companion IPv4 address.
+
+  @retval EFI_SUCCESS           Link initialized successfully.
+  @retval EFI_INVALID_PARAMETER Link or CompanionIp is NULL.
+  @retval EFI_NO_MAPPING        The NIC has no IPv4 address.
+  @retval other                 UDP4 setup failure.
+**/
+EFI_STATUS
+CompanionAttach (
+  IN OUT COMPANION_LINK    *Link,
+  IN     EFI_HANDLE        NicHandle,
+  IN     EFI_IPv4_ADDRESS  *CompanionIp
+  )
+{
+  EFI_IPv4_ADDRESS  AnyIp;
+
+  ZeroMem (&AnyIp, sizeof (AnyIp));
+  return CompanionInitLink (Link, NicHandle, &AnyIp, CompanionIp, NULL, FALSE);
+}
+
+/**
+  Transmit one datagram to the companion control port and wait for
+  the UDP4 completion.
+
+  @param[in,out]  Link  Companion link context.
+  @param[in]      Data  Datagram payload.
+  @param[in]      Len   Payload length in bytes.
+
+  @retval EFI_SUCCESS  Datagram sent.
   @retval EFI_TIMEOUT  Transmit timed out.
   @retval other        Transmit failure.
 **/
+STATIC
 EFI_STATUS
-CompanionSendCommand (
+CompanionTransmit (
   IN OUT COMPANION_LINK  *Link,
-  IN     CONST CHAR8     *Command
+  IN     CONST VOID      *Data,
+  IN     UINTN           Len
   )
 {
   EFI_STATUS                 Status;
   EFI_UDP4_COMPLETION_TOKEN  TxToken;
   EFI_UDP4_TRANSMIT_DATA     TxData;
   EFI_UDP4_SESSION_DATA      SessionData;
-  UINTN                      Len;
-  UINTN                      ElapsedMs;
-
-  if (Link == NULL || Link->Udp4 == NULL || Command == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  Len = AsciiStrLen (Command);
-  if (Len == 0 || Len > COMPANION_MAX_MSG_SIZE) {
-    return EFI_INVALID_PARAMETER;
-  }
+  UINT64                     DeadlineUs;
 
   //
   // Session data specifies the destination per-packet.
@@ -370,7 +499,7 @@ CompanionSendCommand (
   TxData.DataLength              = (UINT32)Len;
   TxData.FragmentCount           = 1;
   TxData.FragmentTable[0].FragmentLength = (UINT32)Len;
-  TxData.FragmentTable[0].FragmentBuffer = (VOID *)Command;
+  TxData.FragmentTable[0].FragmentBuffer = (VOID *)Data;
 
   //
   // Create completion token
@@ -420,13 +549,15 @@ CompanionSendCommand (
   }
 
   //
-  // Poll until complete or timeout
+  // Poll until complete or timeout. Completion normally arrives on the
+  // first Poll, so only back off briefly between polls.
   //
-  ElapsedMs = 0;
-  while (TxToken.Status == EFI_NOT_READY && ElapsedMs < Link->TimeoutMs) {
+  DeadlineUs = UtilGetTimeUs () + (UINT64)Link->TimeoutMs * 1000;
+  while (TxToken.Status == EFI_NOT_READY && UtilGetTimeUs () < DeadlineUs) {
     Link->Udp4->Poll (Link->Udp4);
-    gBS->Stall (1000);
-    ElapsedMs++;
+    if (TxToken.Status == EFI_NOT_READY) {
+      gBS->Stall (50);
+    }
   }
 
   if (TxToken.Status == EFI_NOT_READY) {
@@ -437,54 +568,65 @@ CompanionSendCommand (
 
   Status = TxToken.Status;
   gBS->CloseEvent (TxToken.Event);
-
-  Link->MessageId++;
   return Status;
 }
 
 /**
-  Receive a response from the companion with timeout.
-  Uses SNP (Simple Network Protocol) directly to receive raw Ethernet
-  frames, completely bypassing the MNP/IP4/UDP4 receive stack.
-  Parses Ethernet+IPv4+UDP headers to find control channel packets.
-
-  Also counts total received frames for diagnostics — the count is
-  stored in Link->StatusMsg on timeout to help identify whether the
-  NIC is receiving any frames at all.
+  Send a raw ASCII command over the UDP control channel.
 
-  @param[in,out]  Link          Companion link context.
-  @param[out]     Response      Buffer to receive ASCII response.
-  @param[in]      ResponseSize  Size of Response buffer in bytes.
-  @param[in]      TimeoutMs     Receive timeout in milliseconds.
+  @param[in,out]  Link     Companion link context.
+  @param[in]      Command  ASCII command string to send.
 
-  @retval EFI_SUCCESS      Response received successfully.
-  @retval EFI_TIMEOUT      No response within timeout period.
-  @retval EFI_UNSUPPORTED  SNP not available.
-  @retval other            Receive failure.
+  @retval EFI_SUCCESS  Command sent successfully.
+  @retval EFI_TIMEOUT  Transmit timed out.
+  @retval other        Transmit failure.
 **/
 EFI_STATUS
-CompanionReceiveResponse (
+CompanionSendCommand (
   IN OUT COMPANION_LINK  *Link,
-  OUT    CHAR8           *Response,
-  IN     UINTN           ResponseSize,
-  IN     UINT32          TimeoutMs
+  IN     CONST CHAR8     *Command
   )
 {
-  EFI_STATUS                   Status;
-  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
-  UINTN                        ElapsedMs;
-  UINT8                        RxBuf[1600];
-  UINTN                        BufSize;
-  UINTN                        HeaderSize;
-  EFI_TPL                      OldTpl;
-  UINTN                        FrameCount;
-  UINTN                        Ipv4Count;
-  UINTN                        UdpCount;
+  EFI_STATUS  Status;
+  UINTN       Len;
 
-  if (Link == NULL || Response == NULL || ResponseSize == 0) {
+  if (Link == NULL || Link->Udp4 == NULL || Command == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Len = AsciiStrLen (Command);
+  if (Len == 0 || Len > COMPANION_MAX_MSG_SIZE) {
     return EFI_INVALID_PARAMETER;
   }
 
+  Status = CompanionTransmit (Link, Command, Len);
+  if (!EFI_ERROR (Status)) {
+    Link->MessageId++;
+  }
+  return Status;
+}
+
+/**
+  Locate SNP on the link NIC and make sure unicast and broadcast
+  receive are enabled. The control channel reads raw frames from SNP,
+  completely bypassing the MNP/IP4/UDP4 receive stack.
+
+  @param[in]   Link  Companion link context.
+  @param[out]  Snp   SNP instance of the NIC.
+
+  @retval EFI_SUCCESS      SNP ready for receive.
+  @retval EFI_UNSUPPORTED  SNP not available.
+  @retval EFI_NOT_READY    SNP not initialized.
+**/
+STATIC
+EFI_STATUS
+CompanionOpenSnp (
+  IN  COMPANION_LINK               *Link,
+  OUT EFI_SIMPLE_NETWORK_PROTOCOL  **Snp
+  )
+{
+  EFI_STATUS  Status;
+
   //
   // Get SNP directly from the NIC handle.
   // This is the lowest possible level — reads raw frames from the
@@ -493,13 +635,13 @@ CompanionReceiveResponse (
   Status = gBS->HandleProtocol (
                   Link->NicHandle,
                   &gEfiSimpleNetworkProtocolGuid,
-                  (VOID **)&Snp
+                  (VOID **)Snp
                   );
-  if (EFI_ERROR (Status) || Snp == NULL) {
+  if (EFI_ERROR (Status) || *Snp == NULL) {
     return EFI_UNSUPPORTED;
   }
 
-  if (Snp->Mode->State != EfiSimpleNetworkInitialized) {
+  if ((*Snp)->Mode->State != EfiSimpleNetworkInitialized) {
     return EFI_NOT_READY;
   }
 
@@ -507,184 +649,704 @@ CompanionReceiveResponse (
   // Ensure unicast receive is enabled on the NIC.
   // Some drivers require explicit ReceiveFilters configuration.
   //
-  Snp->ReceiveFilters (
-         Snp,
-         EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
-         EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST,
-         0,
-         FALSE,
-         0,
-         NULL
-         );
-
-  Response[0] = '\0';
-  ElapsedMs   = 0;
-  FrameCount  = 0;
-  Ipv4Count   = 0;
-  UdpCount    = 0;
-
-  while (ElapsedMs < TimeoutMs) {
-    //
-    // Raise TPL to prevent MNP background polling from consuming
-    // frames between our SNP->Receive() calls.
-    //
-    BufSize    = sizeof (RxBuf);
-    HeaderSize = 0;
-
-    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
-    Status = Snp->Receive (Snp, &HeaderSize, &BufSize, RxBuf, NULL, NULL, NULL);
-    gBS->RestoreTPL (OldTpl);
-
-    if (Status == EFI_NOT_READY) {
-      //
-      // No frame in NIC buffer — wait and retry
-      //
-      gBS->Stall (2000);  // 2ms
-      ElapsedMs += 2;
-      continue;
-    }
-
-    if (EFI_ERROR (Status)) {
-      gBS->Stall (2000);
-      ElapsedMs += 2;
-      continue;
-    }
-
-    //
-    // Got a raw Ethernet frame.
-    //
-    FrameCount++;
+  (*Snp)->ReceiveFilters (
+            *Snp,
+            EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
+            EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST,
+            0,
+            FALSE,
+            0,
+            NULL
+            );
 
-    //
-    // Need at least Ethernet header (14) + IP header (20) + UDP header (8) = 42
-    //
-    if (BufSize < 42 || HeaderSize < 14) {
-      continue;
-    }
+  return EFI_SUCCESS;
+}
 
-    //
-    // Check EtherType at bytes [12-13] (big-endian): 0x0800 = IPv4
-    //
-    if (RxBuf[12] != 0x08 || RxBuf[13] != 0x00) {
-      continue;
-    }
+/**
+  Locate the control channel payload in a received frame.
+
+  @param[in]      Link        Companion link context.
+  @param[in]      RxBuf       Received frame.
+  @param[in]      BufSize     Frame length.
+  @param[in]      HeaderSize  Media header length reported by SNP.
+  @param[out]     Payload     Start of the UDP payload inside RxBuf.
+  @param[out]     PayloadLen  UDP payload length.
+  @param[in,out]  Counts      IPv4 / UDP counters (Counts[1], Counts[2]).
+
+  @retval EFI_SUCCESS    Control channel datagram.
+  @retval EFI_NOT_FOUND  The frame is not for us.
+**/
+STATIC
+EFI_STATUS
+CompanionMatchControl (
+  IN     COMPANION_LINK  *Link,
+  IN     UINT8           *RxBuf,
+  IN     UINTN           BufSize,
+  IN     UINTN           HeaderSize,
+  OUT    UINT8           **Payload,
+  OUT    UINTN           *PayloadLen,
+  IN OUT UINTN           *Counts
+  )
+{
+  UINT8   *IpHdr;
+  UINT16  IpHdrLen;
+  UINT16  DstPort;
+  UINT16  UdpLen;
 
-    //
-    // Parse IPv4 header (starts after Ethernet header)
-    //
-    {
-      UINT8   *IpHdr;
-      UINT16  IpHdrLen;
-      UINT16  DstPort;
-      UINT16  UdpLen;
-      UINT16  PayloadLen;
-      UINTN   CopyLen;
+  //
+  // Need at least Ethernet header (14) + IP header (20) + UDP header (8) = 42
+  //
+  if (BufSize < 42 || HeaderSize < 14) {
+    return EFI_NOT_FOUND;
+  }
 
-      IpHdr = RxBuf + HeaderSize;
+  //
+  // Check EtherType at bytes [12-13] (big-endian): 0x0800 = IPv4
+  //
+  if (RxBuf[12] != 0x08 || RxBuf[13] != 0x00) {
+    return EFI_NOT_FOUND;
+  }
 
-      //
-      // Verify IPv4 version
-      //
-      if ((IpHdr[0] >> 4) != 4) {
-        continue;
-      }
+  //
+  // Parse IPv4 header (starts after Ethernet header)
+  //
+  IpHdr = RxBuf + HeaderSize;
 
-      Ipv4Count++;
+  //
+  // Verify IPv4 version
+  //
+  if ((IpHdr[0] >> 4) != 4) {
+    return EFI_NOT_FOUND;
+  }
 
-      //
-      // Check protocol = UDP (17)
-      //
-      if (IpHdr[9] != 17) {
-        continue;
-      }
+  Counts[1]++;
 
-      UdpCount++;
+  //
+  // Check protocol = UDP (17)
+  //
+  if (IpHdr[9] != 17) {
+    return EFI_NOT_FOUND;
+  }
 
-      //
-      // Check source IP matches companion
-      //
-      if (CompareMem (&IpHdr[12], &Link->CompanionIp, 4) != 0) {
-        continue;
-      }
+  Counts[2]++;
 
-      IpHdrLen = (UINT16)((IpHdr[0] & 0x0F) * 4);
+  //
+  // Check source IP matches companion
+  //
+  if (CompareMem (&IpHdr[12], &Link->CompanionIp, 4) != 0) {
+    return EFI_NOT_FOUND;
+  }
 
-      if (BufSize < HeaderSize + IpHdrLen + 8) {
-        continue;
-      }
+  IpHdrLen = (UINT16)((IpHdr[0] & 0x0F) * 4);
 
-      //
-      // Parse UDP: [0-1] SrcPort, [2-3] DstPort, [4-5] Length
-      // All in network byte order (big-endian).
-      //
-      DstPort = (UINT16)((IpHdr[IpHdrLen + 2] << 8) | IpHdr[IpHdrLen + 3]);
+  if (BufSize < HeaderSize + IpHdrLen + 8) {
+    return EFI_NOT_FOUND;
+  }
 
-      if (DstPort != Link->Port) {
-        continue;
-      }
+  //
+  // Parse UDP: [0-1] SrcPort, [2-3] DstPort, [4-5] Length
+  // All in network byte order (big-endian).
+  //
+  DstPort = (UINT16)((IpHdr[IpHdrLen + 2] << 8) | IpHdr[IpHdrLen + 3]);
 
-      //
-      // Found matching UDP packet — extract payload
-      //
-      UdpLen     = (UINT16)((IpHdr[IpHdrLen + 4] << 8) | IpHdr[IpHdrLen + 5]);
-      PayloadLen = (UINT16)(UdpLen - 8);
-
-      if (PayloadLen > 0 &&
-          HeaderSize + IpHdrLen + 8 + PayloadLen <= BufSize) {
-        CopyLen = PayloadLen;
-        if (CopyLen >= ResponseSize - 1) {
-          CopyLen = ResponseSize - 1;
-        }
-        CopyMem (Response, &IpHdr[IpHdrLen + 8], CopyLen);
-        Response[CopyLen] = '\0';
-        return EFI_SUCCESS;
-      }
-    }
+  if (DstPort != Link->Port) {
+    return EFI_NOT_FOUND;
   }
 
   //
-  // Timeout — store diagnostic frame counts in StatusMsg.
-  // This helps identify whether the NIC is receiving any frames at all.
+  // Found matching UDP packet — locate payload
   //
-  UnicodeSPrint (
-    Link->StatusMsg, sizeof (Link->StatusMsg),
-    L"RX frames:%d ipv4:%d udp:%d (no match in %dms)",
-    FrameCount, Ipv4Count, UdpCount, TimeoutMs
-    );
+  UdpLen = (UINT16)((IpHdr[IpHdrLen + 4] << 8) | IpHdr[IpHdrLen + 5]);
+  if (UdpLen <= 8 || HeaderSize + IpHdrLen + UdpLen > BufSize) {
+    return EFI_NOT_FOUND;
+  }
 
-  return EFI_TIMEOUT;
+  *Payload    = &IpHdr[IpHdrLen + 8];
+  *PayloadLen = UdpLen - 8;
+  return EFI_SUCCESS;
 }
 
 /**
-  Perform handshake with the companion.
-  Sends HELLO via UDP4 and receives ACK via MNP (which bypasses the
-  unreliable UDP4 receive path). Retries up to 3 times.
-
-  @param[in,out]  Link  Companion link context.
-
-  @retval EFI_SUCCESS       Handshake completed, companion connected.
-  @retval EFI_TIMEOUT       No response from companion after all retries.
-  @retval EFI_DEVICE_ERROR  Unexpected response.
-  @retval other             Communication failure.
+  Read one frame from SNP and return its UDP payload if it is a
+  control channel datagram from the companion. Any other frame is
+  handed to Link->RxTap when one is set, and dropped otherwise.
+
+  @param[in]      Link        Companion link context.
+  @param[in]      Snp         SNP instance from CompanionOpenSnp.
+  @param[out]     RxBuf       Frame buffer.
+  @param[in]      RxSize      Size of RxBuf.
+  @param[out]     Payload     Start of the UDP payload inside RxBuf.
+  @param[out]     PayloadLen  UDP payload length.
+  @param[in,out]  Counts      Frame / IPv4 / UDP counters for diagnostics.
+
+  @retval EFI_SUCCESS    Control channel datagram received.
+  @retval EFI_NOT_FOUND  A frame was consumed but is not for us.
+  @retval EFI_NOT_READY  No frame waiting (or receive error).
 **/
+STATIC
 EFI_STATUS
-CompanionConnect (
-  IN OUT COMPANION_LINK  *Link
+CompanionRxPayload (
+  IN     COMPANION_LINK               *Link,
+  IN     EFI_SIMPLE_NETWORK_PROTOCOL  *Snp,
+  OUT    UINT8                        *RxBuf,
+  IN     UINTN                        RxSize,
+  OUT    UINT8                        **Payload,
+  OUT    UINTN                        *PayloadLen,
+  IN OUT UINTN                        *Counts
   )
 {
   EFI_STATUS  Status;
-  UINTN       Attempt;
-  CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINTN       BufSize;
+  UINTN       HeaderSize;
+  EFI_TPL     OldTpl;
 
-  if (Link == NULL || Link->Udp4 == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
+  //
+  // Raise TPL to prevent MNP background polling from consuming
+  // frames between our SNP->Receive() calls.
+  //
+  BufSize    = RxSize;
+  HeaderSize = 0;
 
-  if (Link->Mnp == NULL) {
-    Link->State = COMPANION_ERROR;
-    UtilSafeStrCpy (Link->StatusMsg, L"MNP not available for receive", 128);
-    return EFI_UNSUPPORTED;
-  }
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = Snp->Receive (Snp, &HeaderSize, &BufSize, RxBuf, NULL, NULL, NULL);
+  gBS->RestoreTPL (OldTpl);
+
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // Got a raw Ethernet frame.
+  //
+  Counts[0]++;
+
+  Status = CompanionMatchControl (Link, RxBuf, BufSize, HeaderSize, Payload, PayloadLen, Counts);
+  if (Status == EFI_NOT_FOUND && Link->RxTap != NULL) {
+    Link->RxTap (Link->RxTapContext, RxBuf, BufSize);
+  }
+
+  return Status;
+}
+
+/**
+  Receive a response from the companion with timeout.
+  Uses SNP (Simple Network Protocol) directly to receive raw Ethernet
+  frames, completely bypassing the MNP/IP4/UDP4 receive stack.
+  Parses Ethernet+IPv4+UDP headers to find control channel packets.
+
+  Also counts total received frames for diagnostics — the count is
+  stored in Link->StatusMsg on timeout to help identify whether the
+  NIC is receiving any frames at all.
+
+  The NIC is polled every COMPANION_RX_POLL_US, so the return time is
+  within a few microseconds of the arrival (the TIME exchange of
+  CompanionTimeSample depends on it).
+
+  @param[in,out]  Link          Companion link context.
+  @param[out]     Response      Buffer to receive ASCII response.
+  @param[in]      ResponseSize  Size of Response buffer in bytes.
+  @param[in]      TimeoutMs     Receive timeout in milliseconds.
+
+  @retval EFI_SUCCESS      Response received successfully.
+  @retval EFI_TIMEOUT      No response within timeout period.
+  @retval EFI_UNSUPPORTED  SNP not available.
+  @retval other            Receive failure.
+**/
+EFI_STATUS
+CompanionReceiveResponse (
+  IN OUT COMPANION_LINK  *Link,
+  OUT    CHAR8           *Response,
+  IN     UINTN           ResponseSize,
+  IN     UINT32          TimeoutMs
+  )
+{
+  EFI_STATUS                   Status;
+  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
+  UINT64                       DeadlineUs;
+  UINT8                        RxBuf[1600];
+  UINT8                        *Payload;
+  UINTN                        PayloadLen;
+  UINTN                        CopyLen;
+  UINTN                        Counts[3];
+
+  if (Link == NULL || Response == NULL || ResponseSize == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = CompanionOpenSnp (Link, &Snp);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Response[0] = '\0';
+  DeadlineUs  = UtilGetTimeUs () + (UINT64)TimeoutMs * 1000;
+  ZeroMem (Counts, sizeof (Counts));
+
+  while (UtilGetTimeUs () < DeadlineUs) {
+    Status = CompanionRxPayload (Link, Snp, RxBuf, sizeof (RxBuf), &Payload, &PayloadLen, Counts);
+
+    if (Status == EFI_NOT_READY) {
+      //
+      // No frame in NIC buffer — wait and retry
+      //
+      gBS->Stall (COMPANION_RX_POLL_US);
+      continue;
+    }
+
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    CopyLen = PayloadLen;
+    if (CopyLen >= ResponseSize - 1) {
+      CopyLen = ResponseSize - 1;
+    }
+    CopyMem (Response, Payload, CopyLen);
+    Response[CopyLen] = '\0';
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Timeout — store diagnostic frame counts in StatusMsg.
+  // This helps identify whether the NIC is receiving any frames at all.
+  //
+  UnicodeSPrint (
+    Link->StatusMsg, sizeof (Link->StatusMsg),
+    L"RX frames:%d ipv4:%d udp:%d (no match in %dms)",
+    Counts[0], Counts[1], Counts[2], TimeoutMs
+    );
+
+  return EFI_TIMEOUT;
+}
+
+//
+// ============================================================
+// Framed protocol: pipelined requests, RTO, fragment reassembly
+// ============================================================
+//
+
+/**
+  Feed one RTT sample into the RFC 6298 estimator and update the RTO
+  used for new requests.
+
+  @param[in,out]  Link      Companion link context.
+  @param[in]      SampleUs  Round trip of a request sent only once.
+**/
+STATIC
+VOID
+CompanionRttSample (
+  IN OUT COMPANION_LINK  *Link,
+  IN     UINT32          SampleUs
+  )
+{
+  UINT32  Delta;
+  UINT32  RtoMs;
+
+  SampleUs = MAX (SampleUs, 1);
+  if (Link->SrttUs == 0) {
+    Link->SrttUs   = SampleUs;
+    Link->RttVarUs = SampleUs / 2;
+  } else {
+    Delta          = (Link->SrttUs > SampleUs) ? Link->SrttUs - SampleUs : SampleUs - Link->SrttUs;
+    Link->RttVarUs = (3 * Link->RttVarUs + Delta) / 4;
+    Link->SrttUs   = (7 * Link->SrttUs + SampleUs) / 8;
+  }
+
+  RtoMs       = (Link->SrttUs + 4 * Link->RttVarUs) / 1000 + 1;
+  Link->RtoMs = MIN (MAX (RtoMs, COMPANION_RTO_MIN_MS), COMPANION_RTO_MAX_MS);
+}
+
+/**
+  (Re)transmit a framed request, advertising the response fragments
+  already received.
+
+  @param[in,out]  Link  Companion link context.
+  @param[in,out]  Req   Outstanding request.
+
+  @retval EFI_SUCCESS  Frame sent.
+  @retval other        Transmit failure (treated as a lost frame).
+**/
+STATIC
+EFI_STATUS
+CompanionFrameSend (
+  IN OUT COMPANION_LINK     *Link,
+  IN OUT COMPANION_REQUEST  *Req
+  )
+{
+  CompanionPut16 (Req->Frame, 10, Req->FragMask);
+  Req->SentUs = UtilGetTimeUs ();
+  return CompanionTransmit (Link, Req->Frame, Req->FrameLen);
+}
+
+/**
+  Store one response fragment in its outstanding request.
+
+  @param[in,out]  Link     Companion link context.
+  @param[in]      Payload  UDP payload of a control channel datagram.
+  @param[in]      Len      Payload length.
+**/
+STATIC
+VOID
+CompanionFrameInput (
+  IN OUT COMPANION_LINK  *Link,
+  IN     CONST UINT8     *Payload,
+  IN     UINTN           Len
+  )
+{
+  COMPANION_REQUEST  *Req;
+  UINT16             MsgId;
+  UINT16             FragIndex;
+  UINT16             FragCount;
+  UINTN              FragLen;
+  UINTN              Offset;
+  UINTN              Copy;
+  UINTN              Idx;
+
+  if (Len < COMPANION_FRAME_HDR_SIZE || Payload[0] != COMPANION_FRAME_MAGIC ||
+      (Payload[1] & COMPANION_FRAME_FLAG_RESPONSE) == 0) {
+    return;
+  }
+
+  MsgId     = COMPANION_GET16 (Payload, 2);
+  FragIndex = COMPANION_GET16 (Payload, 4);
+  FragCount = COMPANION_GET16 (Payload, 6);
+  FragLen   = COMPANION_GET16 (Payload, 8);
+  if (FragCount == 0 || FragCount > COMPANION_MAX_FRAGS || FragIndex >= FragCount ||
+      COMPANION_FRAME_HDR_SIZE + FragLen > Len) {
+    return;
+  }
+
+  //
+  // Late duplicates of completed requests find no slot and are dropped
+  //
+  Req = NULL;
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    if (Link->Requests[Idx].InUse && !Link->Requests[Idx].Done &&
+        Link->Requests[Idx].MsgId == MsgId) {
+      Req = &Link->Requests[Idx];
+      break;
+    }
+  }
+  if (Req == NULL) {
+    return;
+  }
+
+  if (Req->FragCount == 0) {
+    Req->FragCount = FragCount;
+  }
+  if (Req->FragCount != FragCount || (Req->FragMask & (1 << FragIndex)) != 0) {
+    return;
+  }
+
+  Offset = (UINTN)FragIndex * COMPANION_FRAG_PAYLOAD;
+  if (Offset < COMPANION_MAX_RESPONSE) {
+    Copy = MIN (FragLen, COMPANION_MAX_RESPONSE - Offset);
+    CopyMem (Req->Buffer + Offset, Payload + COMPANION_FRAME_HDR_SIZE, Copy);
+    Req->Length = MAX (Req->Length, Offset + Copy);
+  }
+  Req->FragMask |= (UINT16)(1 << FragIndex);
+
+  if (Req->FragMask == (UINT16)((1 << FragCount) - 1)) {
+    Req->Done   = TRUE;
+    Req->Status = EFI_SUCCESS;
+    //
+    // Karn: only requests answered without retransmission give a sample
+    //
+    if (Req->Retries == 0) {
+      CompanionRttSample (Link, (UINT32)(UtilGetTimeUs () - Req->SentUs));
+    }
+  }
+}
+
+/**
+  Drain up to COMPANION_PUMP_BUDGET received frames into their
+  requests, then retransmit every request whose RTO has expired
+  (doubling its RTO) or fail it once COMPANION_MAX_RETRIES is reached.
+  The budget and the deadline keep a flood of test traffic from holding
+  the caller in the drain past its timeout or its retransmissions.
+
+  @param[in,out]  Link        Companion link context.
+  @param[in]      Snp         SNP instance from CompanionOpenSnp.
+  @param[in]      DeadlineUs  Stop draining at this time.
+**/
+STATIC
+VOID
+CompanionPump (
+  IN OUT COMPANION_LINK               *Link,
+  IN     EFI_SIMPLE_NETWORK_PROTOCOL  *Snp,
+  IN     UINT64                       DeadlineUs
+  )
+{
+  EFI_STATUS         Status;
+  UINT8              RxBuf[1600];
+  UINT8              *Payload;
+  UINTN              PayloadLen;
+  UINTN              Counts[3];
+  UINTN              Idx;
+  UINTN              Budget;
+  UINT64             NowUs;
+  COMPANION_REQUEST  *Req;
+
+  ZeroMem (Counts, sizeof (Counts));
+  for (Budget = 0; Budget < COMPANION_PUMP_BUDGET; Budget++) {
+    Status = CompanionRxPayload (Link, Snp, RxBuf, sizeof (RxBuf), &Payload, &PayloadLen, Counts);
+    if (Status == EFI_NOT_READY) {
+      break;
+    }
+    if (!EFI_ERROR (Status)) {
+      CompanionFrameInput (Link, Payload, PayloadLen);
+    }
+    if (UtilGetTimeUs () >= DeadlineUs) {
+      break;
+    }
+  }
+
+  NowUs = UtilGetTimeUs ();
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    Req = &Link->Requests[Idx];
+    if (!Req->InUse || Req->Done || NowUs - Req->SentUs < (UINT64)Req->RtoMs * 1000) {
+      continue;
+    }
+    if (Req->Retries >= COMPANION_MAX_RETRIES) {
+      Req->Done   = TRUE;
+      Req->Status = EFI_TIMEOUT;
+      continue;
+    }
+    Req->Retries++;
+    Req->RtoMs = MIN (Req->RtoMs * 2, COMPANION_RTO_MAX_MS);
+    Link->Retransmits++;
+    CompanionFrameSend (Link, Req);
+  }
+}
+
+/**
+  Queue a request to the companion without waiting for its response.
+  With the framed protocol up to COMPANION_MAX_OUTSTANDING requests may
+  be in flight; the companion still executes them in submit order. On
+  a text-protocol session only one request may be outstanding.
+
+  @param[in,out]  Link     Companion link context.
+  @param[in]      Command  ASCII command (same text as the text protocol).
+  @param[out]     MsgId    Handle for CompanionWait.
+
+  @retval EFI_SUCCESS           Request sent (or queued for retransmission).
+  @retval EFI_OUT_OF_RESOURCES  All request slots busy, or no memory.
+  @retval EFI_NOT_READY         Text session already has a request outstanding.
+  @retval other                 Invalid parameter or transmit failure.
+**/
+EFI_STATUS
+CompanionSubmit (
+  IN OUT COMPANION_LINK  *Link,
+  IN     CONST CHAR8     *Command,
+  OUT    UINT16          *MsgId
+  )
+{
+  EFI_STATUS         Status;
+  COMPANION_REQUEST  *Req;
+  UINTN              Len;
+  UINTN              Idx;
+
+  if (Link == NULL || Link->Udp4 == NULL || Command == NULL || MsgId == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Len = AsciiStrLen (Command);
+  if (Len == 0 || Len > COMPANION_MAX_MSG_SIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Req = NULL;
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    if (Link->Requests[Idx].InUse) {
+      if (Link->Protocol != COMPANION_PROTO_FRAMED) {
+        return EFI_NOT_READY;
+      }
+    } else if (Req == NULL) {
+      Req = &Link->Requests[Idx];
+    }
+  }
+  if (Req == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Link->Protocol != COMPANION_PROTO_FRAMED) {
+    Status = CompanionSendCommand (Link, Command);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Link->NextMsgId++;
+    Req->InUse = TRUE;
+    Req->Done  = FALSE;
+    Req->MsgId = Link->NextMsgId;
+    *MsgId     = Req->MsgId;
+    return EFI_SUCCESS;
+  }
+
+  if (Req->Buffer == NULL) {
+    Req->Buffer = AllocatePool (COMPANION_MAX_RESPONSE);
+    if (Req->Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Link->NextMsgId++;
+  Req->InUse     = TRUE;
+  Req->Done      = FALSE;
+  Req->Status    = EFI_NOT_READY;
+  Req->MsgId     = Link->NextMsgId;
+  Req->FragCount = 0;
+  Req->FragMask  = 0;
+  Req->Retries   = 0;
+  Req->RtoMs     = Link->RtoMs;
+  Req->Length    = 0;
+  Req->FrameLen  = COMPANION_FRAME_HDR_SIZE + Len;
+
+  Req->Frame[0] = COMPANION_FRAME_MAGIC;
+  Req->Frame[1] = 0;
+  CompanionPut16 (Req->Frame, 2, Req->MsgId);
+  CompanionPut16 (Req->Frame, 4, 0);
+  CompanionPut16 (Req->Frame, 6, 1);
+  CompanionPut16 (Req->Frame, 8, (UINT16)Len);
+  CopyMem (Req->Frame + COMPANION_FRAME_HDR_SIZE, Command, Len);
+
+  //
+  // A failed transmit is handled like a lost frame: the RTO resends it.
+  // Dropping the slot instead would leave a hole in the message ids
+  // that the companion waits on.
+  //
+  CompanionFrameSend (Link, Req);
+  Link->MessageId++;
+
+  *MsgId = Req->MsgId;
+  return EFI_SUCCESS;
+}
+
+/**
+  Wait for the response to a submitted request. Responses of other
+  outstanding requests that arrive meanwhile are kept for their own
+  CompanionWait. A response that does not fit ResponseSize is cut to
+  fit and reported as EFI_BUFFER_TOO_SMALL; COMPANION_REPORT_SIZE holds
+  any response.
+
+  A framed request that is never answered leaves a gap the companion
+  cannot skip, so a timeout marks the link COMPANION_ERROR.
+
+  @param[in,out]  Link          Companion link context.
+  @param[in]      MsgId         Handle from CompanionSubmit.
+  @param[out]     Response      Buffer to receive the ASCII response.
+  @param[in]      ResponseSize  Size of Response buffer in bytes.
+  @param[in]      TimeoutMs     Wait timeout in milliseconds.
+
+  @retval EFI_SUCCESS           Response received.
+  @retval EFI_BUFFER_TOO_SMALL  Response received but truncated to ResponseSize.
+  @retval EFI_NOT_FOUND         No outstanding request with this id.
+  @retval EFI_TIMEOUT           No (complete) response in time.
+  @retval other                 Invalid parameter or SNP failure.
+**/
+EFI_STATUS
+CompanionWait (
+  IN OUT COMPANION_LINK  *Link,
+  IN     UINT16          MsgId,
+  OUT    CHAR8           *Response,
+  IN     UINTN           ResponseSize,
+  IN     UINT32          TimeoutMs
+  )
+{
+  EFI_STATUS                   Status;
+  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
+  COMPANION_REQUEST            *Req;
+  UINT64                       DeadlineUs;
+  UINTN                        CopyLen;
+  UINTN                        Idx;
+
+  if (Link == NULL || Response == NULL || ResponseSize == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Req = NULL;
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    if (Link->Requests[Idx].InUse && Link->Requests[Idx].MsgId == MsgId) {
+      Req = &Link->Requests[Idx];
+      break;
+    }
+  }
+  if (Req == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (Link->Protocol != COMPANION_PROTO_FRAMED) {
+    Status     = CompanionReceiveResponse (Link, Response, ResponseSize, TimeoutMs);
+    Req->InUse = FALSE;
+    return Status;
+  }
+
+  Response[0] = '\0';
+  Status = CompanionOpenSnp (Link, &Snp);
+  if (!EFI_ERROR (Status)) {
+    DeadlineUs = UtilGetTimeUs () + (UINT64)TimeoutMs * 1000;
+    while (!Req->Done && UtilGetTimeUs () < DeadlineUs) {
+      CompanionPump (Link, Snp, DeadlineUs);
+    }
+    Status = Req->Done ? Req->Status : EFI_TIMEOUT;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    CopyLen = MIN (Req->Length, ResponseSize - 1);
+    CopyMem (Response, Req->Buffer, CopyLen);
+    Response[CopyLen] = '\0';
+    if (CopyLen < Req->Length) {
+      Status = EFI_BUFFER_TOO_SMALL;
+      UnicodeSPrint (
+        Link->StatusMsg, sizeof (Link->StatusMsg),
+        L"Response %d is %d bytes, buffer holds %d",
+        MsgId, Req->Length, ResponseSize - 1
+        );
+    }
+  } else {
+    Link->State = COMPANION_ERROR;
+    UnicodeSPrint (
+      Link->StatusMsg, sizeof (Link->StatusMsg),
+      L"Request %d unanswered after %d retransmits (%r)",
+      MsgId, Req->Retries, Status
+      );
+  }
+
+  Req->InUse = FALSE;
+  return Status;
+}
+
+/**
+  Perform handshake with the companion.
+  Sends HELLO via UDP4 and receives ACK via MNP (which bypasses the
+  unreliable UDP4 receive path). Retries up to 3 times. HELLO offers
+  the framed protocol; the HELLO round trip seeds the RTO estimator.
+
+  @param[in,out]  Link  Companion link context.
+
+  @retval EFI_SUCCESS       Handshake completed, companion connected.
+  @retval EFI_TIMEOUT       No response from companion after all retries.
+  @retval EFI_DEVICE_ERROR  Unexpected response.
+  @retval other             Communication failure.
+**/
+EFI_STATUS
+CompanionConnect (
+  IN OUT COMPANION_LINK  *Link
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Attempt;
+  CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT64      HelloUs;
+
+  if (Link == NULL || Link->Udp4 == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Link->Mnp == NULL) {
+    Link->State = COMPANION_ERROR;
+    UtilSafeStrCpy (Link->StatusMsg, L"MNP not available for receive", 128);
+    return EFI_UNSUPPORTED;
+  }
 
   Link->State = COMPANION_CONNECTING;
 
@@ -700,7 +1362,8 @@ CompanionConnect (
     // incoming ACK frame during the send completion process,
     // so we don't need the "receive-before-send" pattern.
     //
-    Status = CompanionSendCommand (Link, "HELLO DDTSoft 1.0\n");
+    HelloUs = UtilGetTimeUs ();
+    Status  = CompanionSendCommand (Link, "HELLO DDTSoft 1.0 proto=2\n");
     if (EFI_ERROR (Status)) {
       //
       // Send failed — wait for ARP to settle and retry
@@ -721,8 +1384,21 @@ CompanionConnect (
     }
 
     if (AsciiStrnCmp (Response, "ACK", 3) == 0) {
-      Link->State = COMPANION_CONNECTED;
-      UtilSafeStrCpy (Link->StatusMsg, L"Connected to companion", 128);
+      //
+      // Older companions answer a plain ACK: stay on the text protocol
+      //
+      Link->State     = COMPANION_CONNECTED;
+      Link->NextMsgId = 0;
+      Link->SrttUs    = 0;
+      Link->RtoMs     = COMPANION_RTO_INIT_MS;
+      CompanionRttSample (Link, (UINT32)(UtilGetTimeUs () - HelloUs));
+      if (AsciiStrStr (Response, "proto=2") != NULL) {
+        Link->Protocol = COMPANION_PROTO_FRAMED;
+        UtilSafeStrCpy (Link->StatusMsg, L"Connected to companion (framed protocol)", 128);
+      } else {
+        Link->Protocol = COMPANION_PROTO_TEXT;
+        UtilSafeStrCpy (Link->StatusMsg, L"Connected to companion", 128);
+      }
       return EFI_SUCCESS;
     }
 
@@ -760,7 +1436,9 @@ CompanionDisconnect (
   IN OUT COMPANION_LINK  *Link
   )
 {
-  CHAR8  Response[COMPANION_MAX_MSG_SIZE];
+  CHAR8   Response[COMPANION_MAX_MSG_SIZE];
+  UINT16  MsgId;
+  UINTN   Idx;
 
   if (Link == NULL || Link->Udp4 == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -770,11 +1448,20 @@ CompanionDisconnect (
     //
     // Send DONE, best-effort
     //
-    CompanionSendCommand (Link, "DONE\n");
-    CompanionReceiveResponse (Link, Response, sizeof (Response), 1000);
+    if (!EFI_ERROR (CompanionSubmit (Link, "DONE\n", &MsgId))) {
+      CompanionWait (Link, MsgId, Response, sizeof (Response), 1000);
+    }
   }
 
-  Link->State = COMPANION_DISCONNECTED;
+  //
+  // Requests never waited for die with the session
+  //
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    Link->Requests[Idx].InUse = FALSE;
+  }
+
+  Link->State    = COMPANION_DISCONNECTED;
+  Link->Protocol = COMPANION_PROTO_TEXT;
   UtilSafeStrCpy (Link->StatusMsg, L"Disconnected", 128);
   return EFI_SUCCESS;
 }
@@ -795,6 +1482,7 @@ CompanionDestroy (
 {
   EFI_STATUS                    Status;
   EFI_SERVICE_BINDING_PROTOCOL  *Udp4Sb;
+  UINTN                         Idx;
 
   if (Link == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -807,6 +1495,21 @@ CompanionDestroy (
     CompanionDisconnect (Link);
   }
 
+  //
+  // Release framed-protocol reassembly buffers and the report
+  //
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    if (Link->Requests[Idx].Buffer != NULL) {
+      FreePool (Link->Requests[Idx].Buffer);
+      Link->Requests[Idx].Buffer = NULL;
+    }
+    Link->Requests[Idx].InUse = FALSE;
+  }
+  if (Link->Report != NULL) {
+    FreePool (Link->Report);
+    Link->Report = NULL;
+  }
+
   //
   // Unconfigure and destroy MNP child
   //
@@ -853,9 +1556,73 @@ CompanionDestroy (
     Link->Udp4ChildHandle = NULL;
   }
 
-  Link->State = COMPANION_DISCONNECTED;
-  UtilSafeStrCpy (Link->StatusMsg, L"Destroyed", 128);
-  return EFI_SUCCESS;
+  Link->State = COMPANION_DISCONNECTED;
+  UtilSafeStrCpy (Link->StatusMsg, L"Destroyed", 128);
+  return EFI_SUCCESS;
+}
+
+/**
+  Check a PREPARE response; READY keeps its detail in Link->ReadyDetail.
+
+  @param[in,out]  Link      Companion link context.
+  @param[in]      Response  PREPARE response text.
+
+  @retval EFI_SUCCESS       READY.
+  @retval EFI_DEVICE_ERROR  ERROR or unexpected response.
+**/
+STATIC
+EFI_STATUS
+CompanionPrepareReply (
+  IN OUT COMPANION_LINK  *Link,
+  IN     CONST CHAR8     *Response
+  )
+{
+  UINTN  Len;
+
+  if (AsciiStrnCmp (Response, "READY", 5) == 0) {
+    AsciiStrCpyS (Link->ReadyDetail, sizeof (Link->ReadyDetail),
+                  Response + ((Response[5] == ' ') ? 6 : 5));
+    Len = AsciiStrLen (Link->ReadyDetail);
+    while (Len > 0 && (Link->ReadyDetail[Len - 1] == '\n' || Link->ReadyDetail[Len - 1] == '\r')) {
+      Link->ReadyDetail[--Len] = '\0';
+    }
+    UtilSafeStrCpy (Link->StatusMsg, L"Companion ready", 128);
+    return EFI_SUCCESS;
+  }
+
+  if (AsciiStrnCmp (Response, "ERROR", 5) == 0) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Companion PREPARE error", 128);
+    return EFI_DEVICE_ERROR;
+  }
+
+  UtilSafeStrCpy (Link->StatusMsg, L"Unexpected PREPARE response", 128);
+  return EFI_DEVICE_ERROR;
+}
+
+/**
+  Build the PREPARE command text.
+
+  @param[in]   Layer    OSI layer identifier.
+  @param[in]   Test     Test name.
+  @param[in]   Args     Additional arguments (optional, may be NULL).
+  @param[out]  CmdBuf   Command buffer.
+  @param[in]   CmdSize  Size of CmdBuf in bytes.
+**/
+STATIC
+VOID
+CompanionPrepareCommand (
+  IN  CONST CHAR8  *Layer,
+  IN  CONST CHAR8  *Test,
+  IN  CONST CHAR8  *Args  OPTIONAL,
+  OUT CHAR8        *CmdBuf,
+  IN  UINTN        CmdSize
+  )
+{
+  if (Args != NULL && AsciiStrLen (Args) > 0) {
+    AsciiSPrint (CmdBuf, CmdSize, "PREPARE %a %a %a\n", Layer, Test, Args);
+  } else {
+    AsciiSPrint (CmdBuf, CmdSize, "PREPARE %a %a\n", Layer, Test);
+  }
 }
 
 /**
@@ -866,6 +1633,9 @@ CompanionDestroy (
   @param[in]      Test   Test name (e.g., "ICMP_ECHO", "TCP_CONNECT").
   @param[in]      Args   Additional arguments (optional, may be NULL).
 
+  The text after "READY" (service parameters such as negotiated ports,
+  "key=value" pairs like a REPORT) is kept in Link->ReadyDetail.
+
   @retval EFI_SUCCESS     Companion is READY for the test.
   @retval EFI_DEVICE_ERROR  Companion returned error.
   @retval other           Communication failure.
@@ -881,6 +1651,7 @@ CompanionPrepare (
   EFI_STATUS  Status;
   CHAR8       CmdBuf[COMPANION_MAX_MSG_SIZE];
   CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT16      MsgId;
 
   if (Link == NULL || Link->State != COMPANION_CONNECTED) {
     return EFI_NOT_READY;
@@ -890,16 +1661,10 @@ CompanionPrepare (
     return EFI_INVALID_PARAMETER;
   }
 
-  //
-  // Build PREPARE command
-  //
-  if (Args != NULL && AsciiStrLen (Args) > 0) {
-    AsciiSPrint (CmdBuf, sizeof (CmdBuf), "PREPARE %a %a %a\n", Layer, Test, Args);
-  } else {
-    AsciiSPrint (CmdBuf, sizeof (CmdBuf), "PREPARE %a %a\n", Layer, Test);
-  }
+  Link->ReadyDetail[0] = '\0';
+  CompanionPrepareCommand (Layer, Test, Args, CmdBuf, sizeof (CmdBuf));
 
-  Status = CompanionSendCommand (Link, CmdBuf);
+  Status = CompanionSubmit (Link, CmdBuf, &MsgId);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"Failed to send PREPARE", 128);
     return Status;
@@ -908,24 +1673,13 @@ CompanionPrepare (
   //
   // Wait for READY
   //
-  Status = CompanionReceiveResponse (Link, Response, sizeof (Response), Link->TimeoutMs);
+  Status = CompanionWait (Link, MsgId, Response, sizeof (Response), Link->TimeoutMs);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"No response to PREPARE", 128);
     return Status;
   }
 
-  if (AsciiStrnCmp (Response, "READY", 5) == 0) {
-    UtilSafeStrCpy (Link->StatusMsg, L"Companion ready", 128);
-    return EFI_SUCCESS;
-  }
-
-  if (AsciiStrnCmp (Response, "ERROR", 5) == 0) {
-    UtilSafeStrCpy (Link->StatusMsg, L"Companion PREPARE error", 128);
-    return EFI_DEVICE_ERROR;
-  }
-
-  UtilSafeStrCpy (Link->StatusMsg, L"Unexpected PREPARE response", 128);
-  return EFI_DEVICE_ERROR;
+  return CompanionPrepareReply (Link, Response);
 }
 
 /**
@@ -944,18 +1698,19 @@ CompanionStart (
 {
   EFI_STATUS  Status;
   CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT16      MsgId;
 
   if (Link == NULL || Link->State != COMPANION_CONNECTED) {
     return EFI_NOT_READY;
   }
 
-  Status = CompanionSendCommand (Link, "START\n");
+  Status = CompanionSubmit (Link, "START\n", &MsgId);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"Failed to send START", 128);
     return Status;
   }
 
-  Status = CompanionReceiveResponse (Link, Response, sizeof (Response), Link->TimeoutMs);
+  Status = CompanionWait (Link, MsgId, Response, sizeof (Response), Link->TimeoutMs);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"No response to START", 128);
     return Status;
@@ -970,6 +1725,99 @@ CompanionStart (
   return EFI_DEVICE_ERROR;
 }
 
+/**
+  PREPARE and START a test in one round trip.
+  On a framed session both requests are submitted back to back; the
+  companion executes them in order, so START fires the run PREPARE has
+  just armed. A START that follows a failed PREPARE has nothing to
+  fire. A text session falls back to CompanionPrepare + CompanionStart.
+
+  @param[in,out]  Link   Companion link context.
+  @param[in]      Layer  OSI layer identifier.
+  @param[in]      Test   Test name.
+  @param[in]      Args   Additional arguments (optional, may be NULL).
+
+  @retval EFI_SUCCESS       Companion READY and START acknowledged.
+  @retval EFI_DEVICE_ERROR  Companion rejected PREPARE or START.
+  @retval other             Communication failure.
+**/
+EFI_STATUS
+CompanionPrepareStart (
+  IN OUT COMPANION_LINK  *Link,
+  IN     CONST CHAR8     *Layer,
+  IN     CONST CHAR8     *Test,
+  IN     CONST CHAR8     *Args  OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  EFI_STATUS  StartStatus;
+  CHAR8       CmdBuf[COMPANION_MAX_MSG_SIZE];
+  CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT16      PrepareId;
+  UINT16      StartId;
+
+  if (Link == NULL || Link->State != COMPANION_CONNECTED) {
+    return EFI_NOT_READY;
+  }
+
+  if (Layer == NULL || Test == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Link->Protocol != COMPANION_PROTO_FRAMED) {
+    Status = CompanionPrepare (Link, Layer, Test, Args);
+    if (!EFI_ERROR (Status)) {
+      Status = CompanionStart (Link);
+    }
+    return Status;
+  }
+
+  Link->ReadyDetail[0] = '\0';
+  CompanionPrepareCommand (Layer, Test, Args, CmdBuf, sizeof (CmdBuf));
+
+  Status = CompanionSubmit (Link, CmdBuf, &PrepareId);
+  if (EFI_ERROR (Status)) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Failed to send PREPARE", 128);
+    return Status;
+  }
+  StartStatus = CompanionSubmit (Link, "START\n", &StartId);
+
+  Status = CompanionWait (Link, PrepareId, Response, sizeof (Response), Link->TimeoutMs);
+  if (EFI_ERROR (Status)) {
+    UtilSafeStrCpy (Link->StatusMsg, L"No response to PREPARE", 128);
+    return Status;
+  }
+  Status = CompanionPrepareReply (Link, Response);
+
+  //
+  // Collect the START answer even after a failed PREPARE so its slot
+  // is released
+  //
+  if (EFI_ERROR (StartStatus)) {
+    if (!EFI_ERROR (Status)) {
+      UtilSafeStrCpy (Link->StatusMsg, L"Failed to send START", 128);
+      Status = StartStatus;
+    }
+    return Status;
+  }
+  StartStatus = CompanionWait (Link, StartId, Response, sizeof (Response), Link->TimeoutMs);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (EFI_ERROR (StartStatus)) {
+    UtilSafeStrCpy (Link->StatusMsg, L"No response to START", 128);
+    return StartStatus;
+  }
+
+  if (AsciiStrnCmp (Response, "ACK", 3) == 0) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Test started", 128);
+    return EFI_SUCCESS;
+  }
+
+  UtilSafeStrCpy (Link->StatusMsg, L"Unexpected START response", 128);
+  return EFI_DEVICE_ERROR;
+}
+
 /**
   Send STOP command to halt a running test.
 
@@ -985,18 +1833,19 @@ CompanionStop (
 {
   EFI_STATUS  Status;
   CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT16      MsgId;
 
   if (Link == NULL || Link->State != COMPANION_CONNECTED) {
     return EFI_NOT_READY;
   }
 
-  Status = CompanionSendCommand (Link, "STOP\n");
+  Status = CompanionSubmit (Link, "STOP\n", &MsgId);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"Failed to send STOP", 128);
     return Status;
   }
 
-  Status = CompanionReceiveResponse (Link, Response, sizeof (Response), Link->TimeoutMs);
+  Status = CompanionWait (Link, MsgId, Response, sizeof (Response), Link->TimeoutMs);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -1009,53 +1858,379 @@ CompanionStop (
   return EFI_DEVICE_ERROR;
 }
 
+/**
+  Return the link's report buffer, allocating it on first use.
+
+  @param[in,out]  Link  Companion link context.
+
+  @return  COMPANION_REPORT_SIZE buffer holding an empty string, or NULL.
+**/
+STATIC
+CHAR8 *
+CompanionReportBuffer (
+  IN OUT COMPANION_LINK  *Link
+  )
+{
+  if (Link->Report == NULL) {
+    Link->Report = AllocatePool (COMPANION_REPORT_SIZE);
+    if (Link->Report == NULL) {
+      return NULL;
+    }
+  }
+  Link->Report[0] = '\0';
+  return Link->Report;
+}
+
+/**
+  Check a RESULT response held in the link's report buffer.
+
+  @param[in,out]  Link  Companion link context.
+
+  @retval EFI_SUCCESS       REPORT (or a plain OK without results).
+  @retval EFI_DEVICE_ERROR  Companion answered ERROR.
+**/
+STATIC
+EFI_STATUS
+CompanionResultReply (
+  IN OUT COMPANION_LINK  *Link
+  )
+{
+  if (AsciiStrnCmp (Link->Report, "REPORT", 6) == 0) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Result received", 128);
+    return EFI_SUCCESS;
+  }
+
+  if (AsciiStrnCmp (Link->Report, "ERROR", 5) == 0) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Companion result error", 128);
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Send RESULT query and receive test result from the companion.
+  The report is kept in a COMPANION_REPORT_SIZE pool buffer owned by
+  the link; it stays valid until the next RESULT or CompanionDestroy.
 
-  @param[in,out]  Link        Companion link context.
-  @param[out]     Result      Buffer to receive result data.
-  @param[in]      ResultSize  Size of Result buffer in bytes.
+  @param[in,out]  Link    Companion link context.
+  @param[out]     Report  Set to the NUL-terminated report text.
 
-  @retval EFI_SUCCESS  Result received successfully.
-  @retval other        Communication or protocol failure.
+  @retval EFI_SUCCESS           Result received successfully.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the report buffer.
+  @retval other                 Communication or protocol failure.
 **/
 EFI_STATUS
 CompanionGetResult (
   IN OUT COMPANION_LINK  *Link,
-  OUT    CHAR8           *Result,
-  IN     UINTN           ResultSize
+  OUT    CONST CHAR8     **Report
   )
 {
   EFI_STATUS  Status;
+  UINT16      MsgId;
 
-  if (Link == NULL || Link->State != COMPANION_CONNECTED || Result == NULL) {
+  if (Link == NULL || Link->State != COMPANION_CONNECTED || Report == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
-  Status = CompanionSendCommand (Link, "RESULT\n");
+  *Report = CompanionReportBuffer (Link);
+  if (*Report == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = CompanionSubmit (Link, "RESULT\n", &MsgId);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"Failed to send RESULT", 128);
     return Status;
   }
 
   //
-  // Wait for REPORT response (may take longer for large results)
+  // Wait for REPORT response (may take longer for large results; on the
+  // framed protocol it arrives in fragments up to COMPANION_MAX_RESPONSE)
   //
-  Status = CompanionReceiveResponse (Link, Result, ResultSize, Link->TimeoutMs * 2);
+  Status = CompanionWait (Link, MsgId, Link->Report, COMPANION_REPORT_SIZE, Link->TimeoutMs * 2);
   if (EFI_ERROR (Status)) {
     UtilSafeStrCpy (Link->StatusMsg, L"No result from companion", 128);
     return Status;
   }
 
-  if (AsciiStrnCmp (Result, "REPORT", 6) == 0) {
-    UtilSafeStrCpy (Link->StatusMsg, L"Result received", 128);
-    return EFI_SUCCESS;
+  return CompanionResultReply (Link);
+}
+
+/**
+  STOP a test and fetch its RESULT in one round trip.
+  On a framed session STOP and RESULT are submitted back to back and
+  the companion answers RESULT after it has stopped the run. The STOP
+  answer only matters for releasing its slot; like a separate
+  CompanionStop, its failure does not stop the RESULT. A text session
+  falls back to CompanionStop + CompanionGetResult.
+
+  @param[in,out]  Link    Companion link context.
+  @param[out]     Report  Set to the NUL-terminated report text
+                          (see CompanionGetResult).
+
+  @retval EFI_SUCCESS           Result received successfully.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the report buffer.
+  @retval other                 Communication or protocol failure.
+**/
+EFI_STATUS
+CompanionStopResult (
+  IN OUT COMPANION_LINK  *Link,
+  OUT    CONST CHAR8     **Report
+  )
+{
+  EFI_STATUS  Status;
+  EFI_STATUS  StopStatus;
+  CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT16      StopId;
+  UINT16      MsgId;
+
+  if (Link == NULL || Link->State != COMPANION_CONNECTED || Report == NULL) {
+    return EFI_INVALID_PARAMETER;
   }
 
-  if (AsciiStrnCmp (Result, "ERROR", 5) == 0) {
-    UtilSafeStrCpy (Link->StatusMsg, L"Companion result error", 128);
-    return EFI_DEVICE_ERROR;
+  if (Link->Protocol != COMPANION_PROTO_FRAMED) {
+    CompanionStop (Link);
+    return CompanionGetResult (Link, Report);
+  }
+
+  *Report = CompanionReportBuffer (Link);
+  if (*Report == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  StopStatus = CompanionSubmit (Link, "STOP\n", &StopId);
+  Status     = CompanionSubmit (Link, "RESULT\n", &MsgId);
+  if (!EFI_ERROR (StopStatus)) {
+    CompanionWait (Link, StopId, Response, sizeof (Response), Link->TimeoutMs);
+  }
+  if (EFI_ERROR (Status)) {
+    UtilSafeStrCpy (Link->StatusMsg, L"Failed to send RESULT", 128);
+    return Status;
+  }
+
+  Status = CompanionWait (Link, MsgId, Link->Report, COMPANION_REPORT_SIZE, Link->TimeoutMs * 2);
+  if (EFI_ERROR (Status)) {
+    UtilSafeStrCpy (Link->StatusMsg, L"No result from companion", 128);
+    return Status;
+  }
+
+  return CompanionResultReply (Link);
+}
+
+/**
+  Find the value of a "key=value" field.
+  Service results are "key=value" pairs separated by ',' (within a
+  service) and ';' (between services); the first exact key match wins.
+
+  @param[in]  Report  REPORT (or READY detail) text.
+  @param[in]  Key     Field name, without the trailing '='; not empty.
+
+  @return  Start of the value, or NULL if there is no such field.
+**/
+STATIC
+CONST CHAR8 *
+CompanionFindField (
+  IN CONST CHAR8  *Report,
+  IN CONST CHAR8  *Key
+  )
+{
+  CONST CHAR8  *Pos;
+  UINTN        KeyLen;
+
+  KeyLen = AsciiStrLen (Key);
+  for (Pos = AsciiStrStr (Report, Key); Pos != NULL; Pos = AsciiStrStr (Pos + KeyLen, Key)) {
+    //
+    // Must start a field ("source_bytes" is not "bytes") and be followed by '='
+    //
+    if (Pos != Report &&
+        Pos[-1] != ' ' && Pos[-1] != ',' && Pos[-1] != ';' && Pos[-1] != '=') {
+      continue;
+    }
+    if (Pos[KeyLen] != '=') {
+      continue;
+    }
+    return Pos + KeyLen + 1;
+  }
+
+  return NULL;
+}
+
+/**
+  Extract a numeric field from a REPORT string (see CompanionFindField).
+
+  @param[in]   Report  REPORT response text from CompanionGetResult.
+  @param[in]   Key     Field name, without the trailing '='.
+  @param[out]  Value   Parsed decimal value.
+
+  @retval EFI_SUCCESS            Field found and parsed.
+  @retval EFI_NOT_FOUND          Report has no such field.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+**/
+EFI_STATUS
+CompanionResultValue (
+  IN  CONST CHAR8  *Report,
+  IN  CONST CHAR8  *Key,
+  OUT UINT64       *Value
+  )
+{
+  CONST CHAR8  *Pos;
+
+  if (Report == NULL || Key == NULL || Value == NULL || Key[0] == '\0') {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Pos = CompanionFindField (Report, Key);
+  if (Pos == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Value = AsciiStrDecimalToUint64 (Pos);
+  return EFI_SUCCESS;
+}
+
+/**
+  Extract a text field from a REPORT string or a READY detail (see
+  CompanionFindField). The value ends at the next ',', ';', space or
+  line end.
+
+  @param[in]   Report     Response text.
+  @param[in]   Key        Field name, without the trailing '='.
+  @param[out]  Value      Field value, NUL terminated.
+  @param[in]   ValueSize  Size of Value in bytes.
+
+  @retval EFI_SUCCESS            Field found and copied.
+  @retval EFI_NOT_FOUND          No such field, or it is empty.
+  @retval EFI_BUFFER_TOO_SMALL   The value does not fit ValueSize.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+**/
+EFI_STATUS
+CompanionResultString (
+  IN  CONST CHAR8  *Report,
+  IN  CONST CHAR8  *Key,
+  OUT CHAR8        *Value,
+  IN  UINTN        ValueSize
+  )
+{
+  CONST CHAR8  *Pos;
+  UINTN        Len;
+
+  if (Report == NULL || Key == NULL || Value == NULL || ValueSize == 0 || Key[0] == '\0') {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Value[0] = '\0';
+  Pos      = CompanionFindField (Report, Key);
+  if (Pos == NULL) {
+    return EFI_NOT_FOUND;
   }
 
+  Len = 0;
+  while (Pos[Len] != '\0' && Pos[Len] != ',' && Pos[Len] != ';' &&
+         Pos[Len] != ' ' && Pos[Len] != '\r' && Pos[Len] != '\n') {
+    Len++;
+  }
+  if (Len == 0) {
+    return EFI_NOT_FOUND;
+  }
+  if (Len >= ValueSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (Value, Pos, Len);
+  Value[Len] = '\0';
   return EFI_SUCCESS;
 }
+
+/**
+  One clock-offset exchange with the companion (NTP-style, one sample).
+  Sends "TIME <Seq>" as plain text, bypassing the framed request queue,
+  and stamps the send and the reply arrival on the DUT clock. The reply
+  carries the companion's CLOCK_MONOTONIC arrival and send times.
+
+  Replies to earlier TIME requests that arrive late are skipped. Only
+  valid with no framed request outstanding, since the raw receive would
+  consume its response.
+
+  @param[in,out]  Link       Companion link context.
+  @param[in]      Seq        Exchange number, echoed in the reply.
+  @param[in]      TimeoutMs  Reply timeout in milliseconds.
+  @param[out]     SendUs     DUT time the request was sent (T1).
+  @param[out]     RecvUs     DUT time the reply arrived (T4).
+  @param[out]     PeerRxNs   Companion time the request arrived (T2).
+  @param[out]     PeerTxNs   Companion time the reply was sent (T3).
+
+  @retval EFI_SUCCESS       Sample taken.
+  @retval EFI_NOT_READY     Not connected, or a request is outstanding.
+  @retval EFI_TIMEOUT       No matching reply in time.
+  @retval EFI_UNSUPPORTED   Companion does not know TIME.
+  @retval other             Transmit or receive failure.
+**/
+EFI_STATUS
+CompanionTimeSample (
+  IN OUT COMPANION_LINK  *Link,
+  IN     UINT32          Seq,
+  IN     UINT32          TimeoutMs,
+  OUT    UINT64          *SendUs,
+  OUT    UINT64          *RecvUs,
+  OUT    UINT64          *PeerRxNs,
+  OUT    UINT64          *PeerTxNs
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       Command[32];
+  CHAR8       Response[COMPANION_MAX_MSG_SIZE];
+  UINT64      DeadlineUs;
+  UINT64      NowUs;
+  UINT64      ReplySeq;
+  UINTN       Idx;
+
+  if (Link == NULL || SendUs == NULL || RecvUs == NULL || PeerRxNs == NULL || PeerTxNs == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Link->State != COMPANION_CONNECTED) {
+    return EFI_NOT_READY;
+  }
+  for (Idx = 0; Idx < COMPANION_MAX_OUTSTANDING; Idx++) {
+    if (Link->Requests[Idx].InUse) {
+      return EFI_NOT_READY;
+    }
+  }
+
+  AsciiSPrint (Command, sizeof (Command), "TIME %u\n", Seq);
+
+  *SendUs = UtilGetTimeUs ();
+  Status  = CompanionSendCommand (Link, Command);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  DeadlineUs = *SendUs + (UINT64)TimeoutMs * 1000;
+  for (NowUs = *SendUs; NowUs < DeadlineUs; NowUs = UtilGetTimeUs ()) {
+    Status = CompanionReceiveResponse (
+               Link, Response, sizeof (Response),
+               (UINT32)((DeadlineUs - NowUs + 999) / 1000)
+               );
+    *RecvUs = UtilGetTimeUs ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (AsciiStrnCmp (Response, "ERROR", 5) == 0) {
+      return EFI_UNSUPPORTED;
+    }
+    if (AsciiStrnCmp (Response, "TIME ", 5) != 0 ||
+        EFI_ERROR (CompanionResultValue (Response, "seq", &ReplySeq)) ||
+        ReplySeq != Seq) {
+      continue;
+    }
+
+    if (EFI_ERROR (CompanionResultValue (Response, "rx", PeerRxNs)) ||
+        EFI_ERROR (CompanionResultValue (Response, "tx", PeerTxNs))) {
+      return EFI_PROTOCOL_ERROR;
+    }
+    return EFI_SUCCESS;
+  }
+
+  return EFI_TIMEOUT;
+}
@@ -1,6 +1,8 @@
 /** @file
   Layer 2 (Data Link) test implementations.
-  Tests MAC validation, ARP, broadcast, frame TX/RX, MTU, receive filters.
+  Tests MAC validation, ARP, broadcast, frame TX/RX, MTU, receive filters,
+  subnet host discovery and receive capacity against the companion's
+  frame generator.
   Uses EFI_SIMPLE_NETWORK_PROTOCOL for raw frame operations.
 **/
 
@@ -1111,3 +1113,1213 @@ TestL2ReceiveFilter (
 
   return EFI_SUCCESS;
 }
+
+//
+// ============================================================
+// Subnet host discovery (paced raw ARP sweep + ICMP confirm)
+// ============================================================
+//
+
+#define L2_DISC_RATE_PPS     2000     // /24 in ~130 ms, /16 in ~33 s
+#define L2_DISC_GRACE_MS     500      // wait for late replies after the last request
+#define L2_DISC_MAX_HOSTS    65534    // sweep at most a /16
+#define L2_DISC_MAX_TABLE    4096     // hosts kept with MAC/latency
+#define L2_DISC_ICMP_MAX     256      // ICMP-confirm only tables up to this size
+#define L2_DISC_ICMP_ID      0xDD33
+
+typedef struct {
+  UINT32    HostIndex;                // offset from the network address
+  UINT8     Mac[6];
+  UINT32    LatencyUs;                // ARP request -> first reply
+  BOOLEAN   IcmpOk;
+  UINT32    IcmpRttUs;
+} L2_DISC_HOST;
+
+typedef struct {
+  UINT8          Network[4];
+  UINTN          PrefixLen;
+  UINT32         HostCount;           // addresses swept
+  BOOLEAN        Truncated;           // subnet larger than L2_DISC_MAX_HOSTS
+  UINT32         *SentOffUs;          // per host: request time relative to StartUs
+  UINT8          *Seen;               // per host bitmap
+  L2_DISC_HOST   *Table;
+  UINTN          ArpSent;
+  UINTN          Found;               // hosts answering ARP
+  UINTN          Kept;                // entries in Table
+  UINTN          IcmpSent;
+  UINTN          IcmpOk;
+  UINT64         StartUs;
+  UINT64         ElapsedUs;
+} L2_DISC_STATE;
+
+/**
+  Host address for a sweep index.
+
+  @param[in]   State  Sweep state.
+  @param[in]   Index  Host index, 1..HostCount.
+  @param[out]  Ip     IPv4 address (4 bytes).
+**/
+STATIC
+VOID
+L2DiscHostIp (
+  IN  L2_DISC_STATE  *State,
+  IN  UINT32         Index,
+  OUT UINT8          *Ip
+  )
+{
+  UINT32  Addr;
+
+  Addr  = ((UINT32)State->Network[0] << 24) | ((UINT32)State->Network[1] << 16) |
+          ((UINT32)State->Network[2] << 8)  |  (UINT32)State->Network[3];
+  Addr += Index;
+  Ip[0] = (UINT8)(Addr >> 24);
+  Ip[1] = (UINT8)(Addr >> 16);
+  Ip[2] = (UINT8)(Addr >> 8);
+  Ip[3] = (UINT8)Addr;
+}
+
+/**
+  Sweep index of an address, 0 when outside the swept range.
+
+  @param[in]  State  Sweep state.
+  @param[in]  Ip     IPv4 address (4 bytes).
+
+  @return  Host index 1..HostCount, or 0.
+**/
+STATIC
+UINT32
+L2DiscHostIndex (
+  IN L2_DISC_STATE  *State,
+  IN CONST UINT8    *Ip
+  )
+{
+  UINT32  Net;
+  UINT32  Addr;
+
+  Net  = ((UINT32)State->Network[0] << 24) | ((UINT32)State->Network[1] << 16) |
+         ((UINT32)State->Network[2] << 8)  |  (UINT32)State->Network[3];
+  Addr = ((UINT32)Ip[0] << 24) | ((UINT32)Ip[1] << 16) | ((UINT32)Ip[2] << 8) | (UINT32)Ip[3];
+
+  if (Addr <= Net || Addr - Net > State->HostCount) {
+    return 0;
+  }
+  return Addr - Net;
+}
+
+/**
+  Drain received frames into the discovery table: ARP replies addressed
+  to us during the sweep, ICMP echo replies during confirmation.
+
+  @param[in]      Io       Packet I/O context.
+  @param[in]      LocalIp  Our IPv4 address.
+  @param[in,out]  State    Sweep state.
+**/
+STATIC
+VOID
+L2DiscDrain (
+  IN OUT PKT_IO         *Io,
+  IN     CONST UINT8    *LocalIp,
+  IN OUT L2_DISC_STATE  *State
+  )
+{
+  UINT8          RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN          RxLen;
+  UINTN          Budget;
+  UINT32         Index;
+  UINT32         NowOffUs;
+  UINT16         Slot;
+  PARSED_PACKET  Parsed;
+  L2_DISC_HOST   *Host;
+
+  for (Budget = 0; Budget < 64; Budget++) {
+    RxLen = sizeof (RxBuf);
+    if (EFI_ERROR (PktIoReceive (Io, RxBuf, &RxLen))) {
+      return;
+    }
+    NowOffUs = (UINT32)(UtilGetTimeUs () - State->StartUs);
+
+    if (EFI_ERROR (PktParsePacket (RxBuf, RxLen, &Parsed))) {
+      continue;
+    }
+
+    if (Parsed.HasArp) {
+      if (NTOHS (Parsed.Arp->Operation) != ARP_OP_REPLY ||
+          CompareMem (Parsed.Arp->TargetIp, LocalIp, 4) != 0) {
+        continue;
+      }
+      Index = L2DiscHostIndex (State, Parsed.Arp->SenderIp);
+      if (Index == 0 || State->SentOffUs[Index] == 0 ||
+          (State->Seen[Index >> 3] & (1 << (Index & 7))) != 0) {
+        continue;
+      }
+      State->Seen[Index >> 3] |= (UINT8)(1 << (Index & 7));
+      State->Found++;
+
+      if (State->Kept < L2_DISC_MAX_TABLE) {
+        Host = &State->Table[State->Kept++];
+        Host->HostIndex = Index;
+        Host->LatencyUs = NowOffUs - State->SentOffUs[Index];
+        CopyMem (Host->Mac, Parsed.Arp->SenderMac, 6);
+      }
+      continue;
+    }
+
+    //
+    // ICMP confirmation: sequence number is the table slot
+    //
+    if (Parsed.HasIpv4 && Parsed.HasIcmp &&
+        Parsed.Icmp->Type == ICMP_TYPE_ECHO_REPLY &&
+        NTOHS (Parsed.Icmp->Identifier) == L2_DISC_ICMP_ID &&
+        CompareMem (Parsed.Ipv4->DstAddr, LocalIp, 4) == 0) {
+      Slot = NTOHS (Parsed.Icmp->SequenceNumber);
+      if (Slot >= State->Kept || State->Table[Slot].IcmpOk ||
+          L2DiscHostIndex (State, Parsed.Ipv4->SrcAddr) != State->Table[Slot].HostIndex) {
+        continue;
+      }
+      State->Table[Slot].IcmpOk    = TRUE;
+      State->Table[Slot].IcmpRttUs = NowOffUs - State->Table[Slot].IcmpRttUs;
+      State->IcmpOk++;
+    }
+  }
+}
+
+/**
+  Wait until TargetOffUs (relative to State->StartUs), draining replies.
+
+  @param[in,out]  Io           Packet I/O context.
+  @param[in]      LocalIp      Our IPv4 address.
+  @param[in,out]  State        Sweep state.
+  @param[in]      TargetOffUs  Time to wait for.
+**/
+STATIC
+VOID
+L2DiscWaitUntil (
+  IN OUT PKT_IO         *Io,
+  IN     CONST UINT8    *LocalIp,
+  IN OUT L2_DISC_STATE  *State,
+  IN     UINT64         TargetOffUs
+  )
+{
+  while (UtilGetTimeUs () - State->StartUs < TargetOffUs) {
+    L2DiscDrain (Io, LocalIp, State);
+  }
+}
+
+/**
+  Sweep the subnet with paced ARP requests from one raw-SNP loop, then
+  ICMP-confirm the hosts found (small tables only).
+
+  @param[in]      Nic      NIC information.
+  @param[in]      LocalIp  Our IPv4 address (sender of the requests).
+  @param[in,out]  State    Network/PrefixLen/HostCount set; results filled.
+
+  @retval EFI_SUCCESS           Sweep completed.
+  @retval EFI_OUT_OF_RESOURCES  Table allocation failed.
+  @retval other                 Raw I/O could not be opened.
+**/
+STATIC
+EFI_STATUS
+L2DiscSweep (
+  IN     NIC_INFO       *Nic,
+  IN     CONST UINT8    *LocalIp,
+  IN OUT L2_DISC_STATE  *State
+  )
+{
+  EFI_STATUS  Status;
+  PKT_IO      Io;
+  UINT8       Frame[128];
+  UINT8       HostIp[4];
+  UINTN       FrameLen;
+  UINT32      Index;
+  UINT32      IntervalUs;
+  UINT64      SendOffUs;
+  UINTN       Slot;
+
+  State->SentOffUs = AllocateZeroPool ((State->HostCount + 1) * sizeof (UINT32));
+  State->Seen      = AllocateZeroPool ((State->HostCount >> 3) + 1);
+  State->Table     = AllocateZeroPool (L2_DISC_MAX_TABLE * sizeof (L2_DISC_HOST));
+  if (State->SentOffUs == NULL || State->Seen == NULL || State->Table == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  IntervalUs     = 1000000 / L2_DISC_RATE_PPS;
+  State->StartUs = UtilGetTimeUs ();
+  SendOffUs      = 0;
+
+  for (Index = 1; Index <= State->HostCount; Index++) {
+    L2DiscHostIp (State, Index, HostIp);
+    if (CompareMem (HostIp, LocalIp, 4) == 0) {
+      continue;
+    }
+
+    L2DiscWaitUntil (&Io, LocalIp, State, SendOffUs);
+
+    FrameLen = PktBuildArpRequest (Frame, Io.SrcMac, LocalIp, HostIp);
+    State->SentOffUs[Index] = (UINT32)MAX (UtilGetTimeUs () - State->StartUs, 1);
+    if (!EFI_ERROR (PktIoSend (&Io, Frame, FrameLen))) {
+      State->ArpSent++;
+    }
+    SendOffUs += IntervalUs;
+  }
+
+  L2DiscWaitUntil (&Io, LocalIp, State, SendOffUs + L2_DISC_GRACE_MS * 1000);
+
+  //
+  // Confirm with ICMP echo straight to the learned MAC (no second ARP).
+  // IcmpRttUs holds the send offset until the reply converts it to RTT.
+  //
+  if (State->Kept > 0 && State->Kept <= L2_DISC_ICMP_MAX) {
+    for (Slot = 0; Slot < State->Kept; Slot++) {
+      L2DiscWaitUntil (&Io, LocalIp, State, SendOffUs);
+      L2DiscHostIp (State, State->Table[Slot].HostIndex, HostIp);
+      FrameLen = PktBuildIcmpEchoRequest (
+                   Frame, Io.SrcMac, State->Table[Slot].Mac, LocalIp, HostIp,
+                   L2_DISC_ICMP_ID, (UINT16)Slot, NULL, 32
+                   );
+      State->Table[Slot].IcmpRttUs = (UINT32)(UtilGetTimeUs () - State->StartUs);
+      if (!EFI_ERROR (PktIoSend (&Io, Frame, FrameLen))) {
+        State->IcmpSent++;
+      }
+      SendOffUs = MAX (SendOffUs, UtilGetTimeUs () - State->StartUs) + IntervalUs;
+    }
+    L2DiscWaitUntil (&Io, LocalIp, State, SendOffUs + L2_DISC_GRACE_MS * 1000);
+  }
+
+  State->ElapsedUs = UtilGetTimeUs () - State->StartUs;
+  PktIoClose (&Io);
+  return EFI_SUCCESS;
+}
+
+/**
+  Test L2.8: Host Discovery
+  Walks the NIC's IPv4 subnet (Ipv4Address/SubnetMask, else the test
+  config) with paced raw ARP requests from a single loop, collecting
+  replies asynchronously into a table of IP, MAC and first-response
+  latency. Hosts found on small segments are then confirmed with ICMP
+  echo. Subnets larger than /16 are limited to the local /16.
+
+  PASS: At least one other host answered ARP
+  WARN: Sweep ran but nothing answered
+  FAIL: Raw I/O unavailable or no usable IPv4 configuration
+**/
+EFI_STATUS
+TestL2HostDiscovery (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS     Status;
+  L2_DISC_STATE  State;
+  CONST UINT8    *LocalIp;
+  CONST UINT8    *Mask;
+  UINT32         Mask32;
+  UINTN          I;
+  UINTN          Pos;
+  UINT8          HostIp[4];
+  L2_DISC_HOST   *Host;
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    Result->StatusCode = TEST_RESULT_SKIP;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SNP not initialized");
+    return EFI_SUCCESS;
+  }
+
+  if (Nic->HasIpConfig) {
+    LocalIp = Nic->Ipv4Address.Addr;
+    Mask    = Nic->SubnetMask.Addr;
+  } else {
+    LocalIp = Config->LocalIp.Addr;
+    Mask    = Config->SubnetMask.Addr;
+  }
+
+  ZeroMem (&State, sizeof (State));
+  Mask32 = ((UINT32)Mask[0] << 24) | ((UINT32)Mask[1] << 16) | ((UINT32)Mask[2] << 8) | (UINT32)Mask[3];
+  while (State.PrefixLen < 32 && (Mask32 & (0x80000000 >> State.PrefixLen)) != 0) {
+    State.PrefixLen++;
+  }
+
+  if (State.PrefixLen < 16) {
+    State.PrefixLen = 16;
+    State.Truncated = TRUE;
+  }
+  if (State.PrefixLen > 30) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Subnet /%d has no other hosts to sweep", State.PrefixLen);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Host discovery needs a prefix of /30 or shorter");
+    return EFI_SUCCESS;
+  }
+
+  Mask32 = 0xFFFFFFFF << (32 - State.PrefixLen);
+  for (I = 0; I < 4; I++) {
+    State.Network[I] = (UINT8)(LocalIp[I] & (UINT8)(Mask32 >> (24 - I * 8)));
+  }
+  State.HostCount = (~Mask32) - 1;   // without network and broadcast
+
+  Status = L2DiscSweep (Nic, LocalIp, &State);
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Host discovery could not run: %r", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Raw frame I/O (SNP/MNP) unavailable");
+    goto Cleanup;
+  }
+
+  Result->PacketsSent     = State.ArpSent + State.IcmpSent;
+  Result->PacketsReceived = State.Found + State.IcmpOk;
+
+  //
+  // "ip mac latency" per host in address order; '*' = answered ICMP too
+  //
+  Pos = 0;
+  for (I = 0; I < State.Kept; I++) {
+    UINTN  J;
+    UINTN  Best;
+
+    //
+    // Selection pass by HostIndex keeps the listing in address order
+    //
+    Best = I;
+    for (J = I + 1; J < State.Kept; J++) {
+      if (State.Table[J].HostIndex < State.Table[Best].HostIndex) {
+        Best = J;
+      }
+    }
+    if (Best != I) {
+      L2_DISC_HOST  Tmp;
+      CopyMem (&Tmp, &State.Table[I], sizeof (Tmp));
+      CopyMem (&State.Table[I], &State.Table[Best], sizeof (Tmp));
+      CopyMem (&State.Table[Best], &Tmp, sizeof (Tmp));
+    }
+
+    if ((Pos + 48) * sizeof (CHAR16) >= sizeof (Result->Detail)) {
+      UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                     L" ... +%d", State.Found - I);
+      break;
+    }
+
+    Host = &State.Table[I];
+    L2DiscHostIp (&State, Host->HostIndex, HostIp);
+    UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                   L"%s%d.%d.%d.%d %02X:%02X:%02X:%02X:%02X:%02X %d.%dms%s",
+                   I > 0 ? L" | " : L"",
+                   HostIp[0], HostIp[1], HostIp[2], HostIp[3],
+                   Host->Mac[0], Host->Mac[1], Host->Mac[2],
+                   Host->Mac[3], Host->Mac[4], Host->Mac[5],
+                   Host->LatencyUs / 1000, (Host->LatencyUs / 100) % 10,
+                   Host->IcmpOk ? L"*" : L"");
+    Pos += StrLen (&Result->Detail[Pos]);
+  }
+
+  if (State.Found > 0) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"%d host(s) alive in %d.%d.%d.%d/%d (%d ARP, %d ms), %d ICMP-confirmed%s",
+                   State.Found,
+                   State.Network[0], State.Network[1], State.Network[2], State.Network[3],
+                   State.PrefixLen, State.ArpSent,
+                   (UINT32)DivU64x32 (State.ElapsedUs, 1000),
+                   State.IcmpOk, State.Truncated ? L", /16 limit" : L"");
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No hosts answered ARP in %d.%d.%d.%d/%d (%d requests)",
+                   State.Network[0], State.Network[1], State.Network[2], State.Network[3],
+                   State.PrefixLen, State.ArpSent);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check link/VLAN and that the local IP is in the intended subnet");
+  }
+
+Cleanup:
+  if (State.SentOffUs != NULL) {
+    FreePool (State.SentOffUs);
+  }
+  if (State.Seen != NULL) {
+    FreePool (State.Seen);
+  }
+  if (State.Table != NULL) {
+    FreePool (State.Table);
+  }
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// DUT receive capacity (companion frame generator)
+// ============================================================
+//
+
+#define L2_RXC_ETHERTYPE       0x88B5   // IEEE 802 local experimental
+#define L2_RXC_DEFAULT_SIZE    64       // minimum frames: worst case for frames/s
+#define L2_RXC_MAX_SIZE        1514
+#define L2_RXC_DEFAULT_MS      3000
+#define L2_RXC_GRACE_MS        500      // frames still queued after the run
+#define L2_RXC_START_MS        1000     // first frame must arrive within this
+#define L2_RXC_START_DELAY_MS  200      // generator waits for us to leave START
+#define L2_RXC_MAX_SEQ         (1U << 26)  // caps the seen-bitmap at 8 MB
+#define L2_RXC_LOSS_WARN_PERMILLE  10   // > 1.0% loss: DUT RX saturated
+
+//
+// Generator payload after the Ethernet header, big-endian
+//
+#pragma pack(1)
+typedef struct {
+  CHAR8     Magic[8];                   // "DDTRXGEN"
+  UINT32    RunId;
+  UINT32    Seq;
+} L2_RXC_HEADER;
+#pragma pack()
+
+typedef struct {
+  UINT64    Frames;                     // frames of the run, duplicates included
+  UINT64    Unique;
+  UINT64    Bytes;
+  UINT64    Dup;
+  UINT64    Reorder;
+  UINT64    Gaps;
+  UINT64    Foreign;                    // other traffic received meanwhile
+  UINT32    NextSeq;                    // highest sequence seen + 1
+  UINT64    FirstUs;
+  UINT64    LastUs;
+  UINT8     *Seen;
+} L2_RXC_STATS;
+
+//
+// Companion link RX tap context: run frames read by the control channel
+//
+typedef struct {
+  UINT32          RunId;
+  L2_RXC_STATS    *Stats;
+} L2_RXC_TAP;
+
+/**
+  Account one received frame against the generator run.
+
+  @param[in]      Frame   Received Ethernet frame.
+  @param[in]      Length  Frame length.
+  @param[in]      RunId   Run id the companion stamps in every frame.
+  @param[in]      NowUs   Receive time.
+  @param[in,out]  Stats   Run statistics.
+**/
+STATIC
+VOID
+L2RxcAccount (
+  IN     CONST UINT8   *Frame,
+  IN     UINTN         Length,
+  IN     UINT32        RunId,
+  IN     UINT64        NowUs,
+  IN OUT L2_RXC_STATS  *Stats
+  )
+{
+  CONST L2_RXC_HEADER  *Hdr;
+  UINT32               Seq;
+
+  if (Length < sizeof (ETHERNET_HEADER) + sizeof (L2_RXC_HEADER) ||
+      NTOHS (((CONST ETHERNET_HEADER *)Frame)->EtherType) != L2_RXC_ETHERTYPE) {
+    Stats->Foreign++;
+    return;
+  }
+  Hdr = (CONST L2_RXC_HEADER *)(Frame + sizeof (ETHERNET_HEADER));
+  if (CompareMem (Hdr->Magic, "DDTRXGEN", sizeof (Hdr->Magic)) != 0 ||
+      SwapBytes32 (Hdr->RunId) != RunId) {
+    Stats->Foreign++;
+    return;
+  }
+
+  Seq = SwapBytes32 (Hdr->Seq);
+  if (Seq >= L2_RXC_MAX_SEQ) {
+    Stats->Foreign++;
+    return;
+  }
+
+  Stats->Frames++;
+  if ((Stats->Seen[Seq >> 3] & (1 << (Seq & 7))) != 0) {
+    Stats->Dup++;
+    return;
+  }
+  Stats->Seen[Seq >> 3] |= (UINT8)(1 << (Seq & 7));
+
+  Stats->Unique++;
+  Stats->Bytes += Length;
+  if (Seq >= Stats->NextSeq) {
+    if (Seq > Stats->NextSeq) {
+      Stats->Gaps++;
+    }
+    Stats->NextSeq = Seq + 1;
+  } else {
+    Stats->Reorder++;
+  }
+  if (Stats->FirstUs == 0) {
+    Stats->FirstUs = NowUs;
+  }
+  Stats->LastUs = NowUs;
+}
+
+/**
+  Companion link RX tap: account a frame the control channel read
+  while a request was outstanding.
+
+  @param[in]  Context  L2_RXC_TAP of the run.
+  @param[in]  Frame    Received Ethernet frame.
+  @param[in]  Length   Frame length.
+**/
+STATIC
+VOID
+EFIAPI
+L2RxcTap (
+  IN VOID         *Context,
+  IN CONST UINT8  *Frame,
+  IN UINTN        Length
+  )
+{
+  L2_RXC_TAP  *Tap;
+
+  Tap = (L2_RXC_TAP *)Context;
+  L2RxcAccount (Frame, Length, Tap->RunId, UtilGetTimeUs (), Tap->Stats);
+}
+
+/**
+  Receive the generator run: poll raw I/O until the run has ended and
+  the link has been quiet for L2_RXC_GRACE_MS.
+
+  @param[in,out]  Io          Packet I/O context.
+  @param[in]      RunId       Run id to count.
+  @param[in]      DurationMs  Generator run time.
+  @param[in,out]  Stats       Run statistics (Seen allocated by caller).
+**/
+STATIC
+VOID
+L2RxcReceive (
+  IN OUT PKT_IO        *Io,
+  IN     UINT32        RunId,
+  IN     UINT32        DurationMs,
+  IN OUT L2_RXC_STATS  *Stats
+  )
+{
+  UINT8   RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN   RxLen;
+  UINT64  StartUs;
+  UINT64  NowUs;
+  UINT64  EndUs;
+
+  StartUs = UtilGetTimeUs ();
+  EndUs   = StartUs + (UINT64)(DurationMs + L2_RXC_START_MS) * 1000;
+  NowUs   = StartUs;
+
+  for (;;) {
+    RxLen = sizeof (RxBuf);
+    if (!EFI_ERROR (PktIoReceive (Io, RxBuf, &RxLen))) {
+      NowUs = UtilGetTimeUs ();
+      L2RxcAccount (RxBuf, RxLen, RunId, NowUs, Stats);
+      continue;
+    }
+
+    NowUs = UtilGetTimeUs ();
+    if (Stats->FirstUs == 0) {
+      //
+      // Nothing yet: the generator never started
+      //
+      if (NowUs - StartUs > L2_RXC_START_MS * 1000) {
+        break;
+      }
+    } else if (NowUs - Stats->LastUs > L2_RXC_GRACE_MS * 1000 ||
+               NowUs > EndUs + L2_RXC_GRACE_MS * 1000) {
+      break;
+    }
+  }
+}
+
+/**
+  Test L2.9: RX Capacity
+  Receive-side counterpart of the stress floods: the companion's frame
+  generator blasts sequence-numbered frames (EtherType 0x88B5, default
+  64 bytes, Config->DatagramSize) at the DUT MAC for Config->DurationMs
+  (default 3 s), unpaced or at Config->RatePps, using sendmmsg batches.
+  The DUT counts what arrives through raw I/O and compares it with what
+  the companion reports it sent.
+
+  PASS: DUT received the run with <= 1% loss
+  WARN: Higher loss (DUT receive path saturated), duplicates
+  FAIL: Raw I/O or companion generator unavailable, nothing received
+**/
+EFI_STATUS
+TestL2RxCapacity (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS      Status;
+  EFI_STATUS      LinkStatus;
+  PKT_IO          Io;
+  COMPANION_LINK  Link;
+  CHAR8           Args[128];
+  CONST CHAR8     *Report;
+  L2_RXC_STATS    Stats;
+  L2_RXC_TAP      Tap;
+  UINT32          Size;
+  UINT32          DurationMs;
+  UINT32          RunId;
+  UINT64          GenSent;
+  UINT64          GenUs;
+  UINT64          GenStalls;
+  UINT64          Lost;
+  UINT64          RxSpanUs;
+  UINT64          OfferedPps;
+  UINT64          RxPps;
+  UINT32          RxMbpsX10;
+  UINT32          LossPermille;
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    Result->StatusCode = TEST_RESULT_SKIP;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SNP not initialized");
+    return EFI_SUCCESS;
+  }
+
+  DurationMs = (Config->DurationMs > 0) ? Config->DurationMs : L2_RXC_DEFAULT_MS;
+  Size       = (Config->DatagramSize > 0) ? Config->DatagramSize : L2_RXC_DEFAULT_SIZE;
+  Size       = MIN (MAX (Size, 60), L2_RXC_MAX_SIZE);
+  RunId      = (UINT32)UtilGetTimeUs () & 0x7FFFFFFF;
+
+  ZeroMem (&Stats, sizeof (Stats));
+  Stats.Seen = AllocateZeroPool (L2_RXC_MAX_SEQ / 8);
+  if (Stats.Seen == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the sequence bitmap");
+    return EFI_SUCCESS;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    FreePool (Stats.Seen);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"RX capacity could not run: %r", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Raw frame I/O (SNP/MNP) unavailable");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Arm the generator for our MAC, then fire it. The generator holds
+  // its first frame for L2_RXC_START_DELAY_MS so the receive loop is
+  // running by then; frames that still reach the control channel while
+  // PREPARE/START are outstanding are counted through the link's RX tap.
+  //
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args),
+                   "run=%d size=%d rate=%d ms=%d mac=%02x:%02x:%02x:%02x:%02x:%02x delay_ms=%d",
+                   RunId, Size, Config->RatePps, DurationMs,
+                   Io.SrcMac[0], Io.SrcMac[1], Io.SrcMac[2],
+                   Io.SrcMac[3], Io.SrcMac[4], Io.SrcMac[5], L2_RXC_START_DELAY_MS);
+      Tap.RunId         = RunId;
+      Tap.Stats         = &Stats;
+      Link.RxTap        = L2RxcTap;
+      Link.RxTapContext = &Tap;
+      LinkStatus        = CompanionPrepareStart (&Link, "L2", "RX_CAPACITY", Args);
+      Link.RxTap        = NULL;
+    }
+    if (EFI_ERROR (LinkStatus)) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  if (EFI_ERROR (LinkStatus)) {
+    PktIoClose (&Io);
+    FreePool (Stats.Seen);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Companion frame generator unavailable: %r", LinkStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"RX capacity needs the companion to generate traffic");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Run the companion as root (raw socket) on the target IP");
+    return EFI_SUCCESS;
+  }
+
+  L2RxcReceive (&Io, RunId, DurationMs, &Stats);
+  PktIoClose (&Io);
+
+  GenSent   = 0;
+  GenUs     = 0;
+  GenStalls = 0;
+  LinkStatus = CompanionStopResult (&Link, &Report);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionResultValue (Report, "gen_sent", &GenSent);
+  }
+  if (!EFI_ERROR (LinkStatus)) {
+    CompanionResultValue (Report, "gen_us", &GenUs);
+    CompanionResultValue (Report, "gen_stalls", &GenStalls);
+  }
+  CompanionDisconnect (&Link);
+  CompanionDestroy (&Link);
+  FreePool (Stats.Seen);
+
+  Result->PacketsSent     = GenSent;
+  Result->PacketsReceived = Stats.Unique;
+  Result->BytesReceived   = Stats.Bytes;
+
+  if (Stats.Unique == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"RX capacity: received 0 of %llu generator frames", GenSent);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No frames of run %d arrived (%llu other frames seen)",
+                   RunId, Stats.Foreign);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check that the companion interface is on this segment");
+    return EFI_SUCCESS;
+  }
+
+  RxSpanUs     = MAX (Stats.LastUs - Stats.FirstUs, 1);
+  RxPps        = DivU64x64Remainder (Stats.Unique * 1000000, RxSpanUs, NULL);
+  RxMbpsX10    = (UINT32)DivU64x64Remainder (Stats.Bytes * 80, RxSpanUs, NULL);
+  OfferedPps   = (GenUs > 0) ? DivU64x64Remainder (GenSent * 1000000, GenUs, NULL) : 0;
+  Lost         = (GenSent > Stats.Unique) ? GenSent - Stats.Unique : 0;
+  LossPermille = (GenSent > 0) ? (UINT32)DivU64x64Remainder (Lost * 1000, GenSent, NULL) : 0;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"Companion sent %llu x %d B in %llu ms (%llu pps offered, %a, %llu stalls%s) | "
+                 L"DUT received %llu, lost %llu (%d.%d%%), dup %llu, reordered %llu, gaps %llu, "
+                 L"other %llu | RX %llu pps, %d.%d Mbps",
+                 GenSent, Size, DivU64x32 (GenUs, 1000), OfferedPps,
+                 Config->RatePps > 0 ? "paced" : "unpaced", GenStalls,
+                 EFI_ERROR (LinkStatus) ? L", no generator report" : L"",
+                 Stats.Unique, Lost, LossPermille / 10, LossPermille % 10,
+                 Stats.Dup, Stats.Reorder, Stats.Gaps, Stats.Foreign,
+                 RxPps, RxMbpsX10 / 10, RxMbpsX10 % 10);
+
+  if (EFI_ERROR (LinkStatus)) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DUT received %llu pps (%d B frames), generator count unavailable",
+                   RxPps, Size);
+  } else if (LossPermille <= L2_RXC_LOSS_WARN_PERMILLE && Stats.Dup == 0) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DUT received %llu pps / %d.%d Mbps, loss %d.%d%% (%d B frames)",
+                   RxPps, RxMbpsX10 / 10, RxMbpsX10 % 10,
+                   LossPermille / 10, LossPermille % 10, Size);
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DUT RX saturated at %llu pps (offered %llu), loss %d.%d%%",
+                   RxPps, OfferedPps, LossPermille / 10, LossPermille % 10);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Lower RatePps to find the loss-free rate; check NIC RX ring size and driver polling");
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// Full-duplex bidirectional stream (DUT TX + companion TX)
+// ============================================================
+//
+
+#define L2_BID_DEFAULT_SIZE    1514     // full frames load the link in both directions
+#define L2_BID_DEFAULT_PPS     5000     // ~60 Mbps each way at 1514 B
+#define L2_BID_MAX_PPS         200000
+#define L2_BID_RX_BATCH        16       // frames received between TX slots
+#define L2_BID_MAX_LAG_US      10000    // TX further behind than this: skip ahead
+#define L2_BID_ASYM_PERMILLE   10       // loss difference that flags one direction
+
+typedef struct {
+  UINT64    Sent;
+  UINT64    Bytes;
+  UINT64    Errors;                     // SNP transmit failures
+  UINT64    Skips;                      // schedule resets (DUT could not keep pace)
+  UINT64    FirstUs;
+  UINT64    LastUs;
+} L2_BID_TX;
+
+/**
+  Run both directions at once: send the DUT stream at IntervalUs per
+  frame for DurationMs while counting the companion's generator frames
+  in between, then wait for the companion's tail.
+
+  @param[in,out]  Io          Packet I/O context.
+  @param[in,out]  Frame       DUT frame template (sequence stamped here).
+  @param[in]      Length      Frame length.
+  @param[in]      RunId       Run id of both streams.
+  @param[in]      IntervalUs  DUT frame interval.
+  @param[in]      DurationMs  Run time.
+  @param[in,out]  Tx          DUT transmit statistics.
+  @param[in,out]  Rx          Companion stream statistics (Seen allocated by caller).
+**/
+STATIC
+VOID
+L2BidRun (
+  IN OUT PKT_IO        *Io,
+  IN OUT UINT8         *Frame,
+  IN     UINTN         Length,
+  IN     UINT32        RunId,
+  IN     UINT32        IntervalUs,
+  IN     UINT32        DurationMs,
+  IN OUT L2_BID_TX     *Tx,
+  IN OUT L2_RXC_STATS  *Rx
+  )
+{
+  L2_RXC_HEADER  *Hdr;
+  UINT8          RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN          RxLen;
+  UINTN          N;
+  UINT32         Seq;
+  UINT64         StartUs;
+  UINT64         TxEndUs;
+  UINT64         NextTxUs;
+  UINT64         NowUs;
+
+  Hdr      = (L2_RXC_HEADER *)(Frame + sizeof (ETHERNET_HEADER));
+  Seq      = 0;
+  StartUs  = UtilGetTimeUs ();
+  TxEndUs  = StartUs + (UINT64)DurationMs * 1000;
+  NextTxUs = StartUs;
+
+  for (;;) {
+    for (N = 0; N < L2_BID_RX_BATCH; N++) {
+      RxLen = sizeof (RxBuf);
+      if (EFI_ERROR (PktIoReceive (Io, RxBuf, &RxLen))) {
+        break;
+      }
+      L2RxcAccount (RxBuf, RxLen, RunId, UtilGetTimeUs (), Rx);
+    }
+
+    NowUs = UtilGetTimeUs ();
+    if (NowUs < TxEndUs) {
+      if (NowUs < NextTxUs) {
+        continue;
+      }
+      Hdr->Seq = SwapBytes32 (Seq);
+      if (EFI_ERROR (PktIoSend (Io, Frame, Length))) {
+        Tx->Errors++;
+      } else {
+        Seq++;
+        Tx->Sent++;
+        Tx->Bytes += Length;
+        if (Tx->FirstUs == 0) {
+          Tx->FirstUs = NowUs;
+        }
+        Tx->LastUs = NowUs;
+      }
+      NextTxUs += IntervalUs;
+      if (NowUs > NextTxUs + L2_BID_MAX_LAG_US) {
+        //
+        // Bursting to catch up would distort the offered rate
+        //
+        NextTxUs = NowUs;
+        Tx->Skips++;
+      }
+      continue;
+    }
+
+    //
+    // Our stream is done; the companion's may still be arriving
+    //
+    if (Rx->FirstUs == 0 ||
+        NowUs - Rx->LastUs > L2_RXC_GRACE_MS * 1000 ||
+        NowUs > TxEndUs + (L2_RXC_START_MS + L2_RXC_GRACE_MS) * 1000) {
+      break;
+    }
+  }
+}
+
+/**
+  Loss of one direction in permille.
+
+  @param[in]  Sent      Frames put on the wire.
+  @param[in]  Received  Unique frames counted at the far end.
+
+  @return Loss in 0.1% units.
+**/
+STATIC
+UINT32
+L2BidLossPermille (
+  IN UINT64  Sent,
+  IN UINT64  Received
+  )
+{
+  if (Sent == 0 || Received >= Sent) {
+    return 0;
+  }
+  return (UINT32)DivU64x64Remainder ((Sent - Received) * 1000, Sent, NULL);
+}
+
+/**
+  Test L2.10: Bidirectional
+  Full-duplex counterpart of RX Capacity and the one-way stress floods:
+  the DUT paces sequence-numbered frames (EtherType 0x88B5, magic
+  DDTDUTTX, default 1514 bytes, Config->DatagramSize) to the companion
+  MAC at Config->RatePps (default 5000) for Config->DurationMs (default
+  3 s), while the companion's frame generator streams back at the same
+  rate and size. Each side counts the other's sequence numbers, so loss
+  and throughput are reported per direction. Duplex mismatches and
+  half-duplex links only lose frames when both directions are loaded,
+  and usually in one direction more than the other.
+
+  PASS: Both directions <= 1% loss
+  WARN: One direction clearly worse (asymmetric), or both lossy
+  FAIL: Raw I/O, companion MAC or generator unavailable, nothing received
+**/
+EFI_STATUS
+TestL2Bidirectional (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS      Status;
+  EFI_STATUS      LinkStatus;
+  PKT_IO          Io;
+  COMPANION_LINK  Link;
+  CHAR8           Args[128];
+  CONST CHAR8     *Report;
+  UINT8           Frame[L2_RXC_MAX_SIZE];
+  UINT8           PeerMac[6];
+  L2_RXC_HEADER   *Hdr;
+  L2_RXC_STATS    Rx;
+  L2_RXC_TAP      Tap;
+  L2_BID_TX       Tx;
+  UINTN           Attempt;
+  UINTN           I;
+  UINT32          Size;
+  UINT32          Rate;
+  UINT32          DurationMs;
+  UINT32          RunId;
+  UINT64          GenSent;
+  UINT64          PeerRx;
+  UINT64          PeerBytes;
+  UINT64          PeerUs;
+  UINT64          PeerDrops;
+  UINT64          TxPps;
+  UINT64          RxPps;
+  UINT32          TxMbpsX10;
+  UINT32          RxMbpsX10;
+  UINT32          OutLoss;
+  UINT32          InLoss;
+  UINT32          Worse;
+  UINT32          Better;
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    Result->StatusCode = TEST_RESULT_SKIP;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SNP not initialized");
+    return EFI_SUCCESS;
+  }
+
+  DurationMs = (Config->DurationMs > 0) ? Config->DurationMs : L2_RXC_DEFAULT_MS;
+  Size       = (Config->DatagramSize > 0) ? Config->DatagramSize : L2_BID_DEFAULT_SIZE;
+  Size       = MIN (MAX (Size, 60), L2_RXC_MAX_SIZE);
+  Rate       = (Config->RatePps > 0) ? Config->RatePps : L2_BID_DEFAULT_PPS;
+  Rate       = MIN (Rate, L2_BID_MAX_PPS);
+  RunId      = (UINT32)UtilGetTimeUs () & 0x7FFFFFFF;
+
+  ZeroMem (&Tx, sizeof (Tx));
+  ZeroMem (&Rx, sizeof (Rx));
+  Rx.Seen = AllocateZeroPool (L2_RXC_MAX_SEQ / 8);
+  if (Rx.Seen == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the sequence bitmap");
+    return EFI_SUCCESS;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    FreePool (Rx.Seen);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Bidirectional test could not run: %r", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Raw frame I/O (SNP/MNP) unavailable");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Raw frames go to the companion itself, so it must be on-link
+  //
+  Status = EFI_TIMEOUT;
+  for (Attempt = 0; Attempt < 3 && EFI_ERROR (Status); Attempt++) {
+    Status = PktIoResolveMac (&Io, Config->LocalIp.Addr, Config->TargetIp.Addr,
+                              PeerMac, 1000);
+  }
+  if (EFI_ERROR (Status)) {
+    PktIoClose (&Io);
+    FreePool (Rx.Seen);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Companion MAC not resolved: %r", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No ARP reply from %d.%d.%d.%d",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3]);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"The companion must be on this segment (raw L2 frames are not routed)");
+    return EFI_SUCCESS;
+  }
+
+  PktBuildEthernetHeader (Frame, PeerMac, Io.SrcMac, L2_RXC_ETHERTYPE);
+  Hdr = (L2_RXC_HEADER *)(Frame + sizeof (ETHERNET_HEADER));
+  CopyMem (Hdr->Magic, "DDTDUTTX", sizeof (Hdr->Magic));
+  Hdr->RunId = SwapBytes32 (RunId);
+  Hdr->Seq   = 0;
+  for (I = sizeof (ETHERNET_HEADER) + sizeof (L2_RXC_HEADER); I < Size; I++) {
+    Frame[I] = (UINT8)(I - sizeof (ETHERNET_HEADER));
+  }
+
+  //
+  // Arm the generator (our MAC, same rate/size) and the companion's
+  // counter of our stream, then fire both directions together
+  //
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args),
+                   "run=%d size=%d rate=%d ms=%d mac=%02x:%02x:%02x:%02x:%02x:%02x",
+                   RunId, Size, Rate, DurationMs,
+                   Io.SrcMac[0], Io.SrcMac[1], Io.SrcMac[2],
+                   Io.SrcMac[3], Io.SrcMac[4], Io.SrcMac[5]);
+      Tap.RunId         = RunId;
+      Tap.Stats         = &Rx;
+      Link.RxTap        = L2RxcTap;
+      Link.RxTapContext = &Tap;
+      LinkStatus        = CompanionPrepareStart (&Link, "L2", "BIDIR", Args);
+      Link.RxTap        = NULL;
+    }
+    if (EFI_ERROR (LinkStatus)) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  if (EFI_ERROR (LinkStatus)) {
+    PktIoClose (&Io);
+    FreePool (Rx.Seen);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Companion frame generator unavailable: %r", LinkStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Bidirectional test needs the companion to send and count frames");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Run the companion as root (raw socket) on the target IP");
+    return EFI_SUCCESS;
+  }
+
+  L2BidRun (&Io, Frame, Size, RunId, 1000000 / Rate, DurationMs, &Tx, &Rx);
+  PktIoClose (&Io);
+
+  GenSent   = 0;
+  PeerRx    = 0;
+  PeerBytes = 0;
+  PeerUs    = 0;
+  PeerDrops = 0;
+  LinkStatus = CompanionStopResult (&Link, &Report);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionResultValue (Report, "bidir_rx", &PeerRx);
+  }
+  if (!EFI_ERROR (LinkStatus)) {
+    CompanionResultValue (Report, "gen_sent", &GenSent);
+    CompanionResultValue (Report, "bidir_rx_bytes", &PeerBytes);
+    CompanionResultValue (Report, "bidir_rx_us", &PeerUs);
+    CompanionResultValue (Report, "bidir_rx_drops", &PeerDrops);
+  }
+  CompanionDisconnect (&Link);
+  CompanionDestroy (&Link);
+  FreePool (Rx.Seen);
+
+  Result->PacketsSent     = Tx.Sent;
+  Result->PacketsReceived = Rx.Unique;
+  Result->BytesSent       = Tx.Bytes;
+  Result->BytesReceived   = Rx.Bytes;
+
+  if (EFI_ERROR (LinkStatus)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Bidirectional: DUT sent %llu, received %llu, no companion count: %r",
+                   Tx.Sent, Rx.Unique, LinkStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"The companion did not report its count of the DUT stream");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Update the companion: frame_generator must support L2 BIDIR");
+    return EFI_SUCCESS;
+  }
+
+  if (Tx.Sent == 0 || PeerRx == 0 || Rx.Unique == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Bidirectional: DUT->companion %llu/%llu, companion->DUT %llu/%llu",
+                   PeerRx, Tx.Sent, Rx.Unique, GenSent);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"A direction carried nothing (%llu TX errors, %llu other frames seen)",
+                   Tx.Errors, Rx.Foreign);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check link state and that the companion interface is on this segment");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Delivered rates, measured where the frames arrived
+  //
+  TxPps     = (PeerUs > 0) ? DivU64x64Remainder (PeerRx * 1000000, PeerUs, NULL) : 0;
+  TxMbpsX10 = (PeerUs > 0) ? (UINT32)DivU64x64Remainder (PeerBytes * 80, PeerUs, NULL) : 0;
+  RxPps     = DivU64x64Remainder (Rx.Unique * 1000000, MAX (Rx.LastUs - Rx.FirstUs, 1), NULL);
+  RxMbpsX10 = (UINT32)DivU64x64Remainder (Rx.Bytes * 80, MAX (Rx.LastUs - Rx.FirstUs, 1), NULL);
+  OutLoss   = L2BidLossPermille (Tx.Sent, PeerRx);
+  InLoss    = L2BidLossPermille (GenSent, Rx.Unique);
+  Worse     = MAX (OutLoss, InLoss);
+  Better    = MIN (OutLoss, InLoss);
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d B at %d pps each way for %d ms | "
+                 L"DUT->companion: sent %llu, received %llu, loss %d.%d%%, %llu pps, %d.%d Mbps "
+                 L"(%llu TX errors, %llu pacing skips, %llu companion kernel drops) | "
+                 L"companion->DUT: sent %llu, received %llu, loss %d.%d%%, %llu pps, %d.%d Mbps "
+                 L"(dup %llu, reordered %llu, other %llu)",
+                 Size, Rate, DurationMs,
+                 Tx.Sent, PeerRx, OutLoss / 10, OutLoss % 10, TxPps,
+                 TxMbpsX10 / 10, TxMbpsX10 % 10, Tx.Errors, Tx.Skips, PeerDrops,
+                 GenSent, Rx.Unique, InLoss / 10, InLoss % 10, RxPps,
+                 RxMbpsX10 / 10, RxMbpsX10 % 10, Rx.Dup, Rx.Reorder, Rx.Foreign);
+
+  if (Worse <= L2_RXC_LOSS_WARN_PERMILLE) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Full duplex OK: out %d.%d / in %d.%d Mbps, loss %d.%d%% / %d.%d%%",
+                   TxMbpsX10 / 10, TxMbpsX10 % 10, RxMbpsX10 / 10, RxMbpsX10 % 10,
+                   OutLoss / 10, OutLoss % 10, InLoss / 10, InLoss % 10);
+  } else if (Worse - Better > L2_BID_ASYM_PERMILLE) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Asymmetric loss: %s %d.%d%% vs %d.%d%% the other way",
+                   (OutLoss > InLoss) ? L"DUT->companion" : L"companion->DUT",
+                   Worse / 10, Worse % 10, Better / 10, Better % 10);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   (OutLoss > InLoss && PeerDrops > 0) ?
+                   L"Companion kernel dropped frames: rerun at a lower RatePps to rule out the counter" :
+                   L"Duplex mismatch likely: check speed/duplex negotiation on both link partners");
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Both directions lossy: out %d.%d%%, in %d.%d%% at %d pps",
+                   OutLoss / 10, OutLoss % 10, InLoss / 10, InLoss % 10, Rate);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Link saturated or half duplex: compare with one-way RX Capacity at the same rate");
+  }
+
+  return EFI_SUCCESS;
+}
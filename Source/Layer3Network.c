@@ -6,7 +6,9 @@
   Uses EFI_ARP_PROTOCOL for MAC resolution and EFI_IP4_PROTOCOL for ICMP
   when the IP4 stack is active (the MNP layer consumes frames from
   SNP.Receive, making raw SNP receive unusable). Falls back to raw SNP
-  when protocol stack is unavailable.
+  when protocol stack is unavailable. TTL discovery sends all probes at
+  once through the shared PacketIo path (SNP TX, private MNP RX); the
+  same path carries the RFC 5227 ARP probes of duplicate IP detection.
 **/
 
 #include <DDTSoftNetTest.h>
@@ -1044,6 +1046,1382 @@ L3Ping (
   return EFI_NOT_READY;
 }
 
+//
+// ============================================================
+// Parallel traceroute (all TTL probes in flight at once)
+// ============================================================
+//
+
+#define L3_TRACE_ID              0xDD31   // distinct from L3_ICMP_ID ping traffic
+#define L3_TRACE_MAX_TTL         16
+#define L3_TRACE_DEFAULT_ROUNDS  3
+#define L3_TRACE_MAX_ROUNDS      8
+#define L3_TRACE_ROUND_GAP_MS    20       // spread rounds past router ICMP rate limits
+#define L3_TRACE_TIMEOUT_MS      2000     // after the last probe leaves
+
+//
+// ICMP sequence encodes the probe: high byte round, low byte TTL
+//
+#define L3_TRACE_SEQ(Round, Ttl)  ((UINT16)(((Round) << 8) | (Ttl)))
+
+typedef struct {
+  UINT8      Addr[4];                      // first responder at this TTL
+  BOOLEAN    MultiPath;                    // later replies came from another address
+  BOOLEAN    IsTarget;                     // echo reply from the target itself
+  UINT32     Replies;
+  UINT32     RttUs[L3_TRACE_MAX_ROUNDS];   // one sample per answered round
+} L3_TRACE_HOP;
+
+/**
+  Match one received frame against outstanding trace probes.
+  Accepts Echo Reply from the target and Time Exceeded / Destination
+  Unreachable quoting one of our probes (RFC 792: original IP header
+  plus the first 8 bytes of its payload, i.e. our ICMP id/sequence).
+
+  @param[in]      Frame      Received Ethernet frame.
+  @param[in]      Length     Frame length.
+  @param[in]      Config     Test configuration (LocalIp/TargetIp).
+  @param[in]      Rounds     Rounds launched.
+  @param[in]      SentUs     Send timestamps, [Round][Ttl].
+  @param[in,out]  Answered   Per-probe answered flags, [Round][Ttl].
+  @param[in,out]  Hops       Per-TTL results, indexed by TTL.
+  @param[in]      NowUs      Receive timestamp.
+**/
+STATIC
+VOID
+L3TraceMatch (
+  IN     CONST UINT8   *Frame,
+  IN     UINTN         Length,
+  IN     TEST_CONFIG   *Config,
+  IN     UINTN         Rounds,
+  IN     UINT64        SentUs[][L3_TRACE_MAX_TTL + 1],
+  IN OUT BOOLEAN       Answered[][L3_TRACE_MAX_TTL + 1],
+  IN OUT L3_TRACE_HOP  *Hops,
+  IN     UINT64        NowUs
+  )
+{
+  PARSED_PACKET  Parsed;
+  IPV4_HEADER    *Inner;
+  ICMP_HEADER    *Probe;
+  UINTN          InnerHdrLen;
+  UINT16         Id;
+  UINT16         Seq;
+  UINTN          Round;
+  UINTN          Ttl;
+  L3_TRACE_HOP   *Hop;
+  BOOLEAN        FromTarget;
+
+  if (EFI_ERROR (PktParsePacket (Frame, Length, &Parsed)) ||
+      !Parsed.HasIpv4 || !Parsed.HasIcmp ||
+      CompareMem (Parsed.Ipv4->DstAddr, Config->LocalIp.Addr, 4) != 0) {
+    return;
+  }
+
+  if (Parsed.Icmp->Type == ICMP_TYPE_ECHO_REPLY) {
+    if (CompareMem (Parsed.Ipv4->SrcAddr, Config->TargetIp.Addr, 4) != 0) {
+      return;
+    }
+    Id  = NTOHS (Parsed.Icmp->Identifier);
+    Seq = NTOHS (Parsed.Icmp->SequenceNumber);
+    FromTarget = TRUE;
+  } else if (Parsed.Icmp->Type == ICMP_TYPE_TIME_EXCEEDED ||
+             Parsed.Icmp->Type == ICMP_TYPE_DEST_UNREACH) {
+    if (Parsed.PayloadLength < IPV4_MIN_HEADER_SIZE + ICMP_HEADER_SIZE) {
+      return;
+    }
+    Inner       = (IPV4_HEADER *)Parsed.Payload;
+    InnerHdrLen = IPV4_HDR_LEN (Inner->VersionIhl);
+    if (Inner->Protocol != IP_PROTO_ICMP ||
+        Parsed.PayloadLength < InnerHdrLen + ICMP_HEADER_SIZE ||
+        CompareMem (Inner->DstAddr, Config->TargetIp.Addr, 4) != 0) {
+      return;
+    }
+    Probe = (ICMP_HEADER *)(Parsed.Payload + InnerHdrLen);
+    Id    = NTOHS (Probe->Identifier);
+    Seq   = NTOHS (Probe->SequenceNumber);
+    FromTarget = (CompareMem (Parsed.Ipv4->SrcAddr, Config->TargetIp.Addr, 4) == 0);
+  } else {
+    return;
+  }
+
+  Round = Seq >> 8;
+  Ttl   = Seq & 0xFF;
+  if (Id != L3_TRACE_ID || Round >= Rounds || Ttl == 0 || Ttl > L3_TRACE_MAX_TTL ||
+      Answered[Round][Ttl]) {
+    return;
+  }
+  Answered[Round][Ttl] = TRUE;
+
+  Hop = &Hops[Ttl];
+  if (Hop->Replies == 0) {
+    CopyMem (Hop->Addr, Parsed.Ipv4->SrcAddr, 4);
+  } else if (CompareMem (Hop->Addr, Parsed.Ipv4->SrcAddr, 4) != 0) {
+    Hop->MultiPath = TRUE;
+  }
+  Hop->IsTarget = Hop->IsTarget || FromTarget;
+  Hop->RttUs[Hop->Replies] = (UINT32)(NowUs - SentUs[Round][Ttl]);
+  Hop->Replies++;
+}
+
+/**
+  Trace the path to Config->TargetIp with every TTL probe of every
+  round in flight at once: Rounds x L3_TRACE_MAX_TTL echo requests go
+  out back-to-back over raw SNP, then replies are collected for one
+  timeout window. Total time is about L3_TRACE_TIMEOUT_MS regardless of
+  how many hops stay silent.
+
+  @param[in]   Nic      NIC information.
+  @param[in]   Config   Test configuration.
+  @param[in]   Rounds   Probes per TTL (1..L3_TRACE_MAX_ROUNDS).
+  @param[out]  Hops     L3_TRACE_MAX_TTL + 1 entries, indexed by TTL.
+  @param[out]  Sent     Probes transmitted.
+
+  @retval EFI_SUCCESS  Trace ran (Hops may still be empty).
+  @retval other        Raw I/O or next-hop resolution failed.
+**/
+STATIC
+EFI_STATUS
+L3TraceParallel (
+  IN  NIC_INFO      *Nic,
+  IN  TEST_CONFIG   *Config,
+  IN  UINTN         Rounds,
+  OUT L3_TRACE_HOP  *Hops,
+  OUT UINTN         *Sent
+  )
+{
+  EFI_STATUS  Status;
+  PKT_IO      Io;
+  UINT8       DstMac[6];
+  UINT8       Frame[128];
+  UINT8       RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN       FrameLen;
+  UINTN       RxLen;
+  UINTN       Round;
+  UINTN       Ttl;
+  UINTN       I;
+  UINT8       Payload[32];
+  IPV4_HEADER *Ip;
+  UINT64      SentUs[L3_TRACE_MAX_ROUNDS][L3_TRACE_MAX_TTL + 1];
+  BOOLEAN     Answered[L3_TRACE_MAX_ROUNDS][L3_TRACE_MAX_TTL + 1];
+  UINT64      NowUs;
+  UINT64      EndUs;
+
+  ZeroMem (Hops, (L3_TRACE_MAX_TTL + 1) * sizeof (L3_TRACE_HOP));
+  ZeroMem (SentUs, sizeof (SentUs));
+  ZeroMem (Answered, sizeof (Answered));
+  *Sent = 0;
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    return EFI_NOT_READY;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = PktIoResolveNextHop (
+             &Io,
+             Config->LocalIp.Addr,
+             Config->SubnetMask.Addr,
+             Config->Gateway.Addr,
+             Config->TargetIp.Addr,
+             DstMac
+             );
+  if (EFI_ERROR (Status)) {
+    PktIoClose (&Io);
+    return Status;
+  }
+
+  for (I = 0; I < sizeof (Payload); I++) {
+    Payload[I] = (UINT8)I;
+  }
+
+  for (Round = 0; Round < Rounds; Round++) {
+    for (Ttl = 1; Ttl <= L3_TRACE_MAX_TTL; Ttl++) {
+      FrameLen = PktBuildIcmpEchoRequest (
+                   Frame, Io.SrcMac, DstMac,
+                   Config->LocalIp.Addr, Config->TargetIp.Addr,
+                   L3_TRACE_ID, L3_TRACE_SEQ (Round, Ttl),
+                   Payload, sizeof (Payload)
+                   );
+
+      //
+      // Builder uses TTL 64; patch it and re-checksum the IP header
+      //
+      Ip                 = (IPV4_HEADER *)(Frame + ETHERNET_HEADER_SIZE);
+      Ip->Ttl            = (UINT8)Ttl;
+      Ip->HeaderChecksum = 0;
+      Ip->HeaderChecksum = HTONS (PktChecksum ((UINT8 *)Ip, IPV4_MIN_HEADER_SIZE));
+
+      SentUs[Round][Ttl] = UtilGetTimeUs ();
+      if (!EFI_ERROR (PktIoSend (&Io, Frame, FrameLen))) {
+        (*Sent)++;
+      }
+    }
+
+    //
+    // Collect early replies while spacing the rounds
+    //
+    EndUs = UtilGetTimeUs () + L3_TRACE_ROUND_GAP_MS * 1000;
+    do {
+      RxLen = sizeof (RxBuf);
+      if (!EFI_ERROR (PktIoReceive (&Io, RxBuf, &RxLen))) {
+        L3TraceMatch (RxBuf, RxLen, Config, Rounds, SentUs, Answered, Hops, UtilGetTimeUs ());
+      }
+      NowUs = UtilGetTimeUs ();
+    } while (NowUs < EndUs);
+  }
+
+  EndUs = UtilGetTimeUs () + L3_TRACE_TIMEOUT_MS * 1000;
+  do {
+    RxLen = sizeof (RxBuf);
+    if (!EFI_ERROR (PktIoReceive (&Io, RxBuf, &RxLen))) {
+      L3TraceMatch (RxBuf, RxLen, Config, Rounds, SentUs, Answered, Hops, UtilGetTimeUs ());
+    } else {
+      gBS->Stall (100);
+    }
+    NowUs = UtilGetTimeUs ();
+  } while (NowUs < EndUs);
+
+  PktIoClose (&Io);
+  return EFI_SUCCESS;
+}
+
+/**
+  Fill a test result from a parallel trace.
+
+  @param[in]   Hops    Per-TTL results from L3TraceParallel.
+  @param[in]   Rounds  Probes sent per TTL.
+  @param[in]   Sent    Probes transmitted.
+  @param[out]  Result  Test result.
+**/
+STATIC
+VOID
+L3TraceReport (
+  IN  L3_TRACE_HOP      *Hops,
+  IN  UINTN             Rounds,
+  IN  UINTN             Sent,
+  OUT TEST_RESULT_DATA  *Result
+  )
+{
+  UINTN   Ttl;
+  UINTN   LastTtl;
+  UINTN   DestTtl;
+  UINTN   Responded;
+  UINTN   Pos;
+  UINTN   I;
+  UINT32  Sorted[L3_TRACE_MAX_ROUNDS];
+  UINT32  MinUs;
+  UINT32  MedUs;
+  UINT32  MaxUs;
+  UINT32  DestMedUs;
+  UINT64  SumUs;
+
+  DestTtl   = 0;
+  DestMedUs = 0;
+  LastTtl   = 0;
+  Responded = 0;
+  for (Ttl = 1; Ttl <= L3_TRACE_MAX_TTL; Ttl++) {
+    if (Hops[Ttl].Replies == 0) {
+      continue;
+    }
+    Result->PacketsReceived += Hops[Ttl].Replies;
+    LastTtl = Ttl;
+    if (Hops[Ttl].IsTarget) {
+      DestTtl = Ttl;
+      break;
+    }
+  }
+  Result->PacketsSent = Sent;
+
+  //
+  // "ttl:addr min/med/max ms answered/rounds" per hop, '*' for silence
+  //
+  Pos = 0;
+  Result->Detail[0] = L'\0';
+  for (Ttl = 1; Ttl <= LastTtl; Ttl++) {
+    if ((Pos + 48) * sizeof (CHAR16) >= sizeof (Result->Detail)) {
+      UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16), L" ...");
+      break;
+    }
+    if (Hops[Ttl].Replies == 0) {
+      UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                     L"%s%d:*", Ttl > 1 ? L" | " : L"", Ttl);
+      Pos += StrLen (&Result->Detail[Pos]);
+      continue;
+    }
+
+    Responded++;
+    CopyMem (Sorted, Hops[Ttl].RttUs, Hops[Ttl].Replies * sizeof (UINT32));
+    UtilSortUint32 (Sorted, Hops[Ttl].Replies);
+    MinUs = Sorted[0];
+    MaxUs = Sorted[Hops[Ttl].Replies - 1];
+    MedUs = UtilPercentile (Sorted, Hops[Ttl].Replies, 50);
+
+    UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                   L"%s%d:%d.%d.%d.%d%s %d.%d/%d.%d/%d.%dms %d/%d",
+                   Ttl > 1 ? L" | " : L"", Ttl,
+                   Hops[Ttl].Addr[0], Hops[Ttl].Addr[1], Hops[Ttl].Addr[2], Hops[Ttl].Addr[3],
+                   Hops[Ttl].MultiPath ? L"+" : L"",
+                   MinUs / 1000, (MinUs / 100) % 10,
+                   MedUs / 1000, (MedUs / 100) % 10,
+                   MaxUs / 1000, (MaxUs / 100) % 10,
+                   Hops[Ttl].Replies, Rounds);
+    Pos += StrLen (&Result->Detail[Pos]);
+
+    if (Ttl == DestTtl) {
+      SumUs = 0;
+      for (I = 0; I < Hops[Ttl].Replies; I++) {
+        SumUs += Sorted[I];
+      }
+      DestMedUs        = MedUs;
+      Result->RttMinUs = MinUs;
+      Result->RttMaxUs = MaxUs;
+      Result->RttAvgUs = (UINT32)DivU64x32 (SumUs, (UINT32)Hops[Ttl].Replies);
+    }
+  }
+
+  if (DestTtl > 0) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Target reached in %d hop(s), %d silent, RTT med=%d us (%d rounds, parallel)",
+                   DestTtl, DestTtl - Responded, DestMedUs, Rounds);
+  } else if (Responded > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Target not reached in %d hops (%d hops responded)",
+                   L3_TRACE_MAX_TTL, Responded);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Target may be more than %d hops away or blocking ICMP", L3_TRACE_MAX_TTL);
+  } else {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No hops responded (0/%d)", L3_TRACE_MAX_TTL);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No ICMP Time Exceeded or Echo Reply received for %d probes", Sent);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check gateway reachability and ICMP filtering");
+  }
+}
+
+//
+// ============================================================
+// Path MTU discovery (DF probes, parallel size bracketing)
+// ============================================================
+//
+
+#define L3_PMTU_ID              0xDD32
+#define L3_PMTU_MIN             68       // RFC 791 minimum IPv4 MTU
+#define L3_PMTU_PROBES          8        // sizes in flight per round
+#define L3_PMTU_MAX_ROUNDS      8
+#define L3_PMTU_TIMEOUT_MS      1000     // round wait while nothing has answered
+#define L3_PMTU_SETTLE_MIN_MS   20       // after the first answer: max(4 x RTT, this)
+#define L3_PMTU_MAX_SILENT      2        // rounds with no answer at all before giving up
+
+#define L3_PMTU_PENDING   0
+#define L3_PMTU_OK        1
+#define L3_PMTU_TOO_BIG   2
+
+typedef struct {
+  UINT16    Size;                        // IP total length
+  UINT8     *Frame;
+  UINT64    SentUs;
+  UINT8     Outcome;
+} L3_PMTU_PROBE;
+
+typedef struct {
+  UINT32    LinkMtu;                     // Snp->Mode->MaxPacketSize
+  UINT32    PathMtu;                     // largest echoed DF probe
+  UINT32    ReportedMtu;                 // smallest Frag-Needed next-hop MTU, 0 = none
+  UINT8     Reporter[4];
+  UINTN     Rounds;
+  UINTN     Sent;
+  UINTN     Answered;
+  UINTN     FragNeeded;
+  UINTN     SilentDrops;                 // oversize probes dropped without ICMP
+  UINT64    ElapsedUs;
+} L3_PMTU_RESULT;
+
+/**
+  Match one received frame against the probes of the current round.
+
+  @param[in]      Frame    Received Ethernet frame.
+  @param[in]      Length   Frame length.
+  @param[in]      Config   Test configuration.
+  @param[in]      Round    Current round (high byte of the ICMP sequence).
+  @param[in,out]  Probes   Probes of this round.
+  @param[in]      Count    Probe count.
+  @param[in,out]  Res      Discovery result (Frag-Needed bookkeeping).
+
+  @return  RTT in microseconds of a newly answered probe, 0 otherwise.
+**/
+STATIC
+UINT32
+L3PmtuMatch (
+  IN     CONST UINT8     *Frame,
+  IN     UINTN           Length,
+  IN     TEST_CONFIG     *Config,
+  IN     UINTN           Round,
+  IN OUT L3_PMTU_PROBE   *Probes,
+  IN     UINTN           Count,
+  IN OUT L3_PMTU_RESULT  *Res
+  )
+{
+  PARSED_PACKET  Parsed;
+  IPV4_HEADER    *Inner;
+  ICMP_HEADER    *Probe;
+  UINTN          InnerHdrLen;
+  UINT16         Id;
+  UINT16         Seq;
+  UINTN          Idx;
+  UINT8          Outcome;
+  UINT32         NextHopMtu;
+
+  if (EFI_ERROR (PktParsePacket (Frame, Length, &Parsed)) ||
+      !Parsed.HasIpv4 || !Parsed.HasIcmp ||
+      CompareMem (Parsed.Ipv4->DstAddr, Config->LocalIp.Addr, 4) != 0) {
+    return 0;
+  }
+
+  NextHopMtu = 0;
+  if (Parsed.Icmp->Type == ICMP_TYPE_ECHO_REPLY) {
+    if (CompareMem (Parsed.Ipv4->SrcAddr, Config->TargetIp.Addr, 4) != 0) {
+      return 0;
+    }
+    Id      = NTOHS (Parsed.Icmp->Identifier);
+    Seq     = NTOHS (Parsed.Icmp->SequenceNumber);
+    Outcome = L3_PMTU_OK;
+  } else if (Parsed.Icmp->Type == ICMP_TYPE_DEST_UNREACH) {
+    if (Parsed.PayloadLength < IPV4_MIN_HEADER_SIZE + ICMP_HEADER_SIZE) {
+      return 0;
+    }
+    Inner       = (IPV4_HEADER *)Parsed.Payload;
+    InnerHdrLen = IPV4_HDR_LEN (Inner->VersionIhl);
+    if (Inner->Protocol != IP_PROTO_ICMP ||
+        Parsed.PayloadLength < InnerHdrLen + ICMP_HEADER_SIZE ||
+        CompareMem (Inner->DstAddr, Config->TargetIp.Addr, 4) != 0) {
+      return 0;
+    }
+    Probe   = (ICMP_HEADER *)(Parsed.Payload + InnerHdrLen);
+    Id      = NTOHS (Probe->Identifier);
+    Seq     = NTOHS (Probe->SequenceNumber);
+    Outcome = L3_PMTU_TOO_BIG;
+    if (Parsed.Icmp->Code == ICMP_CODE_FRAG_NEEDED) {
+      //
+      // RFC 1191: next-hop MTU in the low 16 bits of the "unused" word
+      //
+      NextHopMtu = NTOHS (Parsed.Icmp->SequenceNumber);
+    }
+  } else {
+    return 0;
+  }
+
+  Idx = Seq & 0xFF;
+  if (Id != L3_PMTU_ID || (UINTN)(Seq >> 8) != Round || Idx >= Count ||
+      Probes[Idx].Outcome != L3_PMTU_PENDING) {
+    return 0;
+  }
+  Probes[Idx].Outcome = Outcome;
+
+  if (Outcome == L3_PMTU_TOO_BIG && Parsed.Icmp->Code == ICMP_CODE_FRAG_NEEDED) {
+    Res->FragNeeded++;
+    if (NextHopMtu >= L3_PMTU_MIN && NextHopMtu < Probes[Idx].Size &&
+        (Res->ReportedMtu == 0 || NextHopMtu < Res->ReportedMtu)) {
+      Res->ReportedMtu = NextHopMtu;
+      CopyMem (Res->Reporter, Parsed.Ipv4->SrcAddr, 4);
+    }
+  }
+
+  return (UINT32)(UtilGetTimeUs () - Probes[Idx].SentUs);
+}
+
+/**
+  Discover the path MTU to Config->TargetIp with DF-set ICMP echo probes
+  sent over raw SNP. Each round launches up to L3_PMTU_PROBES sizes
+  spread over the open interval (confirmed, upper bound] at once; an
+  echo raises the confirmed size, Frag-Needed (with its next-hop MTU)
+  or silence above a confirmed size lowers the bound. The upper bound
+  starts at Snp->Mode->MaxPacketSize, so jumbo links are searched too.
+  A round ends a few RTTs after its first answer, so a normal path
+  resolves in 2-4 rounds.
+
+  @param[in]   Nic     NIC information.
+  @param[in]   Config  Test configuration.
+  @param[out]  Res     Discovery result.
+
+  @retval EFI_SUCCESS  Search ran (Res->PathMtu == 0 if nothing answered).
+  @retval other        Raw I/O, next-hop resolution or allocation failed.
+**/
+STATIC
+EFI_STATUS
+L3PmtuDiscover (
+  IN  NIC_INFO        *Nic,
+  IN  TEST_CONFIG     *Config,
+  OUT L3_PMTU_RESULT  *Res
+  )
+{
+  EFI_STATUS     Status;
+  PKT_IO         Io;
+  UINT8          DstMac[6];
+  L3_PMTU_PROBE  Probes[L3_PMTU_PROBES];
+  UINT8          *RxBuf;
+  UINTN          RxSize;
+  UINTN          RxLen;
+  UINTN          Count;
+  UINTN          Idx;
+  UINTN          Pending;
+  UINTN          Silent;
+  UINT32         Lo;
+  UINT32         Hi;
+  UINT32         Base;
+  UINT32         RttUs;
+  UINT32         SettleUs;
+  BOOLEAN        AnyOk;
+  UINT64         StartUs;
+  UINT64         NowUs;
+  UINT64         EndUs;
+
+  ZeroMem (Res, sizeof (L3_PMTU_RESULT));
+  ZeroMem (Probes, sizeof (Probes));
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    return EFI_NOT_READY;
+  }
+
+  Res->LinkMtu = Nic->Snp->Mode->MaxPacketSize;
+  if (Res->LinkMtu < L3_PMTU_MIN || Res->LinkMtu > 0xFFFF) {
+    Res->LinkMtu = DEFAULT_MTU;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = PktIoResolveNextHop (
+             &Io,
+             Config->LocalIp.Addr,
+             Config->SubnetMask.Addr,
+             Config->Gateway.Addr,
+             Config->TargetIp.Addr,
+             DstMac
+             );
+  if (EFI_ERROR (Status)) {
+    PktIoClose (&Io);
+    return Status;
+  }
+
+  //
+  // Every probe keeps its own frame: SNP may still own a queued buffer
+  // while the next size is being sent.
+  //
+  RxSize = ETHERNET_HEADER_SIZE + Res->LinkMtu + 4;
+  RxBuf  = AllocatePool (RxSize);
+  Status = (RxBuf != NULL) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+  for (Idx = 0; Idx < L3_PMTU_PROBES && !EFI_ERROR (Status); Idx++) {
+    Probes[Idx].Frame = AllocateZeroPool (ETHERNET_HEADER_SIZE + Res->LinkMtu);
+    if (Probes[Idx].Frame == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    goto Cleanup;
+  }
+
+  Lo      = 0;
+  Hi      = Res->LinkMtu;
+  Silent  = 0;
+  StartUs = UtilGetTimeUs ();
+
+  while (Lo < Hi && Res->Rounds < L3_PMTU_MAX_ROUNDS && Silent < L3_PMTU_MAX_SILENT) {
+    //
+    // Spread sizes evenly over (Base, Hi]; the last probe is Hi itself
+    //
+    Base  = (Lo > 0) ? Lo : L3_PMTU_MIN - 1;
+    Count = MIN (L3_PMTU_PROBES, Hi - Base);
+    for (Idx = 0; Idx < Count; Idx++) {
+      Probes[Idx].Size    = (UINT16)(Base + ((Hi - Base) * (UINT32)(Idx + 1)) / (UINT32)Count);
+      Probes[Idx].Outcome = L3_PMTU_PENDING;
+      PktBuildIcmpEchoRequest (
+        Probes[Idx].Frame, Io.SrcMac, DstMac,
+        Config->LocalIp.Addr, Config->TargetIp.Addr,
+        L3_PMTU_ID, (UINT16)((Res->Rounds << 8) | Idx),
+        NULL, Probes[Idx].Size - IPV4_MIN_HEADER_SIZE - ICMP_HEADER_SIZE
+        );
+    }
+
+    for (Idx = 0; Idx < Count; Idx++) {
+      Probes[Idx].SentUs = UtilGetTimeUs ();
+      if (!EFI_ERROR (PktIoSend (&Io, Probes[Idx].Frame, ETHERNET_HEADER_SIZE + Probes[Idx].Size))) {
+        Res->Sent++;
+      }
+    }
+
+    EndUs   = UtilGetTimeUs () + L3_PMTU_TIMEOUT_MS * 1000;
+    Pending = Count;
+    while (Pending > 0) {
+      RxLen = RxSize;
+      if (!EFI_ERROR (PktIoReceive (&Io, RxBuf, &RxLen))) {
+        RttUs = L3PmtuMatch (RxBuf, RxLen, Config, Res->Rounds, Probes, Count, Res);
+        if (RttUs > 0) {
+          Pending--;
+          SettleUs = MAX (RttUs * 4, L3_PMTU_SETTLE_MIN_MS * 1000);
+          NowUs    = UtilGetTimeUs ();
+          if (NowUs + SettleUs < EndUs) {
+            EndUs = NowUs + SettleUs;
+          }
+        }
+      }
+      if (UtilGetTimeUs () >= EndUs) {
+        break;
+      }
+    }
+
+    Res->Rounds++;
+
+    //
+    // Raise the confirmed size first, then pull the bound down
+    //
+    AnyOk = FALSE;
+    for (Idx = 0; Idx < Count; Idx++) {
+      if (Probes[Idx].Outcome != L3_PMTU_PENDING) {
+        Res->Answered++;
+      }
+      if (Probes[Idx].Outcome == L3_PMTU_OK) {
+        AnyOk = TRUE;
+        Lo    = MAX (Lo, Probes[Idx].Size);
+      }
+    }
+
+    for (Idx = 0; Idx < Count; Idx++) {
+      if (Probes[Idx].Size <= Lo) {
+        continue;
+      }
+      if (Probes[Idx].Outcome == L3_PMTU_TOO_BIG) {
+        Hi = MIN (Hi, (UINT32)Probes[Idx].Size - 1);
+      } else if (Probes[Idx].Outcome == L3_PMTU_PENDING && AnyOk) {
+        //
+        // Smaller sizes got through, this one vanished: dropped for size
+        //
+        Res->SilentDrops++;
+        Hi = MIN (Hi, (UINT32)Probes[Idx].Size - 1);
+      }
+    }
+
+    if (Res->ReportedMtu > Lo && Res->ReportedMtu < Hi) {
+      Hi = Res->ReportedMtu;
+    }
+    Hi = MAX (Hi, Lo);
+
+    Silent = (Pending == Count) ? Silent + 1 : 0;
+  }
+
+  Res->PathMtu   = Lo;
+  Res->ElapsedUs = UtilGetTimeUs () - StartUs;
+  Status         = EFI_SUCCESS;
+
+Cleanup:
+  for (Idx = 0; Idx < L3_PMTU_PROBES; Idx++) {
+    if (Probes[Idx].Frame != NULL) {
+      FreePool (Probes[Idx].Frame);
+    }
+  }
+  if (RxBuf != NULL) {
+    FreePool (RxBuf);
+  }
+  PktIoClose (&Io);
+  return Status;
+}
+
+/**
+  Fill a test result from a path MTU search.
+
+  @param[in]   Pmtu    Search result from L3PmtuDiscover.
+  @param[out]  Result  Test result.
+**/
+STATIC
+VOID
+L3PmtuReport (
+  IN  L3_PMTU_RESULT    *Pmtu,
+  OUT TEST_RESULT_DATA  *Result
+  )
+{
+  Result->PacketsSent     = Pmtu->Sent;
+  Result->PacketsReceived = Pmtu->Answered;
+
+  if (Pmtu->PathMtu == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Path MTU discovery failed: no replies received");
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No echo or Frag-Needed for %d DF probes in %d rounds",
+                   Pmtu->Sent, Pmtu->Rounds);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify target is reachable with basic ping first");
+    return;
+  }
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"Link MTU %d, path MTU %d (largest echoed DF probe, payload %d). "
+                 L"Rounds %d, probes %d/%d answered, %d ms. "
+                 L"Frag-Needed: %d (next-hop MTU %d from %d.%d.%d.%d), silent drops: %d",
+                 Pmtu->LinkMtu, Pmtu->PathMtu,
+                 Pmtu->PathMtu - IPV4_MIN_HEADER_SIZE - ICMP_HEADER_SIZE,
+                 Pmtu->Rounds, Pmtu->Answered, Pmtu->Sent,
+                 (UINT32)DivU64x32 (Pmtu->ElapsedUs, 1000),
+                 Pmtu->FragNeeded, Pmtu->ReportedMtu,
+                 Pmtu->Reporter[0], Pmtu->Reporter[1], Pmtu->Reporter[2], Pmtu->Reporter[3],
+                 Pmtu->SilentDrops);
+
+  if (Pmtu->PathMtu >= Pmtu->LinkMtu || Pmtu->PathMtu >= DEFAULT_MTU) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Path MTU = %d bytes (link %d, %d rounds)",
+                   Pmtu->PathMtu, Pmtu->LinkMtu, Pmtu->Rounds);
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Path MTU = %d bytes, below link MTU %d",
+                   Pmtu->PathMtu, Pmtu->LinkMtu);
+    if (Pmtu->FragNeeded == 0 && Pmtu->SilentDrops > 0) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Oversize DF probes dropped without ICMP Frag-Needed: possible PMTU black hole");
+    } else {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"A hop with a smaller MTU (tunnel/VPN/VLAN) is on the path");
+    }
+  }
+}
+
+//
+// ============================================================
+// Address conflict detection (RFC 5227 ARP probes)
+// ============================================================
+//
+
+#define L3_DAD_PROBE_WAIT_MS      1000     // initial random delay 0..PROBE_WAIT
+#define L3_DAD_PROBE_NUM          3
+#define L3_DAD_PROBE_MIN_MS       1000     // random gap between probes
+#define L3_DAD_PROBE_MAX_MS       2000
+#define L3_DAD_ANNOUNCE_WAIT_MS   2000     // listen after the last probe
+
+#define L3_DAD_NONE       0
+#define L3_DAD_REPLY      1                // ARP reply from the address owner
+#define L3_DAD_REQUEST    2                // ARP request/announcement sent from the address
+#define L3_DAD_PROBE      3                // another host probing the same address
+
+typedef struct {
+  UINT8     Kind;                        // L3_DAD_*
+  UINT8     ConflictMac[6];
+  UINTN     ProbesSent;
+  UINTN     ArpSeen;                     // ARP frames received while listening
+  UINT64    DetectUs;                    // first probe to conflict, 0 = before the first probe
+  UINT64    ElapsedUs;
+} L3_DAD_RESULT;
+
+/**
+  Pick a random delay in [MinMs, MaxMs) from a linear congruential
+  generator. RFC 5227 asks for jitter so hosts that power up together
+  do not probe in lockstep; the seed mixes the MAC with the clock.
+
+  @param[in,out]  Seed   Generator state.
+  @param[in]      MinMs  Lower bound in milliseconds.
+  @param[in]      MaxMs  Upper bound in milliseconds.
+
+  @return  Delay in microseconds.
+**/
+STATIC
+UINT64
+L3DadJitterUs (
+  IN OUT UINT32  *Seed,
+  IN     UINT32  MinMs,
+  IN     UINT32  MaxMs
+  )
+{
+  *Seed = *Seed * 1103515245 + 12345;
+  return (UINT64)(MinMs + ((*Seed >> 16) % (MaxMs - MinMs))) * 1000;
+}
+
+/**
+  Check one received frame for an address conflict on ProbeIp.
+  Following RFC 5227 section 2.1.1, any ARP packet whose sender IP is
+  the probed address, or an ARP probe for the same address, from a MAC
+  other than ours is a conflict.
+
+  @param[in]   Frame    Received Ethernet frame.
+  @param[in]   Length   Frame length.
+  @param[in]   OwnMac   Our MAC address.
+  @param[in]   ProbeIp  Address being probed.
+  @param[out]  Dad      Conflict kind and MAC are filled on a match.
+
+  @retval TRUE   Frame is a conflict.
+  @retval FALSE  Not ARP, or no conflict.
+**/
+STATIC
+BOOLEAN
+L3DadMatch (
+  IN  CONST UINT8    *Frame,
+  IN  UINTN          Length,
+  IN  CONST UINT8    *OwnMac,
+  IN  CONST UINT8    *ProbeIp,
+  OUT L3_DAD_RESULT  *Dad
+  )
+{
+  PARSED_PACKET  Parsed;
+  ARP_HEADER     *Arp;
+  UINT16         Op;
+  UINT8          ZeroIp[4];
+
+  if (EFI_ERROR (PktParsePacket (Frame, Length, &Parsed)) || !Parsed.HasArp) {
+    return FALSE;
+  }
+
+  Dad->ArpSeen++;
+  Arp = Parsed.Arp;
+  if (CompareMem (Arp->SenderMac, OwnMac, 6) == 0) {
+    return FALSE;
+  }
+
+  Op = NTOHS (Arp->Operation);
+  ZeroMem (ZeroIp, sizeof (ZeroIp));
+
+  if (CompareMem (Arp->SenderIp, ProbeIp, 4) == 0) {
+    Dad->Kind = (Op == ARP_OP_REPLY) ? L3_DAD_REPLY : L3_DAD_REQUEST;
+  } else if (Op == ARP_OP_REQUEST &&
+             CompareMem (Arp->SenderIp, ZeroIp, 4) == 0 &&
+             CompareMem (Arp->TargetIp, ProbeIp, 4) == 0) {
+    Dad->Kind = L3_DAD_PROBE;
+  } else {
+    return FALSE;
+  }
+
+  CopyMem (Dad->ConflictMac, Arp->SenderMac, 6);
+  return TRUE;
+}
+
+/**
+  Probe ProbeIp the way RFC 5227 does before claiming an address:
+  after a random 0..PROBE_WAIT delay, send PROBE_NUM ARP probes
+  (sender IP 0.0.0.0, target IP = ProbeIp) PROBE_MIN..PROBE_MAX apart,
+  then listen for ANNOUNCE_WAIT. Receive runs the whole time through
+  the shared PacketIo child, so a defending reply, an announcement or
+  a competing probe stops the run as soon as it arrives. No
+  announcement is sent: the address is only tested, not claimed.
+
+  @param[in]   Nic      NIC information.
+  @param[in]   ProbeIp  Address to check.
+  @param[out]  Dad      Probe result.
+
+  @retval EFI_SUCCESS  Probing ran (Dad->Kind != L3_DAD_NONE on conflict).
+  @retval other        Raw I/O could not be opened.
+**/
+STATIC
+EFI_STATUS
+L3DadProbe (
+  IN  NIC_INFO       *Nic,
+  IN  CONST UINT8    *ProbeIp,
+  OUT L3_DAD_RESULT  *Dad
+  )
+{
+  EFI_STATUS  Status;
+  PKT_IO      Io;
+  UINT8       Frames[L3_DAD_PROBE_NUM][64];
+  UINT8       RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN       RxLen;
+  UINTN       FrameLen;
+  UINT8       ZeroIp[4];
+  UINT32      Seed;
+  UINT64      StartUs;
+  UINT64      FirstUs;
+  UINT64      NextUs;
+  UINT64      NowUs;
+
+  ZeroMem (Dad, sizeof (L3_DAD_RESULT));
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    return EFI_NOT_READY;
+  }
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem (ZeroIp, sizeof (ZeroIp));
+  ZeroMem (Frames, sizeof (Frames));
+
+  Seed    = (UINT32)UtilGetTimeUs () ^
+            ((UINT32)Io.SrcMac[2] << 24 | (UINT32)Io.SrcMac[3] << 16 |
+             (UINT32)Io.SrcMac[4] << 8  | Io.SrcMac[5]);
+  StartUs = UtilGetTimeUs ();
+  FirstUs = 0;
+  NextUs  = StartUs + L3DadJitterUs (&Seed, 0, L3_DAD_PROBE_WAIT_MS);
+
+  while (TRUE) {
+    RxLen = sizeof (RxBuf);
+    if (!EFI_ERROR (PktIoReceive (&Io, RxBuf, &RxLen)) &&
+        L3DadMatch (RxBuf, RxLen, Io.SrcMac, ProbeIp, Dad)) {
+      NowUs = UtilGetTimeUs ();
+      Dad->DetectUs = (FirstUs != 0) ? NowUs - FirstUs : 0;
+      break;
+    }
+
+    NowUs = UtilGetTimeUs ();
+    if (NowUs < NextUs) {
+      continue;
+    }
+    if (Dad->ProbesSent == L3_DAD_PROBE_NUM) {
+      break;
+    }
+
+    //
+    // Each probe keeps its own frame: SNP may still own the previous one
+    //
+    FrameLen = PktBuildArpRequest (Frames[Dad->ProbesSent], Io.SrcMac, ZeroIp, ProbeIp);
+    if (!EFI_ERROR (PktIoSend (&Io, Frames[Dad->ProbesSent], FrameLen))) {
+      if (FirstUs == 0) {
+        FirstUs = NowUs;
+      }
+    }
+    Dad->ProbesSent++;
+
+    if (Dad->ProbesSent < L3_DAD_PROBE_NUM) {
+      NextUs = NowUs + L3DadJitterUs (&Seed, L3_DAD_PROBE_MIN_MS, L3_DAD_PROBE_MAX_MS);
+    } else {
+      NextUs = NowUs + L3_DAD_ANNOUNCE_WAIT_MS * 1000;
+    }
+  }
+
+  Dad->ElapsedUs = UtilGetTimeUs () - StartUs;
+  PktIoClose (&Io);
+  return EFI_SUCCESS;
+}
+
+/**
+  Fill a test result from an RFC 5227 probe run.
+
+  @param[in]   Dad      Probe result from L3DadProbe.
+  @param[in]   ProbeIp  Address that was probed.
+  @param[out]  Result   Test result.
+**/
+STATIC
+VOID
+L3DadReport (
+  IN  L3_DAD_RESULT     *Dad,
+  IN  CONST UINT8       *ProbeIp,
+  OUT TEST_RESULT_DATA  *Result
+  )
+{
+  CHAR16  MacStr[20];
+
+  Result->PacketsSent     = Dad->ProbesSent;
+  Result->PacketsReceived = Dad->ArpSeen;
+  Result->BytesSent       = Dad->ProbesSent * (ETHERNET_HEADER_SIZE + ARP_HEADER_SIZE);
+
+  if (Dad->Kind == L3_DAD_NONE) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No duplicate IP detected for %d.%d.%d.%d (%d probes, %d ms)",
+                   ProbeIp[0], ProbeIp[1], ProbeIp[2], ProbeIp[3],
+                   Dad->ProbesSent, (UINT32)DivU64x32 (Dad->ElapsedUs, 1000));
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"RFC 5227 probing: %d ARP probes, %d ARP frames heard, no reply, "
+                   L"announcement or competing probe for the address in %d ms",
+                   Dad->ProbesSent, Dad->ArpSeen,
+                   (UINT32)DivU64x32 (Dad->ElapsedUs, 1000));
+    return;
+  }
+
+  UtilFormatMac (Dad->ConflictMac, MacStr);
+  Result->StatusCode = TEST_RESULT_FAIL;
+  UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                 L"DUPLICATE IP detected! %d.%d.%d.%d claimed by %s",
+                 ProbeIp[0], ProbeIp[1], ProbeIp[2], ProbeIp[3],
+                 MacStr);
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"Conflict: %s from %s after %d probes, %d us after the first probe "
+                 L"(%d ARP frames heard)",
+                 (Dad->Kind == L3_DAD_REPLY)   ? L"ARP reply" :
+                 (Dad->Kind == L3_DAD_REQUEST) ? L"ARP request/announcement" :
+                                                 L"competing ARP probe",
+                 MacStr, Dad->ProbesSent, (UINT32)Dad->DetectUs, Dad->ArpSeen);
+  if (Dad->Kind == L3_DAD_PROBE) {
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Another host (MAC %s) is probing for the same IP address",
+                   MacStr);
+  } else {
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Another host (MAC %s) has the same IP address",
+                   MacStr);
+  }
+  UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                 L"Change IP on one of the conflicting hosts");
+}
+
+//
+// ============================================================
+// DUT reflector (companion-driven ICMP/UDP echo)
+// ============================================================
+//
+
+#define L3_RFL_UDP_PORT         7        // RFC 862 echo
+#define L3_RFL_TX_SLOTS         64       // reflected frames SNP may still own
+#define L3_RFL_SLOT_SIZE        1536
+#define L3_RFL_PROBES           1000     // companion ping-pong probes per latency phase
+#define L3_RFL_WINDOW           32       // datagrams in flight in the rate phase
+#define L3_RFL_DEFAULT_SIZE     64       // ICMP/UDP payload bytes
+#define L3_RFL_MAX_SIZE         1472
+#define L3_RFL_DEFAULT_MS       3000     // rate phase
+#define L3_RFL_START_MS         2000     // first request must arrive within this
+#define L3_RFL_IDLE_MS          1000     // quiet this long after traffic: run over
+#define L3_RFL_CAP_MS           30000    // on top of the rate phase, whatever arrives
+#define L3_RFL_DRAIN_MS         100      // for SNP to hand back the last TX slots
+#define L3_RFL_TTL              64
+#define L3_RFL_LOSS_WARN_PERMILLE  10    // > 1.0% rate phase loss
+
+typedef struct {
+  UINT64    Rx;                          // frames received
+  UINT64    Icmp;                        // requests addressed to us, by kind
+  UINT64    Udp;
+  UINT64    Arp;
+  UINT64    Other;                       // anything not reflected
+  UINT64    Reflected;
+  UINT64    TxBusy;                      // dropped: no TX slot, or SNP queue full
+  UINT64    TxErrors;
+  UINT64    TurnMin;                     // RX-to-TX turnaround, TSC ticks
+  UINT64    TurnSum;
+  UINT64    TurnMax;
+  UINT64    TscPerUs;                    // measured over the run
+  UINT64    FirstUs;
+  UINT64    LastUs;
+} L3_RFL_STATS;
+
+/**
+  Turn one received frame into its reflection, in place. An ARP
+  request for OwnIp becomes the reply, an ICMP echo request to OwnIp
+  the echo reply, and a UDP datagram to port 7 goes back with its
+  ports swapped. Swapping the addresses and ports moves words around
+  without changing the one's complement sums (the UDP pseudo-header
+  included), so only the ICMP type and the TTL need a checksum update,
+  done incrementally.
+
+  @param[in,out]  Frame   Received Ethernet frame, rewritten if reflected.
+  @param[in]      Length  Frame length.
+  @param[in]      OwnMac  Our MAC address.
+  @param[in]      OwnIp   Our IPv4 address.
+  @param[in,out]  Stats   Per-kind counters.
+
+  @return  Length to transmit, 0 if the frame is not reflected.
+**/
+STATIC
+UINTN
+L3RflRewrite (
+  IN OUT UINT8         *Frame,
+  IN     UINTN         Length,
+  IN     CONST UINT8   *OwnMac,
+  IN     CONST UINT8   *OwnIp,
+  IN OUT L3_RFL_STATS  *Stats
+  )
+{
+  ETHERNET_HEADER  *Eth;
+  ARP_HEADER       *Arp;
+  IPV4_HEADER      *Ip;
+  ICMP_HEADER      *Icmp;
+  UDP_HEADER       *Udp;
+  UINT8            PeerMac[6];
+  UINT8            PeerIp[4];
+  UINTN            IpLen;
+  UINTN            TotalLen;
+  UINT16           OldWord;
+  UINT16           Port;
+
+  Eth = (ETHERNET_HEADER *)Frame;
+  if (Length < ETHERNET_HEADER_SIZE + ARP_HEADER_SIZE) {
+    Stats->Other++;
+    return 0;
+  }
+
+  if (NTOHS (Eth->EtherType) == ETHERTYPE_ARP) {
+    Arp = (ARP_HEADER *)(Frame + ETHERNET_HEADER_SIZE);
+    if (NTOHS (Arp->Operation) != ARP_OP_REQUEST ||
+        CompareMem (Arp->TargetIp, OwnIp, 4) != 0) {
+      Stats->Other++;
+      return 0;
+    }
+    Stats->Arp++;
+    CopyMem (PeerMac, Arp->SenderMac, 6);
+    CopyMem (PeerIp, Arp->SenderIp, 4);
+    Length = PktBuildArpReply (Frame, OwnMac, OwnIp, PeerMac, PeerIp);
+    ZeroMem (Frame + Length, MIN_ETHERNET_FRAME_SIZE - 4 - Length);
+    return MIN_ETHERNET_FRAME_SIZE - 4;
+  }
+
+  if (NTOHS (Eth->EtherType) != ETHERTYPE_IPV4) {
+    Stats->Other++;
+    return 0;
+  }
+
+  //
+  // Only whole datagrams to us, with room for the ICMP/UDP header
+  //
+  Ip       = (IPV4_HEADER *)(Frame + ETHERNET_HEADER_SIZE);
+  IpLen    = IPV4_HDR_LEN (Ip->VersionIhl);
+  TotalLen = NTOHS (Ip->TotalLength);
+  if (IPV4_VERSION (Ip->VersionIhl) != 4 || IpLen < IPV4_MIN_HEADER_SIZE ||
+      TotalLen < IpLen + UDP_HEADER_SIZE || ETHERNET_HEADER_SIZE + TotalLen > Length ||
+      (NTOHS (Ip->FlagsFragOffset) & (IP_FLAG_MF | IP_FRAG_MASK)) != 0 ||
+      CompareMem (Ip->DstAddr, OwnIp, 4) != 0) {
+    Stats->Other++;
+    return 0;
+  }
+
+  if (Ip->Protocol == IP_PROTO_ICMP) {
+    Icmp = (ICMP_HEADER *)((UINT8 *)Ip + IpLen);
+    if (Icmp->Type != ICMP_TYPE_ECHO_REQUEST) {
+      Stats->Other++;
+      return 0;
+    }
+    OldWord        = (UINT16)((Icmp->Type << 8) | Icmp->Code);
+    Icmp->Type     = ICMP_TYPE_ECHO_REPLY;
+    Icmp->Checksum = HTONS (PktChecksumAdjust (NTOHS (Icmp->Checksum), OldWord,
+                                               (UINT16)((Icmp->Type << 8) | Icmp->Code)));
+    Stats->Icmp++;
+  } else if (Ip->Protocol == IP_PROTO_UDP) {
+    Udp = (UDP_HEADER *)((UINT8 *)Ip + IpLen);
+    if (NTOHS (Udp->DstPort) != L3_RFL_UDP_PORT) {
+      Stats->Other++;
+      return 0;
+    }
+    Port         = Udp->SrcPort;
+    Udp->SrcPort = Udp->DstPort;
+    Udp->DstPort = Port;
+    Stats->Udp++;
+  } else {
+    Stats->Other++;
+    return 0;
+  }
+
+  CopyMem (Ip->DstAddr, Ip->SrcAddr, 4);
+  CopyMem (Ip->SrcAddr, OwnIp, 4);
+  OldWord            = (UINT16)((Ip->Ttl << 8) | Ip->Protocol);
+  Ip->Ttl            = L3_RFL_TTL;
+  Ip->HeaderChecksum = HTONS (PktChecksumAdjust (NTOHS (Ip->HeaderChecksum), OldWord,
+                                                 (UINT16)((Ip->Ttl << 8) | Ip->Protocol)));
+
+  CopyMem (Eth->DstMac, Eth->SrcMac, 6);
+  CopyMem (Eth->SrcMac, OwnMac, 6);
+  return Length;
+}
+
+/**
+  Take back the TX slots SNP has finished sending.
+
+  @param[in]      Snp    Simple Network Protocol.
+  @param[in]      Slots  Slot buffers.
+  @param[in,out]  Busy   Per-slot ownership flags.
+  @param[in,out]  InUse  Slots SNP still owns.
+**/
+STATIC
+VOID
+L3RflReclaim (
+  IN     EFI_SIMPLE_NETWORK_PROTOCOL  *Snp,
+  IN     UINT8                        *Slots,
+  IN OUT BOOLEAN                      *Busy,
+  IN OUT UINTN                        *InUse
+  )
+{
+  VOID   *TxBuf;
+  UINTN  Index;
+
+  while (*InUse > 0) {
+    TxBuf = NULL;
+    if (EFI_ERROR (Snp->GetStatus (Snp, NULL, &TxBuf)) || TxBuf == NULL) {
+      return;
+    }
+    if ((UINT8 *)TxBuf < Slots) {
+      continue;
+    }
+    Index = ((UINT8 *)TxBuf - Slots) / L3_RFL_SLOT_SIZE;
+    if (Index < L3_RFL_TX_SLOTS && Busy[Index]) {
+      Busy[Index] = FALSE;
+      (*InUse)--;
+    }
+  }
+}
+
+/**
+  Reflect until the companion's run is over. Each frame is received
+  straight into a free TX slot, rewritten there by L3RflRewrite and
+  transmitted from the same buffer, so nothing is copied. The loop
+  holds TPL_CALLBACK: MNP's background poll cannot take frames away,
+  and the IP4 stack cannot answer the same echo request a second time.
+  The run ends L3_RFL_IDLE_MS after the last request, or when nothing
+  arrives within L3_RFL_START_MS.
+
+  @param[in]      Snp         Simple Network Protocol.
+  @param[in]      OwnMac      Our MAC address.
+  @param[in]      OwnIp       Our IPv4 address.
+  @param[in]      DurationMs  Length of the companion's rate phase.
+  @param[in]      Slots       L3_RFL_TX_SLOTS buffers of L3_RFL_SLOT_SIZE bytes.
+  @param[in,out]  Stats       Run statistics.
+
+  @retval TRUE   SNP handed back every slot; Slots may be freed.
+  @retval FALSE  SNP still owns a slot.
+**/
+STATIC
+BOOLEAN
+L3RflLoop (
+  IN     EFI_SIMPLE_NETWORK_PROTOCOL  *Snp,
+  IN     CONST UINT8                  *OwnMac,
+  IN     CONST UINT8                  *OwnIp,
+  IN     UINT32                       DurationMs,
+  IN     UINT8                        *Slots,
+  IN OUT L3_RFL_STATS                 *Stats
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+  BOOLEAN     Busy[L3_RFL_TX_SLOTS];
+  UINT8       Scratch[L3_RFL_SLOT_SIZE];
+  UINT8       *Frame;
+  UINTN       InUse;
+  UINTN       Next;
+  UINTN       Tries;
+  UINTN       HeaderSize;
+  UINTN       Length;
+  UINTN       TxLen;
+  UINT64      RxTsc;
+  UINT64      Ticks;
+  UINT64      StartTsc;
+  UINT64      StartUs;
+  UINT64      NowUs;
+
+  ZeroMem (Busy, sizeof (Busy));
+  InUse = 0;
+  Next  = 0;
+
+  Snp->ReceiveFilters (
+    Snp,
+    EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
+    EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST,
+    0, FALSE, 0, NULL
+    );
+
+  OldTpl   = gBS->RaiseTPL (TPL_CALLBACK);
+  StartUs  = UtilGetTimeUs ();
+  StartTsc = AsmReadTsc ();
+
+  for (;;) {
+    L3RflReclaim (Snp, Slots, Busy, &InUse);
+
+    //
+    // Receive into the next free slot; with all of them in flight the
+    // frame lands in scratch and is dropped after being counted
+    //
+    Frame = Scratch;
+    for (Tries = 0; Tries < L3_RFL_TX_SLOTS; Tries++) {
+      if (!Busy[Next]) {
+        Frame = Slots + Next * L3_RFL_SLOT_SIZE;
+        break;
+      }
+      Next = (Next + 1) % L3_RFL_TX_SLOTS;
+    }
+
+    HeaderSize = 0;
+    Length     = L3_RFL_SLOT_SIZE;
+    Status     = Snp->Receive (Snp, &HeaderSize, &Length, Frame, NULL, NULL, NULL);
+    if (!EFI_ERROR (Status)) {
+      RxTsc = AsmReadTsc ();
+      Stats->Rx++;
+      TxLen = L3RflRewrite (Frame, Length, OwnMac, OwnIp, Stats);
+      if (TxLen == 0) {
+        continue;
+      }
+
+      NowUs = UtilGetTimeUs ();
+      if (Stats->FirstUs == 0) {
+        Stats->FirstUs = NowUs;
+      }
+      Stats->LastUs = NowUs;
+
+      if (Frame == Scratch) {
+        Stats->TxBusy++;
+        continue;
+      }
+
+      Status = Snp->Transmit (Snp, 0, TxLen, Frame, NULL, NULL, NULL);
+      if (EFI_ERROR (Status)) {
+        if (Status == EFI_NOT_READY) {
+          Stats->TxBusy++;
+        } else {
+          Stats->TxErrors++;
+        }
+        continue;
+      }
+      Ticks = AsmReadTsc () - RxTsc;
+
+      Busy[Next] = TRUE;
+      InUse++;
+      Next = (Next + 1) % L3_RFL_TX_SLOTS;
+
+      Stats->Reflected++;
+      Stats->TurnSum += Ticks;
+      if (Stats->TurnMin == 0 || Ticks < Stats->TurnMin) {
+        Stats->TurnMin = Ticks;
+      }
+      if (Ticks > Stats->TurnMax) {
+        Stats->TurnMax = Ticks;
+      }
+      continue;
+    }
+
+    NowUs = UtilGetTimeUs ();
+    if (Stats->FirstUs == 0) {
+      if (NowUs - StartUs > L3_RFL_START_MS * 1000) {
+        break;
+      }
+    } else if (NowUs - Stats->LastUs > L3_RFL_IDLE_MS * 1000) {
+      break;
+    }
+    if (NowUs - StartUs > (UINT64)(DurationMs + L3_RFL_CAP_MS) * 1000) {
+      break;
+    }
+  }
+
+  NowUs           = UtilGetTimeUs ();
+  Stats->TscPerUs = DivU64x64Remainder (AsmReadTsc () - StartTsc,
+                                        MAX (NowUs - StartUs, 1), NULL);
+
+  //
+  // The slot memory goes back to the pool: wait for the last sends
+  //
+  while (InUse > 0 && UtilGetTimeUs () - NowUs < L3_RFL_DRAIN_MS * 1000) {
+    L3RflReclaim (Snp, Slots, Busy, &InUse);
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return (BOOLEAN)(InUse == 0);
+}
+
+/**
+  Convert TSC ticks to nanoseconds.
+
+  @param[in]  Ticks     TSC ticks.
+  @param[in]  TscPerUs  Ticks per microsecond.
+
+  @return  Nanoseconds (0 if the rate is unknown).
+**/
+STATIC
+UINT64
+L3RflTicksToNs (
+  IN UINT64  Ticks,
+  IN UINT64  TscPerUs
+  )
+{
+  return (TscPerUs > 0) ? DivU64x64Remainder (Ticks * 1000, TscPerUs, NULL) : 0;
+}
+
 //
 // ============================================================
 // Test implementations
@@ -1317,8 +2695,11 @@ TestL3IcmpSweep (
 
 /**
   Test L3.4: TTL/Hop Discovery
-  Sends ICMP echo requests with increasing TTL values to discover
-  the number of hops to the target. Similar to traceroute.
+  Traceroute to the target. By default every TTL probe (1..16) of
+  several rounds (Config->Iterations, default 3) is launched at once
+  over raw SNP and answers are collected in one timeout window, giving
+  per-hop RTT min/median/max. When raw I/O is unavailable it falls back
+  to sequential L3Ping probes with increasing TTL.
 
   PASS: Target reached and hop count determined
   WARN: Reached target but some hops didn't respond
@@ -1331,15 +2712,30 @@ TestL3TtlHopDiscovery (
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS  Status;
-  UINT32      RttUs;
-  UINT8       ReplyType;
-  UINT8       ReplyCode;
-  UINT8       Ttl;
-  UINT8       MaxTtl;
-  UINTN       HopsResponded;
-  BOOLEAN     TargetReached;
+  EFI_STATUS    Status;
+  UINT32        RttUs;
+  UINT8         ReplyType;
+  UINT8         ReplyCode;
+  UINT8         Ttl;
+  UINT8         MaxTtl;
+  UINTN         HopsResponded;
+  BOOLEAN       TargetReached;
+  L3_TRACE_HOP  Hops[L3_TRACE_MAX_TTL + 1];
+  UINTN         Rounds;
+  UINTN         Sent;
+
+  Rounds = (Config->Iterations > 0 && Config->Iterations <= L3_TRACE_MAX_ROUNDS) ?
+           Config->Iterations : L3_TRACE_DEFAULT_ROUNDS;
+
+  Status = L3TraceParallel (Nic, Config, Rounds, Hops, &Sent);
+  if (!EFI_ERROR (Status) && Sent > 0) {
+    L3TraceReport (Hops, Rounds, Sent, Result);
+    return EFI_SUCCESS;
+  }
 
+  //
+  // Sequential fallback: one probe at a time through L3Ping
+  //
   MaxTtl        = 16;
   HopsResponded = 0;
   TargetReached = FALSE;
@@ -1407,8 +2803,11 @@ TestL3TtlHopDiscovery (
 
 /**
   Test L3.5: MTU Path Discovery
-  Sends ICMP echo requests with varying payload sizes to discover the path MTU.
-  Binary search between minimum and maximum.
+  Discovers the path MTU with DF-set raw ICMP probes, several sizes per
+  round in parallel, honouring Frag-Needed next-hop MTU hints and
+  searching up to the link MTU (jumbo frames included). Falls back to a
+  sequential IP4 binary search over 8..1472 bytes of payload when raw
+  I/O is unavailable.
 
   PASS: Path MTU determined
   WARN: Could only send small packets
@@ -1421,18 +2820,25 @@ TestL3MtuPathDiscovery (
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS  Status;
-  UINT32      RttUs;
-  UINT8       ReplyType;
-  UINT8       ReplyCode;
-  UINTN       Lo;
-  UINTN       Hi;
-  UINTN       Mid;
-  UINTN       LargestOk;
-  UINT16      SeqNum;
+  EFI_STATUS      Status;
+  UINT32          RttUs;
+  UINT8           ReplyType;
+  UINT8           ReplyCode;
+  UINTN           Lo;
+  UINTN           Hi;
+  UINTN           Mid;
+  UINTN           LargestOk;
+  UINT16          SeqNum;
+  L3_PMTU_RESULT  Pmtu;
+
+  Status = L3PmtuDiscover (Nic, Config, &Pmtu);
+  if (!EFI_ERROR (Status) && Pmtu.Sent > 0) {
+    L3PmtuReport (&Pmtu, Result);
+    return EFI_SUCCESS;
+  }
 
   //
-  // Binary search for path MTU
+  // Fallback: binary search for path MTU via IP4 (DF not guaranteed)
   // Payload range: 8 bytes (minimum useful) to 1472 (1500 - 20 IP - 8 ICMP)
   //
   Lo        = 8;
@@ -2084,11 +3490,15 @@ TestL3RoutingTable (
 
 /**
   Test L3.10: Duplicate IP Detection
-  Uses ARP protocol to check if another host claims our IP address.
-  Sends ARP request for our own IP and checks if a different MAC responds.
+  Runs RFC 5227 address conflict detection over raw SNP: three ARP
+  probes (sender IP 0.0.0.0) with randomized spacing while listening
+  for a reply, announcement or competing probe from another MAC.
+  Falls back to resolving our own IP through EFI_ARP_PROTOCOL when raw
+  I/O is unavailable.
 
   PASS: No duplicate IP detected
-  FAIL: Another host claims our IP address
+  WARN: No address to probe, or no way to send ARP
+  FAIL: Another host claims (or is probing for) our IP address
 **/
 EFI_STATUS
 TestL3DuplicateIp (
@@ -2101,6 +3511,7 @@ TestL3DuplicateIp (
   CONST UINT8                   *ProbeIp;
   UINT8                         ResolvedMac[6];
   CHAR16                        MacStr[20];
+  L3_DAD_RESULT                 Dad;
 
   //
   // Use our configured IP or the test config local IP
@@ -2111,8 +3522,26 @@ TestL3DuplicateIp (
     ProbeIp = Config->LocalIp.Addr;
   }
 
+  if (ProbeIp[0] == 0 && ProbeIp[1] == 0 && ProbeIp[2] == 0 && ProbeIp[3] == 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No IPv4 address to check for duplicates");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Configure an IP (DHCP or static) and re-run");
+    return EFI_SUCCESS;
+  }
+
   //
-  // Method 1: ARP protocol - resolve our own IP
+  // Method 1: RFC 5227 probing over the shared PacketIo path
+  //
+  Status = L3DadProbe (Nic, ProbeIp, &Dad);
+  if (!EFI_ERROR (Status)) {
+    L3DadReport (&Dad, ProbeIp, Result);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Method 2: ARP protocol - resolve our own IP
   // If someone else responds with a different MAC, it's a duplicate.
   //
   if (Nic->HasArp) {
@@ -2165,97 +3594,238 @@ TestL3DuplicateIp (
     return EFI_SUCCESS;
   }
 
+  Result->StatusCode = TEST_RESULT_WARN;
+  UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                 L"Cannot probe for duplicate IP: raw I/O failed (%r), no ARP protocol",
+                 Status);
+  UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                 L"Check that the NIC driver exposes SNP/MNP or ARP");
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Test L3.11: Reflector
+  Turns the DUT into the echo end of a companion-driven test. The DUT
+  sits in a tight SNP loop answering ARP, ICMP echo and UDP echo (port
+  7) by rewriting each frame in place, while the companion's reflect
+  driver sends: ICMP and UDP ping-pong for latency, then a window of
+  datagrams for Config->DurationMs (default 3 s) to find the highest
+  rate the DUT reflects. Payloads are Config->DatagramSize bytes
+  (default 64). The DUT's own polling loops are not in the measured
+  path, so the RTTs are the wire plus the DUT's RX-to-TX turnaround.
+
+  PASS: Rate phase loss <= 1%, no latency probe lost, no bad reflection
+  WARN: Higher loss, lost probes, ICMP phase skipped (companion not root)
+  FAIL: Companion unavailable, nothing reflected
+**/
+EFI_STATUS
+TestL3Reflector (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS      LinkStatus;
+  COMPANION_LINK  Link;
+  CHAR8           Args[128];
+  CONST CHAR8     *Report;
+  L3_RFL_STATS    Stats;
+  UINT8           *Slots;
+  CONST UINT8     *OwnIp;
+  UINT32          Size;
+  UINT32          DurationMs;
+  UINT32          RunId;
+  UINT64          IcmpN;
+  UINT64          IcmpRaw;
+  UINT64          IcmpLost;
+  UINT64          IcmpBad;
+  UINT64          IcmpMinNs;
+  UINT64          IcmpP50Ns;
+  UINT64          IcmpP99Ns;
+  UINT64          UdpN;
+  UINT64          UdpLost;
+  UINT64          UdpBad;
+  UINT64          UdpMinNs;
+  UINT64          UdpP50Ns;
+  UINT64          UdpP99Ns;
+  UINT64          RateSent;
+  UINT64          RateRecv;
+  UINT64          RateUs;
+  UINT64          RatePps;
+  UINT64          Lost;
+  UINT32          LossPermille;
+  UINT64          TurnMinNs;
+  UINT64          TurnAvgNs;
+  UINT64          TurnMaxNs;
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    Result->StatusCode = TEST_RESULT_SKIP;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SNP not initialized");
+    return EFI_SUCCESS;
+  }
+
   //
-  // Method 2: Raw SNP gratuitous ARP probe (fallback)
-  // This may not work when IP4 stack is active (MNP consumes replies)
+  // Reflect for the address the companion knows us by
   //
-  if (Nic->Snp != NULL && Nic->Snp->Mode->State == EfiSimpleNetworkInitialized) {
-    EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
-    UINT8                        TxBuf[64];
-    UINT8                        RxBuf[MAX_ETHERNET_FRAME_SIZE];
-    UINTN                        TxLen;
-    UINTN                        RxLen;
-    UINTN                        HdrSize;
-    UINTN                        I;
-    ETHERNET_HEADER              *RxEth;
-    ARP_HEADER                   *RxArp;
-    UINT8                        ZeroIp[4];
-
-    Snp = Nic->Snp;
+  OwnIp = Config->LocalIp.Addr;
+  if (OwnIp[0] == 0 && OwnIp[1] == 0 && OwnIp[2] == 0 && OwnIp[3] == 0) {
+    Result->StatusCode = TEST_RESULT_SKIP;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No local IPv4 address to reflect for");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Configure an IP (DHCP or static) and re-run");
+    return EFI_SUCCESS;
+  }
 
-    //
-    // Build ARP probe: Sender IP = 0.0.0.0, Target IP = our IP
-    //
-    ZeroMem (ZeroIp, sizeof (ZeroIp));
-    ZeroMem (TxBuf, sizeof (TxBuf));
-    TxLen = PktBuildArpRequest (TxBuf, Snp->Mode->CurrentAddress.Addr, ZeroIp, ProbeIp);
-
-    Snp->ReceiveFilters (
-      Snp,
-      EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
-      EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST,
-      0, FALSE, 0, NULL
-      );
-
-    Status = Snp->Transmit (Snp, 0, TxLen, TxBuf, NULL, NULL, NULL);
-    if (EFI_ERROR (Status)) {
-      Result->StatusCode = TEST_RESULT_WARN;
-      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                     L"ARP probe TX failed: %r (cannot verify)", Status);
-      return EFI_SUCCESS;
+  DurationMs = (Config->DurationMs > 0) ? Config->DurationMs : L3_RFL_DEFAULT_MS;
+  Size       = (Config->DatagramSize > 0) ? Config->DatagramSize : L3_RFL_DEFAULT_SIZE;
+  Size       = MIN (Size, L3_RFL_MAX_SIZE);
+  RunId      = (UINT32)UtilGetTimeUs () & 0x7FFFFFFF;
+
+  Slots = AllocatePool (L3_RFL_TX_SLOTS * L3_RFL_SLOT_SIZE);
+  if (Slots == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the TX slots");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Arm the reflect driver, fire it, and be in the loop before its
+  // first request (it waits a moment after the START ACK)
+  //
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args),
+                   "run=%d port=%d size=%d probes=%d ms=%d window=%d",
+                   RunId, L3_RFL_UDP_PORT, Size, L3_RFL_PROBES, DurationMs,
+                   L3_RFL_WINDOW);
+      LinkStatus = CompanionPrepareStart (&Link, "L3", "REFLECT", Args);
     }
+    if (EFI_ERROR (LinkStatus)) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  if (EFI_ERROR (LinkStatus)) {
+    FreePool (Slots);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Companion reflect driver unavailable: %r", LinkStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"The reflector needs the companion to send the traffic");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Run the companion on the target IP (as root for the ICMP phase)");
+    return EFI_SUCCESS;
+  }
 
-    Result->PacketsSent = 1;
-    Result->BytesSent   = TxLen;
+  ZeroMem (&Stats, sizeof (Stats));
+  if (L3RflLoop (Nic->Snp, Nic->Snp->Mode->CurrentAddress.Addr, OwnIp,
+                 DurationMs, Slots, &Stats)) {
+    FreePool (Slots);
+  }
+
+  IcmpN = IcmpRaw = IcmpLost = IcmpBad = IcmpMinNs = IcmpP50Ns = IcmpP99Ns = 0;
+  UdpN  = UdpLost = UdpBad = UdpMinNs = UdpP50Ns = UdpP99Ns = 0;
+  RateSent = RateRecv = RateUs = 0;
+
+  LinkStatus = CompanionStopResult (&Link, &Report);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionResultValue (Report, "rfl_rate_sent", &RateSent);
+  }
+  if (!EFI_ERROR (LinkStatus)) {
+    CompanionResultValue (Report, "rfl_rate_recv", &RateRecv);
+    CompanionResultValue (Report, "rfl_rate_us", &RateUs);
+    CompanionResultValue (Report, "rfl_icmp_n", &IcmpN);
+    CompanionResultValue (Report, "rfl_icmp_raw", &IcmpRaw);
+    CompanionResultValue (Report, "rfl_icmp_lost", &IcmpLost);
+    CompanionResultValue (Report, "rfl_icmp_bad", &IcmpBad);
+    CompanionResultValue (Report, "rfl_icmp_min_ns", &IcmpMinNs);
+    CompanionResultValue (Report, "rfl_icmp_p50_ns", &IcmpP50Ns);
+    CompanionResultValue (Report, "rfl_icmp_p99_ns", &IcmpP99Ns);
+    CompanionResultValue (Report, "rfl_udp_n", &UdpN);
+    CompanionResultValue (Report, "rfl_udp_lost", &UdpLost);
+    CompanionResultValue (Report, "rfl_udp_bad", &UdpBad);
+    CompanionResultValue (Report, "rfl_udp_min_ns", &UdpMinNs);
+    CompanionResultValue (Report, "rfl_udp_p50_ns", &UdpP50Ns);
+    CompanionResultValue (Report, "rfl_udp_p99_ns", &UdpP99Ns);
+  }
+  CompanionDisconnect (&Link);
+  CompanionDestroy (&Link);
+
+  Result->PacketsReceived = Stats.Rx;
+  Result->PacketsSent     = Stats.Reflected;
+  Result->RttMinUs        = (UINT32)DivU64x32 (UdpMinNs, 1000);
+  Result->RttMaxUs        = (UINT32)DivU64x32 (UdpP99Ns, 1000);
+
+  if (Stats.Reflected == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Reflector: nothing reflected (%llu frames received)", Stats.Rx);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No ARP/ICMP/UDP echo request for %d.%d.%d.%d arrived "
+                   L"(%llu TX busy, %llu TX errors)",
+                   OwnIp[0], OwnIp[1], OwnIp[2], OwnIp[3], Stats.TxBusy, Stats.TxErrors);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check that the companion interface is on this segment");
+    return EFI_SUCCESS;
+  }
 
-    //
-    // Listen for ARP replies for 3 seconds
-    //
-    for (I = 0; I < 3000; I++) {
-      RxLen   = sizeof (RxBuf);
-      HdrSize = 0;
-      Status  = Snp->Receive (Snp, &HdrSize, &RxLen, RxBuf, NULL, NULL, NULL);
-
-      if (!EFI_ERROR (Status) && RxLen >= ETHERNET_HEADER_SIZE + ARP_HEADER_SIZE) {
-        RxEth = (ETHERNET_HEADER *)RxBuf;
-
-        if (NTOHS (RxEth->EtherType) == ETHERTYPE_ARP) {
-          RxArp = (ARP_HEADER *)(RxBuf + ETHERNET_HEADER_SIZE);
-
-          if (NTOHS (RxArp->Operation) == ARP_OP_REPLY) {
-            if (RxArp->SenderIp[0] == ProbeIp[0] &&
-                RxArp->SenderIp[1] == ProbeIp[1] &&
-                RxArp->SenderIp[2] == ProbeIp[2] &&
-                RxArp->SenderIp[3] == ProbeIp[3]) {
-              if (CompareMem (RxArp->SenderMac, Snp->Mode->CurrentAddress.Addr, 6) != 0) {
-                Result->PacketsReceived = 1;
-                Result->BytesReceived   = RxLen;
-                UtilFormatMac (RxArp->SenderMac, MacStr);
-                Result->StatusCode = TEST_RESULT_FAIL;
-                UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                               L"DUPLICATE IP detected! %d.%d.%d.%d claimed by %s",
-                               ProbeIp[0], ProbeIp[1], ProbeIp[2], ProbeIp[3],
-                               MacStr);
-                UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
-                               L"Another host (MAC %s) has the same IP address",
-                               MacStr);
-                UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                               L"Change IP on one of the conflicting hosts");
-                return EFI_SUCCESS;
-              }
-            }
-          }
-        }
-      }
+  TurnMinNs    = L3RflTicksToNs (Stats.TurnMin, Stats.TscPerUs);
+  TurnAvgNs    = L3RflTicksToNs (DivU64x64Remainder (Stats.TurnSum, Stats.Reflected, NULL),
+                                 Stats.TscPerUs);
+  TurnMaxNs    = L3RflTicksToNs (Stats.TurnMax, Stats.TscPerUs);
+  RatePps      = (RateUs > 0) ? DivU64x64Remainder (RateRecv * 1000000, RateUs, NULL) : 0;
+  Lost         = (RateSent > RateRecv) ? RateSent - RateRecv : 0;
+  LossPermille = (RateSent > 0) ? (UINT32)DivU64x64Remainder (Lost * 1000, RateSent, NULL) : 0;
 
-      gBS->Stall (1000);
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"DUT: %llu in, %llu reflected (ICMP %llu, UDP %llu, ARP %llu), "
+                 L"%llu TX busy, %llu TX errors, turnaround %llu/%llu/%llu ns | "
+                 L"ICMP %s%llu, RTT min/p50/p99 %llu/%llu/%llu ns, lost %llu, bad %llu | "
+                 L"UDP %llu, RTT %llu/%llu/%llu ns, lost %llu, bad %llu | "
+                 L"Rate %llu/%llu in %llu ms, %d B, loss %d.%d%%",
+                 Stats.Rx, Stats.Reflected, Stats.Icmp, Stats.Udp, Stats.Arp,
+                 Stats.TxBusy, Stats.TxErrors, TurnMinNs, TurnAvgNs, TurnMaxNs,
+                 (IcmpRaw == 0) ? L"skipped " : L"", IcmpN,
+                 IcmpMinNs, IcmpP50Ns, IcmpP99Ns, IcmpLost, IcmpBad,
+                 UdpN, UdpMinNs, UdpP50Ns, UdpP99Ns, UdpLost, UdpBad,
+                 RateRecv, RateSent, DivU64x32 (RateUs, 1000), Size,
+                 LossPermille / 10, LossPermille % 10);
+
+  if (EFI_ERROR (LinkStatus) || RateSent == 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Reflected %llu frames, companion report unavailable", Stats.Reflected);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check the companion log for the reflect run");
+  } else if (IcmpBad > 0 || UdpBad > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Reflector returned %llu corrupted replies", IcmpBad + UdpBad);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Bad checksum or payload: check the NIC driver's RX/TX buffer handling");
+  } else if (LossPermille > L3_RFL_LOSS_WARN_PERMILLE || IcmpLost > 0 || UdpLost > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Reflector %llu pps, loss %d.%d%%, %llu probes lost",
+                   RatePps, LossPermille / 10, LossPermille % 10, IcmpLost + UdpLost);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"TX busy drops mean the NIC TX ring is the limit; else the RX path");
+  } else {
+    Result->StatusCode = (IcmpRaw != 0) ? TEST_RESULT_PASS : TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Reflector %llu pps (%d B), UDP RTT p50 %llu ns, turnaround %llu ns",
+                   RatePps, Size, UdpP50Ns, TurnAvgNs);
+    if (IcmpRaw == 0) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"ICMP phase skipped: run the companion as root");
     }
   }
 
-  Result->StatusCode = TEST_RESULT_PASS;
-  UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                 L"No duplicate IP detected for %d.%d.%d.%d",
-                 ProbeIp[0], ProbeIp[1], ProbeIp[2], ProbeIp[3]);
-
   return EFI_SUCCESS;
 }
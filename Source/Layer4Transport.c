@@ -1,7 +1,8 @@
 /** @file
   Layer 4 (Transport) test implementations.
   Tests TCP connect, multi-port, data transfer, close, UDP send/receive,
-  UDP multi-port, port scan, and TCP stress.
+  UDP multi-port, port scan, TCP stress, SYN rate, TCP/UDP throughput and
+  UDP latency.
   Uses EFI_TCP4_PROTOCOL and EFI_UDP4_PROTOCOL via service binding.
 **/
 
@@ -117,6 +118,49 @@ L4DestroyTcpChild (
   }
 }
 
+/**
+  Configure a TCP4 instance for an active open to a remote endpoint.
+
+  @param[in]  Tcp4       TCP4 protocol instance.
+  @param[in]  LocalIp    Local IP address.
+  @param[in]  RemoteIp   Remote IP address.
+  @param[in]  SubnetMask Subnet mask.
+  @param[in]  LocalPort  Local port (0 for ephemeral).
+  @param[in]  RemotePort Remote port.
+  @param[in]  Option     TCP options (buffer sizes, window scaling), or NULL.
+
+  @retval EFI_SUCCESS  Instance configured.
+  @retval other        Configure failure.
+**/
+STATIC
+EFI_STATUS
+L4TcpConfigureActive (
+  IN EFI_TCP4_PROTOCOL  *Tcp4,
+  IN EFI_IPv4_ADDRESS   *LocalIp,
+  IN EFI_IPv4_ADDRESS   *RemoteIp,
+  IN EFI_IPv4_ADDRESS   *SubnetMask,
+  IN UINT16             LocalPort,
+  IN UINT16             RemotePort,
+  IN EFI_TCP4_OPTION    *Option  OPTIONAL
+  )
+{
+  EFI_TCP4_CONFIG_DATA  TcpConfig;
+
+  ZeroMem (&TcpConfig, sizeof (TcpConfig));
+  TcpConfig.TypeOfService                = 0;
+  TcpConfig.TimeToLive                   = 64;
+  TcpConfig.AccessPoint.UseDefaultAddress = FALSE;
+  CopyMem (&TcpConfig.AccessPoint.StationAddress, LocalIp, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&TcpConfig.AccessPoint.SubnetMask, SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  TcpConfig.AccessPoint.StationPort      = LocalPort;
+  CopyMem (&TcpConfig.AccessPoint.RemoteAddress, RemoteIp, sizeof (EFI_IPv4_ADDRESS));
+  TcpConfig.AccessPoint.RemotePort       = RemotePort;
+  TcpConfig.AccessPoint.ActiveFlag       = TRUE;
+  TcpConfig.ControlOption                = Option;
+
+  return Tcp4->Configure (Tcp4, &TcpConfig);
+}
+
 /**
   Configure and connect a TCP4 instance to a remote endpoint.
   Active open: sets up local IP and initiates 3-way handshake.
@@ -128,6 +172,7 @@ L4DestroyTcpChild (
   @param[in]  LocalPort  Local port (0 for ephemeral).
   @param[in]  RemotePort Remote port.
   @param[in]  TimeoutMs  Connection timeout in milliseconds.
+  @param[in]  Option     TCP options, or NULL for stack defaults.
 
   @retval EFI_SUCCESS        Connected (Tcp4StateEstablished).
   @retval EFI_TIMEOUT        Connection timed out.
@@ -142,29 +187,17 @@ L4TcpConnect (
   IN EFI_IPv4_ADDRESS   *SubnetMask,
   IN UINT16             LocalPort,
   IN UINT16             RemotePort,
-  IN UINT32             TimeoutMs
+  IN UINT32             TimeoutMs,
+  IN EFI_TCP4_OPTION    *Option  OPTIONAL
   )
 {
   EFI_STATUS                  Status;
-  EFI_TCP4_CONFIG_DATA        TcpConfig;
   EFI_TCP4_CONNECTION_TOKEN   ConnToken;
 
   //
   // Configure TCP4 for active connection
   //
-  ZeroMem (&TcpConfig, sizeof (TcpConfig));
-  TcpConfig.TypeOfService                = 0;
-  TcpConfig.TimeToLive                   = 64;
-  TcpConfig.AccessPoint.UseDefaultAddress = FALSE;
-  CopyMem (&TcpConfig.AccessPoint.StationAddress, LocalIp, sizeof (EFI_IPv4_ADDRESS));
-  CopyMem (&TcpConfig.AccessPoint.SubnetMask, SubnetMask, sizeof (EFI_IPv4_ADDRESS));
-  TcpConfig.AccessPoint.StationPort      = LocalPort;
-  CopyMem (&TcpConfig.AccessPoint.RemoteAddress, RemoteIp, sizeof (EFI_IPv4_ADDRESS));
-  TcpConfig.AccessPoint.RemotePort       = RemotePort;
-  TcpConfig.AccessPoint.ActiveFlag       = TRUE;
-  TcpConfig.ControlOption                = NULL;
-
-  Status = Tcp4->Configure (Tcp4, &TcpConfig);
+  Status = L4TcpConfigureActive (Tcp4, LocalIp, RemoteIp, SubnetMask, LocalPort, RemotePort, Option);
   if (EFI_ERROR (Status)) {
     return Status;
   }
@@ -492,320 +525,2652 @@ L4TcpClose (
   return Status;
 }
 
+/**
+  Abort a TCP4 connection (RST) without waiting for the FIN handshake.
+
+  @param[in]  Tcp4  TCP4 protocol instance.
+**/
+STATIC
+VOID
+L4TcpAbort (
+  IN EFI_TCP4_PROTOCOL  *Tcp4
+  )
+{
+  EFI_TCP4_CLOSE_TOKEN  CloseToken;
+  UINTN                 Waited;
+
+  ZeroMem (&CloseToken, sizeof (CloseToken));
+  CloseToken.AbortOnClose = TRUE;
+
+  if (EFI_ERROR (gBS->CreateEvent (
+                        EVT_NOTIFY_SIGNAL,
+                        TPL_CALLBACK,
+                        L4NotifyStub,
+                        NULL,
+                        &CloseToken.CompletionToken.Event
+                        ))) {
+    return;
+  }
+
+  CloseToken.CompletionToken.Status = EFI_NOT_READY;
+
+  if (!EFI_ERROR (Tcp4->Close (Tcp4, &CloseToken))) {
+    //
+    // Abort completes locally; a short bounded poll is enough
+    //
+    for (Waited = 0;
+         CloseToken.CompletionToken.Status == EFI_NOT_READY && Waited < 100;
+         Waited++) {
+      Tcp4->Poll (Tcp4);
+      gBS->Stall (1000);
+    }
+    if (CloseToken.CompletionToken.Status == EFI_NOT_READY) {
+      Tcp4->Cancel (Tcp4, &CloseToken.CompletionToken);
+      Tcp4->Poll (Tcp4);
+    }
+  }
+
+  gBS->CloseEvent (CloseToken.CompletionToken.Event);
+}
+
 //
 // ============================================================
-// UDP4 helper functions
+// Parallel TCP connect scanner
 // ============================================================
 //
 
-/**
-  Create a UDP4 child, configure, send a datagram, and optionally wait for a reply.
-  All-in-one helper for UDP tests.
+#define L4_SCAN_MAX_INFLIGHT     64
+#define L4_SCAN_INITIAL_RTO_MS   1000
+#define L4_SCAN_MIN_RTO_MS       50
+#define L4_SCAN_MAX_OPEN_LIST    24
 
-  @param[in]  NicHandle   NIC handle with UDP4 service binding.
-  @param[in]  LocalIp     Local IP address.
-  @param[in]  RemoteIp    Remote IP address.
-  @param[in]  SubnetMask  Subnet mask.
-  @param[in]  LocalPort   Local UDP port.
-  @param[in]  RemotePort  Remote UDP port.
-  @param[in]  SendData    Data to send.
-  @param[in]  SendLen     Send data length.
-  @param[out] RecvBuf     Buffer for received reply (may be NULL).
-  @param[in]  RecvBufSize Receive buffer size.
-  @param[out] RecvLen     Actual received bytes (may be NULL).
-  @param[in]  TimeoutMs   Timeout for send+receive.
+typedef struct {
+  UINT16    First;
+  UINT16    Last;
+} L4_PORT_RANGE;
 
-  @retval EFI_SUCCESS   Send (and optional receive) succeeded.
-  @retval EFI_TIMEOUT   No reply within timeout.
-  @retval other         Protocol error.
+//
+// One in-flight connect probe
+//
+typedef struct {
+  BOOLEAN                      InUse;
+  UINT16                       Port;
+  EFI_HANDLE                   ChildHandle;
+  EFI_TCP4_PROTOCOL            *Tcp4;
+  EFI_TCP4_CONNECTION_TOKEN    ConnToken;
+  UINT64                       StartUs;
+} L4_SCAN_SLOT;
+
+typedef struct {
+  UINTN     Probed;
+  UINTN     Open;
+  UINTN     Closed;               // RST / port unreachable
+  UINTN     Filtered;             // no answer within RTO
+  UINTN     Errors;               // local child/configure failures
+  UINT16    OpenPorts[L4_SCAN_MAX_OPEN_LIST];
+  UINTN     OpenListed;
+  UINT32    SrttUs;
+  UINT32    RttVarUs;
+  UINT32    RtoMs;
+  UINT32    RttMinUs;
+  UINT32    RttMaxUs;
+  UINT64    RttSumUs;
+  UINTN     RttSamples;
+  UINT64    ElapsedUs;
+} L4_SCAN_STATS;
+
+/**
+  Feed one handshake RTT sample into the adaptive per-port timeout.
+  Uses the RFC 6298 SRTT/RTTVAR estimator; the resulting timeout is
+  clamped to [L4_SCAN_MIN_RTO_MS, InitialRtoMs].
+
+  @param[in,out]  Stats         Scan statistics.
+  @param[in]      RttUs         Measured SYN -> SYN/ACK or RST time.
+  @param[in]      InitialRtoMs  Upper bound (timeout before any sample).
 **/
 STATIC
-EFI_STATUS
-L4UdpSendRecv (
-  IN  EFI_HANDLE         NicHandle,
-  IN  EFI_IPv4_ADDRESS   *LocalIp,
-  IN  EFI_IPv4_ADDRESS   *RemoteIp,
-  IN  EFI_IPv4_ADDRESS   *SubnetMask,
-  IN  UINT16             LocalPort,
-  IN  UINT16             RemotePort,
-  IN  CONST VOID         *SendData,
-  IN  UINT32             SendLen,
-  OUT VOID               *RecvBuf       OPTIONAL,
-  IN  UINT32             RecvBufSize    OPTIONAL,
-  OUT UINT32             *RecvLen       OPTIONAL,
-  IN  UINT32             TimeoutMs
+VOID
+L4ScanUpdateRto (
+  IN OUT L4_SCAN_STATS  *Stats,
+  IN     UINT32         RttUs,
+  IN     UINT32         InitialRtoMs
   )
 {
-  EFI_STATUS                    Status;
-  EFI_SERVICE_BINDING_PROTOCOL  *UdpSb;
-  EFI_HANDLE                    ChildHandle;
-  EFI_UDP4_PROTOCOL             *Udp4;
-  EFI_UDP4_CONFIG_DATA          UdpConfig;
-  EFI_UDP4_COMPLETION_TOKEN     TxToken;
-  EFI_UDP4_TRANSMIT_DATA        TxData;
-  EFI_UDP4_COMPLETION_TOKEN     RxToken;
-  BOOLEAN                       DoReceive;
-
-  if (RecvLen != NULL) {
-    *RecvLen = 0;
+  UINT32  Delta;
+  UINT32  RtoUs;
+
+  if (Stats->RttSamples == 0) {
+    Stats->SrttUs   = RttUs;
+    Stats->RttVarUs = RttUs / 2;
+    Stats->RttMinUs = RttUs;
+    Stats->RttMaxUs = RttUs;
+  } else {
+    Delta           = (Stats->SrttUs > RttUs) ? Stats->SrttUs - RttUs : RttUs - Stats->SrttUs;
+    Stats->RttVarUs = (3 * Stats->RttVarUs + Delta) / 4;
+    Stats->SrttUs   = (7 * Stats->SrttUs + RttUs) / 8;
+    if (RttUs < Stats->RttMinUs) Stats->RttMinUs = RttUs;
+    if (RttUs > Stats->RttMaxUs) Stats->RttMaxUs = RttUs;
   }
 
-  DoReceive = (RecvBuf != NULL && RecvBufSize > 0);
+  Stats->RttSumUs += RttUs;
+  Stats->RttSamples++;
 
   //
-  // Create UDP4 child
+  // RTO = SRTT + max(4*RTTVAR, SRTT): never less than twice the
+  // smoothed RTT, so a momentarily busy target is not misread as filtered.
   //
-  ChildHandle = NULL;
-  Udp4        = NULL;
+  RtoUs = Stats->SrttUs + MAX (4 * Stats->RttVarUs, Stats->SrttUs);
+  Stats->RtoMs = RtoUs / 1000 + 1;
+  if (Stats->RtoMs < L4_SCAN_MIN_RTO_MS) {
+    Stats->RtoMs = L4_SCAN_MIN_RTO_MS;
+  }
+  if (Stats->RtoMs > InitialRtoMs) {
+    Stats->RtoMs = InitialRtoMs;
+  }
+}
 
-  Status = gBS->HandleProtocol (
-                  NicHandle,
-                  &gEfiUdp4ServiceBindingProtocolGuid,
-                  (VOID **)&UdpSb
-                  );
+/**
+  Start a connect probe in a free slot.
+
+  @param[in]      Nic     NIC information.
+  @param[in]      Config  Test configuration (addresses).
+  @param[in,out]  Slot    Free slot to use.
+  @param[in]      Port    Destination port to probe.
+
+  @retval EFI_SUCCESS  Connect token queued.
+  @retval other        Child creation, configure or connect failure.
+**/
+STATIC
+EFI_STATUS
+L4ScanLaunch (
+  IN     NIC_INFO      *Nic,
+  IN     TEST_CONFIG   *Config,
+  IN OUT L4_SCAN_SLOT  *Slot,
+  IN     UINT16        Port
+  )
+{
+  EFI_STATUS  Status;
+
+  ZeroMem (Slot, sizeof (L4_SCAN_SLOT));
+  Slot->Port = Port;
+
+  Status = L4CreateTcpChild (Nic->Handle, &Slot->ChildHandle, &Slot->Tcp4);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  Status = UdpSb->CreateChild (UdpSb, &ChildHandle);
+  Status = L4TcpConfigureActive (
+             Slot->Tcp4,
+             &Config->LocalIp,
+             &Config->TargetIp,
+             &Config->SubnetMask,
+             0,
+             Port,
+             NULL
+             );
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (
+                    EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    L4NotifyStub,
+                    NULL,
+                    &Slot->ConnToken.CompletionToken.Event
+                    );
+  }
   if (EFI_ERROR (Status)) {
+    L4DestroyTcpChild (Nic->Handle, Slot->ChildHandle, Slot->Tcp4);
     return Status;
   }
 
-  Status = gBS->HandleProtocol (
-                  ChildHandle,
-                  &gEfiUdp4ProtocolGuid,
-                  (VOID **)&Udp4
-                  );
+  Slot->ConnToken.CompletionToken.Status = EFI_NOT_READY;
+  Slot->StartUs = UtilGetTimeUs ();
+
+  Status = Slot->Tcp4->Connect (Slot->Tcp4, &Slot->ConnToken);
   if (EFI_ERROR (Status)) {
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    gBS->CloseEvent (Slot->ConnToken.CompletionToken.Event);
+    L4DestroyTcpChild (Nic->Handle, Slot->ChildHandle, Slot->Tcp4);
     return Status;
   }
 
-  //
-  // Configure
-  //
-  ZeroMem (&UdpConfig, sizeof (UdpConfig));
-  UdpConfig.AcceptBroadcast    = FALSE;
-  UdpConfig.AcceptPromiscuous  = FALSE;
-  UdpConfig.AcceptAnyPort      = FALSE;
-  UdpConfig.AllowDuplicatePort = TRUE;
-  UdpConfig.TimeToLive         = 64;
-  UdpConfig.DoNotFragment      = FALSE;
-  UdpConfig.UseDefaultAddress  = FALSE;
+  Slot->InUse = TRUE;
+  return EFI_SUCCESS;
+}
 
-  CopyMem (&UdpConfig.StationAddress, LocalIp, sizeof (EFI_IPv4_ADDRESS));
-  CopyMem (&UdpConfig.SubnetMask, SubnetMask, sizeof (EFI_IPv4_ADDRESS));
-  UdpConfig.StationPort = LocalPort;
-  CopyMem (&UdpConfig.RemoteAddress, RemoteIp, sizeof (EFI_IPv4_ADDRESS));
-  UdpConfig.RemotePort = RemotePort;
+/**
+  Release a slot's TCP4 child. Established connections are aborted
+  with RST; pending connect tokens are cancelled first.
 
-  Status = Udp4->Configure (Udp4, &UdpConfig);
-  if (EFI_ERROR (Status)) {
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return Status;
+  @param[in]      Nic   NIC information.
+  @param[in,out]  Slot  Slot to release.
+**/
+STATIC
+VOID
+L4ScanRetire (
+  IN     NIC_INFO      *Nic,
+  IN OUT L4_SCAN_SLOT  *Slot
+  )
+{
+  if (Slot->ConnToken.CompletionToken.Status == EFI_NOT_READY) {
+    Slot->Tcp4->Cancel (Slot->Tcp4, &Slot->ConnToken.CompletionToken);
+    Slot->Tcp4->Poll (Slot->Tcp4);
+  } else if (Slot->ConnToken.CompletionToken.Status == EFI_SUCCESS) {
+    L4TcpAbort (Slot->Tcp4);
   }
 
-  //
-  // Send
-  //
-  ZeroMem (&TxData, sizeof (TxData));
-  TxData.UdpSessionData                = NULL;
-  TxData.GatewayAddress                = NULL;
-  TxData.DataLength                    = SendLen;
-  TxData.FragmentCount                 = 1;
-  TxData.FragmentTable[0].FragmentLength = SendLen;
-  TxData.FragmentTable[0].FragmentBuffer = (VOID *)SendData;
+  L4DestroyTcpChild (Nic->Handle, Slot->ChildHandle, Slot->Tcp4);
+  gBS->CloseEvent (Slot->ConnToken.CompletionToken.Event);
+  Slot->InUse = FALSE;
+}
 
-  ZeroMem (&TxToken, sizeof (TxToken));
-  Status = gBS->CreateEvent (
-                  EVT_NOTIFY_SIGNAL,
-                  TPL_CALLBACK,
-                  L4NotifyStub,
-                  NULL,
-                  &TxToken.Event
-                  );
-  if (EFI_ERROR (Status)) {
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return Status;
+/**
+  Scan TCP port ranges with many connect tokens in flight at once.
+
+  Each port gets its own TCP4 child; up to MaxInFlight connects are
+  outstanding. A port is open when the connect completes, closed when
+  the stack reports RST/port-unreachable, and filtered when nothing
+  arrives within the adaptive timeout derived from observed handshake
+  RTTs (see L4ScanUpdateRto).
+
+  @param[in]   Nic          NIC information.
+  @param[in]   Config       Test configuration.
+  @param[in]   Ranges       Port ranges to scan.
+  @param[in]   RangeCount   Number of entries in Ranges.
+  @param[in]   MaxInFlight  Concurrent connects (1..L4_SCAN_MAX_INFLIGHT).
+  @param[in]   InitialRtoMs Per-port timeout before any RTT sample.
+  @param[out]  Stats        Scan results.
+
+  @retval EFI_SUCCESS           Scan ran to completion.
+  @retval EFI_OUT_OF_RESOURCES  Slot table allocation failed.
+**/
+STATIC
+EFI_STATUS
+L4ScanPorts (
+  IN  NIC_INFO             *Nic,
+  IN  TEST_CONFIG          *Config,
+  IN  CONST L4_PORT_RANGE  *Ranges,
+  IN  UINTN                RangeCount,
+  IN  UINTN                MaxInFlight,
+  IN  UINT32               InitialRtoMs,
+  OUT L4_SCAN_STATS        *Stats
+  )
+{
+  L4_SCAN_SLOT  *Slots;
+  UINTN         RangeIdx;
+  UINT32        NextPort;
+  UINTN         Active;
+  UINTN         I;
+  UINT64        StartUs;
+  UINT64        NowUs;
+  UINT32        RttUs;
+  EFI_STATUS    ConnStatus;
+
+  ZeroMem (Stats, sizeof (L4_SCAN_STATS));
+  Stats->RtoMs = InitialRtoMs;
+
+  if (MaxInFlight == 0 || MaxInFlight > L4_SCAN_MAX_INFLIGHT) {
+    MaxInFlight = L4_SCAN_MAX_INFLIGHT;
   }
 
-  TxToken.Status        = EFI_NOT_READY;
-  TxToken.Packet.TxData = &TxData;
-
-  Status = Udp4->Transmit (Udp4, &TxToken);
-  if (EFI_ERROR (Status)) {
-    gBS->CloseEvent (TxToken.Event);
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return Status;
+  Slots = AllocateZeroPool (MaxInFlight * sizeof (L4_SCAN_SLOT));
+  if (Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  //
-  // Wait for TX completion (timer-based)
-  //
-  {
-    EFI_EVENT  TimerEvent;
-    EFI_STATUS TimerStatus;
+  RangeIdx = 0;
+  NextPort = (RangeCount > 0) ? Ranges[0].First : 0;
+  Active   = 0;
+  StartUs  = UtilGetTimeUs ();
 
-    TimerEvent  = NULL;
-    TimerStatus = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &TimerEvent);
-    if (!EFI_ERROR (TimerStatus)) {
-      gBS->SetTimer (TimerEvent, TimerRelative, (UINT64)TimeoutMs * 10000);
-    }
+  for (;;) {
+    //
+    // Refill free slots from the port ranges
+    //
+    for (I = 0; I < MaxInFlight && RangeIdx < RangeCount; I++) {
+      if (Slots[I].InUse) {
+        continue;
+      }
 
-    while (TxToken.Status == EFI_NOT_READY) {
-      Udp4->Poll (Udp4);
-      if (TimerEvent != NULL && gBS->CheckEvent (TimerEvent) == EFI_SUCCESS) {
-        break;
+      Stats->Probed++;
+      if (EFI_ERROR (L4ScanLaunch (Nic, Config, &Slots[I], (UINT16)NextPort))) {
+        Stats->Errors++;
+      } else {
+        Active++;
+      }
+
+      if (NextPort >= Ranges[RangeIdx].Last) {
+        RangeIdx++;
+        if (RangeIdx < RangeCount) {
+          NextPort = Ranges[RangeIdx].First;
+        }
+      } else {
+        NextPort++;
       }
-      gBS->Stall (1000);
     }
 
-    if (TimerEvent != NULL) {
-      gBS->CloseEvent (TimerEvent);
+    if (Active == 0 && RangeIdx >= RangeCount) {
+      break;
     }
-  }
 
-  if (TxToken.Status == EFI_NOT_READY) {
-    Udp4->Cancel (Udp4, &TxToken);
-    gBS->CloseEvent (TxToken.Event);
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return EFI_TIMEOUT;
+    //
+    // Poll every child: each one's timers and token completion are only
+    // serviced through its own Poll, not through a sibling's
+    //
+    for (I = 0; I < MaxInFlight; I++) {
+      if (Slots[I].InUse) {
+        Slots[I].Tcp4->Poll (Slots[I].Tcp4);
+      }
+    }
+
+    NowUs = UtilGetTimeUs ();
+
+    for (I = 0; I < MaxInFlight; I++) {
+      if (!Slots[I].InUse) {
+        continue;
+      }
+
+      ConnStatus = Slots[I].ConnToken.CompletionToken.Status;
+
+      if (ConnStatus == EFI_NOT_READY) {
+        if (NowUs - Slots[I].StartUs < (UINT64)Stats->RtoMs * 1000) {
+          continue;
+        }
+        Stats->Filtered++;
+      } else {
+        RttUs = (UINT32)(NowUs - Slots[I].StartUs);
+
+        if (ConnStatus == EFI_SUCCESS) {
+          Stats->Open++;
+          if (Stats->OpenListed < L4_SCAN_MAX_OPEN_LIST) {
+            Stats->OpenPorts[Stats->OpenListed++] = Slots[I].Port;
+          }
+          L4ScanUpdateRto (Stats, RttUs, InitialRtoMs);
+        } else if (ConnStatus == EFI_CONNECTION_RESET ||
+                   ConnStatus == EFI_CONNECTION_REFUSED ||
+                   ConnStatus == EFI_PORT_UNREACHABLE) {
+          Stats->Closed++;
+          L4ScanUpdateRto (Stats, RttUs, InitialRtoMs);
+        } else {
+          //
+          // Host/network unreachable, aborted, etc. — no usable answer
+          //
+          Stats->Filtered++;
+        }
+      }
+
+      L4ScanRetire (Nic, &Slots[I]);
+      Active--;
+    }
+
+    gBS->Stall (200);
   }
 
-  Status = TxToken.Status;
-  gBS->CloseEvent (TxToken.Event);
+  Stats->ElapsedUs = UtilGetTimeUs () - StartUs;
 
-  if (EFI_ERROR (Status) || !DoReceive) {
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return Status;
+  FreePool (Slots);
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// Raw SYN engine (SNP TX / MNP RX, bypasses the TCP4 driver)
+// ============================================================
+//
+
+#define L4_SYN_SRC_PORT_BASE   32768
+#define L4_SYN_MAX_PER_STEP    16384     // one source port per probe
+#define L4_SYN_STEP_MS         500
+#define L4_SYN_GRACE_MS        300
+#define L4_SYN_MAX_SAMPLES     65536
+#define L4_SYN_GOOD_PERMILLE   990       // step "sustained" at >= 99.0% answered
+#define L4_SYN_STOP_PERMILLE   900       // stop ramping below 90.0%
+
+STATIC CONST UINT32  mL4SynRates[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 20000 };
+
+#define L4_SYN_NUM_STEPS  (sizeof (mL4SynRates) / sizeof (mL4SynRates[0]))
+
+typedef struct {
+  UINT32    TargetRate;      // SYN/s requested
+  UINT32    SentRate;        // SYN/s actually transmitted
+  UINT32    Sent;
+  UINT32    Answered;        // SYN-ACK or RST matched by cookie
+  UINT32    SynAck;
+  UINT32    Rst;
+} L4_SYN_STEP;
+
+typedef struct {
+  L4_SYN_STEP  Steps[L4_SYN_NUM_STEPS];
+  UINTN        StepCount;
+  UINT32       *Latency;     // answered SYN -> reply times (us)
+  UINTN        LatencyCount;
+  UINT32       BadCookie;    // TCP replies from target failing the cookie check
+  UINT32       TxErrors;
+  UINT32       SustainedRate;
+} L4_SYN_STATS;
+
+/**
+  Sequence-number cookie for a raw SYN. Replies are matched statelessly:
+  a SYN-ACK or RST/ACK from the target must acknowledge cookie + 1.
+  The step secret makes late replies from an earlier step fail the check.
+
+  @param[in]  Secret   Per-step secret.
+  @param[in]  SrcPort  Our source port.
+  @param[in]  DstPort  Target port.
+
+  @return  Initial sequence number for the probe.
+**/
+STATIC
+UINT32
+L4SynCookie (
+  IN UINT32  Secret,
+  IN UINT16  SrcPort,
+  IN UINT16  DstPort
+  )
+{
+  UINT32  H;
+
+  H  = Secret ^ ((UINT32)SrcPort << 16 | DstPort);
+  H ^= H >> 16;
+  H *= 0x7FEB352D;
+  H ^= H >> 15;
+  H *= 0x846CA68B;
+  H ^= H >> 16;
+  return H;
+}
+
+/**
+  Drain received frames and match TCP replies against the step cookie.
+
+  @param[in,out]  Io         Packet I/O context.
+  @param[in]      Config     Test configuration (target IP).
+  @param[in]      DstMac     Next-hop MAC (for the RST to SYN-ACKs).
+  @param[in]      Secret     Current step secret.
+  @param[in]      SentUs     Per-probe send timestamps (0 = not sent).
+  @param[in,out]  Answered   Per-probe answered flags.
+  @param[in,out]  Step       Step counters.
+  @param[in,out]  Stats      Engine statistics (latency samples).
+**/
+STATIC
+VOID
+L4SynDrain (
+  IN OUT PKT_IO        *Io,
+  IN     TEST_CONFIG   *Config,
+  IN     CONST UINT8   *DstMac,
+  IN     UINT32        Secret,
+  IN     CONST UINT64  *SentUs,
+  IN OUT UINT8         *Answered,
+  IN OUT L4_SYN_STEP   *Step,
+  IN OUT L4_SYN_STATS  *Stats
+  )
+{
+  UINT8          RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINT8          RstFrame[64];
+  UINTN          RxLen;
+  UINTN          RstLen;
+  UINTN          Budget;
+  UINT16         LocalPort;
+  UINT16         RemotePort;
+  UINT32         Idx;
+  UINT64         NowUs;
+  PARSED_PACKET  Parsed;
+
+  for (Budget = 0; Budget < 64; Budget++) {
+    RxLen = sizeof (RxBuf);
+    if (EFI_ERROR (PktIoReceive (Io, RxBuf, &RxLen))) {
+      return;
+    }
+    NowUs = UtilGetTimeUs ();
+
+    if (EFI_ERROR (PktParsePacket (RxBuf, RxLen, &Parsed)) ||
+        !Parsed.HasIpv4 || !Parsed.HasTcp ||
+        CompareMem (Parsed.Ipv4->SrcAddr, Config->TargetIp.Addr, 4) != 0 ||
+        (Parsed.Tcp->Flags & TCP_FLAG_ACK) == 0) {
+      continue;
+    }
+
+    LocalPort  = NTOHS (Parsed.Tcp->DstPort);
+    RemotePort = NTOHS (Parsed.Tcp->SrcPort);
+    if (LocalPort < L4_SYN_SRC_PORT_BASE ||
+        LocalPort >= L4_SYN_SRC_PORT_BASE + L4_SYN_MAX_PER_STEP) {
+      continue;
+    }
+
+    if (NTOHL (Parsed.Tcp->AckNumber) != L4SynCookie (Secret, LocalPort, RemotePort) + 1) {
+      Stats->BadCookie++;
+      continue;
+    }
+
+    Idx = LocalPort - L4_SYN_SRC_PORT_BASE;
+    if (SentUs[Idx] == 0 || Answered[Idx]) {
+      continue;
+    }
+    Answered[Idx] = 1;
+    Step->Answered++;
+
+    if (Stats->LatencyCount < L4_SYN_MAX_SAMPLES) {
+      Stats->Latency[Stats->LatencyCount++] = (UINT32)(NowUs - SentUs[Idx]);
+    }
+
+    if ((Parsed.Tcp->Flags & TCP_FLAG_RST) != 0) {
+      Step->Rst++;
+    } else if ((Parsed.Tcp->Flags & TCP_FLAG_SYN) != 0) {
+      Step->SynAck++;
+      //
+      // Tear down the half-open connection on the peer
+      //
+      RstLen = PktBuildTcpPacket (
+                 RstFrame, Io->SrcMac, DstMac,
+                 Config->LocalIp.Addr, Config->TargetIp.Addr,
+                 LocalPort, RemotePort,
+                 NTOHL (Parsed.Tcp->AckNumber), 0,
+                 TCP_FLAG_RST, 0, NULL, 0
+                 );
+      PktIoSend (Io, RstFrame, RstLen);
+    }
   }
+}
 
-  //
-  // Receive reply
-  //
-  ZeroMem (&RxToken, sizeof (RxToken));
-  Status = gBS->CreateEvent (
-                  EVT_NOTIFY_SIGNAL,
-                  TPL_CALLBACK,
-                  L4NotifyStub,
-                  NULL,
-                  &RxToken.Event
-                  );
+/**
+  Run the SYN rate staircase: each step sends SYNs paced at a fixed
+  rate for L4_SYN_STEP_MS, rotating over the target ports, then waits
+  L4_SYN_GRACE_MS for stragglers. Ramping stops once the answered ratio
+  drops below L4_SYN_STOP_PERMILLE.
+
+  @param[in]   Nic        NIC information.
+  @param[in]   Config     Test configuration.
+  @param[in]   PortFirst  First target port.
+  @param[in]   PortLast   Last target port (inclusive).
+  @param[out]  Stats      Results; Stats->Latency must be allocated.
+
+  @retval EFI_SUCCESS  Staircase completed.
+  @retval other        SNP unavailable or next hop unresolved.
+**/
+STATIC
+EFI_STATUS
+L4SynRateRun (
+  IN  NIC_INFO      *Nic,
+  IN  TEST_CONFIG   *Config,
+  IN  UINT16        PortFirst,
+  IN  UINT16        PortLast,
+  OUT L4_SYN_STATS  *Stats
+  )
+{
+  EFI_STATUS    Status;
+  PKT_IO        Io;
+  UINT8         DstMac[6];
+  UINT8         Frame[64];
+  UINTN         FrameLen;
+  UINT64        *SentUs;
+  UINT8         *Answered;
+  UINTN         S;
+  UINT32        Secret;
+  UINT32        Quota;
+  UINT32        Idx;
+  UINT32        IntervalUs;
+  UINT16        SrcPort;
+  UINT16        DstPort;
+  UINT64        StartUs;
+  UINT64        NowUs;
+  UINT64        NextUs;
+  UINT64        EndUs;
+  L4_SYN_STEP   *Step;
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
   if (EFI_ERROR (Status)) {
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
     return Status;
   }
 
-  RxToken.Status        = EFI_NOT_READY;
-  RxToken.Packet.RxData = NULL;
-
-  Status = Udp4->Receive (Udp4, &RxToken);
+  Status = PktIoResolveNextHop (
+             &Io,
+             Config->LocalIp.Addr,
+             Config->SubnetMask.Addr,
+             Config->Gateway.Addr,
+             Config->TargetIp.Addr,
+             DstMac
+             );
   if (EFI_ERROR (Status)) {
-    gBS->CloseEvent (RxToken.Event);
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    PktIoClose (&Io);
     return Status;
   }
 
-  {
-    EFI_EVENT  TimerEvent;
-    EFI_STATUS TimerStatus;
+  SentUs   = AllocateZeroPool (L4_SYN_MAX_PER_STEP * sizeof (UINT64));
+  Answered = AllocateZeroPool (L4_SYN_MAX_PER_STEP);
+  if (SentUs == NULL || Answered == NULL) {
+    if (SentUs != NULL) FreePool (SentUs);
+    if (Answered != NULL) FreePool (Answered);
+    PktIoClose (&Io);
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-    TimerEvent  = NULL;
-    TimerStatus = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &TimerEvent);
-    if (!EFI_ERROR (TimerStatus)) {
-      gBS->SetTimer (TimerEvent, TimerRelative, (UINT64)TimeoutMs * 10000);
+  Secret = (UINT32)UtilGetTimeUs ();
+
+  for (S = 0; S < L4_SYN_NUM_STEPS; S++) {
+    Step             = &Stats->Steps[S];
+    Step->TargetRate = mL4SynRates[S];
+    Stats->StepCount = S + 1;
+
+    Secret     = Secret * 1103515245 + 12345;
+    Quota      = MIN (mL4SynRates[S] * L4_SYN_STEP_MS / 1000, L4_SYN_MAX_PER_STEP);
+    IntervalUs = 1000000 / mL4SynRates[S];
+    ZeroMem (SentUs, L4_SYN_MAX_PER_STEP * sizeof (UINT64));
+    ZeroMem (Answered, L4_SYN_MAX_PER_STEP);
+
+    StartUs = UtilGetTimeUs ();
+    NextUs  = StartUs;
+    Idx     = 0;
+
+    //
+    // Paced send phase
+    //
+    while (Idx < Quota) {
+      NowUs = UtilGetTimeUs ();
+      if (NowUs >= NextUs) {
+        SrcPort = (UINT16)(L4_SYN_SRC_PORT_BASE + Idx);
+        DstPort = (UINT16)(PortFirst + Idx % ((UINT32)PortLast - PortFirst + 1));
+
+        FrameLen = PktBuildTcpPacket (
+                     Frame, Io.SrcMac, DstMac,
+                     Config->LocalIp.Addr, Config->TargetIp.Addr,
+                     SrcPort, DstPort,
+                     L4SynCookie (Secret, SrcPort, DstPort), 0,
+                     TCP_FLAG_SYN, 65535, NULL, 0
+                     );
+
+        SentUs[Idx] = UtilGetTimeUs ();
+        if (EFI_ERROR (PktIoSend (&Io, Frame, FrameLen))) {
+          SentUs[Idx] = 0;
+          Stats->TxErrors++;
+        } else {
+          Step->Sent++;
+        }
+        Idx++;
+        NextUs += IntervalUs;
+      }
+
+      L4SynDrain (&Io, Config, DstMac, Secret, SentUs, Answered, Step, Stats);
     }
 
-    while (RxToken.Status == EFI_NOT_READY) {
-      Udp4->Poll (Udp4);
-      if (TimerEvent != NULL && gBS->CheckEvent (TimerEvent) == EFI_SUCCESS) {
+    NowUs = UtilGetTimeUs ();
+    if (NowUs > StartUs) {
+      Step->SentRate = (UINT32)DivU64x64Remainder ((UINT64)Step->Sent * 1000000, NowUs - StartUs, NULL);
+    }
+
+    //
+    // Grace period for late replies
+    //
+    EndUs = NowUs + L4_SYN_GRACE_MS * 1000;
+    while (UtilGetTimeUs () < EndUs && Step->Answered < Step->Sent) {
+      L4SynDrain (&Io, Config, DstMac, Secret, SentUs, Answered, Step, Stats);
+      gBS->Stall (100);
+    }
+
+    if (Step->Sent > 0 &&
+        (UINT64)Step->Answered * 1000 >= (UINT64)Step->Sent * L4_SYN_GOOD_PERMILLE) {
+      Stats->SustainedRate = Step->SentRate;
+    }
+
+    if (Step->Sent == 0 ||
+        (UINT64)Step->Answered * 1000 < (UINT64)Step->Sent * L4_SYN_STOP_PERMILLE) {
+      break;
+    }
+  }
+
+  FreePool (SentUs);
+  FreePool (Answered);
+  PktIoClose (&Io);
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// Bulk TCP throughput engine (multiple outstanding IO tokens)
+// ============================================================
+//
+
+#define L4_BULK_SINK_PORT        5201     // default; the companion's PREPARE reply overrides
+#define L4_BULK_SOURCE_PORT      5202
+#define L4_BULK_MAX_TOKENS       8
+#define L4_BULK_FRAGS            4
+#define L4_BULK_FRAG_SIZE        16384    // 64 KB per token
+#define L4_BULK_DEFAULT_MS       5000
+#define L4_BULK_MAX_INTERVALS    30
+#define L4_BULK_STALL_MS         200      // no progress this long ~ RTO/retransmit
+#define L4_BULK_SOCK_BUF         (1024 * 1024)
+#define L4_BULK_SETTLE_MS        200      // companion records a session when it closes
+
+typedef struct {
+  EFI_TCP4_IO_TOKEN    Io;
+  VOID                 *Data;      // EFI_TCP4_TRANSMIT_DATA or EFI_TCP4_RECEIVE_DATA
+  UINT8                *RxBuf;
+  BOOLEAN              Pending;
+} L4_BULK_TOKEN;
+
+typedef struct {
+  UINT64      Bytes;
+  UINT64      ElapsedUs;
+  UINT32      IntervalMbpsX10[L4_BULK_MAX_INTERVALS];
+  UINTN       IntervalCount;
+  UINT32      Stalls;
+  UINT32      LongestStallMs;
+  UINT32      TokenErrors;
+  EFI_STATUS  EndStatus;
+} L4_BULK_STATS;
+
+/**
+  Post (or re-post) one bulk IO token.
+
+  @param[in]      Tcp4      Connected TCP4 instance.
+  @param[in,out]  Tok       Token to post.
+  @param[in]      Transmit  TRUE for Transmit, FALSE for Receive.
+
+  @retval EFI_SUCCESS  Token queued.
+  @retval other        Transmit/Receive refused it.
+**/
+STATIC
+EFI_STATUS
+L4BulkPost (
+  IN     EFI_TCP4_PROTOCOL  *Tcp4,
+  IN OUT L4_BULK_TOKEN      *Tok,
+  IN     BOOLEAN            Transmit
+  )
+{
+  EFI_STATUS             Status;
+  EFI_TCP4_RECEIVE_DATA  *RxData;
+  UINTN                  F;
+
+  Tok->Io.CompletionToken.Status = EFI_NOT_READY;
+
+  if (Transmit) {
+    Status = Tcp4->Transmit (Tcp4, &Tok->Io);
+  } else {
+    //
+    // Receive shrinks DataLength/FragmentLength on completion; restore
+    //
+    RxData = (EFI_TCP4_RECEIVE_DATA *)Tok->Data;
+    RxData->UrgentFlag    = FALSE;
+    RxData->DataLength    = L4_BULK_FRAGS * L4_BULK_FRAG_SIZE;
+    RxData->FragmentCount = L4_BULK_FRAGS;
+    for (F = 0; F < L4_BULK_FRAGS; F++) {
+      RxData->FragmentTable[F].FragmentLength = L4_BULK_FRAG_SIZE;
+      RxData->FragmentTable[F].FragmentBuffer = Tok->RxBuf + F * L4_BULK_FRAG_SIZE;
+    }
+    Status = Tcp4->Receive (Tcp4, &Tok->Io);
+  }
+
+  Tok->Pending = !EFI_ERROR (Status);
+  return Status;
+}
+
+/**
+  Stream over a connected TCP4 instance for DurationMs with TokenCount
+  IO tokens outstanding, sampling Mbps once per second and counting
+  stalls (L4_BULK_STALL_MS without any token completing while tokens
+  are outstanding) as the visible symptom of loss/retransmission.
+
+  @param[in]   Tcp4        Connected TCP4 instance.
+  @param[in]   Transmit    TRUE: send to sink. FALSE: receive from source.
+  @param[in]   TokenCount  Outstanding tokens (1..L4_BULK_MAX_TOKENS).
+  @param[in]   DurationMs  Streaming time.
+  @param[out]  Stats       Direction statistics.
+
+  @retval EFI_SUCCESS           Stream ran (see Stats->EndStatus).
+  @retval EFI_OUT_OF_RESOURCES  Token/buffer allocation failed.
+**/
+STATIC
+EFI_STATUS
+L4BulkStream (
+  IN  EFI_TCP4_PROTOCOL  *Tcp4,
+  IN  BOOLEAN            Transmit,
+  IN  UINTN              TokenCount,
+  IN  UINT32             DurationMs,
+  OUT L4_BULK_STATS      *Stats
+  )
+{
+  L4_BULK_TOKEN           Tokens[L4_BULK_MAX_TOKENS];
+  EFI_TCP4_TRANSMIT_DATA  *TxData;
+  EFI_TCP4_RECEIVE_DATA   *RxData;
+  UINT8                   *TxBuf;
+  UINTN                   DataSize;
+  UINTN                   T;
+  UINTN                   F;
+  UINTN                   Pending;
+  UINT64                  StartUs;
+  UINT64                  EndUs;
+  UINT64                  NowUs;
+  UINT64                  LastProgressUs;
+  UINT64                  IntervalStartUs;
+  UINT64                  IntervalBytes;
+  UINT32                  StallMs;
+  BOOLEAN                 InStall;
+  EFI_STATUS              Status;
+
+  ZeroMem (Stats, sizeof (L4_BULK_STATS));
+  ZeroMem (Tokens, sizeof (Tokens));
+  Stats->EndStatus = EFI_SUCCESS;
+
+  if (TokenCount == 0 || TokenCount > L4_BULK_MAX_TOKENS) {
+    TokenCount = L4_BULK_MAX_TOKENS;
+  }
+
+  //
+  // Transmit tokens share one read-only pattern buffer; receive tokens
+  // each get their own.
+  //
+  TxBuf = NULL;
+  if (Transmit) {
+    TxBuf = AllocatePool (L4_BULK_FRAGS * L4_BULK_FRAG_SIZE);
+    if (TxBuf == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    for (F = 0; F < L4_BULK_FRAGS * L4_BULK_FRAG_SIZE; F++) {
+      TxBuf[F] = (UINT8)(F & 0xFF);
+    }
+  }
+
+  DataSize = Transmit ?
+             sizeof (EFI_TCP4_TRANSMIT_DATA) + (L4_BULK_FRAGS - 1) * sizeof (EFI_TCP4_FRAGMENT_DATA) :
+             sizeof (EFI_TCP4_RECEIVE_DATA) + (L4_BULK_FRAGS - 1) * sizeof (EFI_TCP4_FRAGMENT_DATA);
+
+  Status = EFI_SUCCESS;
+  for (T = 0; T < TokenCount && !EFI_ERROR (Status); T++) {
+    Tokens[T].Data = AllocateZeroPool (DataSize);
+    if (Tokens[T].Data == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+
+    if (Transmit) {
+      TxData                = (EFI_TCP4_TRANSMIT_DATA *)Tokens[T].Data;
+      TxData->Push          = FALSE;
+      TxData->Urgent        = FALSE;
+      TxData->DataLength    = L4_BULK_FRAGS * L4_BULK_FRAG_SIZE;
+      TxData->FragmentCount = L4_BULK_FRAGS;
+      for (F = 0; F < L4_BULK_FRAGS; F++) {
+        TxData->FragmentTable[F].FragmentLength = L4_BULK_FRAG_SIZE;
+        TxData->FragmentTable[F].FragmentBuffer = TxBuf + F * L4_BULK_FRAG_SIZE;
+      }
+      Tokens[T].Io.Packet.TxData = TxData;
+    } else {
+      Tokens[T].RxBuf = AllocatePool (L4_BULK_FRAGS * L4_BULK_FRAG_SIZE);
+      if (Tokens[T].RxBuf == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
         break;
       }
-      gBS->Stall (1000);
+      Tokens[T].Io.Packet.RxData = (EFI_TCP4_RECEIVE_DATA *)Tokens[T].Data;
+    }
+
+    Status = gBS->CreateEvent (
+                    EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    L4NotifyStub,
+                    NULL,
+                    &Tokens[T].Io.CompletionToken.Event
+                    );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    StartUs         = UtilGetTimeUs ();
+    EndUs           = StartUs + (UINT64)DurationMs * 1000;
+    LastProgressUs  = StartUs;
+    IntervalStartUs = StartUs;
+    IntervalBytes   = 0;
+    InStall         = FALSE;
+
+    for (T = 0; T < TokenCount; T++) {
+      L4BulkPost (Tcp4, &Tokens[T], Transmit);
+    }
+
+    for (;;) {
+      Tcp4->Poll (Tcp4);
+      NowUs   = UtilGetTimeUs ();
+      Pending = 0;
+
+      for (T = 0; T < TokenCount; T++) {
+        if (!Tokens[T].Pending) {
+          continue;
+        }
+        if (Tokens[T].Io.CompletionToken.Status == EFI_NOT_READY) {
+          Pending++;
+          continue;
+        }
+
+        Tokens[T].Pending = FALSE;
+        if (EFI_ERROR (Tokens[T].Io.CompletionToken.Status)) {
+          Stats->TokenErrors++;
+          Stats->EndStatus = Tokens[T].Io.CompletionToken.Status;
+          continue;
+        }
+
+        if (Transmit) {
+          IntervalBytes += L4_BULK_FRAGS * L4_BULK_FRAG_SIZE;
+        } else {
+          IntervalBytes += ((EFI_TCP4_RECEIVE_DATA *)Tokens[T].Data)->DataLength;
+        }
+        LastProgressUs = NowUs;
+        InStall        = FALSE;
+
+        if (NowUs < EndUs && Stats->EndStatus == EFI_SUCCESS &&
+            !EFI_ERROR (L4BulkPost (Tcp4, &Tokens[T], Transmit))) {
+          Pending++;
+        }
+      }
+
+      //
+      // Stall detection: outstanding tokens but nothing completing
+      //
+      StallMs = (UINT32)((NowUs - LastProgressUs) / 1000);
+      if (Pending > 0 && StallMs >= L4_BULK_STALL_MS) {
+        if (!InStall) {
+          Stats->Stalls++;
+          InStall = TRUE;
+        }
+        if (StallMs > Stats->LongestStallMs) {
+          Stats->LongestStallMs = StallMs;
+        }
+      }
+
+      //
+      // Per-second interval sample
+      //
+      if (NowUs - IntervalStartUs >= 1000000 || (Pending == 0 && NowUs >= EndUs)) {
+        if (Stats->IntervalCount < L4_BULK_MAX_INTERVALS && NowUs > IntervalStartUs) {
+          Stats->IntervalMbpsX10[Stats->IntervalCount++] =
+            (UINT32)DivU64x64Remainder (IntervalBytes * 80, NowUs - IntervalStartUs, NULL);
+        }
+        Stats->Bytes   += IntervalBytes;
+        IntervalBytes   = 0;
+        IntervalStartUs = NowUs;
+      }
+
+      if (Pending == 0 && (NowUs >= EndUs || Stats->EndStatus != EFI_SUCCESS)) {
+        break;
+      }
+
+      //
+      // Receive side cannot drain on its own: stop at the deadline.
+      // Transmit side gets up to 2 s to flush what was queued.
+      //
+      if (NowUs >= EndUs + (Transmit ? 2000000 : 0)) {
+        break;
+      }
+    }
+
+    Stats->Bytes    += IntervalBytes;
+    Stats->ElapsedUs = UtilGetTimeUs () - StartUs;
+  }
+
+  //
+  // Cancel anything still queued; tokens are released after the caller
+  // aborts/destroys the instance, which flushes them.
+  //
+  for (T = 0; T < TokenCount; T++) {
+    if (Tokens[T].Pending && Tokens[T].Io.CompletionToken.Status == EFI_NOT_READY) {
+      Tcp4->Cancel (Tcp4, &Tokens[T].Io.CompletionToken);
+    }
+  }
+  Tcp4->Poll (Tcp4);
+
+  if (!Transmit || Stats->EndStatus != EFI_SUCCESS) {
+    L4TcpAbort (Tcp4);
+  } else {
+    L4TcpClose (Tcp4, 2000);
+  }
+  Tcp4->Configure (Tcp4, NULL);
+
+  for (T = 0; T < TokenCount; T++) {
+    if (Tokens[T].Io.CompletionToken.Event != NULL) {
+      gBS->CloseEvent (Tokens[T].Io.CompletionToken.Event);
+    }
+    if (Tokens[T].Data != NULL) {
+      FreePool (Tokens[T].Data);
     }
+    if (Tokens[T].RxBuf != NULL) {
+      FreePool (Tokens[T].RxBuf);
+    }
+  }
+  if (TxBuf != NULL) {
+    FreePool (TxBuf);
+  }
+
+  return Status;
+}
+
+/**
+  Connect to a companion bulk endpoint with large socket buffers and
+  window scaling, then stream in one direction.
+
+  @param[in]   Nic         NIC information.
+  @param[in]   Config      Test configuration.
+  @param[in]   Transmit    TRUE: send to the sink. FALSE: read from the source.
+  @param[in]   Port        Companion sink or source port.
+  @param[in]   DurationMs  Streaming time.
+  @param[out]  Stats       Direction statistics.
+
+  @retval EFI_SUCCESS  Stream completed (see Stats).
+  @retval other        Child creation or connect failed.
+**/
+STATIC
+EFI_STATUS
+L4BulkRun (
+  IN  NIC_INFO       *Nic,
+  IN  TEST_CONFIG    *Config,
+  IN  BOOLEAN        Transmit,
+  IN  UINT16         Port,
+  IN  UINT32         DurationMs,
+  OUT L4_BULK_STATS  *Stats
+  )
+{
+  EFI_STATUS         Status;
+  EFI_HANDLE         ChildHandle;
+  EFI_TCP4_PROTOCOL  *Tcp4;
+  EFI_TCP4_OPTION    Option;
+
+  ZeroMem (Stats, sizeof (L4_BULK_STATS));
+
+  ZeroMem (&Option, sizeof (Option));
+  Option.ReceiveBufferSize   = L4_BULK_SOCK_BUF;
+  Option.SendBufferSize      = L4_BULK_SOCK_BUF;
+  Option.MaxSynBackLog       = 0;
+  Option.ConnectionTimeout   = 0;
+  Option.DataRetries         = 12;
+  Option.FinTimeout          = 0;
+  Option.TimeWaitTimeout     = 0;
+  Option.KeepAliveProbes     = 0;
+  Option.KeepAliveTime       = 0;
+  Option.KeepAliveInterval   = 0;
+  Option.EnableNagle         = FALSE;
+  Option.EnableTimeStamp     = TRUE;
+  Option.EnableWindowScaling = TRUE;
+  Option.EnableSelectiveAck  = FALSE;
+  Option.EnablePathMtuDiscovery = FALSE;
+
+  Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = L4TcpConnect (
+             Tcp4,
+             &Config->LocalIp,
+             &Config->TargetIp,
+             &Config->SubnetMask,
+             0,
+             Port,
+             3000,
+             &Option
+             );
+  if (!EFI_ERROR (Status)) {
+    Status = L4BulkStream (Tcp4, Transmit, L4_BULK_MAX_TOKENS, DurationMs, Stats);
+  }
+
+  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  return Status;
+}
+
+/**
+  Append "x.y,x.y,..." interval Mbps list to a string.
+
+  @param[in]      Stats   Direction statistics.
+  @param[in,out]  Buf     Destination (appended to).
+  @param[in]      BufSize Destination size in bytes.
+**/
+STATIC
+VOID
+L4BulkFormatIntervals (
+  IN     L4_BULK_STATS  *Stats,
+  IN OUT CHAR16         *Buf,
+  IN     UINTN          BufSize
+  )
+{
+  UINTN  I;
+  UINTN  Pos;
+
+  Pos = StrLen (Buf);
+  for (I = 0; I < Stats->IntervalCount && (Pos + 10) * sizeof (CHAR16) < BufSize; I++) {
+    UnicodeSPrint (&Buf[Pos], BufSize - Pos * sizeof (CHAR16),
+                   I == 0 ? L"%d.%d" : L",%d.%d",
+                   Stats->IntervalMbpsX10[I] / 10, Stats->IntervalMbpsX10[I] % 10);
+    Pos += StrLen (&Buf[Pos]);
+  }
+}
+
+//
+// ============================================================
+// UDP4 helper functions
+// ============================================================
+//
+
+/**
+  Create a UDP4 child, configure, send a datagram, and optionally wait for a reply.
+  All-in-one helper for UDP tests.
+
+  @param[in]  NicHandle   NIC handle with UDP4 service binding.
+  @param[in]  LocalIp     Local IP address.
+  @param[in]  RemoteIp    Remote IP address.
+  @param[in]  SubnetMask  Subnet mask.
+  @param[in]  LocalPort   Local UDP port.
+  @param[in]  RemotePort  Remote UDP port.
+  @param[in]  SendData    Data to send.
+  @param[in]  SendLen     Send data length.
+  @param[out] RecvBuf     Buffer for received reply (may be NULL).
+  @param[in]  RecvBufSize Receive buffer size.
+  @param[out] RecvLen     Actual received bytes (may be NULL).
+  @param[in]  TimeoutMs   Timeout for send+receive.
+
+  @retval EFI_SUCCESS   Send (and optional receive) succeeded.
+  @retval EFI_TIMEOUT   No reply within timeout.
+  @retval other         Protocol error.
+**/
+STATIC
+EFI_STATUS
+L4UdpSendRecv (
+  IN  EFI_HANDLE         NicHandle,
+  IN  EFI_IPv4_ADDRESS   *LocalIp,
+  IN  EFI_IPv4_ADDRESS   *RemoteIp,
+  IN  EFI_IPv4_ADDRESS   *SubnetMask,
+  IN  UINT16             LocalPort,
+  IN  UINT16             RemotePort,
+  IN  CONST VOID         *SendData,
+  IN  UINT32             SendLen,
+  OUT VOID               *RecvBuf       OPTIONAL,
+  IN  UINT32             RecvBufSize    OPTIONAL,
+  OUT UINT32             *RecvLen       OPTIONAL,
+  IN  UINT32             TimeoutMs
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_SERVICE_BINDING_PROTOCOL  *UdpSb;
+  EFI_HANDLE                    ChildHandle;
+  EFI_UDP4_PROTOCOL             *Udp4;
+  EFI_UDP4_CONFIG_DATA          UdpConfig;
+  EFI_UDP4_COMPLETION_TOKEN     TxToken;
+  EFI_UDP4_TRANSMIT_DATA        TxData;
+  EFI_UDP4_COMPLETION_TOKEN     RxToken;
+  BOOLEAN                       DoReceive;
+
+  if (RecvLen != NULL) {
+    *RecvLen = 0;
+  }
+
+  DoReceive = (RecvBuf != NULL && RecvBufSize > 0);
+
+  //
+  // Create UDP4 child
+  //
+  ChildHandle = NULL;
+  Udp4        = NULL;
+
+  Status = gBS->HandleProtocol (
+                  NicHandle,
+                  &gEfiUdp4ServiceBindingProtocolGuid,
+                  (VOID **)&UdpSb
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = UdpSb->CreateChild (UdpSb, &ChildHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (
+                  ChildHandle,
+                  &gEfiUdp4ProtocolGuid,
+                  (VOID **)&Udp4
+                  );
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  //
+  // Configure
+  //
+  ZeroMem (&UdpConfig, sizeof (UdpConfig));
+  UdpConfig.AcceptBroadcast    = FALSE;
+  UdpConfig.AcceptPromiscuous  = FALSE;
+  UdpConfig.AcceptAnyPort      = FALSE;
+  UdpConfig.AllowDuplicatePort = TRUE;
+  UdpConfig.TimeToLive         = 64;
+  UdpConfig.DoNotFragment      = FALSE;
+  UdpConfig.UseDefaultAddress  = FALSE;
+
+  CopyMem (&UdpConfig.StationAddress, LocalIp, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&UdpConfig.SubnetMask, SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.StationPort = LocalPort;
+  CopyMem (&UdpConfig.RemoteAddress, RemoteIp, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.RemotePort = RemotePort;
+
+  Status = Udp4->Configure (Udp4, &UdpConfig);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  //
+  // Send
+  //
+  ZeroMem (&TxData, sizeof (TxData));
+  TxData.UdpSessionData                = NULL;
+  TxData.GatewayAddress                = NULL;
+  TxData.DataLength                    = SendLen;
+  TxData.FragmentCount                 = 1;
+  TxData.FragmentTable[0].FragmentLength = SendLen;
+  TxData.FragmentTable[0].FragmentBuffer = (VOID *)SendData;
+
+  ZeroMem (&TxToken, sizeof (TxToken));
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  L4NotifyStub,
+                  NULL,
+                  &TxToken.Event
+                  );
+  if (EFI_ERROR (Status)) {
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  TxToken.Status        = EFI_NOT_READY;
+  TxToken.Packet.TxData = &TxData;
+
+  Status = Udp4->Transmit (Udp4, &TxToken);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (TxToken.Event);
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  //
+  // Wait for TX completion (timer-based)
+  //
+  {
+    EFI_EVENT  TimerEvent;
+    EFI_STATUS TimerStatus;
+
+    TimerEvent  = NULL;
+    TimerStatus = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &TimerEvent);
+    if (!EFI_ERROR (TimerStatus)) {
+      gBS->SetTimer (TimerEvent, TimerRelative, (UINT64)TimeoutMs * 10000);
+    }
+
+    while (TxToken.Status == EFI_NOT_READY) {
+      Udp4->Poll (Udp4);
+      if (TimerEvent != NULL && gBS->CheckEvent (TimerEvent) == EFI_SUCCESS) {
+        break;
+      }
+      gBS->Stall (1000);
+    }
+
+    if (TimerEvent != NULL) {
+      gBS->CloseEvent (TimerEvent);
+    }
+  }
+
+  if (TxToken.Status == EFI_NOT_READY) {
+    Udp4->Cancel (Udp4, &TxToken);
+    gBS->CloseEvent (TxToken.Event);
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return EFI_TIMEOUT;
+  }
+
+  Status = TxToken.Status;
+  gBS->CloseEvent (TxToken.Event);
+
+  if (EFI_ERROR (Status) || !DoReceive) {
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  //
+  // Receive reply
+  //
+  ZeroMem (&RxToken, sizeof (RxToken));
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  L4NotifyStub,
+                  NULL,
+                  &RxToken.Event
+                  );
+  if (EFI_ERROR (Status)) {
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  RxToken.Status        = EFI_NOT_READY;
+  RxToken.Packet.RxData = NULL;
+
+  Status = Udp4->Receive (Udp4, &RxToken);
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (RxToken.Event);
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  {
+    EFI_EVENT  TimerEvent;
+    EFI_STATUS TimerStatus;
+
+    TimerEvent  = NULL;
+    TimerStatus = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &TimerEvent);
+    if (!EFI_ERROR (TimerStatus)) {
+      gBS->SetTimer (TimerEvent, TimerRelative, (UINT64)TimeoutMs * 10000);
+    }
+
+    while (RxToken.Status == EFI_NOT_READY) {
+      Udp4->Poll (Udp4);
+      if (TimerEvent != NULL && gBS->CheckEvent (TimerEvent) == EFI_SUCCESS) {
+        break;
+      }
+      gBS->Stall (1000);
+    }
+
+    if (TimerEvent != NULL) {
+      gBS->CloseEvent (TimerEvent);
+    }
+  }
+
+  if (RxToken.Status == EFI_NOT_READY) {
+    Udp4->Cancel (Udp4, &RxToken);
+    gBS->CloseEvent (RxToken.Event);
+    Udp4->Configure (Udp4, NULL);
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return EFI_TIMEOUT;
+  }
+
+  Status = RxToken.Status;
+  if (!EFI_ERROR (Status) && RxToken.Packet.RxData != NULL) {
+    UINT32  CopyLen;
+    UINT32  I;
+    UINT32  Offset;
+
+    Offset = 0;
+    for (I = 0; I < RxToken.Packet.RxData->FragmentCount; I++) {
+      CopyLen = RxToken.Packet.RxData->FragmentTable[I].FragmentLength;
+      if (Offset + CopyLen > RecvBufSize) {
+        CopyLen = RecvBufSize - Offset;
+      }
+      if (CopyLen > 0) {
+        CopyMem (
+          (UINT8 *)RecvBuf + Offset,
+          RxToken.Packet.RxData->FragmentTable[I].FragmentBuffer,
+          CopyLen
+          );
+        Offset += CopyLen;
+      }
+    }
+
+    if (RecvLen != NULL) {
+      *RecvLen = Offset;
+    }
+
+    gBS->SignalEvent (RxToken.Packet.RxData->RecycleSignal);
+  }
+
+  gBS->CloseEvent (RxToken.Event);
+  Udp4->Configure (Udp4, NULL);
+  UdpSb->DestroyChild (UdpSb, ChildHandle);
+  return Status;
+}
+
+//
+// ============================================================
+// UDP throughput engine (sequence-numbered datagrams)
+// ============================================================
+//
+
+#define L4_UDPT_ECHO_PORT      5000     // companion udp_echo; accounts, does not echo
+#define L4_UDPT_LOCAL_PORT     50100
+#define L4_UDPT_MAX_TOKENS     16
+#define L4_UDPT_DEFAULT_SIZE   1472     // fills a 1500-byte MTU without fragmenting
+#define L4_UDPT_MAX_SIZE       8972     // 9000-byte jumbo MTU
+#define L4_UDPT_DEFAULT_MS     5000
+#define L4_UDPT_DRAIN_MS       500      // let the companion read its socket backlog
+#define L4_UDPT_LOSS_WARN_PERMILLE  10  // > 1.0% loss downgrades PASS to WARN
+
+//
+// Datagram header, big-endian. The companion keys on the magic, so the
+// rest of the payload is an arbitrary pattern.
+//
+#pragma pack(1)
+typedef struct {
+  CHAR8     Magic[8];                   // "DDTUDPT|"
+  UINT32    RunId;
+  UINT32    Seq;
+} L4_UDPT_HEADER;
+#pragma pack()
+
+typedef struct {
+  EFI_UDP4_COMPLETION_TOKEN  Tok;
+  EFI_UDP4_TRANSMIT_DATA     TxData;
+  UINT8                      *Buf;
+  BOOLEAN                    Pending;
+} L4_UDPT_TOKEN;
+
+typedef struct {
+  UINT64      Posted;                   // sequence numbers handed to Transmit
+  UINT64      Sent;                     // completed without error
+  UINT64      Bytes;
+  UINT64      ElapsedUs;
+  UINT32      TxErrors;
+  UINT32      Backpressure;             // Transmit refused with NOT_READY/OUT_OF_RESOURCES
+  EFI_STATUS  EndStatus;
+} L4_UDPT_STATS;
+
+/**
+  Blast sequence-numbered datagrams to the companion for DurationMs,
+  keeping L4_UDPT_MAX_TOKENS Transmit tokens outstanding so the UDP4
+  driver always has queued work.
+
+  @param[in]   Nic           NIC under test.
+  @param[in]   Config        Test configuration (LocalIp/TargetIp/SubnetMask).
+  @param[in]   Port          Companion UDP port.
+  @param[in]   RunId         Value stamped in every header.
+  @param[in]   DatagramSize  UDP payload size, >= sizeof (L4_UDPT_HEADER).
+  @param[in]   DurationMs    Sending time.
+  @param[out]  Stats         Sender statistics.
+
+  @retval EFI_SUCCESS           Run completed (see Stats).
+  @retval EFI_OUT_OF_RESOURCES  Buffer allocation failed.
+  @retval other                 UDP4 child setup failed.
+**/
+STATIC
+EFI_STATUS
+L4UdptSend (
+  IN  NIC_INFO       *Nic,
+  IN  TEST_CONFIG    *Config,
+  IN  UINT16         Port,
+  IN  UINT32         RunId,
+  IN  UINT32         DatagramSize,
+  IN  UINT32         DurationMs,
+  OUT L4_UDPT_STATS  *Stats
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_SERVICE_BINDING_PROTOCOL  *UdpSb;
+  EFI_HANDLE                    ChildHandle;
+  EFI_UDP4_PROTOCOL             *Udp4;
+  EFI_UDP4_CONFIG_DATA          UdpConfig;
+  L4_UDPT_TOKEN                 Tokens[L4_UDPT_MAX_TOKENS];
+  L4_UDPT_HEADER                *Hdr;
+  UINT32                        NextSeq;
+  UINT64                        StartUs;
+  UINT64                        EndUs;
+  UINT64                        NowUs;
+  UINT64                        LastDoneUs;
+  UINTN                         Idx;
+  UINTN                         J;
+  UINTN                         PendingCount;
+
+  ZeroMem (Stats, sizeof (L4_UDPT_STATS));
+  ZeroMem (Tokens, sizeof (Tokens));
+  Stats->EndStatus = EFI_SUCCESS;
+
+  Status = gBS->HandleProtocol (
+                  Nic->Handle,
+                  &gEfiUdp4ServiceBindingProtocolGuid,
+                  (VOID **)&UdpSb
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ChildHandle = NULL;
+  Status = UdpSb->CreateChild (UdpSb, &ChildHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (ChildHandle, &gEfiUdp4ProtocolGuid, (VOID **)&Udp4);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  ZeroMem (&UdpConfig, sizeof (UdpConfig));
+  UdpConfig.AllowDuplicatePort = TRUE;
+  UdpConfig.TimeToLive         = 64;
+  UdpConfig.DoNotFragment      = FALSE;
+  UdpConfig.UseDefaultAddress  = FALSE;
+  CopyMem (&UdpConfig.StationAddress, &Config->LocalIp, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&UdpConfig.SubnetMask, &Config->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.StationPort = L4_UDPT_LOCAL_PORT;
+  CopyMem (&UdpConfig.RemoteAddress, &Config->TargetIp, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.RemotePort  = Port;
+
+  Status = Udp4->Configure (Udp4, &UdpConfig);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  //
+  // One buffer per token: a queued datagram's bytes must stay untouched
+  // until its token completes.
+  //
+  for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+    Tokens[Idx].Buf = AllocatePool (DatagramSize);
+    if (Tokens[Idx].Buf == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      goto Cleanup;
+    }
+    for (J = sizeof (L4_UDPT_HEADER); J < DatagramSize; J++) {
+      Tokens[Idx].Buf[J] = (UINT8)J;
+    }
+    Hdr = (L4_UDPT_HEADER *)Tokens[Idx].Buf;
+    CopyMem (Hdr->Magic, "DDTUDPT|", sizeof (Hdr->Magic));
+    Hdr->RunId = SwapBytes32 (RunId);
+
+    Tokens[Idx].TxData.DataLength                    = DatagramSize;
+    Tokens[Idx].TxData.FragmentCount                 = 1;
+    Tokens[Idx].TxData.FragmentTable[0].FragmentLength = DatagramSize;
+    Tokens[Idx].TxData.FragmentTable[0].FragmentBuffer = Tokens[Idx].Buf;
+    Tokens[Idx].Tok.Packet.TxData                    = &Tokens[Idx].TxData;
+
+    Status = gBS->CreateEvent (
+                    EVT_NOTIFY_SIGNAL,
+                    TPL_CALLBACK,
+                    L4NotifyStub,
+                    NULL,
+                    &Tokens[Idx].Tok.Event
+                    );
+    if (EFI_ERROR (Status)) {
+      goto Cleanup;
+    }
+  }
+
+  NextSeq    = 0;
+  StartUs    = UtilGetTimeUs ();
+  EndUs      = StartUs + (UINT64)DurationMs * 1000;
+  LastDoneUs = StartUs;
+  NowUs      = StartUs;
+
+  while (NowUs < EndUs) {
+    //
+    // Refill every idle token; stop refilling on driver back-pressure
+    //
+    for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+      if (Tokens[Idx].Pending) {
+        continue;
+      }
+      Hdr      = (L4_UDPT_HEADER *)Tokens[Idx].Buf;
+      Hdr->Seq = SwapBytes32 (NextSeq);
+      Tokens[Idx].Tok.Status = EFI_NOT_READY;
+
+      Status = Udp4->Transmit (Udp4, &Tokens[Idx].Tok);
+      if (!EFI_ERROR (Status)) {
+        Tokens[Idx].Pending = TRUE;
+        NextSeq++;
+        Stats->Posted++;
+      } else if (Status == EFI_NOT_READY || Status == EFI_OUT_OF_RESOURCES) {
+        Stats->Backpressure++;
+        break;
+      } else {
+        Stats->TxErrors++;
+        Stats->EndStatus = Status;
+        break;
+      }
+    }
+
+    Udp4->Poll (Udp4);
+    NowUs = UtilGetTimeUs ();
+
+    for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+      if (!Tokens[Idx].Pending || Tokens[Idx].Tok.Status == EFI_NOT_READY) {
+        continue;
+      }
+      Tokens[Idx].Pending = FALSE;
+      if (EFI_ERROR (Tokens[Idx].Tok.Status)) {
+        Stats->TxErrors++;
+        Stats->EndStatus = Tokens[Idx].Tok.Status;
+      } else {
+        Stats->Sent++;
+        Stats->Bytes += DatagramSize;
+        LastDoneUs    = NowUs;
+      }
+    }
+
+    //
+    // A hard Transmit error will not clear by retrying
+    //
+    if (EFI_ERROR (Stats->EndStatus) && Stats->Sent == 0 && Stats->TxErrors >= L4_UDPT_MAX_TOKENS) {
+      break;
+    }
+  }
+
+  //
+  // Let queued datagrams leave, then give up on the rest (up to 1 s)
+  //
+  EndUs = UtilGetTimeUs () + 1000000;
+  do {
+    Udp4->Poll (Udp4);
+    NowUs        = UtilGetTimeUs ();
+    PendingCount = 0;
+    for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+      if (!Tokens[Idx].Pending) {
+        continue;
+      }
+      if (Tokens[Idx].Tok.Status == EFI_NOT_READY) {
+        PendingCount++;
+        continue;
+      }
+      Tokens[Idx].Pending = FALSE;
+      if (EFI_ERROR (Tokens[Idx].Tok.Status)) {
+        Stats->TxErrors++;
+      } else {
+        Stats->Sent++;
+        Stats->Bytes += DatagramSize;
+        LastDoneUs    = NowUs;
+      }
+    }
+  } while (PendingCount > 0 && NowUs < EndUs);
+
+  Stats->ElapsedUs = LastDoneUs - StartUs;
+  Status           = EFI_SUCCESS;
+
+Cleanup:
+  for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+    if (Tokens[Idx].Pending) {
+      Udp4->Cancel (Udp4, &Tokens[Idx].Tok);
+    }
+  }
+  Udp4->Configure (Udp4, NULL);
+  UdpSb->DestroyChild (UdpSb, ChildHandle);
+
+  for (Idx = 0; Idx < L4_UDPT_MAX_TOKENS; Idx++) {
+    if (Tokens[Idx].Tok.Event != NULL) {
+      gBS->CloseEvent (Tokens[Idx].Tok.Event);
+    }
+    if (Tokens[Idx].Buf != NULL) {
+      FreePool (Tokens[Idx].Buf);
+    }
+  }
+
+  return Status;
+}
+
+//
+// ============================================================
+// UDP latency engine (companion residence time subtracted)
+// ============================================================
+//
+
+#define L4_LAT_ECHO_PORT       5000     // companion udp_echo
+#define L4_LAT_LOCAL_PORT      50200
+#define L4_LAT_DEFAULT_PROBES  200
+#define L4_LAT_MAX_PROBES      2000
+#define L4_LAT_PROBE_SIZE      64
+#define L4_LAT_TIMEOUT_US      200000   // per probe
+#define L4_LAT_GAP_US          1000     // minimum probe period
+
+//
+// Probe header, big-endian. The companion echoes the datagram with
+// ResidenceNs filled in: its kernel RX timestamp to the reply send.
+//
+#pragma pack(1)
+typedef struct {
+  CHAR8     Magic[8];                   // "DDTLATE|"
+  UINT32    Seq;
+  UINT32    ResidenceNs;
+} L4_LAT_HEADER;
+#pragma pack()
+
+typedef struct {
+  UINT32    *RttUs;                     // answered probes: raw RTT
+  UINT32    *NetUs;                     // answered probes: RTT - residence
+  UINTN     Answered;
+  UINTN     Lost;
+  UINTN     Stale;                      // late replies to earlier probes
+  UINTN     WithResidence;              // replies carrying a residence time
+  UINT64    ResidenceNsSum;
+  UINT32    ResidenceNsMax;
+} L4_LAT_STATS;
+
+/**
+  Send Probes latency probes one at a time to the companion's UDP echo
+  and time each reply by polling the UDP4 child without stalling.
+
+  @param[in]   Nic     NIC under test.
+  @param[in]   Config  Test configuration (LocalIp/TargetIp/SubnetMask).
+  @param[in]   Port    Companion UDP port.
+  @param[in]   Probes  Number of probes; Stats arrays hold this many.
+  @param[out]  Stats   Results; RttUs and NetUs must be allocated.
+
+  @retval EFI_SUCCESS  Run completed (see Stats).
+  @retval other        UDP4 child setup failed.
+**/
+STATIC
+EFI_STATUS
+L4LatencyRun (
+  IN  NIC_INFO       *Nic,
+  IN  TEST_CONFIG    *Config,
+  IN  UINT16         Port,
+  IN  UINTN          Probes,
+  OUT L4_LAT_STATS   *Stats
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_SERVICE_BINDING_PROTOCOL  *UdpSb;
+  EFI_HANDLE                    ChildHandle;
+  EFI_UDP4_PROTOCOL             *Udp4;
+  EFI_UDP4_CONFIG_DATA          UdpConfig;
+  EFI_UDP4_COMPLETION_TOKEN     TxToken;
+  EFI_UDP4_TRANSMIT_DATA        TxData;
+  EFI_UDP4_COMPLETION_TOKEN     RxToken;
+  EFI_UDP4_RECEIVE_DATA         *RxData;
+  UINT8                         TxBuf[L4_LAT_PROBE_SIZE];
+  L4_LAT_HEADER                 Reply;
+  L4_LAT_HEADER                 *Hdr;
+  UINT64                        SentUs;
+  UINT64                        NowUs;
+  UINT32                        ResNs;
+  UINT32                        RttUs;
+  UINTN                         Seq;
+  UINTN                         J;
+  BOOLEAN                       Done;
+
+  Stats->Answered       = 0;
+  Stats->Lost           = 0;
+  Stats->Stale          = 0;
+  Stats->WithResidence  = 0;
+  Stats->ResidenceNsSum = 0;
+  Stats->ResidenceNsMax = 0;
+
+  Status = gBS->HandleProtocol (
+                  Nic->Handle,
+                  &gEfiUdp4ServiceBindingProtocolGuid,
+                  (VOID **)&UdpSb
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ChildHandle = NULL;
+  Status = UdpSb->CreateChild (UdpSb, &ChildHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (ChildHandle, &gEfiUdp4ProtocolGuid, (VOID **)&Udp4);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  ZeroMem (&UdpConfig, sizeof (UdpConfig));
+  UdpConfig.AllowDuplicatePort = TRUE;
+  UdpConfig.TimeToLive         = 64;
+  UdpConfig.DoNotFragment      = FALSE;
+  UdpConfig.UseDefaultAddress  = FALSE;
+  CopyMem (&UdpConfig.StationAddress, &Config->LocalIp, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&UdpConfig.SubnetMask, &Config->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.StationPort = L4_LAT_LOCAL_PORT;
+  CopyMem (&UdpConfig.RemoteAddress, &Config->TargetIp, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.RemotePort  = Port;
+
+  Status = Udp4->Configure (Udp4, &UdpConfig);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  ZeroMem (&TxToken, sizeof (TxToken));
+  ZeroMem (&RxToken, sizeof (RxToken));
+  Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L4NotifyStub, NULL, &TxToken.Event);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L4NotifyStub, NULL, &RxToken.Event);
+  }
+  if (EFI_ERROR (Status)) {
+    goto Cleanup;
+  }
+
+  for (J = sizeof (L4_LAT_HEADER); J < sizeof (TxBuf); J++) {
+    TxBuf[J] = (UINT8)J;
+  }
+  Hdr = (L4_LAT_HEADER *)TxBuf;
+  CopyMem (Hdr->Magic, "DDTLATE|", sizeof (Hdr->Magic));
+  Hdr->ResidenceNs = 0;
+
+  ZeroMem (&TxData, sizeof (TxData));
+  TxData.DataLength                      = sizeof (TxBuf);
+  TxData.FragmentCount                   = 1;
+  TxData.FragmentTable[0].FragmentLength = sizeof (TxBuf);
+  TxData.FragmentTable[0].FragmentBuffer = TxBuf;
+  TxToken.Packet.TxData                  = &TxData;
+
+  //
+  // One Receive token stays posted so a reply is never held up by a
+  // missing buffer; it is re-posted as soon as a datagram is consumed
+  //
+  RxToken.Status = EFI_NOT_READY;
+  Status = Udp4->Receive (Udp4, &RxToken);
+  if (EFI_ERROR (Status)) {
+    goto Cleanup;
+  }
+
+  for (Seq = 0; Seq < Probes; Seq++) {
+    Hdr->Seq       = SwapBytes32 ((UINT32)Seq);
+    TxToken.Status = EFI_NOT_READY;
+    SentUs         = UtilGetTimeUs ();
+    Status         = Udp4->Transmit (Udp4, &TxToken);
+    if (EFI_ERROR (Status)) {
+      Stats->Lost++;
+      continue;
+    }
+
+    Done = FALSE;
+    do {
+      Udp4->Poll (Udp4);
+      NowUs = UtilGetTimeUs ();
+
+      if (RxToken.Status == EFI_NOT_READY) {
+        continue;
+      }
+
+      RxData = RxToken.Packet.RxData;
+      if (!EFI_ERROR (RxToken.Status) && RxData != NULL) {
+        ZeroMem (&Reply, sizeof (Reply));
+        if (RxData->DataLength >= sizeof (Reply) && RxData->FragmentCount > 0 &&
+            RxData->FragmentTable[0].FragmentLength >= sizeof (Reply)) {
+          CopyMem (&Reply, RxData->FragmentTable[0].FragmentBuffer, sizeof (Reply));
+        }
+        gBS->SignalEvent (RxData->RecycleSignal);
+
+        if (CompareMem (Reply.Magic, "DDTLATE|", sizeof (Reply.Magic)) == 0) {
+          if (SwapBytes32 (Reply.Seq) == (UINT32)Seq) {
+            RttUs = (UINT32)(NowUs - SentUs);
+            ResNs = SwapBytes32 (Reply.ResidenceNs);
+            Stats->RttUs[Stats->Answered] = RttUs;
+            Stats->NetUs[Stats->Answered] = (ResNs / 1000 < RttUs) ? RttUs - ResNs / 1000 : 0;
+            Stats->Answered++;
+            if (ResNs > 0) {
+              Stats->WithResidence++;
+              Stats->ResidenceNsSum += ResNs;
+              Stats->ResidenceNsMax  = MAX (Stats->ResidenceNsMax, ResNs);
+            }
+            Done = TRUE;
+          } else {
+            Stats->Stale++;
+          }
+        }
+      }
+
+      RxToken.Status        = EFI_NOT_READY;
+      RxToken.Packet.RxData = NULL;
+      if (EFI_ERROR (Udp4->Receive (Udp4, &RxToken))) {
+        Status = EFI_DEVICE_ERROR;
+        goto Cleanup;
+      }
+    } while (!Done && NowUs - SentUs < L4_LAT_TIMEOUT_US);
+
+    if (!Done) {
+      Stats->Lost++;
+    }
+
+    //
+    // The transmit must have completed before its buffer is rewritten
+    //
+    while (TxToken.Status == EFI_NOT_READY && UtilGetTimeUs () - SentUs < L4_LAT_TIMEOUT_US) {
+      Udp4->Poll (Udp4);
+    }
+    if (TxToken.Status == EFI_NOT_READY) {
+      Udp4->Cancel (Udp4, &TxToken);
+    }
+
+    while (UtilGetTimeUs () - SentUs < L4_LAT_GAP_US) {
+      Udp4->Poll (Udp4);
+    }
+  }
+  Status = EFI_SUCCESS;
+
+Cleanup:
+  if (RxToken.Event != NULL) {
+    if (RxToken.Status == EFI_NOT_READY) {
+      Udp4->Cancel (Udp4, &RxToken);
+    }
+    gBS->CloseEvent (RxToken.Event);
+  }
+  if (TxToken.Event != NULL) {
+    gBS->CloseEvent (TxToken.Event);
+  }
+  Udp4->Configure (Udp4, NULL);
+  UdpSb->DestroyChild (UdpSb, ChildHandle);
+  return Status;
+}
+
+//
+// ============================================================
+// One-way delay engine (clock offset over the control channel)
+// ============================================================
+//
+
+#define L4_OWD_ECHO_PORT        5000     // companion udp_echo
+#define L4_OWD_LOCAL_PORT       50201
+#define L4_OWD_DEFAULT_PROBES   500
+#define L4_OWD_MAX_PROBES       4000
+#define L4_OWD_PROBE_SIZE       64
+#define L4_OWD_DEFAULT_PPS      100
+#define L4_OWD_MAX_PPS          1000     // stop-and-wait, one probe in flight
+#define L4_OWD_TIMEOUT_US       200000   // per probe
+#define L4_OWD_SYNC_ROUNDS      16
+#define L4_OWD_SYNC_TIMEOUT_MS  200
+#define L4_OWD_SYNC_GAP_US      2000
+#define L4_OWD_MAX_UNCERT_US    250      // offset error bound for a PASS
+
+//
+// Probe header, big-endian. The DUT stamps its send time; the companion
+// echoes the datagram with its CLOCK_MONOTONIC arrival and send times.
+//
+#pragma pack(1)
+typedef struct {
+  CHAR8     Magic[8];                   // "DDTOWDP|"
+  UINT32    Seq;
+  UINT32    Reserved;
+  UINT64    DutTxUs;
+  UINT64    PeerRxNs;
+  UINT64    PeerTxNs;
+} L4_OWD_HEADER;
+#pragma pack()
+
+//
+// Clock offset estimate: companion clock minus DUT clock, from the TIME
+// exchange with the smallest round trip (NTP clock filter)
+//
+typedef struct {
+  INT64     OffsetUs;
+  UINT64    AtUs;                       // DUT time of the estimate
+  UINT32    DelayUs;                    // best round trip minus companion time
+  UINTN     Samples;
+} L4_OWD_SYNC;
+
+typedef struct {
+  UINT64    *MidUs;                     // answered probes: DUT time halfway
+  INT64     *FwdRawUs;                  // companion arrival - DUT send (mixed clocks)
+  INT64     *RevRawUs;                  // DUT arrival - companion send (mixed clocks)
+  UINTN     Answered;
+  UINTN     Lost;
+  UINTN     Stale;
+} L4_OWD_STATS;
+
+//
+// Delay distribution of one direction
+//
+typedef struct {
+  INT32     MinUs;
+  INT32     P50Us;
+  INT32     P99Us;
+  INT32     MaxUs;
+  UINT32    JitterUs;                   // RFC 3550 interarrival jitter
+} L4_OWD_DIR;
+
+/**
+  Estimate the companion clock offset from Rounds TIME exchanges over
+  the control channel. Each exchange gives offset
+  ((T2 - T1) + (T3 - T4)) / 2 and delay (T4 - T1) - (T3 - T2); the
+  offset of the lowest-delay exchange is kept, since queueing on either
+  path biases it by at most half the delay.
+
+  @param[in,out]  Link    Connected companion link.
+  @param[in]      Rounds  Number of exchanges.
+  @param[out]     Sync    Best estimate.
+
+  @retval EFI_SUCCESS      At least one exchange answered.
+  @retval EFI_UNSUPPORTED  Companion does not support TIME.
+  @retval EFI_TIMEOUT      No exchange answered.
+**/
+STATIC
+EFI_STATUS
+L4OwdClockSync (
+  IN OUT COMPANION_LINK  *Link,
+  IN     UINTN           Rounds,
+  OUT    L4_OWD_SYNC     *Sync
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      T1;
+  UINT64      T2;
+  UINT64      T3;
+  UINT64      T4;
+  UINT64      PeerRxNs;
+  UINT64      PeerTxNs;
+  UINT64      Rtt;
+  UINT64      Delay;
+  UINTN       Round;
+
+  ZeroMem (Sync, sizeof (*Sync));
+  Sync->DelayUs = MAX_UINT32;
+
+  for (Round = 0; Round < Rounds; Round++) {
+    Status = CompanionTimeSample (Link, (UINT32)Round, L4_OWD_SYNC_TIMEOUT_MS,
+                                  &T1, &T4, &PeerRxNs, &PeerTxNs);
+    if (Status == EFI_UNSUPPORTED) {
+      return Status;
+    }
+    if (!EFI_ERROR (Status) && PeerTxNs >= PeerRxNs) {
+      T2    = DivU64x32 (PeerRxNs, 1000);
+      T3    = DivU64x32 (PeerTxNs, 1000);
+      Rtt   = T4 - T1;
+      Delay = (Rtt > T3 - T2) ? Rtt - (T3 - T2) : 0;
+      Sync->Samples++;
+      if (Delay < Sync->DelayUs) {
+        Sync->DelayUs  = (UINT32)Delay;
+        Sync->OffsetUs = DivS64x64Remainder ((INT64)(T2 - T1) + (INT64)(T3 - T4), 2, NULL);
+        Sync->AtUs     = T1 + Rtt / 2;
+      }
+    }
+
+    gBS->Stall (L4_OWD_SYNC_GAP_US);
+  }
+
+  return (Sync->Samples > 0) ? EFI_SUCCESS : EFI_TIMEOUT;
+}
+
+/**
+  Clock offset at DUT time AtUs, interpolated between the estimates
+  taken before and after the probe stream so oscillator drift on either
+  side (including TSC calibration error) does not skew the delays.
+
+  @param[in]  Before  Estimate taken before the probes.
+  @param[in]  After   Estimate taken after the probes.
+  @param[in]  AtUs    DUT time.
+
+  @return Companion clock minus DUT clock at AtUs, in microseconds.
+**/
+STATIC
+INT64
+L4OwdOffsetAt (
+  IN CONST L4_OWD_SYNC  *Before,
+  IN CONST L4_OWD_SYNC  *After,
+  IN       UINT64       AtUs
+  )
+{
+  INT64  Span;
+
+  Span = (INT64)(After->AtUs - Before->AtUs);
+  if (Span <= 0) {
+    return Before->OffsetUs;
+  }
+
+  return Before->OffsetUs +
+         DivS64x64Remainder (
+           MultS64x64 (After->OffsetUs - Before->OffsetUs, (INT64)(AtUs - Before->AtUs)),
+           Span,
+           NULL
+           );
+}
+
+/**
+  Summarize the delays of one direction. Jitter is taken in probe order
+  (RFC 3550 A.8, 1/16 gain); it depends only on delay differences, so
+  any residual clock offset cancels out of it.
+
+  @param[in]   Delays   Per-probe delays, in probe order.
+  @param[in]   Count    Number of delays (at least 1).
+  @param[out]  Scratch  Count UINT32s of sort space.
+  @param[out]  Dir      Distribution.
+**/
+STATIC
+VOID
+L4OwdSummarize (
+  IN  CONST INT32  *Delays,
+  IN  UINTN        Count,
+  OUT UINT32       *Scratch,
+  OUT L4_OWD_DIR   *Dir
+  )
+{
+  INT32   Min;
+  INT32   Diff;
+  UINT32  Jitter16;
+  UINTN   I;
+
+  Min      = Delays[0];
+  Jitter16 = 0;
+  for (I = 1; I < Count; I++) {
+    Min       = MIN (Min, Delays[I]);
+    Diff      = Delays[I] - Delays[I - 1];
+    Jitter16 += (UINT32)((Diff < 0) ? -Diff : Diff) - ((Jitter16 + 8) >> 4);
+  }
+
+  //
+  // Sort relative to the minimum: a small offset error can push some
+  // one-way delays below zero
+  //
+  for (I = 0; I < Count; I++) {
+    Scratch[I] = (UINT32)(Delays[I] - Min);
+  }
+  UtilSortUint32 (Scratch, Count);
+
+  Dir->MinUs    = Min;
+  Dir->P50Us    = Min + (INT32)UtilPercentile (Scratch, Count, 50);
+  Dir->P99Us    = Min + (INT32)UtilPercentile (Scratch, Count, 99);
+  Dir->MaxUs    = Min + (INT32)Scratch[Count - 1];
+  Dir->JitterUs = Jitter16 >> 4;
+}
+
+/**
+  Send Probes timestamped probes, paced at PeriodUs, one at a time to
+  the companion's UDP echo and record the raw (mixed-clock) delays of
+  each direction. Offsets are applied afterwards, once the drift is known.
+
+  @param[in]   Nic       NIC under test.
+  @param[in]   Config    Test configuration (LocalIp/TargetIp/SubnetMask).
+  @param[in]   Port      Companion UDP port.
+  @param[in]   Probes    Number of probes; Stats arrays hold this many.
+  @param[in]   PeriodUs  Probe period.
+  @param[out]  Stats     Results; the arrays must be allocated.
+
+  @retval EFI_SUCCESS  Run completed (see Stats).
+  @retval other        UDP4 child setup failed.
+**/
+STATIC
+EFI_STATUS
+L4OwdRun (
+  IN  NIC_INFO       *Nic,
+  IN  TEST_CONFIG    *Config,
+  IN  UINT16         Port,
+  IN  UINTN          Probes,
+  IN  UINT32         PeriodUs,
+  OUT L4_OWD_STATS   *Stats
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_SERVICE_BINDING_PROTOCOL  *UdpSb;
+  EFI_HANDLE                    ChildHandle;
+  EFI_UDP4_PROTOCOL             *Udp4;
+  EFI_UDP4_CONFIG_DATA          UdpConfig;
+  EFI_UDP4_COMPLETION_TOKEN     TxToken;
+  EFI_UDP4_TRANSMIT_DATA        TxData;
+  EFI_UDP4_COMPLETION_TOKEN     RxToken;
+  EFI_UDP4_RECEIVE_DATA         *RxData;
+  UINT8                         TxBuf[L4_OWD_PROBE_SIZE];
+  L4_OWD_HEADER                 Reply;
+  L4_OWD_HEADER                 *Hdr;
+  UINT64                        SentUs;
+  UINT64                        NowUs;
+  UINT64                        PeerRxUs;
+  UINT64                        PeerTxUs;
+  UINTN                         Seq;
+  UINTN                         J;
+  BOOLEAN                       Done;
+
+  Stats->Answered = 0;
+  Stats->Lost     = 0;
+  Stats->Stale    = 0;
+
+  Status = gBS->HandleProtocol (
+                  Nic->Handle,
+                  &gEfiUdp4ServiceBindingProtocolGuid,
+                  (VOID **)&UdpSb
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ChildHandle = NULL;
+  Status = UdpSb->CreateChild (UdpSb, &ChildHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->HandleProtocol (ChildHandle, &gEfiUdp4ProtocolGuid, (VOID **)&Udp4);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  ZeroMem (&UdpConfig, sizeof (UdpConfig));
+  UdpConfig.AllowDuplicatePort = TRUE;
+  UdpConfig.TimeToLive         = 64;
+  UdpConfig.DoNotFragment      = FALSE;
+  UdpConfig.UseDefaultAddress  = FALSE;
+  CopyMem (&UdpConfig.StationAddress, &Config->LocalIp, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&UdpConfig.SubnetMask, &Config->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.StationPort = L4_OWD_LOCAL_PORT;
+  CopyMem (&UdpConfig.RemoteAddress, &Config->TargetIp, sizeof (EFI_IPv4_ADDRESS));
+  UdpConfig.RemotePort  = Port;
+
+  Status = Udp4->Configure (Udp4, &UdpConfig);
+  if (EFI_ERROR (Status)) {
+    UdpSb->DestroyChild (UdpSb, ChildHandle);
+    return Status;
+  }
+
+  ZeroMem (&TxToken, sizeof (TxToken));
+  ZeroMem (&RxToken, sizeof (RxToken));
+  Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L4NotifyStub, NULL, &TxToken.Event);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L4NotifyStub, NULL, &RxToken.Event);
+  }
+  if (EFI_ERROR (Status)) {
+    goto Cleanup;
+  }
+
+  for (J = sizeof (L4_OWD_HEADER); J < sizeof (TxBuf); J++) {
+    TxBuf[J] = (UINT8)J;
+  }
+  Hdr = (L4_OWD_HEADER *)TxBuf;
+  CopyMem (Hdr->Magic, "DDTOWDP|", sizeof (Hdr->Magic));
+  Hdr->Reserved = 0;
+  Hdr->PeerRxNs = 0;
+  Hdr->PeerTxNs = 0;
+
+  ZeroMem (&TxData, sizeof (TxData));
+  TxData.DataLength                      = sizeof (TxBuf);
+  TxData.FragmentCount                   = 1;
+  TxData.FragmentTable[0].FragmentLength = sizeof (TxBuf);
+  TxData.FragmentTable[0].FragmentBuffer = TxBuf;
+  TxToken.Packet.TxData                  = &TxData;
+
+  RxToken.Status = EFI_NOT_READY;
+  Status = Udp4->Receive (Udp4, &RxToken);
+  if (EFI_ERROR (Status)) {
+    goto Cleanup;
+  }
+
+  for (Seq = 0; Seq < Probes; Seq++) {
+    Hdr->Seq       = SwapBytes32 ((UINT32)Seq);
+    TxToken.Status = EFI_NOT_READY;
+    SentUs         = UtilGetTimeUs ();
+    Hdr->DutTxUs   = SwapBytes64 (SentUs);
+    Status         = Udp4->Transmit (Udp4, &TxToken);
+    if (EFI_ERROR (Status)) {
+      Stats->Lost++;
+      continue;
+    }
+
+    Done = FALSE;
+    do {
+      Udp4->Poll (Udp4);
+      NowUs = UtilGetTimeUs ();
+
+      if (RxToken.Status == EFI_NOT_READY) {
+        continue;
+      }
+
+      RxData = RxToken.Packet.RxData;
+      if (!EFI_ERROR (RxToken.Status) && RxData != NULL) {
+        ZeroMem (&Reply, sizeof (Reply));
+        if (RxData->DataLength >= sizeof (Reply) && RxData->FragmentCount > 0 &&
+            RxData->FragmentTable[0].FragmentLength >= sizeof (Reply)) {
+          CopyMem (&Reply, RxData->FragmentTable[0].FragmentBuffer, sizeof (Reply));
+        }
+        gBS->SignalEvent (RxData->RecycleSignal);
+
+        if (CompareMem (Reply.Magic, "DDTOWDP|", sizeof (Reply.Magic)) == 0) {
+          if (SwapBytes32 (Reply.Seq) == (UINT32)Seq && Reply.PeerRxNs != 0) {
+            PeerRxUs = DivU64x32 (SwapBytes64 (Reply.PeerRxNs), 1000);
+            PeerTxUs = DivU64x32 (SwapBytes64 (Reply.PeerTxNs), 1000);
+            Stats->MidUs[Stats->Answered]    = SentUs + (NowUs - SentUs) / 2;
+            Stats->FwdRawUs[Stats->Answered] = (INT64)(PeerRxUs - SentUs);
+            Stats->RevRawUs[Stats->Answered] = (INT64)(NowUs - PeerTxUs);
+            Stats->Answered++;
+            Done = TRUE;
+          } else {
+            Stats->Stale++;
+          }
+        }
+      }
+
+      RxToken.Status        = EFI_NOT_READY;
+      RxToken.Packet.RxData = NULL;
+      if (EFI_ERROR (Udp4->Receive (Udp4, &RxToken))) {
+        Status = EFI_DEVICE_ERROR;
+        goto Cleanup;
+      }
+    } while (!Done && NowUs - SentUs < L4_OWD_TIMEOUT_US);
+
+    if (!Done) {
+      Stats->Lost++;
+    }
+
+    //
+    // The transmit must have completed before its buffer is rewritten
+    //
+    while (TxToken.Status == EFI_NOT_READY && UtilGetTimeUs () - SentUs < L4_OWD_TIMEOUT_US) {
+      Udp4->Poll (Udp4);
+    }
+    if (TxToken.Status == EFI_NOT_READY) {
+      Udp4->Cancel (Udp4, &TxToken);
+    }
+
+    while (UtilGetTimeUs () - SentUs < PeriodUs) {
+      Udp4->Poll (Udp4);
+    }
+  }
+  Status = EFI_SUCCESS;
+
+Cleanup:
+  if (RxToken.Event != NULL) {
+    if (RxToken.Status == EFI_NOT_READY) {
+      Udp4->Cancel (Udp4, &RxToken);
+    }
+    gBS->CloseEvent (RxToken.Event);
+  }
+  if (TxToken.Event != NULL) {
+    gBS->CloseEvent (TxToken.Event);
+  }
+  Udp4->Configure (Udp4, NULL);
+  UdpSb->DestroyChild (UdpSb, ChildHandle);
+  return Status;
+}
+
+//
+// ============================================================
+// Test implementations
+// ============================================================
+//
+
+/**
+  Test L4.1: TCP Connect
+  Establishes a TCP connection to the target on the configured port.
+  Tests the TCP three-way handshake.
+
+  PASS: Connection established successfully
+  FAIL: Connection refused, timed out, or failed
+**/
+EFI_STATUS
+TestL4TcpConnect (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS          Status;
+  EFI_HANDLE          ChildHandle;
+  EFI_TCP4_PROTOCOL   *Tcp4;
+  UINT16              Port;
+  UINT64              StartTime;
+  UINT64              EndTime;
+
+  ChildHandle = NULL;
+  Tcp4        = NULL;
+
+  Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Failed to create TCP4 child: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify TCP4 protocol stack is loaded on this NIC");
+    return EFI_SUCCESS;
+  }
+
+  Port = Config->TargetPort > 0 ? Config->TargetPort : 80;
+
+  StartTime = UtilGetTimestamp ();
+
+  Status = L4TcpConnect (
+             Tcp4,
+             &Config->LocalIp,
+             &Config->TargetIp,
+             &Config->SubnetMask,
+             0,
+             Port,
+             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000,
+             NULL
+             );
+
+  EndTime = UtilGetTimestamp ();
+  Result->RttMinUs = (UINT32)((EndTime - StartTime) * 1000000);
+  Result->RttAvgUs = Result->RttMinUs;
+  Result->RttMaxUs = Result->RttMinUs;
+
+  if (!EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP connected to %d.%d.%d.%d:%d in %d us",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3],
+                   Port, Result->RttMinUs);
+
+    //
+    // Graceful close
+    //
+    L4TcpClose (Tcp4, 3000);
+  } else if (Status == EFI_TIMEOUT) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP connection to port %d timed out", Port);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"TCP handshake did not complete within timeout");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check firewall rules and target service availability");
+  } else {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP connect to port %d failed: %r", Port, Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"TCP connection error: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify target is listening on port %d", Port);
+  }
+
+  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  return EFI_SUCCESS;
+}
+
+/**
+  Test L4.2: TCP Multi-Port
+  Tests TCP connectivity on multiple common ports.
+
+  PASS: At least one port connected
+  WARN: Some ports failed
+  FAIL: All ports failed
+**/
+EFI_STATUS
+TestL4TcpMultiPort (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS          Status;
+  EFI_HANDLE          ChildHandle;
+  EFI_TCP4_PROTOCOL   *Tcp4;
+  UINT16              Ports[]  = { 80, 443, 8080, 22 };
+  UINTN               NumPorts = sizeof (Ports) / sizeof (Ports[0]);
+  UINTN               I;
+  UINTN               OpenCount;
+  UINTN               ClosedCount;
+
+  OpenCount   = 0;
+  ClosedCount = 0;
+
+  for (I = 0; I < NumPorts; I++) {
+    ChildHandle = NULL;
+    Tcp4        = NULL;
+
+    Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+    if (EFI_ERROR (Status)) {
+      ClosedCount++;
+      continue;
+    }
+
+    Result->PacketsSent++;
+
+    Status = L4TcpConnect (
+               Tcp4,
+               &Config->LocalIp,
+               &Config->TargetIp,
+               &Config->SubnetMask,
+               0,
+               Ports[I],
+               3000,
+               NULL
+               );
+
+    if (!EFI_ERROR (Status)) {
+      OpenCount++;
+      Result->PacketsReceived++;
+      L4TcpClose (Tcp4, 2000);
+    } else {
+      ClosedCount++;
+    }
+
+    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+
+    gBS->Stall (100000);  // 100ms between attempts
+  }
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"Ports tested: 80, 443, 8080, 22  Open: %d  Closed: %d",
+                 OpenCount, ClosedCount);
+
+  if (OpenCount == NumPorts) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"All %d ports open", NumPorts);
+  } else if (OpenCount > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"%d/%d ports open, %d closed/filtered",
+                   OpenCount, NumPorts, ClosedCount);
+  } else {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"All %d ports closed/filtered", NumPorts);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Could not connect to any tested port");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check target services and firewall configuration");
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Test L4.3: TCP Data Transfer
+  Establishes a TCP connection, sends test data, and attempts to receive
+  an echo response. Measures throughput.
+
+  PASS: Data sent and echo received
+  WARN: Data sent but no echo
+  FAIL: Connection or send failed
+**/
+EFI_STATUS
+TestL4TcpDataTransfer (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS          Status;
+  EFI_HANDLE          ChildHandle;
+  EFI_TCP4_PROTOCOL   *Tcp4;
+  UINT16              Port;
+  CHAR8               SendBuf[64];
+  UINT8               RecvBuf[256];
+  UINT32              RecvLen;
+  UINTN               SendLen;
+
+  ChildHandle = NULL;
+  Tcp4        = NULL;
 
-    if (TimerEvent != NULL) {
-      gBS->CloseEvent (TimerEvent);
-    }
+  Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP4 child creation failed: %r", Status);
+    return EFI_SUCCESS;
   }
 
-  if (RxToken.Status == EFI_NOT_READY) {
-    Udp4->Cancel (Udp4, &RxToken);
-    gBS->CloseEvent (RxToken.Event);
-    Udp4->Configure (Udp4, NULL);
-    UdpSb->DestroyChild (UdpSb, ChildHandle);
-    return EFI_TIMEOUT;
+  //
+  // Use port 22 (echo) by default; port 80/8080 do HTTP, not echo
+  //
+  Port = Config->TargetPort > 0 ? Config->TargetPort : 22;
+
+  Status = L4TcpConnect (
+             Tcp4,
+             &Config->LocalIp,
+             &Config->TargetIp,
+             &Config->SubnetMask,
+             0,
+             Port,
+             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000,
+             NULL
+             );
+
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP connect to port %d failed: %r", Port, Status);
+    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+    return EFI_SUCCESS;
   }
 
-  Status = RxToken.Status;
-  if (!EFI_ERROR (Status) && RxToken.Packet.RxData != NULL) {
-    UINT32  CopyLen;
-    UINT32  I;
-    UINT32  Offset;
+  //
+  // Send test data
+  //
+  AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft Test Data %d\r\n", UtilGetTimestamp ());
+  SendLen = AsciiStrLen (SendBuf);
 
-    Offset = 0;
-    for (I = 0; I < RxToken.Packet.RxData->FragmentCount; I++) {
-      CopyLen = RxToken.Packet.RxData->FragmentTable[I].FragmentLength;
-      if (Offset + CopyLen > RecvBufSize) {
-        CopyLen = RecvBufSize - Offset;
-      }
-      if (CopyLen > 0) {
-        CopyMem (
-          (UINT8 *)RecvBuf + Offset,
-          RxToken.Packet.RxData->FragmentTable[I].FragmentBuffer,
-          CopyLen
-          );
-        Offset += CopyLen;
-      }
-    }
+  Status = L4TcpSend (Tcp4, SendBuf, (UINT32)SendLen, 3000);
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP data send failed: %r", Status);
+    L4TcpClose (Tcp4, 2000);
+    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+    return EFI_SUCCESS;
+  }
 
-    if (RecvLen != NULL) {
-      *RecvLen = Offset;
-    }
+  Result->PacketsSent = 1;
+  Result->BytesSent   = SendLen;
 
-    gBS->SignalEvent (RxToken.Packet.RxData->RecycleSignal);
+  //
+  // Try to receive echo
+  //
+  RecvLen = 0;
+  Status = L4TcpReceive (Tcp4, RecvBuf, sizeof (RecvBuf) - 1, &RecvLen, 3000);
+
+  if (!EFI_ERROR (Status) && RecvLen > 0) {
+    Result->PacketsReceived = 1;
+    Result->BytesReceived   = RecvLen;
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP data transfer OK: sent %d, received %d bytes",
+                   SendLen, RecvLen);
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP data sent (%d bytes) but no echo received", SendLen);
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"Target may not echo data. Send succeeded, connection was functional.");
   }
 
-  gBS->CloseEvent (RxToken.Event);
-  Udp4->Configure (Udp4, NULL);
-  UdpSb->DestroyChild (UdpSb, ChildHandle);
-  return Status;
+  L4TcpClose (Tcp4, 3000);
+  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  return EFI_SUCCESS;
 }
 
-//
-// ============================================================
-// Test implementations
-// ============================================================
-//
-
 /**
-  Test L4.1: TCP Connect
-  Establishes a TCP connection to the target on the configured port.
-  Tests the TCP three-way handshake.
+  Test L4.4: TCP Close
+  Tests graceful TCP connection closure (FIN handshake).
+  Connects, then performs graceful close and verifies completion.
 
-  PASS: Connection established successfully
-  FAIL: Connection refused, timed out, or failed
+  PASS: Graceful close completed
+  WARN: Close timed out (may still be in TIME_WAIT)
+  FAIL: Connection or close failed
 **/
 EFI_STATUS
-TestL4TcpConnect (
+TestL4TcpClose (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS          Status;
-  EFI_HANDLE          ChildHandle;
-  EFI_TCP4_PROTOCOL   *Tcp4;
-  UINT16              Port;
-  UINT64              StartTime;
-  UINT64              EndTime;
+  EFI_STATUS                Status;
+  EFI_HANDLE                ChildHandle;
+  EFI_TCP4_PROTOCOL         *Tcp4;
+  EFI_TCP4_CONNECTION_STATE State;
+  UINT16                    Port;
 
   ChildHandle = NULL;
   Tcp4        = NULL;
@@ -814,16 +3179,12 @@ TestL4TcpConnect (
   if (EFI_ERROR (Status)) {
     Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"Failed to create TCP4 child: %r", Status);
-    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Verify TCP4 protocol stack is loaded on this NIC");
+                   L"TCP4 child creation failed: %r", Status);
     return EFI_SUCCESS;
   }
 
   Port = Config->TargetPort > 0 ? Config->TargetPort : 80;
 
-  StartTime = UtilGetTimestamp ();
-
   Status = L4TcpConnect (
              Tcp4,
              &Config->LocalIp,
@@ -831,723 +3192,1282 @@ TestL4TcpConnect (
              &Config->SubnetMask,
              0,
              Port,
-             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000
+             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000,
+             NULL
              );
 
-  EndTime = UtilGetTimestamp ();
-  Result->RttMinUs = (UINT32)((EndTime - StartTime) * 1000000);
-  Result->RttAvgUs = Result->RttMinUs;
-  Result->RttMaxUs = Result->RttMinUs;
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP connect failed (cannot test close): %r", Status);
+    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Verify we're in ESTABLISHED state
+  //
+  State = Tcp4StateClosed;
+  Tcp4->GetModeData (Tcp4, &State, NULL, NULL, NULL, NULL);
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"State before close: %d (4=ESTABLISHED)", State);
+
+  //
+  // Perform graceful close
+  //
+  Status = L4TcpClose (Tcp4, 5000);
 
   if (!EFI_ERROR (Status)) {
+    //
+    // Check state after close
+    //
+    State = Tcp4StateClosed;
+    Tcp4->GetModeData (Tcp4, &State, NULL, NULL, NULL, NULL);
+
     Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP connected to %d.%d.%d.%d:%d in %d us",
-                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
-                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3],
-                   Port, Result->RttMinUs);
+                   L"TCP graceful close completed (state=%d)", State);
+  } else if (Status == EFI_TIMEOUT) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP close timed out (may be in TIME_WAIT)");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Peer may not have completed FIN handshake");
+  } else {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP close failed: %r", Status);
+  }
+
+  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  return EFI_SUCCESS;
+}
+
+/**
+  Test L4.5: UDP Send/Receive
+  Sends a UDP datagram to the target and waits for an echo response.
+
+  PASS: Datagram sent and reply received
+  WARN: Datagram sent but no reply
+  FAIL: Send failed
+**/
+EFI_STATUS
+TestL4UdpSendReceive (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       SendBuf[64];
+  UINT8       RecvBuf[256];
+  UINT32      RecvLen;
+  UINTN       SendLen;
+  UINT16      Port;
+
+  Port = Config->TargetPort > 0 ? Config->TargetPort : 5000;
+
+  AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft UDP Test %d", UtilGetTimestamp ());
+  SendLen = AsciiStrLen (SendBuf);
+
+  RecvLen = 0;
+
+  Status = L4UdpSendRecv (
+             Nic->Handle,
+             &Config->LocalIp,
+             &Config->TargetIp,
+             &Config->SubnetMask,
+             (UINT16)(50000 + (UtilGetTimestamp () % 1000)),
+             Port,
+             SendBuf,
+             (UINT32)SendLen,
+             RecvBuf,
+             sizeof (RecvBuf),
+             &RecvLen,
+             Config->TimeoutMs > 0 ? Config->TimeoutMs : 3000
+             );
+
+  Result->PacketsSent = 1;
+  Result->BytesSent   = SendLen;
 
+  if (!EFI_ERROR (Status) && RecvLen > 0) {
+    Result->PacketsReceived = 1;
+    Result->BytesReceived   = RecvLen;
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP echo OK: sent %d, received %d bytes (port %d)",
+                   SendLen, RecvLen, Port);
+  } else if (Status == EFI_TIMEOUT || !EFI_ERROR (Status)) {
     //
-    // Graceful close
+    // UDP send succeeded (packet left the NIC) but no echo received.
+    // Known issue: EFI UDP4 Receive is unreliable on some platforms.
     //
-    L4TcpClose (Tcp4, 3000);
-  } else if (Status == EFI_TIMEOUT) {
-    Result->StatusCode = TEST_RESULT_FAIL;
+    Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP connection to port %d timed out", Port);
-    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
-                   L"TCP handshake did not complete within timeout");
-    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Check firewall rules and target service availability");
+                   L"UDP sent %d bytes to port %d, no echo (rx may be unsupported)",
+                   SendLen, Port);
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"UDP send OK. Receive may fail due to platform UDP4 limitations. "
+                   L"Use companion logs to verify echo was sent.");
   } else {
-    Result->StatusCode = TEST_RESULT_FAIL;
+    //
+    // Check if the error happened during receive (after send completed)
+    // If so, send was OK — treat as WARN, not FAIL
+    //
+    Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP connect to port %d failed: %r", Port, Status);
-    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
-                   L"TCP connection error: %r", Status);
+                   L"UDP sent to port %d, receive error: %r", Port, Status);
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"UDP send likely succeeded but receive returned %r. "
+                   L"Platform UDP4 Receive may not work correctly.", Status);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Verify target is listening on port %d", Port);
+                   L"Check companion logs for received UDP packets");
   }
 
-  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.2: TCP Multi-Port
-  Tests TCP connectivity on multiple common ports.
+  Test L4.6: UDP Multi-Port
+  Tests UDP communication on multiple ports.
 
-  PASS: At least one port connected
-  WARN: Some ports failed
-  FAIL: All ports failed
+  PASS: All ports responded
+  WARN: Some ports responded
+  FAIL: No ports responded
 **/
 EFI_STATUS
-TestL4TcpMultiPort (
+TestL4UdpMultiPort (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS          Status;
-  EFI_HANDLE          ChildHandle;
-  EFI_TCP4_PROTOCOL   *Tcp4;
-  UINT16              Ports[]  = { 80, 443, 8080, 22 };
-  UINTN               NumPorts = sizeof (Ports) / sizeof (Ports[0]);
-  UINTN               I;
-  UINTN               OpenCount;
-  UINTN               ClosedCount;
+  EFI_STATUS  Status;
+  UINT16      Ports[]  = { 5000, 5001, 5002 };
+  UINTN       NumPorts = sizeof (Ports) / sizeof (Ports[0]);
+  UINTN       I;
+  UINTN       SendOk;
+  UINTN       RecvOk;
+  CHAR8       SendBuf[64];
+  UINT8       RecvBuf[256];
+  UINT32      RecvLen;
+  UINTN       SendLen;
 
-  OpenCount   = 0;
-  ClosedCount = 0;
+  SendOk = 0;
+  RecvOk = 0;
 
   for (I = 0; I < NumPorts; I++) {
-    ChildHandle = NULL;
-    Tcp4        = NULL;
-
-    Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
-    if (EFI_ERROR (Status)) {
-      ClosedCount++;
-      continue;
-    }
-
-    Result->PacketsSent++;
+    AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft UDP port %d", Ports[I]);
+    SendLen = AsciiStrLen (SendBuf);
+    RecvLen = 0;
 
-    Status = L4TcpConnect (
-               Tcp4,
+    Status = L4UdpSendRecv (
+               Nic->Handle,
                &Config->LocalIp,
                &Config->TargetIp,
                &Config->SubnetMask,
-               0,
+               (UINT16)(50100 + I),
                Ports[I],
-               3000
+               SendBuf,
+               (UINT32)SendLen,
+               RecvBuf,
+               sizeof (RecvBuf),
+               &RecvLen,
+               2000
                );
 
+    Result->PacketsSent++;
+    Result->BytesSent += SendLen;
+
     if (!EFI_ERROR (Status)) {
-      OpenCount++;
-      Result->PacketsReceived++;
-      L4TcpClose (Tcp4, 2000);
-    } else {
-      ClosedCount++;
+      SendOk++;
+      if (RecvLen > 0) {
+        RecvOk++;
+        Result->PacketsReceived++;
+        Result->BytesReceived += RecvLen;
+      }
     }
 
-    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
-
-    gBS->Stall (100000);  // 100ms between attempts
+    gBS->Stall (200000);  // 200ms between sends
   }
 
   UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                 L"Ports tested: 80, 443, 8080, 22  Open: %d  Closed: %d",
-                 OpenCount, ClosedCount);
+                 L"Ports: 5000, 5001, 5002  Sent: %d  Replies: %d",
+                 SendOk, RecvOk);
 
-  if (OpenCount == NumPorts) {
+  if (RecvOk == NumPorts) {
     Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"All %d ports open", NumPorts);
-  } else if (OpenCount > 0) {
+                   L"All %d UDP ports responded", NumPorts);
+  } else if (RecvOk > 0) {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"%d/%d ports open, %d closed/filtered",
-                   OpenCount, NumPorts, ClosedCount);
+                   L"%d/%d UDP ports responded", RecvOk, NumPorts);
+  } else if (SendOk > 0) {
+    //
+    // All sends OK but no replies — likely platform UDP4 Receive limitation
+    //
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP sent on %d/%d ports OK, no replies (rx limitation)",
+                   SendOk, NumPorts);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Platform UDP4 Receive may not work. Check companion logs.");
   } else {
     Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"All %d ports closed/filtered", NumPorts);
-    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
-                   L"Could not connect to any tested port");
+                   L"UDP send failed on all %d ports", NumPorts);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Check target services and firewall configuration");
+                   L"Check UDP4 protocol stack and network connectivity");
   }
 
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.3: TCP Data Transfer
-  Establishes a TCP connection, sends test data, and attempts to receive
-  an echo response. Measures throughput.
+  Test L4.7: Port Scan
+  Parallel TCP connect scan of the target. Scans
+  Config->PortRangeStart..PortRangeEnd when set, otherwise ports 1-1024
+  plus a few common high service ports. Up to L4_SCAN_MAX_INFLIGHT
+  connects are outstanding; the per-port timeout adapts to the observed
+  handshake RTT. Each port is reported open, closed (RST) or filtered.
 
-  PASS: Data sent and echo received
-  WARN: Data sent but no echo
-  FAIL: Connection or send failed
+  PASS: Scan completed, open ports found
+  WARN: Scan completed, no open ports
+  FAIL: Cannot create TCP connections
 **/
 EFI_STATUS
-TestL4TcpDataTransfer (
+TestL4PortScan (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS          Status;
-  EFI_HANDLE          ChildHandle;
-  EFI_TCP4_PROTOCOL   *Tcp4;
-  UINT16              Port;
-  CHAR8               SendBuf[64];
-  UINT8               RecvBuf[256];
-  UINT32              RecvLen;
-  UINTN               SendLen;
+  EFI_STATUS           Status;
+  L4_SCAN_STATS        Stats;
+  L4_PORT_RANGE        UserRange;
+  CONST L4_PORT_RANGE  *Ranges;
+  UINTN                RangeCount;
+  UINT32               InitialRtoMs;
+  UINTN                I;
+  UINTN                Pos;
+  CHAR16               PortList[160];
+  STATIC CONST L4_PORT_RANGE  DefaultRanges[] = {
+    { 1,    1024 },
+    { 3389, 3389 },
+    { 8080, 8080 },
+    { 8443, 8443 }
+  };
+
+  if (Config->PortRangeStart != 0) {
+    UserRange.First = Config->PortRangeStart;
+    UserRange.Last  = (Config->PortRangeEnd >= Config->PortRangeStart) ?
+                      Config->PortRangeEnd : Config->PortRangeStart;
+    Ranges     = &UserRange;
+    RangeCount = 1;
+  } else {
+    Ranges     = DefaultRanges;
+    RangeCount = sizeof (DefaultRanges) / sizeof (DefaultRanges[0]);
+  }
 
-  ChildHandle = NULL;
-  Tcp4        = NULL;
+  InitialRtoMs = (Config->TimeoutMs > 0 && Config->TimeoutMs < L4_SCAN_INITIAL_RTO_MS) ?
+                 Config->TimeoutMs : L4_SCAN_INITIAL_RTO_MS;
 
-  Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+  Status = L4ScanPorts (Nic, Config, Ranges, RangeCount, L4_SCAN_MAX_INFLIGHT, InitialRtoMs, &Stats);
   if (EFI_ERROR (Status)) {
-    Result->StatusCode = TEST_RESULT_FAIL;
+    Result->StatusCode = TEST_RESULT_ERROR;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP4 child creation failed: %r", Status);
+                   L"Port scan could not start (%r)", Status);
     return EFI_SUCCESS;
   }
 
-  //
-  // Use port 22 (echo) by default; port 80/8080 do HTTP, not echo
-  //
-  Port = Config->TargetPort > 0 ? Config->TargetPort : 22;
-
-  Status = L4TcpConnect (
-             Tcp4,
-             &Config->LocalIp,
-             &Config->TargetIp,
-             &Config->SubnetMask,
-             0,
-             Port,
-             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000
-             );
-
-  if (EFI_ERROR (Status)) {
-    Result->StatusCode = TEST_RESULT_FAIL;
-    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP connect to port %d failed: %r", Port, Status);
-    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
-    return EFI_SUCCESS;
+  Result->PacketsSent     = Stats.Probed - Stats.Errors;
+  Result->PacketsReceived = Stats.Open + Stats.Closed;
+  if (Stats.RttSamples > 0) {
+    Result->RttMinUs    = Stats.RttMinUs;
+    Result->RttAvgUs    = (UINT32)(Stats.RttSumUs / Stats.RttSamples);
+    Result->RttMaxUs    = Stats.RttMaxUs;
+    Result->RttJitterUs = Stats.RttVarUs;
   }
 
   //
-  // Send test data
+  // Build "22,80,443" style open port list
   //
-  AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft Test Data %d\r\n", UtilGetTimestamp ());
-  SendLen = AsciiStrLen (SendBuf);
+  PortList[0] = L'\0';
+  Pos = 0;
+  for (I = 0; I < Stats.OpenListed && Pos + 8 < sizeof (PortList) / sizeof (CHAR16); I++) {
+    UnicodeSPrint (&PortList[Pos], sizeof (PortList) - Pos * sizeof (CHAR16),
+                   I == 0 ? L"%d" : L",%d", Stats.OpenPorts[I]);
+    Pos += StrLen (&PortList[Pos]);
+  }
+  if (Stats.Open > Stats.OpenListed) {
+    UnicodeSPrint (&PortList[Pos], sizeof (PortList) - Pos * sizeof (CHAR16), L",...");
+  }
 
-  Status = L4TcpSend (Tcp4, SendBuf, (UINT32)SendLen, 3000);
-  if (EFI_ERROR (Status)) {
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d.%d.%d.%d: %d ports in %d ms (%d in flight), open=%d closed=%d filtered=%d err=%d, "
+                 L"final timeout %d ms; open: %s",
+                 Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                 Config->TargetIp.Addr[2], Config->TargetIp.Addr[3],
+                 Stats.Probed, (UINT32)(Stats.ElapsedUs / 1000), L4_SCAN_MAX_INFLIGHT,
+                 Stats.Open, Stats.Closed, Stats.Filtered, Stats.Errors,
+                 Stats.RtoMs, Stats.Open > 0 ? PortList : L"none");
+
+  if (Stats.Errors == Stats.Probed) {
     Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP data send failed: %r", Status);
-    L4TcpClose (Tcp4, 2000);
-    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+                   L"Port scan failed: cannot create TCP connections");
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"TCP4 child creation/configure failed for all %d ports", Stats.Probed);
     return EFI_SUCCESS;
   }
 
-  Result->PacketsSent = 1;
-  Result->BytesSent   = SendLen;
-
-  //
-  // Try to receive echo
-  //
-  RecvLen = 0;
-  Status = L4TcpReceive (Tcp4, RecvBuf, sizeof (RecvBuf) - 1, &RecvLen, 3000);
-
-  if (!EFI_ERROR (Status) && RecvLen > 0) {
-    Result->PacketsReceived = 1;
-    Result->BytesReceived   = RecvLen;
+  if (Stats.Open > 0) {
     Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP data transfer OK: sent %d, received %d bytes",
-                   SendLen, RecvLen);
+                   L"Port scan: %d open, %d closed, %d filtered (%d ms)",
+                   Stats.Open, Stats.Closed, Stats.Filtered,
+                   (UINT32)(Stats.ElapsedUs / 1000));
   } else {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP data sent (%d bytes) but no echo received", SendLen);
-    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                   L"Target may not echo data. Send succeeded, connection was functional.");
+                   L"No open ports: %d closed, %d filtered",
+                   Stats.Closed, Stats.Filtered);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   Stats.Closed > 0 ?
+                   L"Target answers with RST; no service listening in scanned range" :
+                   L"Target may have firewall dropping all scanned ports");
   }
 
-  L4TcpClose (Tcp4, 3000);
-  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.4: TCP Close
-  Tests graceful TCP connection closure (FIN handshake).
-  Connects, then performs graceful close and verifies completion.
+  Test L4.8: TCP Stress
+  Rapidly opens and closes TCP connections to stress-test the transport layer.
+  Measures success rate and connection timing.
+
+  PASS: All connections succeeded
+  WARN: Some connections failed
+  FAIL: Majority of connections failed
+**/
+EFI_STATUS
+TestL4TcpStress (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS          Status;
+  EFI_HANDLE          ChildHandle;
+  EFI_TCP4_PROTOCOL   *Tcp4;
+  UINT16              Port;
+  UINTN               Iterations;
+  UINTN               I;
+  UINTN               Succeeded;
+  UINTN               Failed;
+  UINT64              StartTime;
+  UINT64              EndTime;
+  UINT32              MinUs;
+  UINT32              MaxUs;
+  UINT64              TotalUs;
+  UINT32              CurUs;
+
+  Port       = Config->TargetPort > 0 ? Config->TargetPort : 80;
+  Iterations = (Config->Iterations > 0 && Config->Iterations <= 50) ? Config->Iterations : 10;
+
+  Succeeded = 0;
+  Failed    = 0;
+  MinUs     = 0xFFFFFFFF;
+  MaxUs     = 0;
+  TotalUs   = 0;
+
+  for (I = 0; I < Iterations; I++) {
+    ChildHandle = NULL;
+    Tcp4        = NULL;
+
+    Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
+    if (EFI_ERROR (Status)) {
+      Failed++;
+      continue;
+    }
 
-  PASS: Graceful close completed
-  WARN: Close timed out (may still be in TIME_WAIT)
-  FAIL: Connection or close failed
-**/
-EFI_STATUS
-TestL4TcpClose (
-  IN  NIC_INFO         *Nic,
-  IN  TEST_CONFIG      *Config,
-  OUT TEST_RESULT_DATA *Result
-  )
-{
-  EFI_STATUS                Status;
-  EFI_HANDLE                ChildHandle;
-  EFI_TCP4_PROTOCOL         *Tcp4;
-  EFI_TCP4_CONNECTION_STATE State;
-  UINT16                    Port;
+    Result->PacketsSent++;
+    StartTime = UtilGetTimestamp ();
 
-  ChildHandle = NULL;
-  Tcp4        = NULL;
+    Status = L4TcpConnect (
+               Tcp4,
+               &Config->LocalIp,
+               &Config->TargetIp,
+               &Config->SubnetMask,
+               0,
+               Port,
+               3000,
+               NULL
+               );
 
-  Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
-  if (EFI_ERROR (Status)) {
-    Result->StatusCode = TEST_RESULT_FAIL;
-    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP4 child creation failed: %r", Status);
-    return EFI_SUCCESS;
-  }
+    EndTime = UtilGetTimestamp ();
+    CurUs = (UINT32)((EndTime - StartTime) * 1000000);
 
-  Port = Config->TargetPort > 0 ? Config->TargetPort : 80;
+    if (!EFI_ERROR (Status)) {
+      Succeeded++;
+      Result->PacketsReceived++;
+      TotalUs += CurUs;
+      if (CurUs < MinUs) MinUs = CurUs;
+      if (CurUs > MaxUs) MaxUs = CurUs;
 
-  Status = L4TcpConnect (
-             Tcp4,
-             &Config->LocalIp,
-             &Config->TargetIp,
-             &Config->SubnetMask,
-             0,
-             Port,
-             Config->TimeoutMs > 0 ? Config->TimeoutMs : 5000
-             );
+      L4TcpClose (Tcp4, 2000);
+    } else {
+      Failed++;
+    }
 
-  if (EFI_ERROR (Status)) {
-    Result->StatusCode = TEST_RESULT_FAIL;
-    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP connect failed (cannot test close): %r", Status);
     L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
-    return EFI_SUCCESS;
+
+    gBS->Stall (100000);  // 100ms between iterations
   }
 
-  //
-  // Verify we're in ESTABLISHED state
-  //
-  State = Tcp4StateClosed;
-  Tcp4->GetModeData (Tcp4, &State, NULL, NULL, NULL, NULL);
+  if (Succeeded > 0) {
+    Result->RttMinUs    = MinUs;
+    Result->RttAvgUs    = (UINT32)(TotalUs / Succeeded);
+    Result->RttMaxUs    = MaxUs;
+    Result->RttJitterUs = MaxUs - MinUs;
+  }
 
   UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                 L"State before close: %d (4=ESTABLISHED)", State);
-
-  //
-  // Perform graceful close
-  //
-  Status = L4TcpClose (Tcp4, 5000);
-
-  if (!EFI_ERROR (Status)) {
-    //
-    // Check state after close
-    //
-    State = Tcp4StateClosed;
-    Tcp4->GetModeData (Tcp4, &State, NULL, NULL, NULL, NULL);
+                 L"Port %d: %d/%d succeeded, min=%d avg=%d max=%d us",
+                 Port, Succeeded, Iterations,
+                 Succeeded > 0 ? MinUs : 0,
+                 Succeeded > 0 ? (UINT32)(TotalUs / Succeeded) : 0,
+                 Succeeded > 0 ? MaxUs : 0);
 
+  if (Succeeded == Iterations) {
     Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP graceful close completed (state=%d)", State);
-  } else if (Status == EFI_TIMEOUT) {
+                   L"TCP stress %d/%d OK (avg=%d us)", Succeeded, Iterations,
+                   (UINT32)(TotalUs / Succeeded));
+  } else if (Succeeded > Iterations / 2) {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP close timed out (may be in TIME_WAIT)");
+                   L"TCP stress %d/%d succeeded (%d failed)",
+                   Succeeded, Iterations, Failed);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Peer may not have completed FIN handshake");
+                   L"Some connections failed; possible resource exhaustion");
   } else {
     Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP close failed: %r", Status);
+                   L"TCP stress mostly failed: %d/%d succeeded",
+                   Succeeded, Iterations);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Majority of TCP connections failed (%d/%d)",
+                   Failed, Iterations);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check target capacity and TCP stack resources");
   }
 
-  L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.5: UDP Send/Receive
-  Sends a UDP datagram to the target and waits for an echo response.
-
-  PASS: Datagram sent and reply received
-  WARN: Datagram sent but no reply
-  FAIL: Send failed
+  Test L4.9: SYN Rate
+  Stateless connection-rate benchmark using raw SYN frames built with
+  PktBuildTcpPacket (no firmware TCP4 involvement). SYNs are paced in a
+  rising staircase of rates; SYN-ACK/RST replies are matched by
+  sequence-number cookie. Reports the highest rate the peer answered
+  at >= 99% and the connection-setup latency distribution.
+  Target port(s): Config->PortRangeStart..PortRangeEnd, else
+  Config->TargetPort, else 80. Closed ports work too (RST is a reply).
+
+  PASS: Peer sustained at least the lowest step
+  WARN: Replies received but no step reached 99%
+  FAIL: No replies / SNP unavailable
 **/
 EFI_STATUS
-TestL4UdpSendReceive (
+TestL4SynRate (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS  Status;
-  CHAR8       SendBuf[64];
-  UINT8       RecvBuf[256];
-  UINT32      RecvLen;
-  UINTN       SendLen;
-  UINT16      Port;
+  EFI_STATUS    Status;
+  L4_SYN_STATS  Stats;
+  UINT16        PortFirst;
+  UINT16        PortLast;
+  UINTN         S;
+  UINTN         Pos;
+  UINT64        LatSum;
+  UINT32        TotalSent;
+  UINT32        TotalAnswered;
+
+  if (Config->PortRangeStart != 0) {
+    PortFirst = Config->PortRangeStart;
+    PortLast  = (Config->PortRangeEnd >= PortFirst) ? Config->PortRangeEnd : PortFirst;
+  } else {
+    PortFirst = (Config->TargetPort > 0) ? Config->TargetPort : 80;
+    PortLast  = PortFirst;
+  }
 
-  Port = Config->TargetPort > 0 ? Config->TargetPort : 5000;
+  ZeroMem (&Stats, sizeof (Stats));
+  Stats.Latency = AllocatePool (L4_SYN_MAX_SAMPLES * sizeof (UINT32));
+  if (Stats.Latency == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SYN rate: out of memory");
+    return EFI_SUCCESS;
+  }
 
-  AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft UDP Test %d", UtilGetTimestamp ());
-  SendLen = AsciiStrLen (SendBuf);
+  Status = L4SynRateRun (Nic, Config, PortFirst, PortLast, &Stats);
+  if (EFI_ERROR (Status)) {
+    FreePool (Stats.Latency);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"SYN rate test could not start (%r)", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"SNP not initialized or next-hop MAC not resolvable");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check link and target/gateway reachability via ARP");
+    return EFI_SUCCESS;
+  }
 
-  RecvLen = 0;
+  TotalSent     = 0;
+  TotalAnswered = 0;
+  for (S = 0; S < Stats.StepCount; S++) {
+    TotalSent     += Stats.Steps[S].Sent;
+    TotalAnswered += Stats.Steps[S].Answered;
+  }
 
-  Status = L4UdpSendRecv (
-             Nic->Handle,
-             &Config->LocalIp,
-             &Config->TargetIp,
-             &Config->SubnetMask,
-             (UINT16)(50000 + (UtilGetTimestamp () % 1000)),
-             Port,
-             SendBuf,
-             (UINT32)SendLen,
-             RecvBuf,
-             sizeof (RecvBuf),
-             &RecvLen,
-             Config->TimeoutMs > 0 ? Config->TimeoutMs : 3000
-             );
+  Result->PacketsSent     = TotalSent;
+  Result->PacketsReceived = TotalAnswered;
+  Result->BytesSent       = (UINT64)TotalSent * (ETHERNET_HEADER_SIZE + IPV4_MIN_HEADER_SIZE + TCP_MIN_HEADER_SIZE);
 
-  Result->PacketsSent = 1;
-  Result->BytesSent   = SendLen;
+  LatSum = 0;
+  for (S = 0; S < Stats.LatencyCount; S++) {
+    LatSum += Stats.Latency[S];
+  }
+  UtilSortUint32 (Stats.Latency, Stats.LatencyCount);
+
+  if (Stats.LatencyCount > 0) {
+    Result->RttMinUs    = Stats.Latency[0];
+    Result->RttAvgUs    = (UINT32)(LatSum / Stats.LatencyCount);
+    Result->RttMaxUs    = Stats.Latency[Stats.LatencyCount - 1];
+    Result->RttJitterUs = UtilPercentile (Stats.Latency, Stats.LatencyCount, 99) -
+                          UtilPercentile (Stats.Latency, Stats.LatencyCount, 50);
+  }
 
-  if (!EFI_ERROR (Status) && RecvLen > 0) {
-    Result->PacketsReceived = 1;
-    Result->BytesReceived   = RecvLen;
-    Result->StatusCode = TEST_RESULT_PASS;
+  //
+  // Detail: per-step "rate:answered%" then latency percentiles
+  //
+  Pos = 0;
+  for (S = 0; S < Stats.StepCount && Pos < 300; S++) {
+    UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                   L"%d/s:%d%% ", Stats.Steps[S].SentRate,
+                   Stats.Steps[S].Sent > 0 ? Stats.Steps[S].Answered * 100 / Stats.Steps[S].Sent : 0);
+    Pos += StrLen (&Result->Detail[Pos]);
+  }
+  UnicodeSPrint (&Result->Detail[Pos], sizeof (Result->Detail) - Pos * sizeof (CHAR16),
+                 L"| port %d-%d, latency p50=%d p90=%d p99=%d us, badcookie=%d txerr=%d",
+                 PortFirst, PortLast,
+                 UtilPercentile (Stats.Latency, Stats.LatencyCount, 50),
+                 UtilPercentile (Stats.Latency, Stats.LatencyCount, 90),
+                 UtilPercentile (Stats.Latency, Stats.LatencyCount, 99),
+                 Stats.BadCookie, Stats.TxErrors);
+
+  if (TotalAnswered == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"UDP echo OK: sent %d, received %d bytes (port %d)",
-                   SendLen, RecvLen, Port);
-  } else if (Status == EFI_TIMEOUT || !EFI_ERROR (Status)) {
-    //
-    // UDP send succeeded (packet left the NIC) but no echo received.
-    // Known issue: EFI UDP4 Receive is unreliable on some platforms.
-    //
-    Result->StatusCode = TEST_RESULT_WARN;
+                   L"No SYN-ACK/RST replies to %d SYNs", TotalSent);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Target did not answer any raw SYN");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check firewall on target; TCP may be filtered");
+  } else if (Stats.SustainedRate > 0) {
+    Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"UDP sent %d bytes to port %d, no echo (rx may be unsupported)",
-                   SendLen, Port);
-    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                   L"UDP send OK. Receive may fail due to platform UDP4 limitations. "
-                   L"Use companion logs to verify echo was sent.");
+                   L"Peer sustains %d SYN/s (p50 setup %d us)",
+                   Stats.SustainedRate,
+                   UtilPercentile (Stats.Latency, Stats.LatencyCount, 50));
   } else {
-    //
-    // Check if the error happened during receive (after send completed)
-    // If so, send was OK — treat as WARN, not FAIL
-    //
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"UDP sent to port %d, receive error: %r", Port, Status);
-    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                   L"UDP send likely succeeded but receive returned %r. "
-                   L"Platform UDP4 Receive may not work correctly.", Status);
+                   L"Only %d/%d SYNs answered even at %d/s",
+                   Stats.Steps[0].Answered, Stats.Steps[0].Sent, Stats.Steps[0].TargetRate);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Check companion logs for received UDP packets");
+                   L"Peer may rate-limit SYNs (syncookies, SYN flood protection)");
   }
 
+  FreePool (Stats.Latency);
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.6: UDP Multi-Port
-  Tests UDP communication on multiple ports.
-
-  PASS: All ports responded
-  WARN: Some ports responded
-  FAIL: No ports responded
+  Test L4.10: TCP Throughput
+  Bulk transfer through the firmware TCP4 stack against the companion:
+  streams to the sink port (DUT -> companion), then reads from the
+  source port (companion -> DUT), each for Config->DurationMs (default
+  5 s). L4_BULK_MAX_TOKENS multi-fragment IO tokens are kept in flight
+  per direction. The ports come from the companion's PREPARE reply.
+
+  A completed Transmit token only means TCP4 buffered the data, so the
+  TX rate is what the companion's sink actually received; the RX rate
+  is measured here, next to the companion's retransmit count for it.
+  Also reports per-second Mbps and stalls (periods >= L4_BULK_STALL_MS
+  with no completion: retransmission timeouts).
+
+  PASS: Both directions moved data without stalls
+  WARN: Data moved but with stalls/errors, one direction failed, or no
+        companion accounting
+  FAIL: No data in either direction
 **/
 EFI_STATUS
-TestL4UdpMultiPort (
+TestL4TcpThroughput (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS  Status;
-  UINT16      Ports[]  = { 5000, 5001, 5002 };
-  UINTN       NumPorts = sizeof (Ports) / sizeof (Ports[0]);
-  UINTN       I;
-  UINTN       SendOk;
-  UINTN       RecvOk;
-  CHAR8       SendBuf[64];
-  UINT8       RecvBuf[256];
-  UINT32      RecvLen;
-  UINTN       SendLen;
-
-  SendOk = 0;
-  RecvOk = 0;
-
-  for (I = 0; I < NumPorts; I++) {
-    AsciiSPrint (SendBuf, sizeof (SendBuf), "DDTSoft UDP port %d", Ports[I]);
-    SendLen = AsciiStrLen (SendBuf);
-    RecvLen = 0;
-
-    Status = L4UdpSendRecv (
-               Nic->Handle,
-               &Config->LocalIp,
-               &Config->TargetIp,
-               &Config->SubnetMask,
-               (UINT16)(50100 + I),
-               Ports[I],
-               SendBuf,
-               (UINT32)SendLen,
-               RecvBuf,
-               sizeof (RecvBuf),
-               &RecvLen,
-               2000
-               );
+  EFI_STATUS      TxStatus;
+  EFI_STATUS      RxStatus;
+  EFI_STATUS      LinkStatus;
+  COMPANION_LINK  Link;
+  BOOLEAN         LinkUp;
+  CONST CHAR8     *Report;
+  L4_BULK_STATS   Tx;
+  L4_BULK_STATS   Rx;
+  UINT64          Value;
+  UINT64          SinkBytes;
+  UINT64          SinkUs;
+  UINT64          Retrans;
+  UINT16          SinkPort;
+  UINT16          SourcePort;
+  UINT32          DurationMs;
+  UINT32          QueuedMbpsX10;
+  UINT32          TxMbpsX10;
+  UINT32          RxMbpsX10;
+  CHAR16          TxList[96];
+  CHAR16          RxList[96];
+
+  DurationMs = (Config->DurationMs > 0) ? Config->DurationMs : L4_BULK_DEFAULT_MS;
+  SinkPort   = L4_BULK_SINK_PORT;
+  SourcePort = L4_BULK_SOURCE_PORT;
 
-    Result->PacketsSent++;
-    Result->BytesSent += SendLen;
+  //
+  // Ask the companion for its bulk ports; this also clears its counters
+  //
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionPrepare (&Link, "L4", "TCP_THROUGHPUT", NULL);
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
+  if (LinkUp) {
+    if (!EFI_ERROR (CompanionResultValue (Link.ReadyDetail, "sink_port", &Value)) &&
+        Value > 0 && Value <= 0xFFFF) {
+      SinkPort = (UINT16)Value;
+    }
+    if (!EFI_ERROR (CompanionResultValue (Link.ReadyDetail, "source_port", &Value)) &&
+        Value > 0 && Value <= 0xFFFF) {
+      SourcePort = (UINT16)Value;
+    }
+  }
 
-    if (!EFI_ERROR (Status)) {
-      SendOk++;
-      if (RecvLen > 0) {
-        RecvOk++;
-        Result->PacketsReceived++;
-        Result->BytesReceived += RecvLen;
-      }
+  TxStatus = L4BulkRun (Nic, Config, TRUE, SinkPort, DurationMs, &Tx);
+  RxStatus = L4BulkRun (Nic, Config, FALSE, SourcePort, DurationMs, &Rx);
+
+  SinkBytes = 0;
+  SinkUs    = 0;
+  Retrans   = 0;
+  if (LinkUp) {
+    gBS->Stall (L4_BULK_SETTLE_MS * 1000);
+    LinkStatus = CompanionGetResult (&Link, &Report);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionResultValue (Report, "sink_bytes", &SinkBytes);
+    }
+    if (!EFI_ERROR (LinkStatus)) {
+      CompanionResultValue (Report, "sink_us", &SinkUs);
+      CompanionResultValue (Report, "source_retrans", &Retrans);
     }
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+    LinkUp = !EFI_ERROR (LinkStatus);
+  }
 
-    gBS->Stall (200000);  // 200ms between sends
+  QueuedMbpsX10 = (Tx.ElapsedUs > 0) ? (UINT32)DivU64x64Remainder (Tx.Bytes * 80, Tx.ElapsedUs, NULL) : 0;
+  TxMbpsX10     = (SinkUs > 0) ? (UINT32)DivU64x64Remainder (SinkBytes * 80, SinkUs, NULL) : 0;
+  RxMbpsX10     = (Rx.ElapsedUs > 0) ? (UINT32)DivU64x64Remainder (Rx.Bytes * 80, Rx.ElapsedUs, NULL) : 0;
+  if (!LinkUp) {
+    //
+    // Without the sink's count only the queued rate is known
+    //
+    TxMbpsX10 = QueuedMbpsX10;
   }
 
-  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                 L"Ports: 5000, 5001, 5002  Sent: %d  Replies: %d",
-                 SendOk, RecvOk);
+  Result->BytesSent     = LinkUp ? SinkBytes : Tx.Bytes;
+  Result->BytesReceived = Rx.Bytes;
 
-  if (RecvOk == NumPorts) {
-    Result->StatusCode = TEST_RESULT_PASS;
-    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"All %d UDP ports responded", NumPorts);
-  } else if (RecvOk > 0) {
-    Result->StatusCode = TEST_RESULT_WARN;
+  TxList[0] = L'\0';
+  RxList[0] = L'\0';
+  L4BulkFormatIntervals (&Tx, TxList, sizeof (TxList));
+  L4BulkFormatIntervals (&Rx, RxList, sizeof (RxList));
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"TX->:%d: %d.%d Mbps %s (queued %d.%d) [%s] stalls=%d max=%dms err=%d (%r) | "
+                 L"RX<-:%d: %d.%d Mbps [%s] stalls=%d max=%dms err=%d retrans=%llu (%r) | "
+                 L"%d tokens x %d KB",
+                 SinkPort, TxMbpsX10 / 10, TxMbpsX10 % 10,
+                 LinkUp ? L"at sink" : L"queued, no companion count",
+                 QueuedMbpsX10 / 10, QueuedMbpsX10 % 10, TxList,
+                 Tx.Stalls, Tx.LongestStallMs, Tx.TokenErrors,
+                 EFI_ERROR (TxStatus) ? TxStatus : Tx.EndStatus,
+                 SourcePort, RxMbpsX10 / 10, RxMbpsX10 % 10, RxList,
+                 Rx.Stalls, Rx.LongestStallMs, Rx.TokenErrors, Retrans,
+                 EFI_ERROR (RxStatus) ? RxStatus : Rx.EndStatus,
+                 L4_BULK_MAX_TOKENS, L4_BULK_FRAGS * L4_BULK_FRAG_SIZE / 1024);
+
+  if (Tx.Bytes == 0 && Rx.Bytes == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"%d/%d UDP ports responded", RecvOk, NumPorts);
-  } else if (SendOk > 0) {
-    //
-    // All sends OK but no replies — likely platform UDP4 Receive limitation
-    //
+                   L"TCP throughput: no data moved (TX %r, RX %r)", TxStatus, RxStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Could not stream to companion ports %d/%d", SinkPort, SourcePort);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Start companion with bulk sink/source ports enabled");
+    return EFI_SUCCESS;
+  }
+
+  if (!LinkUp) {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"UDP sent on %d/%d ports OK, no replies (rx limitation)",
-                   SendOk, NumPorts);
+                   L"TCP RX %d.%d Mbps, TX unconfirmed (%d.%d Mbps queued)",
+                   RxMbpsX10 / 10, RxMbpsX10 % 10, QueuedMbpsX10 / 10, QueuedMbpsX10 % 10);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Platform UDP4 Receive may not work. Check companion logs.");
+                   L"Control channel unavailable (%r): run the companion to count the TX side",
+                   LinkStatus);
+  } else if (SinkBytes > 0 && Rx.Bytes > 0 &&
+             Tx.Stalls == 0 && Rx.Stalls == 0 &&
+             Tx.TokenErrors == 0 && Rx.TokenErrors == 0) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"TCP goodput TX %d.%d / RX %d.%d Mbps, %llu retransmits",
+                   TxMbpsX10 / 10, TxMbpsX10 % 10, RxMbpsX10 / 10, RxMbpsX10 % 10, Retrans);
   } else {
-    Result->StatusCode = TEST_RESULT_FAIL;
+    Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"UDP send failed on all %d ports", NumPorts);
+                   L"TCP goodput TX %d.%d / RX %d.%d Mbps, %d stalls, %llu retransmits",
+                   TxMbpsX10 / 10, TxMbpsX10 % 10, RxMbpsX10 / 10, RxMbpsX10 % 10,
+                   Tx.Stalls + Rx.Stalls, Retrans);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Check UDP4 protocol stack and network connectivity");
+                   L"Stalls indicate loss/retransmit timeouts; check cabling, duplex and NIC driver");
   }
 
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.7: Port Scan
-  Scans common TCP ports on the target to identify open services.
-
-  PASS: Scan completed, open ports found
-  WARN: Scan completed, no open ports
-  FAIL: Cannot create TCP connections
+  Test L4.11: UDP Throughput
+  Sends sequence-numbered datagrams (Config->DatagramSize, default
+  1472 bytes) to the companion's UDP echo port for Config->DurationMs
+  (default 5 s) with L4_UDPT_MAX_TOKENS Transmit tokens outstanding.
+  The companion is told the run id over the control channel; it counts
+  received sequence numbers, gaps, reordering and duplicates instead of
+  echoing, and reports them back through RESULT, giving real goodput
+  and loss rather than DUT-side frame counts.
+
+  PASS: Companion received the run with <= 1% loss and no duplicates
+  WARN: Higher loss/duplicates, or no companion accounting available
+  FAIL: Nothing sent, or companion received none of the run
 **/
 EFI_STATUS
-TestL4PortScan (
+TestL4UdpThroughput (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS          Status;
-  EFI_HANDLE          ChildHandle;
-  EFI_TCP4_PROTOCOL   *Tcp4;
-  UINT16              Ports[]  = { 22, 80, 443, 8080, 53, 3389 };
-  UINTN               NumPorts = sizeof (Ports) / sizeof (Ports[0]);
-  UINTN               I;
-  UINTN               OpenCount;
-  UINTN               TotalTried;
-
-  OpenCount  = 0;
-  TotalTried = 0;
-
-  for (I = 0; I < NumPorts; I++) {
-    ChildHandle = NULL;
-    Tcp4        = NULL;
+  EFI_STATUS      Status;
+  EFI_STATUS      LinkStatus;
+  COMPANION_LINK  Link;
+  BOOLEAN         LinkUp;
+  CHAR8           Args[64];
+  CONST CHAR8     *Report;
+  L4_UDPT_STATS   Tx;
+  UINT16          Port;
+  UINT32          Size;
+  UINT32          DurationMs;
+  UINT32          RunId;
+  UINT64          RxCount;
+  UINT64          RxBytes;
+  UINT64          Lost;
+  UINT64          Gaps;
+  UINT64          Reorder;
+  UINT64          Dup;
+  UINT32          OfferedX10;
+  UINT32          GoodputX10;
+  UINT32          LossPermille;
+
+  Port       = Config->TargetPort > 0 ? Config->TargetPort : L4_UDPT_ECHO_PORT;
+  DurationMs = (Config->DurationMs > 0) ? Config->DurationMs : L4_UDPT_DEFAULT_MS;
+  Size       = (Config->DatagramSize > 0) ? Config->DatagramSize : L4_UDPT_DEFAULT_SIZE;
+  if (Size < sizeof (L4_UDPT_HEADER)) {
+    Size = sizeof (L4_UDPT_HEADER);
+  }
+  if (Size > L4_UDPT_MAX_SIZE) {
+    Size = L4_UDPT_MAX_SIZE;
+  }
+  RunId = (UINT32)UtilGetTimeUs () & 0x7FFFFFFF;
 
-    Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
-    if (EFI_ERROR (Status)) {
-      continue;
+  //
+  // Arm companion-side accounting for this run id
+  //
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args), "run=%d size=%d", RunId, Size);
+      LinkStatus = CompanionPrepareStart (&Link, "L4", "UDP_THROUGHPUT", Args);
     }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
 
-    TotalTried++;
-    Result->PacketsSent++;
-
-    Status = L4TcpConnect (
-               Tcp4,
-               &Config->LocalIp,
-               &Config->TargetIp,
-               &Config->SubnetMask,
-               0,
-               Ports[I],
-               1500
-               );
+  Status = L4UdptSend (Nic, Config, Port, RunId, Size, DurationMs, &Tx);
 
-    if (!EFI_ERROR (Status)) {
-      OpenCount++;
-      Result->PacketsReceived++;
-      L4TcpClose (Tcp4, 500);
-    }
+  Result->PacketsSent = Tx.Sent;
+  Result->BytesSent   = Tx.Bytes;
+  OfferedX10 = (Tx.ElapsedUs > 0) ? (UINT32)DivU64x64Remainder (Tx.Bytes * 80, Tx.ElapsedUs, NULL) : 0;
 
-    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  RxCount = 0;
+  RxBytes = 0;
+  Lost    = 0;
+  Gaps    = 0;
+  Reorder = 0;
+  Dup     = 0;
 
-    gBS->Stall (50000);  // 50ms between scans
+  if (LinkUp) {
+    gBS->Stall (L4_UDPT_DRAIN_MS * 1000);
+    LinkStatus = CompanionStopResult (&Link, &Report);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionResultValue (Report, "udpt_rx", &RxCount);
+    }
+    if (!EFI_ERROR (LinkStatus)) {
+      CompanionResultValue (Report, "udpt_bytes", &RxBytes);
+      CompanionResultValue (Report, "udpt_gaps", &Gaps);
+      CompanionResultValue (Report, "udpt_reorder", &Reorder);
+      CompanionResultValue (Report, "udpt_dup", &Dup);
+    }
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+    LinkUp = !EFI_ERROR (LinkStatus);
   }
 
-  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                 L"Scanned ports 22,80,443,8080,53,3389 on %d.%d.%d.%d: %d open, %d closed",
-                 Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
-                 Config->TargetIp.Addr[2], Config->TargetIp.Addr[3],
-                 OpenCount, TotalTried - OpenCount);
-
-  if (TotalTried == 0) {
+  if (Tx.Sent == 0) {
     Result->StatusCode = TEST_RESULT_FAIL;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"Port scan failed: cannot create TCP connections");
+                   L"UDP throughput: no datagrams sent (%r)",
+                   EFI_ERROR (Status) ? Status : Tx.EndStatus);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"UDP4 Transmit failed: %d errors, %d refused",
+                   Tx.TxErrors, Tx.Backpressure);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check UDP4 driver support and the local IP configuration");
+    return EFI_SUCCESS;
+  }
+
+  if (!LinkUp) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP offered %d.%d Mbps, no companion accounting",
+                   OfferedX10 / 10, OfferedX10 % 10);
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"Sent %llu x %d B to port %d in %llu ms, TX errors %d, refused %d. "
+                   L"Control channel: %r",
+                   Tx.Sent, Size, Port, DivU64x32 (Tx.ElapsedUs, 1000),
+                   Tx.TxErrors, Tx.Backpressure, LinkStatus);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Run the companion to measure received goodput and loss");
     return EFI_SUCCESS;
   }
 
-  if (OpenCount > 0) {
+  //
+  // Loss is judged against what the DUT actually put on the wire
+  //
+  Lost         = (Tx.Sent > RxCount) ? Tx.Sent - RxCount : 0;
+  LossPermille = (UINT32)DivU64x64Remainder (Lost * 1000, Tx.Sent, NULL);
+  GoodputX10   = (Tx.ElapsedUs > 0) ? (UINT32)DivU64x64Remainder (RxBytes * 80, Tx.ElapsedUs, NULL) : 0;
+
+  Result->PacketsReceived = RxCount;
+  Result->BytesReceived   = RxBytes;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"Sent %llu x %d B in %llu ms (offered %d.%d Mbps, %d tokens, TX err %d, refused %d) | "
+                 L"Companion rx %llu, lost %llu (%d.%d%%), gaps %llu, reordered %llu, dup %llu, "
+                 L"goodput %d.%d Mbps",
+                 Tx.Sent, Size, DivU64x32 (Tx.ElapsedUs, 1000),
+                 OfferedX10 / 10, OfferedX10 % 10, L4_UDPT_MAX_TOKENS,
+                 Tx.TxErrors, Tx.Backpressure,
+                 RxCount, Lost, LossPermille / 10, LossPermille % 10,
+                 Gaps, Reorder, Dup, GoodputX10 / 10, GoodputX10 % 10);
+
+  if (RxCount == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP throughput: companion received 0 of %llu datagrams", Tx.Sent);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"No sequenced datagrams reached companion port %d", Port);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check routing to the companion and its udp_echo service");
+  } else if (LossPermille <= L4_UDPT_LOSS_WARN_PERMILLE && Dup == 0) {
     Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"Port scan: %d open, %d closed/filtered (of %d)",
-                   OpenCount, TotalTried - OpenCount, TotalTried);
+                   L"UDP goodput %d.%d Mbps, loss %d.%d%% (%d B datagrams)",
+                   GoodputX10 / 10, GoodputX10 % 10,
+                   LossPermille / 10, LossPermille % 10, Size);
   } else {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"All %d scanned ports are closed/filtered", TotalTried);
+                   L"UDP goodput %d.%d Mbps, loss %d.%d%%, dup %llu",
+                   GoodputX10 / 10, GoodputX10 % 10,
+                   LossPermille / 10, LossPermille % 10, Dup);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Target may have firewall blocking all scanned ports");
+                   L"Loss above 1%%: reduce DatagramSize/rate or check NIC ring and companion socket buffers");
   }
 
   return EFI_SUCCESS;
 }
 
 /**
-  Test L4.8: TCP Stress
-  Rapidly opens and closes TCP connections to stress-test the transport layer.
-  Measures success rate and connection timing.
-
-  PASS: All connections succeeded
-  WARN: Some connections failed
-  FAIL: Majority of connections failed
+  Test L4.12: UDP Latency
+  Sends Config->Iterations (default 200) sequence-numbered DDTLATE|
+  probes one at a time to the companion's UDP echo and times each reply.
+  The companion writes its residence time (kernel RX timestamp to reply
+  send) into the echo; subtracting it leaves the DUT stack + wire RTT,
+  free of companion scheduling jitter. Run the companion with
+  echo_low_latency for sub-100 us measurements.
+
+  PASS: All probes answered, residence time reported
+  WARN: Probe loss, or the companion reported no residence time
+  FAIL: No replies
 **/
 EFI_STATUS
-TestL4TcpStress (
+TestL4UdpLatency (
   IN  NIC_INFO         *Nic,
   IN  TEST_CONFIG      *Config,
   OUT TEST_RESULT_DATA *Result
   )
 {
-  EFI_STATUS          Status;
-  EFI_HANDLE          ChildHandle;
-  EFI_TCP4_PROTOCOL   *Tcp4;
-  UINT16              Port;
-  UINTN               Iterations;
-  UINTN               I;
-  UINTN               Succeeded;
-  UINTN               Failed;
-  UINT64              StartTime;
-  UINT64              EndTime;
-  UINT32              MinUs;
-  UINT32              MaxUs;
-  UINT64              TotalUs;
-  UINT32              CurUs;
+  EFI_STATUS    Status;
+  L4_LAT_STATS  Stats;
+  UINT16        Port;
+  UINTN         Probes;
+  UINTN         S;
+  UINT64        NetSum;
+  UINT32        ResAvgNs;
+
+  Port   = Config->TargetPort > 0 ? Config->TargetPort : L4_LAT_ECHO_PORT;
+  Probes = (Config->Iterations > 0 && Config->Iterations <= L4_LAT_MAX_PROBES) ?
+           Config->Iterations : L4_LAT_DEFAULT_PROBES;
+
+  ZeroMem (&Stats, sizeof (Stats));
+  Stats.RttUs = AllocatePool (Probes * sizeof (UINT32));
+  Stats.NetUs = AllocatePool (Probes * sizeof (UINT32));
+  if (Stats.RttUs == NULL || Stats.NetUs == NULL) {
+    if (Stats.RttUs != NULL) {
+      FreePool (Stats.RttUs);
+    }
+    if (Stats.NetUs != NULL) {
+      FreePool (Stats.NetUs);
+    }
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for latency samples");
+    return EFI_SUCCESS;
+  }
 
-  Port       = Config->TargetPort > 0 ? Config->TargetPort : 80;
-  Iterations = (Config->Iterations > 0 && Config->Iterations <= 50) ? Config->Iterations : 10;
+  Status = L4LatencyRun (Nic, Config, Port, Probes, &Stats);
 
-  Succeeded = 0;
-  Failed    = 0;
-  MinUs     = 0xFFFFFFFF;
-  MaxUs     = 0;
-  TotalUs   = 0;
+  Result->PacketsSent     = Probes;
+  Result->PacketsReceived = Stats.Answered;
+  Result->BytesSent       = Probes * L4_LAT_PROBE_SIZE;
+  Result->BytesReceived   = Stats.Answered * L4_LAT_PROBE_SIZE;
 
-  for (I = 0; I < Iterations; I++) {
-    ChildHandle = NULL;
-    Tcp4        = NULL;
+  if (EFI_ERROR (Status) || Stats.Answered == 0) {
+    FreePool (Stats.RttUs);
+    FreePool (Stats.NetUs);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP latency: no echo from port %d (%r)", Port, Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"%d probes sent, none answered", Probes);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check the companion udp_echo service and routing");
+    return EFI_SUCCESS;
+  }
 
-    Status = L4CreateTcpChild (Nic->Handle, &ChildHandle, &Tcp4);
-    if (EFI_ERROR (Status)) {
-      Failed++;
-      continue;
-    }
+  NetSum = 0;
+  for (S = 0; S < Stats.Answered; S++) {
+    NetSum += Stats.NetUs[S];
+  }
+  UtilSortUint32 (Stats.RttUs, Stats.Answered);
+  UtilSortUint32 (Stats.NetUs, Stats.Answered);
+  ResAvgNs = (Stats.WithResidence > 0) ?
+             (UINT32)DivU64x64Remainder (Stats.ResidenceNsSum, Stats.WithResidence, NULL) : 0;
 
-    Result->PacketsSent++;
-    StartTime = UtilGetTimestamp ();
+  //
+  // Result RTT fields carry the residence-corrected values
+  //
+  Result->RttMinUs    = Stats.NetUs[0];
+  Result->RttAvgUs    = (UINT32)DivU64x64Remainder (NetSum, Stats.Answered, NULL);
+  Result->RttMaxUs    = Stats.NetUs[Stats.Answered - 1];
+  Result->RttJitterUs = UtilPercentile (Stats.NetUs, Stats.Answered, 99) -
+                        UtilPercentile (Stats.NetUs, Stats.Answered, 50);
 
-    Status = L4TcpConnect (
-               Tcp4,
-               &Config->LocalIp,
-               &Config->TargetIp,
-               &Config->SubnetMask,
-               0,
-               Port,
-               3000
-               );
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d/%d answered, %d lost, %d stale | raw RTT p50=%d p99=%d us | "
+                 L"net RTT min=%d p50=%d p99=%d max=%d us | companion residence avg=%d.%d max=%d.%d us (%d replies)",
+                 Stats.Answered, Probes, Stats.Lost, Stats.Stale,
+                 UtilPercentile (Stats.RttUs, Stats.Answered, 50),
+                 UtilPercentile (Stats.RttUs, Stats.Answered, 99),
+                 Stats.NetUs[0],
+                 UtilPercentile (Stats.NetUs, Stats.Answered, 50),
+                 UtilPercentile (Stats.NetUs, Stats.Answered, 99),
+                 Stats.NetUs[Stats.Answered - 1],
+                 ResAvgNs / 1000, (ResAvgNs / 100) % 10,
+                 Stats.ResidenceNsMax / 1000, (Stats.ResidenceNsMax / 100) % 10,
+                 Stats.WithResidence);
+
+  if (Stats.WithResidence == 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP RTT p50=%d us (companion residence not reported, uncorrected)",
+                   UtilPercentile (Stats.RttUs, Stats.Answered, 50));
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Update the companion; SO_TIMESTAMPING is needed for residence time");
+  } else if (Stats.Lost > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP net RTT p50=%d us p99=%d us, %d of %d probes lost",
+                   UtilPercentile (Stats.NetUs, Stats.Answered, 50),
+                   UtilPercentile (Stats.NetUs, Stats.Answered, 99),
+                   Stats.Lost, Probes);
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"UDP net RTT p50=%d us p99=%d us (companion residence %d.%d us subtracted)",
+                   UtilPercentile (Stats.NetUs, Stats.Answered, 50),
+                   UtilPercentile (Stats.NetUs, Stats.Answered, 99),
+                   ResAvgNs / 1000, (ResAvgNs / 100) % 10);
+  }
 
-    EndTime = UtilGetTimestamp ();
-    CurUs = (UINT32)((EndTime - StartTime) * 1000000);
+  FreePool (Stats.RttUs);
+  FreePool (Stats.NetUs);
+  return EFI_SUCCESS;
+}
 
-    if (!EFI_ERROR (Status)) {
-      Succeeded++;
-      Result->PacketsReceived++;
-      TotalUs += CurUs;
-      if (CurUs < MinUs) MinUs = CurUs;
-      if (CurUs > MaxUs) MaxUs = CurUs;
+/**
+  Test L4.13: One-Way Delay
+  Splits the UDP round trip into its forward (DUT to companion) and
+  reverse halves. The companion clock offset is estimated NTP-style
+  with TIME exchanges over the control channel, before and after the
+  probe stream; the change between the two gives the relative drift,
+  and each probe is corrected with the offset interpolated to its time.
+  Config->Iterations (default 500) DDTOWDP| probes, paced at
+  Config->RatePps (default 100), carry the DUT send time and come back
+  with the companion's arrival and send times, so each direction gets
+  its own delay distribution and RFC 3550 jitter. The companion's echo
+  count splits the loss by direction as well.
+
+  Absolute one-way delays are only as good as the offset: its error is
+  at most half the best TIME round trip, which is reported with them.
+
+  PASS: All probes answered, offset bound within 250 us
+  WARN: Probe loss, or a looser offset bound
+  FAIL: No companion, no TIME support, or no probe replies
+**/
+EFI_STATUS
+TestL4OneWayDelay (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS      Status;
+  COMPANION_LINK  Link;
+  CONST CHAR8     *Report;
+  L4_OWD_SYNC     Before;
+  L4_OWD_SYNC     After;
+  L4_OWD_STATS    Stats;
+  L4_OWD_DIR      Fwd;
+  L4_OWD_DIR      Rev;
+  UINT8           *Pool;
+  INT32           *FwdUs;
+  INT32           *RevUs;
+  UINT32          *Scratch;
+  INT64           OffsetUs;
+  INT64           SpanUs;
+  INT32           DriftPpm;
+  UINT64          Echoes;
+  UINT64          RttSum;
+  UINT32          UncertUs;
+  UINT32          Pps;
+  UINT16          Port;
+  UINTN           Probes;
+  UINTN           FwdLost;
+  UINTN           RevLost;
+  UINTN           S;
+
+  Port   = Config->TargetPort > 0 ? Config->TargetPort : L4_OWD_ECHO_PORT;
+  Probes = (Config->Iterations > 0 && Config->Iterations <= L4_OWD_MAX_PROBES) ?
+           Config->Iterations : L4_OWD_DEFAULT_PROBES;
+  Pps    = (Config->RatePps > 0) ? MIN (Config->RatePps, L4_OWD_MAX_PPS) : L4_OWD_DEFAULT_PPS;
 
-      L4TcpClose (Tcp4, 2000);
-    } else {
-      Failed++;
+  //
+  // One block: raw samples (3 x 64-bit) and corrected delays + sort space (3 x 32-bit)
+  //
+  Pool = AllocateZeroPool (Probes * (3 * sizeof (UINT64) + 3 * sizeof (UINT32)));
+  if (Pool == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for one-way delay samples");
+    return EFI_SUCCESS;
+  }
+  ZeroMem (&Stats, sizeof (Stats));
+  Stats.MidUs    = (UINT64 *)Pool;
+  Stats.FwdRawUs = (INT64 *)(Stats.MidUs + Probes);
+  Stats.RevRawUs = Stats.FwdRawUs + Probes;
+  FwdUs          = (INT32 *)(Stats.RevRawUs + Probes);
+  RevUs          = FwdUs + Probes;
+  Scratch        = (UINT32 *)(RevUs + Probes);
+
+  Status = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (EFI_ERROR (Status)) {
+    FreePool (Pool);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"One-way delay: companion link setup failed (%r)", Status);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Offset before the stream, the probes, then the offset after it
+  //
+  ZeroMem (&Before, sizeof (Before));
+  ZeroMem (&After, sizeof (After));
+  Echoes = 0;
+  Status = CompanionConnect (&Link);
+  if (!EFI_ERROR (Status)) {
+    Status = CompanionPrepare (&Link, "L4", "UDP_OWD", NULL);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = L4OwdClockSync (&Link, L4_OWD_SYNC_ROUNDS, &Before);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = L4OwdRun (Nic, Config, Port, Probes, 1000000 / Pps, &Stats);
+  }
+  if (!EFI_ERROR (Status)) {
+    if (EFI_ERROR (L4OwdClockSync (&Link, L4_OWD_SYNC_ROUNDS, &After))) {
+      CopyMem (&After, &Before, sizeof (After));
+    }
+    if (!EFI_ERROR (CompanionGetResult (&Link, &Report))) {
+      CompanionResultValue (Report, "owd_echoes", &Echoes);
     }
+  }
+  CompanionDisconnect (&Link);
+  CompanionDestroy (&Link);
 
-    L4DestroyTcpChild (Nic->Handle, ChildHandle, Tcp4);
+  Result->PacketsSent     = Probes;
+  Result->PacketsReceived = Stats.Answered;
+  Result->BytesSent       = Probes * L4_OWD_PROBE_SIZE;
+  Result->BytesReceived   = Stats.Answered * L4_OWD_PROBE_SIZE;
 
-    gBS->Stall (100000);  // 100ms between iterations
+  if (EFI_ERROR (Status) || Stats.Answered == 0) {
+    FreePool (Pool);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    if (Status == EFI_UNSUPPORTED) {
+      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                     L"One-way delay: companion has no TIME command");
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Update the companion; clock offset estimation needs TIME");
+    } else if (Before.Samples == 0) {
+      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                     L"One-way delay: no clock offset from the companion (%r)", Status);
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Check that the companion is running and reachable");
+    } else {
+      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                     L"One-way delay: no probe echo from port %d (%r)", Port, Status);
+      UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                     L"%d probes sent, none answered", Probes);
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Check the companion udp_echo service and routing");
+    }
+    return EFI_SUCCESS;
   }
 
-  if (Succeeded > 0) {
-    Result->RttMinUs    = MinUs;
-    Result->RttAvgUs    = (UINT32)(TotalUs / Succeeded);
-    Result->RttMaxUs    = MaxUs;
-    Result->RttJitterUs = MaxUs - MinUs;
+  RttSum = 0;
+  for (S = 0; S < Stats.Answered; S++) {
+    OffsetUs = L4OwdOffsetAt (&Before, &After, Stats.MidUs[S]);
+    FwdUs[S] = (INT32)(Stats.FwdRawUs[S] - OffsetUs);
+    RevUs[S] = (INT32)(Stats.RevRawUs[S] + OffsetUs);
+    RttSum  += (UINT64)(FwdUs[S] + RevUs[S]);
   }
+  L4OwdSummarize (FwdUs, Stats.Answered, Scratch, &Fwd);
+  L4OwdSummarize (RevUs, Stats.Answered, Scratch, &Rev);
 
-  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
-                 L"Port %d: %d/%d succeeded, min=%d avg=%d max=%d us",
-                 Port, Succeeded, Iterations,
-                 Succeeded > 0 ? MinUs : 0,
-                 Succeeded > 0 ? (UINT32)(TotalUs / Succeeded) : 0,
-                 Succeeded > 0 ? MaxUs : 0);
+  SpanUs   = (INT64)(After.AtUs - Before.AtUs);
+  DriftPpm = (SpanUs > 0) ?
+             (INT32)DivS64x64Remainder (MultS64x64 (After.OffsetUs - Before.OffsetUs, 1000000), SpanUs, NULL) : 0;
+  UncertUs = MAX (Before.DelayUs, After.DelayUs) / 2;
 
-  if (Succeeded == Iterations) {
-    Result->StatusCode = TEST_RESULT_PASS;
+  //
+  // Echoed by the companion but not back here: lost on the reverse path
+  //
+  FwdLost = 0;
+  RevLost = 0;
+  if (Echoes >= Stats.Answered && Echoes <= Probes) {
+    FwdLost = Probes - (UINTN)Echoes;
+    RevLost = (UINTN)Echoes - Stats.Answered;
+  }
+
+  Result->RttAvgUs    = (UINT32)DivU64x64Remainder (RttSum, Stats.Answered, NULL);
+  Result->RttJitterUs = MAX (Fwd.JitterUs, Rev.JitterUs);
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d/%d answered at %d pps (fwd lost %d, rev lost %d, %d stale) | "
+                 L"fwd min=%d p50=%d p99=%d max=%d jitter=%d us | "
+                 L"rev min=%d p50=%d p99=%d max=%d jitter=%d us | "
+                 L"offset %ld us +-%d us, drift %d ppm (%d+%d TIME samples)",
+                 Stats.Answered, Probes, Pps, FwdLost, RevLost, Stats.Stale,
+                 Fwd.MinUs, Fwd.P50Us, Fwd.P99Us, Fwd.MaxUs, Fwd.JitterUs,
+                 Rev.MinUs, Rev.P50Us, Rev.P99Us, Rev.MaxUs, Rev.JitterUs,
+                 Before.OffsetUs, UncertUs, DriftPpm, Before.Samples, After.Samples);
+
+  if (Stats.Lost > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP stress %d/%d OK (avg=%d us)", Succeeded, Iterations,
-                   (UINT32)(TotalUs / Succeeded));
-  } else if (Succeeded > Iterations / 2) {
+                   L"OWD fwd p50=%d us rev p50=%d us, %d of %d probes lost",
+                   Fwd.P50Us, Rev.P50Us, Stats.Lost, Probes);
+  } else if (UncertUs > L4_OWD_MAX_UNCERT_US) {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP stress %d/%d succeeded (%d failed)",
-                   Succeeded, Iterations, Failed);
+                   L"OWD fwd p50=%d us rev p50=%d us, offset only within +-%d us",
+                   Fwd.P50Us, Rev.P50Us, UncertUs);
     UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Some connections failed; possible resource exhaustion");
+                   L"The TIME round trip bounds the split; reduce load on the control path");
   } else {
-    Result->StatusCode = TEST_RESULT_FAIL;
+    Result->StatusCode = TEST_RESULT_PASS;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
-                   L"TCP stress mostly failed: %d/%d succeeded",
-                   Succeeded, Iterations);
-    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
-                   L"Majority of TCP connections failed (%d/%d)",
-                   Failed, Iterations);
-    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
-                   L"Check target capacity and TCP stack resources");
+                   L"OWD fwd p50=%d us rev p50=%d us, asymmetry %d us (+-%d us)",
+                   Fwd.P50Us, Rev.P50Us, Fwd.P50Us - Rev.P50Us, UncertUs);
   }
 
+  FreePool (Pool);
   return EFI_SUCCESS;
 }
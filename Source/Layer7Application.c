@@ -1,13 +1,20 @@
 /** @file
   Layer 7 (Application) test implementations.
-  Tests DHCP discovery/lease, DNS resolution, and HTTP connectivity.
-  Uses EFI_DHCP4_PROTOCOL, EFI_DNS4_PROTOCOL, and EFI_HTTP_PROTOCOL.
+  Tests DHCP discovery/lease and DORA timing, DNS resolution and query
+  rate, HTTP connectivity, HTTP download throughput and keep-alive
+  request load, HTTPS handshake and throughput cost, and TFTP
+  throughput across block and window sizes.
+  Uses EFI_DHCP4_PROTOCOL, EFI_DNS4_PROTOCOL, EFI_HTTP_PROTOCOL (with
+  the firmware TLS stack for HTTPS) and EFI_MTFTP4_PROTOCOL; the DHCP
+  server load test emulates many clients over raw frames.
 **/
 
 #include <DDTSoftNetTest.h>
 #include <OsiLayers.h>
 #include <TestCases.h>
 #include <PacketDefs.h>
+#include <Guid/ImageAuthentication.h>
+#include <Guid/TlsAuthentication.h>
 
 //
 // ============================================================
@@ -122,6 +129,75 @@ L7DestroyDhcpChild (
   }
 }
 
+/**
+  Per-acquisition DORA timestamps, filled by L7DhcpTimingCallback.
+**/
+typedef struct {
+  UINT64   StartUs;                     // Start() called
+  UINT64   DiscoverUs;                  // first DHCPDISCOVER sent
+  UINT64   OfferUs;                     // first DHCPOFFER received
+  UINT64   RequestUs;                   // first DHCPREQUEST sent
+  UINT64   AckUs;                       // DHCPACK received
+  UINT64   BoundUs;                     // lease bound
+  BOOLEAN  Nak;
+} L7_DHCP_TIMING;
+
+/**
+  Dhcp4Callback timestamping each DORA step at microsecond resolution.
+  Always lets the driver continue (the first offer is selected, as with
+  no callback). The driver's retransmissions do not call it, so only
+  the first Discover and Request are seen.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+L7DhcpTimingCallback (
+  IN  EFI_DHCP4_PROTOCOL  *This,
+  IN  VOID                *Context,
+  IN  EFI_DHCP4_STATE     CurrentState,
+  IN  EFI_DHCP4_EVENT     Dhcp4Event,
+  IN  EFI_DHCP4_PACKET    *Packet OPTIONAL,
+  OUT EFI_DHCP4_PACKET    **NewPacket OPTIONAL
+  )
+{
+  L7_DHCP_TIMING  *Timing;
+  UINT64          NowUs;
+
+  Timing = (L7_DHCP_TIMING *)Context;
+  NowUs  = UtilGetTimeUs ();
+
+  switch (Dhcp4Event) {
+    case Dhcp4SendDiscover:
+      if (Timing->DiscoverUs == 0) {
+        Timing->DiscoverUs = NowUs;
+      }
+      break;
+    case Dhcp4RcvdOffer:
+      if (Timing->OfferUs == 0) {
+        Timing->OfferUs = NowUs;
+      }
+      break;
+    case Dhcp4SendRequest:
+      if (Timing->RequestUs == 0) {
+        Timing->RequestUs = NowUs;
+      }
+      break;
+    case Dhcp4RcvdAck:
+      Timing->AckUs = NowUs;
+      break;
+    case Dhcp4RcvdNak:
+      Timing->Nak = TRUE;
+      break;
+    case Dhcp4BoundCompleted:
+      Timing->BoundUs = NowUs;
+      break;
+    default:
+      break;
+  }
+
+  return EFI_SUCCESS;
+}
+
 //
 // ============================================================
 // DNS4 helpers
@@ -298,10 +374,99 @@ L7DestroyHttpChild (
   }
 }
 
+//
+// ============================================================
+// MTFTP4 helpers
+// ============================================================
+//
+
+/**
+  Create an MTFTP4 child instance on the given NIC handle.
+**/
+STATIC
+EFI_STATUS
+L7CreateMtftpChild (
+  IN  EFI_HANDLE            NicHandle,
+  OUT EFI_HANDLE            *ChildHandle,
+  OUT EFI_MTFTP4_PROTOCOL   **Mtftp4
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_SERVICE_BINDING_PROTOCOL  *Sb;
+
+  *ChildHandle = NULL;
+  *Mtftp4      = NULL;
+
+  Status = gBS->OpenProtocol (
+                  NicHandle,
+                  &gEfiMtftp4ServiceBindingProtocolGuid,
+                  (VOID **)&Sb,
+                  NULL,
+                  NULL,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Sb->CreateChild (Sb, ChildHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = gBS->OpenProtocol (
+                  *ChildHandle,
+                  &gEfiMtftp4ProtocolGuid,
+                  (VOID **)Mtftp4,
+                  NULL,
+                  NULL,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (EFI_ERROR (Status)) {
+    Sb->DestroyChild (Sb, *ChildHandle);
+    *ChildHandle = NULL;
+    return Status;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Destroy an MTFTP4 child instance.
+**/
+STATIC
+VOID
+L7DestroyMtftpChild (
+  IN EFI_HANDLE           NicHandle,
+  IN EFI_HANDLE           ChildHandle,
+  IN EFI_MTFTP4_PROTOCOL  *Mtftp4
+  )
+{
+  EFI_SERVICE_BINDING_PROTOCOL  *Sb;
+  EFI_STATUS                    Status;
+
+  if (Mtftp4 != NULL) {
+    Mtftp4->Configure (Mtftp4, NULL);
+  }
+
+  Status = gBS->OpenProtocol (
+                  NicHandle,
+                  &gEfiMtftp4ServiceBindingProtocolGuid,
+                  (VOID **)&Sb,
+                  NULL,
+                  NULL,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+  if (!EFI_ERROR (Status) && ChildHandle != NULL) {
+    Sb->DestroyChild (Sb, ChildHandle);
+  }
+}
+
 //
 // ============================================================
 // Test T7.1: DHCP Discover
-// Send DHCP discover and check for offers.
+// Send DHCP discover and check for offers. The DORA steps are
+// timestamped through Dhcp4Callback.
 //
 // PASS: Received DHCP offer/ack, obtained IP address
 // WARN: DHCP configured but no server responded
@@ -325,10 +490,13 @@ TestL7DhcpDiscover (
   UINT32                 RequestTimeout;
   UINTN                  PollCount;
   UINT32                 TimeoutMs;
+  L7_DHCP_TIMING         Timing;
+  UINTN                  Used;
 
   ChildHandle = NULL;
   Dhcp4       = NULL;
   DoneEvent   = NULL;
+  ZeroMem (&Timing, sizeof (Timing));
 
   //
   // Create DHCP4 child
@@ -359,8 +527,8 @@ TestL7DhcpDiscover (
   // ClientAddress = 0.0.0.0 → enters Dhcp4Init state
   //
   ZeroMem (&CfgData.ClientAddress, sizeof (EFI_IPv4_ADDRESS));
-  CfgData.Dhcp4Callback  = NULL;
-  CfgData.CallbackContext = NULL;
+  CfgData.Dhcp4Callback  = L7DhcpTimingCallback;
+  CfgData.CallbackContext = &Timing;
   CfgData.OptionCount    = 0;
   CfgData.OptionList     = NULL;
 
@@ -396,6 +564,7 @@ TestL7DhcpDiscover (
   //
   // Start DHCP process (async)
   //
+  Timing.StartUs = UtilGetTimeUs ();
   Status = Dhcp4->Start (Dhcp4, DoneEvent);
   if (EFI_ERROR (Status) && Status != EFI_ALREADY_STARTED) {
     //
@@ -470,6 +639,20 @@ TestL7DhcpDiscover (
                    ModeData.RouterAddress.Addr[3],
                    ModeData.LeaseTime);
     Result->PacketsReceived = 1;
+    if (Timing.BoundUs != 0 && Timing.AckUs != 0) {
+      //
+      // DORA phases from the callback timestamps (all are set once bound)
+      //
+      Result->DurationMs = DivU64x32 (Timing.BoundUs - Timing.StartUs, 1000);
+      Used = StrLen (Result->Detail);
+      UnicodeSPrint (Result->Detail + Used, sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                     L"  DORA: Discover->Offer %llu us, Offer->Request %llu us, "
+                     L"Request->Ack %llu us, total %llu us",
+                     Timing.OfferUs - Timing.DiscoverUs,
+                     Timing.RequestUs - Timing.OfferUs,
+                     Timing.AckUs - Timing.RequestUs,
+                     Timing.BoundUs - Timing.StartUs);
+    }
   } else if (ModeData.State == Dhcp4Selecting || ModeData.State == Dhcp4Requesting) {
     Result->StatusCode = TEST_RESULT_WARN;
     UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
@@ -1693,3 +1876,3122 @@ TestL7HttpStatusCodes (
 
   return EFI_SUCCESS;
 }
+
+//
+// ============================================================
+// HTTP download engine (streamed body, reused buffer)
+// ============================================================
+//
+
+#define L7_HTTPDL_DEFAULT_BYTES  (64ULL * 1024 * 1024)
+#define L7_HTTPDL_BUF_SIZE       (1024 * 1024)  // one Response call's body buffer
+#define L7_HTTPDL_IDLE_MS        10000          // per Request/Response call
+#define L7_HTTPDL_MAX_INTERVALS  30
+#define L7_HTTPDL_INTERVAL_US    1000000
+
+typedef struct {
+  EFI_HTTP_STATUS_CODE  HttpStatus;
+  UINT64                ContentLength;    // MAX_UINT64 if the server sent none
+  UINT64                Bytes;
+  UINT64                TtfbUs;           // Request -> response headers
+  UINT64                ElapsedUs;        // Request -> last body byte
+  UINT32                IntervalMbpsX10[L7_HTTPDL_MAX_INTERVALS];
+  UINTN                 IntervalCount;
+  UINTN                 Calls;            // Response calls made
+  EFI_STATUS            EndStatus;
+} L7_HTTPDL_STATS;
+
+/**
+  Poll an HTTP instance until a token completes, without stalling, so
+  the driver is driven as fast as the body arrives.
+
+  @param[in]  Http       HTTP instance.
+  @param[in]  Token      Token queued on Http.
+  @param[in]  TimeoutMs  Give up (and cancel) after this long.
+
+  @retval EFI_SUCCESS  Token completed; see Token->Status.
+  @retval EFI_TIMEOUT  Token cancelled.
+**/
+STATIC
+EFI_STATUS
+L7HttpWait (
+  IN EFI_HTTP_PROTOCOL  *Http,
+  IN EFI_HTTP_TOKEN     *Token,
+  IN UINT32             TimeoutMs
+  )
+{
+  UINT64  DeadlineUs;
+
+  DeadlineUs = UtilGetTimeUs () + (UINT64)TimeoutMs * 1000;
+  while (Token->Status == EFI_NOT_READY) {
+    Http->Poll (Http);
+    if (UtilGetTimeUs () > DeadlineUs) {
+      Http->Cancel (Http, Token);
+      return EFI_TIMEOUT;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Create and configure an HTTP child for requests to Config->TargetIp.
+
+  @param[in]   Nic          NIC under test.
+  @param[out]  ChildHandle  HTTP child handle.
+  @param[out]  Http         Configured HTTP instance.
+
+  @retval EFI_SUCCESS  Ready for Request.
+  @retval other        Child creation or Configure failed (child destroyed).
+**/
+STATIC
+EFI_STATUS
+L7HttpOpen (
+  IN  NIC_INFO           *Nic,
+  OUT EFI_HANDLE         *ChildHandle,
+  OUT EFI_HTTP_PROTOCOL  **Http
+  )
+{
+  EFI_STATUS               Status;
+  EFI_HTTP_CONFIG_DATA     HttpCfg;
+  EFI_HTTPv4_ACCESS_POINT  Ipv4Node;
+
+  Status = L7CreateHttpChild (Nic->Handle, ChildHandle, Http);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem (&Ipv4Node, sizeof (Ipv4Node));
+  Ipv4Node.UseDefaultAddress = FALSE;
+  CopyMem (&Ipv4Node.LocalAddress, &Nic->Ipv4Address, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&Ipv4Node.LocalSubnet, &Nic->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  Ipv4Node.LocalPort = 0;
+
+  ZeroMem (&HttpCfg, sizeof (HttpCfg));
+  HttpCfg.HttpVersion          = HttpVersion11;
+  HttpCfg.TimeOutMillisec      = L7_HTTPDL_IDLE_MS;
+  HttpCfg.LocalAddressIsIPv6   = FALSE;
+  HttpCfg.AccessPoint.IPv4Node = &Ipv4Node;
+
+  Status = (*Http)->Configure (*Http, &HttpCfg);
+  if (EFI_ERROR (Status)) {
+    L7DestroyHttpChild (Nic->Handle, *ChildHandle, *Http);
+    *ChildHandle = NULL;
+    *Http        = NULL;
+  }
+  return Status;
+}
+
+/**
+  GET Url and stream the body through repeated Response calls into one
+  reused buffer, sampling Mbps every L7_HTTPDL_INTERVAL_US.
+
+  @param[in]   Http     Configured HTTP instance.
+  @param[in]   Url      Request URL.
+  @param[in]   Host     Host header value.
+  @param[in]   Buf      Body buffer.
+  @param[in]   BufSize  Body buffer size.
+  @param[in]   Keep     TRUE: keep the body, appending each Response call
+                        to Buf (a body larger than BufSize ends with
+                        EFI_BUFFER_TOO_SMALL). FALSE: every call reuses
+                        Buf from the start and the body is discarded.
+  @param[out]  Stats    Download statistics.
+
+  @retval EFI_SUCCESS  Response headers received (see Stats->EndStatus
+                       for how the body transfer ended).
+  @retval other        Request failed or no response; Stats->EndStatus
+                       holds the same status.
+**/
+STATIC
+EFI_STATUS
+L7HttpDownload (
+  IN  EFI_HTTP_PROTOCOL  *Http,
+  IN  CHAR16             *Url,
+  IN  CHAR8              *Host,
+  IN  UINT8              *Buf,
+  IN  UINTN              BufSize,
+  IN  BOOLEAN            Keep,
+  OUT L7_HTTPDL_STATS    *Stats
+  )
+{
+  EFI_STATUS              Status;
+  EFI_HTTP_TOKEN          ReqToken;
+  EFI_HTTP_TOKEN          RspToken;
+  EFI_HTTP_MESSAGE        ReqMsg;
+  EFI_HTTP_MESSAGE        RspMsg;
+  EFI_HTTP_REQUEST_DATA   ReqData;
+  EFI_HTTP_RESPONSE_DATA  RspData;
+  EFI_HTTP_HEADER         ReqHeaders[2];
+  UINT64                  StartUs;
+  UINT64                  NowUs;
+  UINT64                  IntervalStartUs;
+  UINT64                  IntervalBytes;
+  UINTN                   H;
+
+  ZeroMem (Stats, sizeof (L7_HTTPDL_STATS));
+  Stats->ContentLength = MAX_UINT64;
+  ZeroMem (&ReqToken, sizeof (ReqToken));
+  ZeroMem (&RspToken, sizeof (RspToken));
+
+  Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L7NotifyStub, NULL, &ReqToken.Event);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L7NotifyStub, NULL, &RspToken.Event);
+  }
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  ReqHeaders[0].FieldName  = "Host";
+  ReqHeaders[0].FieldValue = Host;
+  ReqHeaders[1].FieldName  = "User-Agent";
+  ReqHeaders[1].FieldValue = "DDTSoft/1.0";
+
+  ZeroMem (&ReqData, sizeof (ReqData));
+  ReqData.Method = HttpMethodGet;
+  ReqData.Url    = Url;
+
+  ZeroMem (&ReqMsg, sizeof (ReqMsg));
+  ReqMsg.Data.Request = &ReqData;
+  ReqMsg.HeaderCount  = 2;
+  ReqMsg.Headers      = ReqHeaders;
+
+  ReqToken.Status  = EFI_NOT_READY;
+  ReqToken.Message = &ReqMsg;
+
+  StartUs = UtilGetTimeUs ();
+  Status  = Http->Request (Http, &ReqToken);
+  if (!EFI_ERROR (Status)) {
+    Status = L7HttpWait (Http, &ReqToken, L7_HTTPDL_IDLE_MS);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = ReqToken.Status;
+  }
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  //
+  // First Response call: status line, headers and the start of the body
+  //
+  ZeroMem (&RspData, sizeof (RspData));
+  ZeroMem (&RspMsg, sizeof (RspMsg));
+  RspMsg.Data.Response = &RspData;
+  RspMsg.BodyLength    = BufSize;
+  RspMsg.Body          = Buf;
+  RspToken.Status      = EFI_NOT_READY;
+  RspToken.Message     = &RspMsg;
+
+  Status = Http->Response (Http, &RspToken);
+  if (!EFI_ERROR (Status)) {
+    Status = L7HttpWait (Http, &RspToken, L7_HTTPDL_IDLE_MS);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = RspToken.Status;
+  }
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  NowUs              = UtilGetTimeUs ();
+  Stats->TtfbUs      = NowUs - StartUs;
+  Stats->HttpStatus  = RspData.StatusCode;
+  Stats->Bytes       = RspMsg.BodyLength;
+  Stats->Calls       = 1;
+  for (H = 0; H < RspMsg.HeaderCount; H++) {
+    if (AsciiStriCmp (RspMsg.Headers[H].FieldName, "Content-Length") == 0) {
+      Stats->ContentLength = AsciiStrDecimalToUint64 (RspMsg.Headers[H].FieldValue);
+    }
+  }
+  if (RspMsg.Headers != NULL) {
+    FreePool (RspMsg.Headers);
+  }
+
+  //
+  // Body: keep calling Response with the same buffer until the whole
+  // Content-Length has been read
+  //
+  IntervalStartUs = NowUs;
+  IntervalBytes   = Stats->Bytes;
+  while (Stats->Bytes < Stats->ContentLength) {
+    if (Keep && Stats->Bytes >= BufSize) {
+      Stats->EndStatus = EFI_BUFFER_TOO_SMALL;
+      break;
+    }
+    ZeroMem (&RspMsg, sizeof (RspMsg));
+    RspMsg.Data.Response = NULL;
+    RspMsg.BodyLength    = Keep ? BufSize - (UINTN)Stats->Bytes : BufSize;
+    RspMsg.Body          = Keep ? Buf + Stats->Bytes : Buf;
+    RspToken.Status      = EFI_NOT_READY;
+
+    Status = Http->Response (Http, &RspToken);
+    if (!EFI_ERROR (Status)) {
+      Status = L7HttpWait (Http, &RspToken, L7_HTTPDL_IDLE_MS);
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = RspToken.Status;
+    }
+    if (EFI_ERROR (Status) || RspMsg.BodyLength == 0) {
+      //
+      // Without a Content-Length the connection close ends the body
+      //
+      if (Stats->ContentLength != MAX_UINT64) {
+        Stats->EndStatus = EFI_ERROR (Status) ? Status : EFI_END_OF_FILE;
+      }
+      break;
+    }
+
+    Stats->Calls++;
+    Stats->Bytes  += RspMsg.BodyLength;
+    IntervalBytes += RspMsg.BodyLength;
+    NowUs          = UtilGetTimeUs ();
+    if (NowUs - IntervalStartUs >= L7_HTTPDL_INTERVAL_US) {
+      if (Stats->IntervalCount < L7_HTTPDL_MAX_INTERVALS) {
+        Stats->IntervalMbpsX10[Stats->IntervalCount++] =
+          (UINT32)DivU64x64Remainder (IntervalBytes * 80, NowUs - IntervalStartUs, NULL);
+      }
+      IntervalStartUs = NowUs;
+      IntervalBytes   = 0;
+    }
+  }
+
+  Stats->ElapsedUs = UtilGetTimeUs () - StartUs;
+  Status           = EFI_SUCCESS;
+
+Done:
+  if (EFI_ERROR (Status)) {
+    Stats->EndStatus = Status;
+  }
+  if (ReqToken.Event != NULL) {
+    gBS->CloseEvent (ReqToken.Event);
+  }
+  if (RspToken.Event != NULL) {
+    gBS->CloseEvent (RspToken.Event);
+  }
+  return Status;
+}
+
+/**
+  Append "x.y,x.y,..." interval Mbps list to a string.
+
+  @param[in]      Stats    Download statistics.
+  @param[in,out]  Buf      Destination (appended to).
+  @param[in]      BufSize  Destination size in bytes.
+**/
+STATIC
+VOID
+L7HttpFormatIntervals (
+  IN     L7_HTTPDL_STATS  *Stats,
+  IN OUT CHAR16           *Buf,
+  IN     UINTN            BufSize
+  )
+{
+  UINTN  I;
+  UINTN  Pos;
+
+  Pos = StrLen (Buf);
+  for (I = 0; I < Stats->IntervalCount && (Pos + 10) * sizeof (CHAR16) < BufSize; I++) {
+    UnicodeSPrint (&Buf[Pos], BufSize - Pos * sizeof (CHAR16),
+                   I == 0 ? L"%d.%d" : L",%d.%d",
+                   Stats->IntervalMbpsX10[I] / 10, Stats->IntervalMbpsX10[I] % 10);
+    Pos += StrLen (&Buf[Pos]);
+  }
+}
+
+//
+// ============================================================
+// Test T7.7: HTTP Download
+// GET /bytes/<N> from the companion (default 64 MB, Config->TransferBytes)
+// and stream the body through repeated Response calls into one 1 MB
+// buffer, the way HTTP boot pulls an image. Reports time to first
+// byte, per-second Mbps and total time.
+//
+// PASS: Whole body received
+// WARN: Body truncated, non-200 status, or HTTP blocked by policy
+// FAIL: HTTP unavailable, request failed or no response
+// ============================================================
+//
+EFI_STATUS
+TestL7HttpDownload (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS         Status;
+  EFI_HANDLE         ChildHandle;
+  EFI_HTTP_PROTOCOL  *Http;
+  L7_HTTPDL_STATS    Stats;
+  UINT8              *Buf;
+  CHAR16             UrlBuf[128];
+  CHAR8              HostBuf[32];
+  UINT16             Port;
+  UINT64             Size;
+  UINT32             MbpsX10;
+
+  Port = (Config->TargetPort > 0) ? Config->TargetPort : 80;
+  Size = (Config->TransferBytes > 0) ? Config->TransferBytes : L7_HTTPDL_DEFAULT_BYTES;
+
+  Buf = AllocatePool (L7_HTTPDL_BUF_SIZE);
+  if (Buf == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the body buffer");
+    return EFI_SUCCESS;
+  }
+
+  Status = L7HttpOpen (Nic, &ChildHandle, &Http);
+  if (EFI_ERROR (Status)) {
+    FreePool (Buf);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Cannot set up HTTP child: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify HTTP service binding is available (NetworkPkg)");
+    return EFI_SUCCESS;
+  }
+
+  if (Port == 80) {
+    UnicodeSPrint (UrlBuf, sizeof (UrlBuf), L"http://%d.%d.%d.%d/bytes/%llu",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3], Size);
+  } else {
+    UnicodeSPrint (UrlBuf, sizeof (UrlBuf), L"http://%d.%d.%d.%d:%d/bytes/%llu",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3], Port, Size);
+  }
+  AsciiSPrint (HostBuf, sizeof (HostBuf), "%d.%d.%d.%d",
+               Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+               Config->TargetIp.Addr[2], Config->TargetIp.Addr[3]);
+
+  Result->PacketsSent = 1;
+  Status = L7HttpDownload (Http, UrlBuf, HostBuf, Buf, L7_HTTPDL_BUF_SIZE, FALSE, &Stats);
+  L7DestroyHttpChild (Nic->Handle, ChildHandle, Http);
+  FreePool (Buf);
+
+  if (Status == EFI_ACCESS_DENIED) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP blocked by firmware security policy");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Try TCP-level throughput instead (L4 TCP Throughput)");
+    return EFI_SUCCESS;
+  }
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP download of /bytes/%llu failed: %r", Size, Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify the companion HTTP server is running at target IP:%d", Port);
+    return EFI_SUCCESS;
+  }
+
+  Result->PacketsReceived = 1;
+  Result->BytesReceived   = Stats.Bytes;
+  Result->DurationMs      = DivU64x32 (Stats.ElapsedUs, 1000);
+  MbpsX10 = (Stats.ElapsedUs > Stats.TtfbUs) ?
+            (UINT32)DivU64x64Remainder (Stats.Bytes * 80, Stats.ElapsedUs - Stats.TtfbUs, NULL) : 0;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%a, %llu of %llu bytes in %llu ms (TTFB %llu.%llu ms), %d Response calls, "
+                 L"%d KB buffer | Mbps/s: ",
+                 Stats.HttpStatus == HTTP_STATUS_200_OK ? "200 OK" : "non-200", Stats.Bytes, Stats.ContentLength == MAX_UINT64 ? 0 : Stats.ContentLength,
+                 DivU64x32 (Stats.ElapsedUs, 1000),
+                 DivU64x32 (Stats.TtfbUs, 1000), DivU64x32 (Stats.TtfbUs, 100) % 10,
+                 Stats.Calls, L7_HTTPDL_BUF_SIZE / 1024);
+  L7HttpFormatIntervals (&Stats, Result->Detail, sizeof (Result->Detail));
+
+  if (Stats.HttpStatus != HTTP_STATUS_200_OK) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP download not 200 OK (EFI_HTTP_STATUS_CODE %d)", Stats.HttpStatus);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"The server must serve /bytes/<N> (DDTSoft companion)");
+  } else if (Stats.Bytes < Size || EFI_ERROR (Stats.EndStatus)) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP download truncated: %llu of %llu bytes (%r)",
+                   Stats.Bytes, Size, Stats.EndStatus);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Server must serve /bytes/<N>; a stall here would also abort HTTP boot");
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP download %llu MB at %d.%d Mbps (TTFB %llu ms, total %llu ms)",
+                   RShiftU64 (Stats.Bytes, 20), MbpsX10 / 10, MbpsX10 % 10,
+                   DivU64x32 (Stats.TtfbUs, 1000), DivU64x32 (Stats.ElapsedUs, 1000));
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// HTTP load engine (parallel keep-alive children)
+// ============================================================
+//
+
+#define L7_HTTPLD_CHILDREN      8
+#define L7_HTTPLD_DEFAULT_REQS  400
+#define L7_HTTPLD_MAX_REQS      10000
+#define L7_HTTPLD_DEFAULT_MS    10000   // run time cap
+#define L7_HTTPLD_BODY_BUF      4096
+#define L7_HTTPLD_MAX_ERRORS    4       // consecutive failures retire a child
+#define L7_HTTPLD_REUSE_WARN_PERMILLE  900  // < 90% reused: connections not kept alive
+
+typedef enum {
+  L7LoadIdle,
+  L7LoadRequest,                        // Request token queued
+  L7LoadHeaders,                        // first Response token queued
+  L7LoadBody,                           // body Response token queued
+  L7LoadRetired
+} L7_HTTPLD_STATE;
+
+typedef struct {
+  EFI_HANDLE              Handle;
+  EFI_HTTP_PROTOCOL       *Http;
+  L7_HTTPLD_STATE         State;
+  EFI_HTTP_TOKEN          ReqToken;
+  EFI_HTTP_TOKEN          RspToken;
+  EFI_HTTP_MESSAGE        ReqMsg;
+  EFI_HTTP_MESSAGE        RspMsg;
+  EFI_HTTP_REQUEST_DATA   ReqData;
+  EFI_HTTP_RESPONSE_DATA  RspData;
+  EFI_HTTP_HEADER         ReqHeaders[2];
+  UINT64                  Remaining;    // body bytes still to read
+  UINT64                  StartUs;
+  UINTN                   Errors;       // consecutive
+  UINT8                   Body[L7_HTTPLD_BODY_BUF];
+} L7_HTTPLD_CHILD;
+
+typedef struct {
+  UINT32      *LatencyUs;               // completed requests
+  UINTN       Completed;
+  UINTN       Issued;
+  UINTN       Failed;
+  UINTN       NonOk;                    // completed with a non-200 status
+  UINTN       Children;                 // children that could be configured
+  UINTN       Retired;
+  UINT64      ElapsedUs;
+  EFI_STATUS  LastError;
+} L7_HTTPLD_STATS;
+
+/**
+  Queue a Response token on a load child: with headers (first call of a
+  request) or for more body.
+
+  @param[in,out]  Child        Load child.
+  @param[in]      WithHeaders  TRUE for the status line and headers.
+
+  @retval EFI_SUCCESS  Token queued.
+  @retval other        Response refused it.
+**/
+STATIC
+EFI_STATUS
+L7LoadPostResponse (
+  IN OUT L7_HTTPLD_CHILD  *Child,
+  IN     BOOLEAN          WithHeaders
+  )
+{
+  ZeroMem (&Child->RspMsg, sizeof (Child->RspMsg));
+  if (WithHeaders) {
+    ZeroMem (&Child->RspData, sizeof (Child->RspData));
+    Child->RspMsg.Data.Response = &Child->RspData;
+  }
+  Child->RspMsg.BodyLength = sizeof (Child->Body);
+  Child->RspMsg.Body       = Child->Body;
+  Child->RspToken.Status   = EFI_NOT_READY;
+  Child->RspToken.Message  = &Child->RspMsg;
+  return Child->Http->Response (Child->Http, &Child->RspToken);
+}
+
+/**
+  Close the token events and destroy the HTTP children of a load run,
+  then free the child array.
+
+  @param[in]  Nic       NIC the children were created on.
+  @param[in]  Children  Array of L7_HTTPLD_CHILDREN entries.
+**/
+STATIC
+VOID
+L7HttpLoadRelease (
+  IN NIC_INFO         *Nic,
+  IN L7_HTTPLD_CHILD  *Children
+  )
+{
+  UINTN  C;
+
+  for (C = 0; C < L7_HTTPLD_CHILDREN; C++) {
+    if (Children[C].ReqToken.Event != NULL) {
+      gBS->CloseEvent (Children[C].ReqToken.Event);
+    }
+    if (Children[C].RspToken.Event != NULL) {
+      gBS->CloseEvent (Children[C].RspToken.Event);
+    }
+    if (Children[C].Http != NULL) {
+      L7DestroyHttpChild (Nic->Handle, Children[C].Handle, Children[C].Http);
+    }
+  }
+  FreePool (Children);
+}
+
+/**
+  Issue Total GETs spread over the children, each child sending
+  its next request as soon as the previous response is complete, so
+  every child keeps one keep-alive connection busy.
+
+  @param[in]      Children    Configured children (Http set).
+  @param[in]      Count       Number of children.
+  @param[in]      Total       Requests to issue.
+  @param[in]      DurationMs  Run time cap.
+  @param[in,out]  Stats       Results; Stats->LatencyUs holds Total entries.
+**/
+STATIC
+VOID
+L7HttpLoadRun (
+  IN     L7_HTTPLD_CHILD  *Children,
+  IN     UINTN            Count,
+  IN     UINTN            Total,
+  IN     UINT32           DurationMs,
+  IN OUT L7_HTTPLD_STATS  *Stats
+  )
+{
+  L7_HTTPLD_CHILD  *Child;
+  EFI_STATUS       Status;
+  UINT64           StartUs;
+  UINT64           EndUs;
+  UINT64           NowUs;
+  UINT64           LastDoneUs;
+  UINTN            Active;
+  UINTN            C;
+  UINTN            H;
+  BOOLEAN          Done;
+
+  StartUs    = UtilGetTimeUs ();
+  EndUs      = StartUs + (UINT64)DurationMs * 1000;
+  LastDoneUs = StartUs;
+
+  for (;;) {
+    Active = 0;
+    NowUs  = UtilGetTimeUs ();
+
+    for (C = 0; C < Count; C++) {
+      Child  = &Children[C];
+      Status = EFI_SUCCESS;
+      Done   = FALSE;
+
+      switch (Child->State) {
+      case L7LoadRetired:
+        continue;
+
+      case L7LoadIdle:
+        if (Stats->Issued >= Total || NowUs >= EndUs) {
+          continue;
+        }
+        Child->ReqToken.Status  = EFI_NOT_READY;
+        Child->ReqToken.Message = &Child->ReqMsg;
+        Child->StartUs          = NowUs;
+        Status = Child->Http->Request (Child->Http, &Child->ReqToken);
+        if (!EFI_ERROR (Status)) {
+          Child->State = L7LoadRequest;
+          Stats->Issued++;
+        }
+        break;
+
+      case L7LoadRequest:
+        Child->Http->Poll (Child->Http);
+        if (Child->ReqToken.Status == EFI_NOT_READY) {
+          break;
+        }
+        Status = Child->ReqToken.Status;
+        if (!EFI_ERROR (Status)) {
+          Status = L7LoadPostResponse (Child, TRUE);
+        }
+        if (!EFI_ERROR (Status)) {
+          Child->State = L7LoadHeaders;
+        }
+        break;
+
+      case L7LoadHeaders:
+      case L7LoadBody:
+        Child->Http->Poll (Child->Http);
+        if (Child->RspToken.Status == EFI_NOT_READY) {
+          break;
+        }
+        Status = Child->RspToken.Status;
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+        if (Child->State == L7LoadHeaders) {
+          Child->Remaining = 0;
+          for (H = 0; H < Child->RspMsg.HeaderCount; H++) {
+            if (AsciiStriCmp (Child->RspMsg.Headers[H].FieldName, "Content-Length") == 0) {
+              Child->Remaining = AsciiStrDecimalToUint64 (Child->RspMsg.Headers[H].FieldValue);
+            }
+          }
+          if (Child->RspMsg.Headers != NULL) {
+            FreePool (Child->RspMsg.Headers);
+          }
+          if (Child->RspData.StatusCode != HTTP_STATUS_200_OK) {
+            Stats->NonOk++;
+          }
+        }
+        Child->Remaining -= MIN (Child->Remaining, Child->RspMsg.BodyLength);
+        if (Child->Remaining > 0) {
+          Status = L7LoadPostResponse (Child, FALSE);
+          if (!EFI_ERROR (Status)) {
+            Child->State = L7LoadBody;
+          }
+        } else {
+          Done = TRUE;
+        }
+        break;
+      }
+
+      if (EFI_ERROR (Status)) {
+        Stats->Failed++;
+        Stats->LastError = Status;
+        Child->State     = L7LoadIdle;
+        if (++Child->Errors >= L7_HTTPLD_MAX_ERRORS || Status == EFI_ACCESS_DENIED) {
+          Child->State = L7LoadRetired;
+          Stats->Retired++;
+        }
+      } else if (Done) {
+        NowUs = UtilGetTimeUs ();
+        Stats->LatencyUs[Stats->Completed++] = (UINT32)(NowUs - Child->StartUs);
+        Child->Errors = 0;
+        Child->State  = L7LoadIdle;
+        LastDoneUs    = NowUs;
+      }
+
+      if (Child->State != L7LoadIdle && Child->State != L7LoadRetired) {
+        Active++;
+      }
+    }
+
+    if (Active == 0 && (Stats->Issued >= Total || NowUs >= EndUs ||
+                        Stats->Retired == Count)) {
+      break;
+    }
+
+    //
+    // A request stuck past the cap (plus the HTTP timeout) is abandoned
+    //
+    if (NowUs >= EndUs + (UINT64)L7_HTTPDL_IDLE_MS * 1000) {
+      for (C = 0; C < Count; C++) {
+        Child = &Children[C];
+        if (Child->State == L7LoadRequest) {
+          Child->Http->Cancel (Child->Http, &Child->ReqToken);
+        } else if (Child->State == L7LoadHeaders || Child->State == L7LoadBody) {
+          Child->Http->Cancel (Child->Http, &Child->RspToken);
+        }
+      }
+      break;
+    }
+  }
+
+  Stats->ElapsedUs = LastDoneUs - StartUs;
+}
+
+//
+// ============================================================
+// Test T7.8: HTTP Load
+// Issue Config->Iterations GETs (default 400) over L7_HTTPLD_CHILDREN
+// parallel HTTP children with asynchronous Request/Response tokens;
+// each child reuses its keep-alive connection for its next request.
+// The companion counts the connections the requests arrived on, giving
+// the connection reuse ratio.
+//
+// PASS: All requests succeeded, >= 90% on reused connections
+// WARN: Failures, non-200 answers, low reuse, or no companion count
+// FAIL: HTTP unavailable or no request completed
+// ============================================================
+//
+EFI_STATUS
+TestL7HttpLoad (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS       Status;
+  EFI_STATUS       LinkStatus;
+  COMPANION_LINK   Link;
+  BOOLEAN          LinkUp;
+  CHAR8            Args[64];
+  CONST CHAR8      *Report;
+  L7_HTTPLD_CHILD  *Children;
+  L7_HTTPLD_STATS  Stats;
+  CHAR16           UrlBuf[128];
+  CHAR8            HostBuf[32];
+  UINT16           Port;
+  UINTN            Total;
+  UINTN            C;
+  UINT64           Conns;
+  UINT64           Served;
+  UINT64           LatSum;
+  UINT32           Rps;
+  UINT32           ReusePermille;
+
+  Port  = (Config->TargetPort > 0) ? Config->TargetPort : 80;
+  Total = (Config->Iterations > 0 && Config->Iterations <= L7_HTTPLD_MAX_REQS) ?
+          Config->Iterations : L7_HTTPLD_DEFAULT_REQS;
+
+  ZeroMem (&Stats, sizeof (Stats));
+  Children        = AllocateZeroPool (L7_HTTPLD_CHILDREN * sizeof (L7_HTTPLD_CHILD));
+  Stats.LatencyUs = AllocatePool (Total * sizeof (UINT32));
+  if (Children == NULL || Stats.LatencyUs == NULL) {
+    if (Children != NULL) {
+      FreePool (Children);
+    }
+    if (Stats.LatencyUs != NULL) {
+      FreePool (Stats.LatencyUs);
+    }
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for HTTP load children");
+    return EFI_SUCCESS;
+  }
+
+  if (Port == 80) {
+    UnicodeSPrint (UrlBuf, sizeof (UrlBuf), L"http://%d.%d.%d.%d/",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3]);
+  } else {
+    UnicodeSPrint (UrlBuf, sizeof (UrlBuf), L"http://%d.%d.%d.%d:%d/",
+                   Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+                   Config->TargetIp.Addr[2], Config->TargetIp.Addr[3], Port);
+  }
+  AsciiSPrint (HostBuf, sizeof (HostBuf), "%d.%d.%d.%d",
+               Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+               Config->TargetIp.Addr[2], Config->TargetIp.Addr[3]);
+
+  //
+  // Children share the URL and headers; each owns its tokens and buffer
+  //
+  Status = EFI_SUCCESS;
+  for (C = 0; C < L7_HTTPLD_CHILDREN; C++) {
+    Status = L7HttpOpen (Nic, &Children[C].Handle, &Children[C].Http);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L7NotifyStub, NULL,
+                               &Children[C].ReqToken.Event);
+    if (!EFI_ERROR (Status)) {
+      Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L7NotifyStub, NULL,
+                                 &Children[C].RspToken.Event);
+    }
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    Children[C].ReqHeaders[0].FieldName  = "Host";
+    Children[C].ReqHeaders[0].FieldValue = HostBuf;
+    Children[C].ReqHeaders[1].FieldName  = "User-Agent";
+    Children[C].ReqHeaders[1].FieldValue = "DDTSoft/1.0";
+    Children[C].ReqData.Method           = HttpMethodGet;
+    Children[C].ReqData.Url              = UrlBuf;
+    Children[C].ReqMsg.Data.Request      = &Children[C].ReqData;
+    Children[C].ReqMsg.HeaderCount       = 2;
+    Children[C].ReqMsg.Headers           = Children[C].ReqHeaders;
+    Children[C].State                    = L7LoadIdle;
+    Stats.Children++;
+  }
+
+  if (Stats.Children == 0) {
+    L7HttpLoadRelease (Nic, Children);
+    FreePool (Stats.LatencyUs);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Cannot set up HTTP child: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify HTTP service binding is available (NetworkPkg)");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Have the companion count connections and requests for this run
+  //
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args), "children=%d requests=%d", Stats.Children, Total);
+      LinkStatus = CompanionPrepareStart (&Link, "L7", "HTTP_LOAD", Args);
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  L7HttpLoadRun (Children, Stats.Children, Total,
+                 (Config->DurationMs > 0) ? Config->DurationMs : L7_HTTPLD_DEFAULT_MS, &Stats);
+
+  L7HttpLoadRelease (Nic, Children);
+
+  Conns  = 0;
+  Served = 0;
+  if (LinkUp) {
+    LinkStatus = CompanionStopResult (&Link, &Report);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionResultValue (Report, "http_conns", &Conns);
+    }
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionResultValue (Report, "http_requests", &Served);
+    }
+    LinkUp = !EFI_ERROR (LinkStatus) && Served > 0;
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+  }
+
+  Result->PacketsSent     = Stats.Issued;
+  Result->PacketsReceived = Stats.Completed;
+
+  if (Stats.Completed == 0) {
+    FreePool (Stats.LatencyUs);
+    if (Stats.LastError == EFI_ACCESS_DENIED) {
+      Result->StatusCode = TEST_RESULT_WARN;
+      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                     L"HTTP blocked by firmware security policy");
+      return EFI_SUCCESS;
+    }
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP load: no request completed (%d failed, last %r)",
+                   Stats.Failed, Stats.LastError);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify the companion HTTP server is running at target IP:%d", Port);
+    return EFI_SUCCESS;
+  }
+
+  LatSum = 0;
+  for (C = 0; C < Stats.Completed; C++) {
+    LatSum += Stats.LatencyUs[C];
+  }
+  UtilSortUint32 (Stats.LatencyUs, Stats.Completed);
+  Result->RttMinUs    = Stats.LatencyUs[0];
+  Result->RttAvgUs    = (UINT32)DivU64x64Remainder (LatSum, Stats.Completed, NULL);
+  Result->RttMaxUs    = Stats.LatencyUs[Stats.Completed - 1];
+  Result->RttJitterUs = UtilPercentile (Stats.LatencyUs, Stats.Completed, 99) -
+                        UtilPercentile (Stats.LatencyUs, Stats.Completed, 50);
+  Result->DurationMs  = DivU64x32 (Stats.ElapsedUs, 1000);
+
+  Rps = (Stats.ElapsedUs > 0) ?
+        (UINT32)DivU64x64Remainder ((UINT64)Stats.Completed * 1000000, Stats.ElapsedUs, NULL) : 0;
+  ReusePermille = (LinkUp && Served > Conns) ?
+                  (UINT32)DivU64x64Remainder ((Served - Conns) * 1000, Served, NULL) : 0;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d children, %d/%d requests OK in %llu ms, %d failed, %d non-200, %d children retired | "
+                 L"latency p50=%d p90=%d p99=%d max=%d us | companion: %llu requests on %llu connections",
+                 Stats.Children, Stats.Completed, Total, DivU64x32 (Stats.ElapsedUs, 1000),
+                 Stats.Failed, Stats.NonOk, Stats.Retired,
+                 UtilPercentile (Stats.LatencyUs, Stats.Completed, 50),
+                 UtilPercentile (Stats.LatencyUs, Stats.Completed, 90),
+                 UtilPercentile (Stats.LatencyUs, Stats.Completed, 99),
+                 Stats.LatencyUs[Stats.Completed - 1],
+                 Served, Conns);
+
+  if (Stats.Failed > 0 || Stats.NonOk > 0 || Stats.Completed < Total) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP load %d req/s, %d of %d requests failed (last %r)",
+                   Rps, Total - (Stats.Completed - Stats.NonOk), Total, Stats.LastError);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Lower Iterations or check the firmware HTTP driver's connection handling");
+  } else if (!LinkUp) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP load %d req/s, p50 %d us (no companion count: reuse unknown)",
+                   Rps, UtilPercentile (Stats.LatencyUs, Stats.Completed, 50));
+  } else if (ReusePermille < L7_HTTPLD_REUSE_WARN_PERMILLE) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP load %d req/s, only %d.%d%% of requests reused a connection",
+                   Rps, ReusePermille / 10, ReusePermille % 10);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Firmware HTTP driver reconnects per request (no keep-alive)");
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTP load %d req/s over %d children, p50 %d us, p99 %d us, %d.%d%% reuse",
+                   Rps, Stats.Children,
+                   UtilPercentile (Stats.LatencyUs, Stats.Completed, 50),
+                   UtilPercentile (Stats.LatencyUs, Stats.Completed, 99),
+                   ReusePermille / 10, ReusePermille % 10);
+  }
+
+  FreePool (Stats.LatencyUs);
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// DNS benchmark engine (concurrent HostNameToIp tokens)
+// ============================================================
+//
+
+#define L7_DNSB_DEFAULT_NAMES   256
+#define L7_DNSB_MAX_NAMES       2048
+#define L7_DNSB_WINDOW          32      // outstanding queries
+#define L7_DNSB_PHASE_MS        30000   // cap per phase
+#define L7_DNSB_NAME_LEN        64
+#define L7_DNSB_SUFFIX          "bench.test.ddtsoft.local"  // without a companion READY
+#define L7_DNSB_SUFFIX_LEN      40
+
+typedef struct {
+  EFI_DNS4_COMPLETION_TOKEN  Token;
+  UINT64                     StartUs;
+  BOOLEAN                    Busy;
+} L7_DNSB_SLOT;
+
+typedef struct {
+  UINT32      *LatencyUs;               // successful lookups
+  UINTN       Issued;
+  UINTN       Completed;
+  UINTN       Failed;
+  UINTN       Sync;                     // answered inside HostNameToIp (cache hit)
+  UINT64      ElapsedUs;
+  EFI_STATUS  LastError;
+} L7_DNSB_PHASE;
+
+/**
+  Create a DNS4 child pointed at Server (else the gateway) with the
+  driver cache enabled.
+
+  @param[in]   Nic          NIC to create the child on.
+  @param[in]   Config       Test configuration.
+  @param[in]   Server       DNS server to query, or NULL for the gateway.
+  @param[out]  ChildHandle  Child handle.
+  @param[out]  Dns4         Configured DNS4 instance.
+  @param[out]  DnsServer    Server the child queries.
+
+  @retval EFI_SUCCESS  Child created and configured.
+  @retval other        Creation or Configure failed; nothing is left open.
+**/
+STATIC
+EFI_STATUS
+L7DnsOpen (
+  IN  NIC_INFO           *Nic,
+  IN  TEST_CONFIG        *Config,
+  IN  EFI_IPv4_ADDRESS   *Server  OPTIONAL,
+  OUT EFI_HANDLE         *ChildHandle,
+  OUT EFI_DNS4_PROTOCOL  **Dns4,
+  OUT EFI_IPv4_ADDRESS   *DnsServer
+  )
+{
+  EFI_STATUS            Status;
+  EFI_DNS4_CONFIG_DATA  DnsCfg;
+
+  if (Server != NULL) {
+    CopyMem (DnsServer, Server, sizeof (EFI_IPv4_ADDRESS));
+  } else if (Config->Gateway.Addr[0] != 0 || Config->Gateway.Addr[1] != 0 ||
+             Config->Gateway.Addr[2] != 0 || Config->Gateway.Addr[3] != 0) {
+    CopyMem (DnsServer, &Config->Gateway, sizeof (EFI_IPv4_ADDRESS));
+  } else {
+    CopyMem (DnsServer, &Nic->Gateway, sizeof (EFI_IPv4_ADDRESS));
+  }
+
+  Status = L7CreateDnsChild (Nic->Handle, ChildHandle, Dns4);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem (&DnsCfg, sizeof (DnsCfg));
+  DnsCfg.DnsServerListCount = 1;
+  DnsCfg.DnsServerList      = DnsServer;
+  DnsCfg.UseDefaultSetting  = FALSE;
+  DnsCfg.EnableDnsCache     = TRUE;
+  DnsCfg.Protocol           = IP_PROTO_UDP;
+  CopyMem (&DnsCfg.StationIp, &Nic->Ipv4Address, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&DnsCfg.SubnetMask, &Nic->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  DnsCfg.LocalPort          = 0;
+  DnsCfg.RetryCount         = 2;
+  DnsCfg.RetryInterval      = 3;
+
+  Status = (*Dns4)->Configure (*Dns4, &DnsCfg);
+  if (EFI_ERROR (Status)) {
+    L7DestroyDnsChild (Nic->Handle, *ChildHandle, *Dns4);
+    *ChildHandle = NULL;
+    *Dns4        = NULL;
+  }
+  return Status;
+}
+
+/**
+  Account a finished lookup and release its answer.
+
+  @param[in,out]  Slot   Slot whose token has completed.
+  @param[in]      NowUs  Completion time.
+  @param[in,out]  Phase  Phase statistics.
+**/
+STATIC
+VOID
+L7DnsBenchComplete (
+  IN OUT L7_DNSB_SLOT   *Slot,
+  IN     UINT64         NowUs,
+  IN OUT L7_DNSB_PHASE  *Phase
+  )
+{
+  DNS_HOST_TO_ADDR_DATA  *H2A;
+
+  H2A = Slot->Token.RspData.H2AData;
+  if (!EFI_ERROR (Slot->Token.Status) && H2A != NULL && H2A->IpCount > 0) {
+    Phase->LatencyUs[Phase->Completed++] = (UINT32)(NowUs - Slot->StartUs);
+  } else {
+    Phase->Failed++;
+    Phase->LastError = EFI_ERROR (Slot->Token.Status) ? Slot->Token.Status : EFI_NOT_FOUND;
+  }
+  if (H2A != NULL) {
+    if (H2A->IpList != NULL) {
+      FreePool (H2A->IpList);
+    }
+    FreePool (H2A);
+  }
+  Slot->Token.RspData.H2AData = NULL;
+  Slot->Busy                  = FALSE;
+}
+
+/**
+  Resolve every name with up to L7_DNSB_WINDOW lookups outstanding,
+  refilling a slot as soon as its lookup completes.
+
+  @param[in]      Dns4   Configured DNS4 instance.
+  @param[in,out]  Slots  L7_DNSB_WINDOW slots with token events created.
+  @param[in]      Names  Count names of L7_DNSB_NAME_LEN characters.
+  @param[in]      Count  Number of names.
+  @param[in,out]  Phase  Phase statistics; LatencyUs holds Count entries.
+**/
+STATIC
+VOID
+L7DnsBenchPhase (
+  IN     EFI_DNS4_PROTOCOL  *Dns4,
+  IN OUT L7_DNSB_SLOT       *Slots,
+  IN     CHAR16             *Names,
+  IN     UINTN              Count,
+  IN OUT L7_DNSB_PHASE      *Phase
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      StartUs;
+  UINT64      NowUs;
+  UINTN       Outstanding;
+  UINTN       S;
+
+  Outstanding = 0;
+  StartUs     = UtilGetTimeUs ();
+
+  while (Phase->Issued < Count || Outstanding > 0) {
+    for (S = 0; S < L7_DNSB_WINDOW && Phase->Issued < Count; S++) {
+      if (Slots[S].Busy) {
+        continue;
+      }
+      Slots[S].Token.Status           = EFI_NOT_READY;
+      Slots[S].Token.RspData.H2AData  = NULL;
+      Slots[S].StartUs                = UtilGetTimeUs ();
+      Status = Dns4->HostNameToIp (Dns4, &Names[Phase->Issued * L7_DNSB_NAME_LEN],
+                                   &Slots[S].Token);
+      Phase->Issued++;
+      if (EFI_ERROR (Status)) {
+        Phase->Failed++;
+        Phase->LastError = Status;
+        continue;
+      }
+      Slots[S].Busy = TRUE;
+      if (Slots[S].Token.Status != EFI_NOT_READY) {
+        //
+        // Answered from the driver cache without a query
+        //
+        Phase->Sync++;
+        L7DnsBenchComplete (&Slots[S], UtilGetTimeUs (), Phase);
+      } else {
+        Outstanding++;
+      }
+    }
+
+    Dns4->Poll (Dns4);
+    NowUs = UtilGetTimeUs ();
+    for (S = 0; S < L7_DNSB_WINDOW; S++) {
+      if (Slots[S].Busy && Slots[S].Token.Status != EFI_NOT_READY) {
+        L7DnsBenchComplete (&Slots[S], NowUs, Phase);
+        Outstanding--;
+      }
+    }
+
+    if (NowUs - StartUs >= (UINT64)L7_DNSB_PHASE_MS * 1000) {
+      for (S = 0; S < L7_DNSB_WINDOW; S++) {
+        if (Slots[S].Busy) {
+          //
+          // Complete frees any answer the driver attached before the cancel
+          //
+          Dns4->Cancel (Dns4, &Slots[S].Token);
+          Slots[S].Token.Status = EFI_TIMEOUT;
+          L7DnsBenchComplete (&Slots[S], NowUs, Phase);
+        }
+      }
+      break;
+    }
+  }
+
+  Phase->ElapsedUs = UtilGetTimeUs () - StartUs;
+}
+
+/**
+  Read the companion's DNS query counter for this DUT.
+
+  @param[in]   Link     Connected companion link.
+  @param[out]  Queries  Queries the companion has answered since PREPARE.
+
+  @retval TRUE   Counter read.
+  @retval FALSE  No report.
+**/
+STATIC
+BOOLEAN
+L7DnsBenchQueries (
+  IN  COMPANION_LINK  *Link,
+  OUT UINT64          *Queries
+  )
+{
+  CONST CHAR8 *Report;
+
+  if (EFI_ERROR (CompanionGetResult (Link, &Report))) {
+    return FALSE;
+  }
+  return !EFI_ERROR (CompanionResultValue (Report, "queries", Queries));
+}
+
+//
+// ============================================================
+// Test T7.9: DNS Benchmark
+// Resolve Config->Iterations generated names (default 256) under the
+// companion's wildcard domain with L7_DNSB_WINDOW lookups outstanding.
+// With a companion link the queries go to the companion (TargetIp),
+// which names that domain in its READY (dns_suffix=); without one the
+// gateway is queried and L7_DNSB_SUFFIX is assumed.
+// The names carry a per-run tag, so the first pass is all cache misses
+// that reach the server (cold); the second pass resolves the same
+// names again and should be answered from the DNS4 driver cache (warm).
+// Reports QPS and separate latency distributions for both passes; the
+// companion's query count confirms which lookups went on the wire.
+//
+// PASS: All names resolved, warm pass served from the cache
+// WARN: Failed lookups, warm lookups reaching the server, no companion
+// FAIL: DNS4 unavailable or no cold lookup resolved
+// ============================================================
+//
+EFI_STATUS
+TestL7DnsBench (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS         Status;
+  EFI_HANDLE         ChildHandle;
+  EFI_DNS4_PROTOCOL  *Dns4;
+  EFI_IPv4_ADDRESS   DnsServer;
+  COMPANION_LINK     Link;
+  BOOLEAN            LinkUp;
+  BOOLEAN            Counted;
+  L7_DNSB_SLOT       *Slots;
+  L7_DNSB_PHASE      Cold;
+  L7_DNSB_PHASE      Warm;
+  CHAR16             *Names;
+  CHAR8              Suffix[L7_DNSB_SUFFIX_LEN];
+  UINTN              Count;
+  UINTN              I;
+  UINT32             RunTag;
+  UINT64             ColdQueries;
+  UINT64             AllQueries;
+  UINT64             WarmQueries;
+  UINT64             LatSum;
+  UINT32             ColdQps;
+  UINT32             WarmQps;
+
+  Count = (Config->Iterations > 0 && Config->Iterations <= L7_DNSB_MAX_NAMES) ?
+          Config->Iterations : L7_DNSB_DEFAULT_NAMES;
+
+  ZeroMem (&Cold, sizeof (Cold));
+  ZeroMem (&Warm, sizeof (Warm));
+  LinkUp         = FALSE;
+  Slots          = AllocateZeroPool (L7_DNSB_WINDOW * sizeof (L7_DNSB_SLOT));
+  Names          = AllocateZeroPool (Count * L7_DNSB_NAME_LEN * sizeof (CHAR16));
+  Cold.LatencyUs = AllocatePool (Count * sizeof (UINT32));
+  Warm.LatencyUs = AllocatePool (Count * sizeof (UINT32));
+  if (Slots == NULL || Names == NULL || Cold.LatencyUs == NULL || Warm.LatencyUs == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  //
+  // The companion's query counter only sees lookups sent to it, so
+  // with a link up the companion is also the DNS server
+  //
+  if (Config->TargetIp.Addr[0] != 0 || Config->TargetIp.Addr[1] != 0 ||
+      Config->TargetIp.Addr[2] != 0 || Config->TargetIp.Addr[3] != 0) {
+    if (!EFI_ERROR (CompanionAttach (&Link, Nic->Handle, &Config->TargetIp))) {
+      LinkUp = !EFI_ERROR (CompanionConnect (&Link)) &&
+               !EFI_ERROR (CompanionPrepare (&Link, "L7", "DNS_BENCH", ""));
+      if (!LinkUp) {
+        CompanionDestroy (&Link);
+      }
+    }
+  }
+  if (!LinkUp ||
+      EFI_ERROR (CompanionResultString (Link.ReadyDetail, "dns_suffix", Suffix, sizeof (Suffix)))) {
+    AsciiStrCpyS (Suffix, sizeof (Suffix), L7_DNSB_SUFFIX);
+  }
+
+  Status = L7DnsOpen (Nic, Config, LinkUp ? &Config->TargetIp : NULL,
+                      &ChildHandle, &Dns4, &DnsServer);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  for (I = 0; I < L7_DNSB_WINDOW; I++) {
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, L7NotifyStub, NULL,
+                               &Slots[I].Token.Event);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  if (EFI_ERROR (Status)) {
+    goto CloseChild;
+  }
+
+  ColdQueries = 0;
+  AllQueries  = 0;
+
+  //
+  // A fresh tag per run keeps earlier runs' cache entries out of the cold pass
+  //
+  RunTag = (UINT32)UtilGetTimeUs ();
+  for (I = 0; I < Count; I++) {
+    UnicodeSPrint (&Names[I * L7_DNSB_NAME_LEN], L7_DNSB_NAME_LEN * sizeof (CHAR16),
+                   L"q%x-%d.%a", RunTag, I, Suffix);
+  }
+
+  L7DnsBenchPhase (Dns4, Slots, Names, Count, &Cold);
+  Counted = LinkUp && L7DnsBenchQueries (&Link, &ColdQueries);
+  L7DnsBenchPhase (Dns4, Slots, Names, Count, &Warm);
+  Counted = Counted && L7DnsBenchQueries (&Link, &AllQueries);
+  WarmQueries = Counted ? AllQueries - ColdQueries : 0;
+  if (!Counted) {
+    ColdQueries = 0;
+  }
+
+  Result->PacketsSent     = Cold.Issued + Warm.Issued;
+  Result->PacketsReceived = Cold.Completed + Warm.Completed;
+  Result->DurationMs      = DivU64x32 (Cold.ElapsedUs + Warm.ElapsedUs, 1000);
+
+  if (Cold.Completed == 0) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DNS benchmark: no name resolved (%d failed, last %r)",
+                   Cold.Failed, Cold.LastError);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check the DNS server at %d.%d.%d.%d serves *.%a",
+                   DnsServer.Addr[0], DnsServer.Addr[1],
+                   DnsServer.Addr[2], DnsServer.Addr[3], Suffix);
+    goto CloseEvents;
+  }
+
+  //
+  // Cold (miss) latencies go into the RTT fields
+  //
+  LatSum = 0;
+  for (I = 0; I < Cold.Completed; I++) {
+    LatSum += Cold.LatencyUs[I];
+  }
+  UtilSortUint32 (Cold.LatencyUs, Cold.Completed);
+  if (Warm.Completed > 0) {
+    UtilSortUint32 (Warm.LatencyUs, Warm.Completed);
+  }
+  Result->RttMinUs    = Cold.LatencyUs[0];
+  Result->RttAvgUs    = (UINT32)DivU64x64Remainder (LatSum, Cold.Completed, NULL);
+  Result->RttMaxUs    = Cold.LatencyUs[Cold.Completed - 1];
+  Result->RttJitterUs = UtilPercentile (Cold.LatencyUs, Cold.Completed, 99) -
+                        UtilPercentile (Cold.LatencyUs, Cold.Completed, 50);
+
+  ColdQps = (Cold.ElapsedUs > 0) ?
+            (UINT32)DivU64x64Remainder ((UINT64)Cold.Completed * 1000000, Cold.ElapsedUs, NULL) : 0;
+  WarmQps = (Warm.ElapsedUs > 0) ?
+            (UINT32)DivU64x64Remainder ((UINT64)Warm.Completed * 1000000, Warm.ElapsedUs, NULL) : 0;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d names, %d outstanding | cold: %d/%d OK, %d qps, "
+                 L"miss p50=%d p90=%d p99=%d max=%d us | warm: %d/%d OK, %d qps, %d from cache, "
+                 L"hit p50=%d p99=%d max=%d us | server queries cold=%llu warm=%llu%s",
+                 Count, L7_DNSB_WINDOW,
+                 Cold.Completed, Count, ColdQps,
+                 UtilPercentile (Cold.LatencyUs, Cold.Completed, 50),
+                 UtilPercentile (Cold.LatencyUs, Cold.Completed, 90),
+                 UtilPercentile (Cold.LatencyUs, Cold.Completed, 99),
+                 Cold.LatencyUs[Cold.Completed - 1],
+                 Warm.Completed, Count, WarmQps, Warm.Sync,
+                 UtilPercentile (Warm.LatencyUs, Warm.Completed, 50),
+                 UtilPercentile (Warm.LatencyUs, Warm.Completed, 99),
+                 (Warm.Completed > 0) ? Warm.LatencyUs[Warm.Completed - 1] : 0,
+                 ColdQueries, WarmQueries,
+                 Counted ? L"" : L" (no companion count)");
+
+  if (Cold.Failed > 0 || Warm.Failed > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DNS %d qps, %d of %d lookups failed (last %r)",
+                   ColdQps, Cold.Failed + Warm.Failed, 2 * Count,
+                   EFI_ERROR (Cold.LastError) ? Cold.LastError : Warm.LastError);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Lookups lost or timed out under %d outstanding queries",
+                   L7_DNSB_WINDOW);
+  } else if (Warm.Sync < Warm.Completed || WarmQueries > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DNS %d qps, but only %d of %d repeat lookups hit the cache",
+                   ColdQps, Warm.Sync, Warm.Completed);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"DNS4 driver cache not used (EnableDnsCache ignored?)");
+  } else if (!Counted) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DNS %d qps, miss p50 %d us, hit p50 %d us (no companion count)",
+                   ColdQps, UtilPercentile (Cold.LatencyUs, Cold.Completed, 50),
+                   UtilPercentile (Warm.LatencyUs, Warm.Completed, 50));
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DNS %d qps, miss p50 %d us / p99 %d us, hit p50 %d us",
+                   ColdQps, UtilPercentile (Cold.LatencyUs, Cold.Completed, 50),
+                   UtilPercentile (Cold.LatencyUs, Cold.Completed, 99),
+                   UtilPercentile (Warm.LatencyUs, Warm.Completed, 50));
+  }
+
+CloseEvents:
+  Status = EFI_SUCCESS;
+CloseChild:
+  for (I = 0; I < L7_DNSB_WINDOW; I++) {
+    if (Slots[I].Token.Event != NULL) {
+      gBS->CloseEvent (Slots[I].Token.Event);
+    }
+  }
+  L7DestroyDnsChild (Nic->Handle, ChildHandle, Dns4);
+Done:
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Cannot set up DNS benchmark: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify DNS4 service binding is available");
+  }
+  if (LinkUp) {
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+  }
+  if (Slots != NULL) {
+    FreePool (Slots);
+  }
+  if (Names != NULL) {
+    FreePool (Names);
+  }
+  if (Cold.LatencyUs != NULL) {
+    FreePool (Cold.LatencyUs);
+  }
+  if (Warm.LatencyUs != NULL) {
+    FreePool (Warm.LatencyUs);
+  }
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// DHCP lease benchmark
+// ============================================================
+//
+
+#define L7_DHCPB_DEFAULT_CYCLES  10
+#define L7_DHCPB_MAX_CYCLES      100
+#define L7_DHCPB_TRY_COUNT       2
+
+//
+// Per-cycle phase samples, one array of Count entries each
+//
+typedef enum {
+  L7DhcpPhaseOffer,                     // first Discover -> first Offer (server/relay)
+  L7DhcpPhaseSelect,                    // first Offer -> first Request (client)
+  L7DhcpPhaseAck,                       // first Request -> Ack (server/relay)
+  L7DhcpPhaseTotal,                     // Start -> bound
+  L7DhcpPhaseMax
+} L7_DHCPB_PHASE;
+
+STATIC CONST CHAR16  *mL7DhcpPhaseName[L7DhcpPhaseMax] = {
+  L"Discover->Offer", L"Offer->Request", L"Request->Ack", L"total"
+};
+
+//
+// ============================================================
+// Test T7.10: DHCP Lease Benchmark
+// Acquire and release a lease Config->Iterations times (default 10)
+// with synchronous Start and the DORA timing callback, then report the
+// p50/p90/max of each phase, pointing at the bottleneck: the server or
+// relay (Offer/Ack wait) or the client (Offer->Request). The Discover
+// and Request try timeouts are set explicitly (4 s, then 8 s). The
+// driver retransmits without a callback, so an Offer or Ack wait that
+// reaches the first try timeout is only counted as a timed-out try:
+// a lost packet that was resent and a server slower than 4 s look the
+// same from here.
+//
+// PASS: Every cycle bound without NAK or timed-out try
+// WARN: Some cycles failed, NAKed or waited past a try timeout
+// FAIL: DHCP unavailable or no cycle bound
+// ============================================================
+//
+EFI_STATUS
+TestL7DhcpBench (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS             Status;
+  EFI_STATUS             LastError;
+  EFI_HANDLE             ChildHandle;
+  EFI_DHCP4_PROTOCOL     *Dhcp4;
+  EFI_DHCP4_CONFIG_DATA  CfgData;
+  L7_DHCP_TIMING         Timing;
+  UINT32                 TryTimeout[L7_DHCPB_TRY_COUNT];
+  UINT32                 *Samples;
+  UINT32                 *Phase[L7DhcpPhaseMax];
+  UINT32                 P50[L7DhcpPhaseMax];
+  UINTN                  Count;
+  UINTN                  Cycle;
+  UINTN                  Bound;
+  UINTN                  Failed;
+  UINTN                  Naks;
+  UINTN                  TimedOut;
+  UINTN                  Used;
+  UINTN                  P;
+  UINTN                  Slowest;
+  UINT64                 StartUs;
+
+  Count = (Config->Iterations > 0 && Config->Iterations <= L7_DHCPB_MAX_CYCLES) ?
+          Config->Iterations : L7_DHCPB_DEFAULT_CYCLES;
+
+  Samples = AllocatePool (L7DhcpPhaseMax * Count * sizeof (UINT32));
+  if (Samples == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for DHCP samples");
+    return EFI_SUCCESS;
+  }
+  for (P = 0; P < L7DhcpPhaseMax; P++) {
+    Phase[P] = Samples + P * Count;
+  }
+
+  Status = L7CreateDhcpChild (Nic->Handle, &ChildHandle, &Dhcp4);
+  if (EFI_ERROR (Status)) {
+    FreePool (Samples);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Cannot create DHCP4 child: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify DHCP4 service binding is available on this NIC");
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Explicit RFC 2131 style backoff rather than the driver defaults, so
+  // the timed-out try threshold below is known
+  //
+  TryTimeout[0] = 4;
+  TryTimeout[1] = 8;
+  ZeroMem (&CfgData, sizeof (CfgData));
+  CfgData.DiscoverTryCount = L7_DHCPB_TRY_COUNT;
+  CfgData.DiscoverTimeout  = TryTimeout;
+  CfgData.RequestTryCount  = L7_DHCPB_TRY_COUNT;
+  CfgData.RequestTimeout   = TryTimeout;
+  CfgData.Dhcp4Callback    = L7DhcpTimingCallback;
+  CfgData.CallbackContext  = &Timing;
+
+  Bound     = 0;
+  Failed    = 0;
+  Naks      = 0;
+  TimedOut  = 0;
+  LastError = EFI_SUCCESS;
+  StartUs   = UtilGetTimeUs ();
+
+  for (Cycle = 0; Cycle < Count; Cycle++) {
+    ZeroMem (&Timing, sizeof (Timing));
+    Status = Dhcp4->Configure (Dhcp4, &CfgData);
+    if (EFI_ERROR (Status)) {
+      LastError = Status;
+      Failed   += Count - Cycle;
+      break;
+    }
+
+    //
+    // Synchronous Start: returns once bound or out of retries
+    //
+    Timing.StartUs = UtilGetTimeUs ();
+    Status = Dhcp4->Start (Dhcp4, NULL);
+
+    //
+    // A reply that took the whole first try timeout came after that try
+    // expired (lost and resent, or just slow)
+    //
+    if (Timing.OfferUs != 0 && Timing.OfferUs - Timing.DiscoverUs >= (UINT64)TryTimeout[0] * 1000000) {
+      TimedOut++;
+    }
+    if (Timing.AckUs != 0 && Timing.AckUs - Timing.RequestUs >= (UINT64)TryTimeout[0] * 1000000) {
+      TimedOut++;
+    }
+    Naks += Timing.Nak ? 1 : 0;
+
+    if (!EFI_ERROR (Status) && Timing.BoundUs != 0 && Timing.AckUs != 0) {
+      Phase[L7DhcpPhaseOffer][Bound]  = (UINT32)(Timing.OfferUs - Timing.DiscoverUs);
+      Phase[L7DhcpPhaseSelect][Bound] = (UINT32)(Timing.RequestUs - Timing.OfferUs);
+      Phase[L7DhcpPhaseAck][Bound]    = (UINT32)(Timing.AckUs - Timing.RequestUs);
+      Phase[L7DhcpPhaseTotal][Bound]  = (UINT32)(Timing.BoundUs - Timing.StartUs);
+      Bound++;
+      Dhcp4->Release (Dhcp4);
+    } else {
+      Failed++;
+      LastError = EFI_ERROR (Status) ? Status : EFI_NOT_READY;
+    }
+
+    Dhcp4->Stop (Dhcp4);
+    Dhcp4->Configure (Dhcp4, NULL);
+  }
+
+  L7DestroyDhcpChild (Nic->Handle, ChildHandle, Dhcp4);
+
+  Result->PacketsSent     = Count;
+  Result->PacketsReceived = Bound;
+  Result->DurationMs      = DivU64x32 (UtilGetTimeUs () - StartUs, 1000);
+
+  if (Bound == 0) {
+    FreePool (Samples);
+    Result->StatusCode = (LastError == EFI_TIMEOUT || LastError == EFI_NO_RESPONSE) ?
+                         TEST_RESULT_WARN : TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP benchmark: no lease in %d cycles (%r)", Count, LastError);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   (LastError == EFI_ACCESS_DENIED) ?
+                   L"Another DHCP instance may already be active" :
+                   L"Verify DHCP server is running on the network");
+    return EFI_SUCCESS;
+  }
+
+  Used    = 0;
+  Slowest = L7DhcpPhaseOffer;
+  for (P = 0; P < L7DhcpPhaseMax; P++) {
+    UtilSortUint32 (Phase[P], Bound);
+    P50[P] = UtilPercentile (Phase[P], Bound, 50);
+    if (P < L7DhcpPhaseTotal && P50[P] > P50[Slowest]) {
+      Slowest = P;
+    }
+    Used += UnicodeSPrint (Result->Detail + Used, sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                           L"%s p50=%d p90=%d max=%d us | ",
+                           mL7DhcpPhaseName[P], P50[P],
+                           UtilPercentile (Phase[P], Bound, 90),
+                           Phase[P][Bound - 1]);
+  }
+  UnicodeSPrint (Result->Detail + Used, sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                 L"%d/%d bound, %d failed, %d NAK, %d waits >= %ds try timeout",
+                 Bound, Count, Failed, Naks, TimedOut, TryTimeout[0]);
+
+  Result->RttMinUs = Phase[L7DhcpPhaseTotal][0];
+  Result->RttAvgUs = P50[L7DhcpPhaseTotal];
+  Result->RttMaxUs = Phase[L7DhcpPhaseTotal][Bound - 1];
+
+  if (TimedOut > 0) {
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"%d Offer/Ack waits reached the %ds try timeout: reply lost or server slow",
+                   TimedOut, TryTimeout[0]);
+  } else if (Slowest == L7DhcpPhaseSelect) {
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Client-side offer processing (Offer->Request) dominates");
+  } else if (P50[L7DhcpPhaseOffer] > 2 * P50[L7DhcpPhaseAck]) {
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Server slow to offer (address allocation or ping check); Ack is fast");
+  } else {
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Offer and Ack waits are similar: server/relay round trip dominates");
+  }
+
+  if (Failed > 0 || Naks > 0 || TimedOut > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP %d/%d leases, %d NAK, %d try timeouts, total p50 %d us",
+                   Bound, Count, Naks, TimedOut, P50[L7DhcpPhaseTotal]);
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP %d leases, total p50 %d us, slowest %s p50 %d us",
+                   Bound, P50[L7DhcpPhaseTotal],
+                   mL7DhcpPhaseName[Slowest], P50[Slowest]);
+  }
+
+  FreePool (Samples);
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// DHCP load engine (raw SNP, synthetic clients)
+// ============================================================
+//
+
+#define L7_DHCPL_DEFAULT_CLIENTS  64
+#define L7_DHCPL_MAX_CLIENTS      4096
+#define L7_DHCPL_DEFAULT_RATE     200     // new clients per second
+#define L7_DHCPL_WINDOW           128     // clients mid-exchange
+#define L7_DHCPL_RETRY_MS         1000
+#define L7_DHCPL_TRIES            3       // sends per message before timing out
+#define L7_DHCPL_DEFAULT_MS       30000   // run time cap
+#define L7_DHCPL_SWEEP_US         10000   // retransmit check interval
+#define L7_DHCPL_MAC_OUI          0x02, 0xDD, 0x4C  // locally administered
+
+typedef enum {
+  L7DhcplIdle,
+  L7DhcplSelecting,                     // DISCOVER sent
+  L7DhcplRequesting,                    // REQUEST sent
+  L7DhcplBound,
+  L7DhcplNaked,
+  L7DhcplTimedOut
+} L7_DHCPL_STATE;
+
+typedef struct {
+  UINT8   State;
+  UINT8   Tries;                        // sends of the current message
+  UINT8   YiAddr[4];
+  UINT8   ServerId[4];
+  UINT8   ServerMac[6];
+  UINT64  DiscoverUs;                   // first DISCOVER
+  UINT64  RequestUs;                    // first REQUEST
+  UINT64  LastTxUs;
+} L7_DHCPL_CLIENT;
+
+typedef struct {
+  PKT_IO           *Io;
+  L7_DHCPL_CLIENT  *Clients;
+  UINTN            Count;
+  UINT32           XidBase;
+  UINT32           *OfferUs;            // DISCOVER -> OFFER per client that got one
+  UINT32           *AckUs;              // REQUEST -> ACK
+  UINT32           *LeaseUs;            // DISCOVER -> ACK
+  UINTN            Offers;
+  UINTN            Bound;
+  UINTN            Naks;
+  UINTN            TimedOut;
+  UINTN            Retransmits;
+  UINTN            Pending;
+  UINTN            Started;
+  UINTN            Released;
+  UINT64           FirstTxUs;
+  UINT64           LastAckUs;
+} L7_DHCPL_ENGINE;
+
+/**
+  Synthetic hardware address of client Index.
+**/
+STATIC
+VOID
+L7DhcplMac (
+  IN  UINTN  Index,
+  OUT UINT8  *Mac
+  )
+{
+  STATIC CONST UINT8  Oui[3] = { L7_DHCPL_MAC_OUI };
+
+  CopyMem (Mac, Oui, 3);
+  Mac[3] = (UINT8)(Index >> 16);
+  Mac[4] = (UINT8)(Index >> 8);
+  Mac[5] = (UINT8)Index;
+}
+
+/**
+  Build and send one client message. DISCOVER and REQUEST are broadcast
+  from 0.0.0.0 with the BROADCAST flag (so replies reach us whatever
+  chaddr says); RELEASE is unicast to the server from the leased address.
+
+  @param[in,out]  Engine   Load engine.
+  @param[in]      Index    Client index.
+  @param[in]      MsgType  DHCP_MSG_DISCOVER, _REQUEST or _RELEASE.
+
+  @retval EFI_SUCCESS  Frame sent.
+  @retval other        PktIoSend failure.
+**/
+STATIC
+EFI_STATUS
+L7DhcplSend (
+  IN OUT L7_DHCPL_ENGINE  *Engine,
+  IN     UINTN            Index,
+  IN     UINT8            MsgType
+  )
+{
+  STATIC CONST UINT8  BroadcastMac[6] = ETHERNET_BROADCAST_MAC;
+  STATIC CONST UINT8  BroadcastIp[4]  = { 255, 255, 255, 255 };
+  STATIC CONST UINT8  ZeroIp[4]       = { 0, 0, 0, 0 };
+  L7_DHCPL_CLIENT     *Client;
+  UINT8               Msg[BOOTP_MIN_SIZE];
+  UINT8               Frame[ETHERNET_HEADER_SIZE + IPV4_MIN_HEADER_SIZE + UDP_HEADER_SIZE + BOOTP_MIN_SIZE];
+  DHCP_HEADER         *Dhcp;
+  UINT8               *Opt;
+  UINTN               FrameLen;
+
+  Client = &Engine->Clients[Index];
+
+  ZeroMem (Msg, sizeof (Msg));
+  Dhcp              = (DHCP_HEADER *)Msg;
+  Dhcp->Op          = BOOTP_OP_REQUEST;
+  Dhcp->HwType      = ARP_HW_ETHERNET;
+  Dhcp->HwLen       = 6;
+  Dhcp->Xid         = HTONL (Engine->XidBase + (UINT32)Index);
+  Dhcp->MagicCookie = HTONL (DHCP_MAGIC_COOKIE);
+  L7DhcplMac (Index, Dhcp->ChAddr);
+
+  Opt    = Msg + DHCP_HEADER_SIZE;
+  *Opt++ = DHCP_OPT_MSG_TYPE;
+  *Opt++ = 1;
+  *Opt++ = MsgType;
+  if (MsgType == DHCP_MSG_REQUEST) {
+    *Opt++ = DHCP_OPT_REQUESTED_IP;
+    *Opt++ = 4;
+    CopyMem (Opt, Client->YiAddr, 4);
+    Opt   += 4;
+  }
+  if (MsgType != DHCP_MSG_DISCOVER) {
+    *Opt++ = DHCP_OPT_SERVER_ID;
+    *Opt++ = 4;
+    CopyMem (Opt, Client->ServerId, 4);
+    Opt   += 4;
+  }
+  *Opt = DHCP_OPT_END;
+
+  if (MsgType == DHCP_MSG_RELEASE) {
+    CopyMem (Dhcp->CiAddr, Client->YiAddr, 4);
+    FrameLen = PktBuildUdpPacket (Frame, Engine->Io->SrcMac, Client->ServerMac,
+                                  Client->YiAddr, Client->ServerId,
+                                  BOOTP_CLIENT_PORT, BOOTP_SERVER_PORT, Msg, sizeof (Msg));
+  } else {
+    Dhcp->Flags = HTONS (BOOTP_FLAG_BROADCAST);
+    FrameLen = PktBuildUdpPacket (Frame, Engine->Io->SrcMac, BroadcastMac,
+                                  ZeroIp, BroadcastIp,
+                                  BOOTP_CLIENT_PORT, BOOTP_SERVER_PORT, Msg, sizeof (Msg));
+  }
+
+  Client->LastTxUs = UtilGetTimeUs ();
+  return PktIoSend (Engine->Io, Frame, FrameLen);
+}
+
+/**
+  Handle one received frame: match a server reply to its client by xid
+  and chaddr and advance that client's exchange.
+
+  @param[in,out]  Engine  Load engine.
+  @param[in]      Frame   Received frame.
+  @param[in]      Length  Frame length.
+  @param[in]      NowUs   Receive time.
+**/
+STATIC
+VOID
+L7DhcplReceive (
+  IN OUT L7_DHCPL_ENGINE  *Engine,
+  IN     UINT8            *Frame,
+  IN     UINTN            Length,
+  IN     UINT64           NowUs
+  )
+{
+  PARSED_PACKET    Parsed;
+  DHCP_HEADER      *Dhcp;
+  L7_DHCPL_CLIENT  *Client;
+  UINT8            Mac[6];
+  UINT8            *Opt;
+  UINT8            *End;
+  UINT8            MsgType;
+  UINT8            *ServerId;
+  UINTN            Index;
+
+  if (EFI_ERROR (PktParsePacket (Frame, Length, &Parsed)) || !Parsed.HasUdp ||
+      NTOHS (Parsed.Udp->DstPort) != BOOTP_CLIENT_PORT ||
+      Parsed.PayloadLength < DHCP_HEADER_SIZE) {
+    return;
+  }
+
+  Dhcp  = (DHCP_HEADER *)Parsed.Payload;
+  Index = (UINT32)(NTOHL (Dhcp->Xid) - Engine->XidBase);
+  if (Dhcp->Op != BOOTP_OP_REPLY || NTOHL (Dhcp->MagicCookie) != DHCP_MAGIC_COOKIE ||
+      Index >= Engine->Started) {
+    return;
+  }
+  L7DhcplMac (Index, Mac);
+  if (CompareMem (Dhcp->ChAddr, Mac, 6) != 0) {
+    return;
+  }
+
+  MsgType  = 0;
+  ServerId = NULL;
+  Opt      = Parsed.Payload + DHCP_HEADER_SIZE;
+  End      = Parsed.Payload + Parsed.PayloadLength;
+  while (Opt < End && *Opt != DHCP_OPT_END) {
+    if (*Opt == DHCP_OPT_PAD) {
+      Opt++;
+      continue;
+    }
+    if (Opt + 2 > End || Opt + 2 + Opt[1] > End) {
+      break;
+    }
+    if (Opt[0] == DHCP_OPT_MSG_TYPE && Opt[1] == 1) {
+      MsgType = Opt[2];
+    } else if (Opt[0] == DHCP_OPT_SERVER_ID && Opt[1] == 4) {
+      ServerId = Opt + 2;
+    }
+    Opt += 2 + Opt[1];
+  }
+
+  Client = &Engine->Clients[Index];
+
+  if (MsgType == DHCP_MSG_OFFER && Client->State == L7DhcplSelecting) {
+    //
+    // First offer wins, as with the firmware client
+    //
+    Engine->OfferUs[Engine->Offers++] = (UINT32)(NowUs - Client->DiscoverUs);
+    CopyMem (Client->YiAddr, Dhcp->YiAddr, 4);
+    CopyMem (Client->ServerId, (ServerId != NULL) ? ServerId : Parsed.Ipv4->SrcAddr, 4);
+    CopyMem (Client->ServerMac, Parsed.Ethernet->SrcMac, 6);
+    Client->State     = L7DhcplRequesting;
+    Client->Tries     = 1;
+    Client->RequestUs = UtilGetTimeUs ();
+    L7DhcplSend (Engine, Index, DHCP_MSG_REQUEST);
+  } else if (MsgType == DHCP_MSG_ACK && Client->State == L7DhcplRequesting) {
+    Engine->AckUs[Engine->Bound]   = (UINT32)(NowUs - Client->RequestUs);
+    Engine->LeaseUs[Engine->Bound] = (UINT32)(NowUs - Client->DiscoverUs);
+    Engine->Bound++;
+    Engine->Pending--;
+    Engine->LastAckUs = NowUs;
+    Client->State     = L7DhcplBound;
+  } else if (MsgType == DHCP_MSG_NAK && Client->State == L7DhcplRequesting) {
+    Engine->Naks++;
+    Engine->Pending--;
+    Client->State = L7DhcplNaked;
+  }
+}
+
+/**
+  Retransmit DISCOVERs and REQUESTs unanswered for L7_DHCPL_RETRY_MS;
+  a client out of tries times out.
+
+  @param[in,out]  Engine  Load engine.
+  @param[in]      NowUs   Current time.
+**/
+STATIC
+VOID
+L7DhcplSweep (
+  IN OUT L7_DHCPL_ENGINE  *Engine,
+  IN     UINT64           NowUs
+  )
+{
+  L7_DHCPL_CLIENT  *Client;
+  UINTN            Index;
+
+  for (Index = 0; Index < Engine->Started; Index++) {
+    Client = &Engine->Clients[Index];
+    if ((Client->State != L7DhcplSelecting && Client->State != L7DhcplRequesting) ||
+        NowUs - Client->LastTxUs < (UINT64)L7_DHCPL_RETRY_MS * 1000) {
+      continue;
+    }
+    if (Client->Tries >= L7_DHCPL_TRIES) {
+      Client->State = L7DhcplTimedOut;
+      Engine->TimedOut++;
+      Engine->Pending--;
+      continue;
+    }
+    Client->Tries++;
+    Engine->Retransmits++;
+    L7DhcplSend (Engine, Index,
+                 (Client->State == L7DhcplSelecting) ? DHCP_MSG_DISCOVER : DHCP_MSG_REQUEST);
+  }
+}
+
+/**
+  Run DORA for every client: start new clients at RatePps while fewer
+  than L7_DHCPL_WINDOW are mid-exchange, answer offers with requests,
+  then release every lease obtained.
+
+  @param[in,out]  Engine      Load engine (Io, Clients, Count, sample arrays set).
+  @param[in]      RatePps     New clients per second.
+  @param[in]      DurationMs  Run time cap.
+**/
+STATIC
+VOID
+L7DhcplRun (
+  IN OUT L7_DHCPL_ENGINE  *Engine,
+  IN     UINT32           RatePps,
+  IN     UINT32           DurationMs
+  )
+{
+  UINT8            RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN            RxLen;
+  UINT64           NowUs;
+  UINT64           EndUs;
+  UINT64           NextStartUs;
+  UINT64           NextSweepUs;
+  UINT64           IntervalUs;
+  L7_DHCPL_CLIENT  *Client;
+  UINTN            Index;
+
+  IntervalUs  = 1000000 / RatePps;
+  NowUs       = UtilGetTimeUs ();
+  EndUs       = NowUs + (UINT64)DurationMs * 1000;
+  NextStartUs = NowUs;
+  NextSweepUs = NowUs + L7_DHCPL_SWEEP_US;
+  Engine->FirstTxUs = NowUs;
+
+  while (NowUs < EndUs && (Engine->Started < Engine->Count || Engine->Pending > 0)) {
+    if (Engine->Started < Engine->Count && Engine->Pending < L7_DHCPL_WINDOW &&
+        NowUs >= NextStartUs) {
+      Client             = &Engine->Clients[Engine->Started];
+      Client->State      = L7DhcplSelecting;
+      Client->Tries      = 1;
+      Client->DiscoverUs = NowUs;
+      Engine->Started++;
+      Engine->Pending++;
+      L7DhcplSend (Engine, Engine->Started - 1, DHCP_MSG_DISCOVER);
+      NextStartUs += IntervalUs;
+    }
+
+    RxLen = sizeof (RxBuf);
+    while (!EFI_ERROR (PktIoReceive (Engine->Io, RxBuf, &RxLen))) {
+      L7DhcplReceive (Engine, RxBuf, RxLen, UtilGetTimeUs ());
+      RxLen = sizeof (RxBuf);
+    }
+
+    NowUs = UtilGetTimeUs ();
+    if (NowUs >= NextSweepUs) {
+      L7DhcplSweep (Engine, NowUs);
+      NextSweepUs = NowUs + L7_DHCPL_SWEEP_US;
+    }
+  }
+
+  //
+  // Give the leases back so the pool is not drained by repeated runs
+  //
+  for (Index = 0; Index < Engine->Started; Index++) {
+    if (Engine->Clients[Index].State == L7DhcplBound &&
+        !EFI_ERROR (L7DhcplSend (Engine, Index, DHCP_MSG_RELEASE))) {
+      Engine->Released++;
+    }
+  }
+}
+
+//
+// ============================================================
+// Test T7.11: DHCP Load
+// Emulate Config->Iterations DHCP clients (default 64, synthetic
+// chaddr 02:DD:4C:xx:xx:xx) from this NIC over raw frames, starting
+// Config->RatePps new clients per second (default 200) with up to
+// L7_DHCPL_WINDOW exchanges in flight - a rack PXE-booting at once.
+// Reports leases/sec, OFFER and ACK latency percentiles, NAKs,
+// timeouts and retransmissions; the companion's built-in server adds
+// its own offer/ack/exhausted counters.
+//
+// PASS: Every client bound
+// WARN: NAKs or timeouts
+// FAIL: Raw frame I/O unavailable or no client got an offer
+// ============================================================
+//
+EFI_STATUS
+TestL7DhcpLoad (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS       Status;
+  EFI_STATUS       LinkStatus;
+  PKT_IO           Io;
+  COMPANION_LINK   Link;
+  BOOLEAN          LinkUp;
+  CONST CHAR8      *Report;
+  L7_DHCPL_ENGINE  Engine;
+  UINT32           *Samples;
+  UINT32           RatePps;
+  UINT32           LeasesPerSec;
+  UINT64           SrvOffers;
+  UINT64           SrvAcks;
+  UINT64           SrvExhausted;
+  UINT64           ElapsedUs;
+
+  ZeroMem (&Engine, sizeof (Engine));
+  Engine.Count = (Config->Iterations > 0 && Config->Iterations <= L7_DHCPL_MAX_CLIENTS) ?
+                 Config->Iterations : L7_DHCPL_DEFAULT_CLIENTS;
+  RatePps      = (Config->RatePps > 0) ? Config->RatePps : L7_DHCPL_DEFAULT_RATE;
+
+  Engine.Clients = AllocateZeroPool (Engine.Count * sizeof (L7_DHCPL_CLIENT));
+  Samples        = AllocatePool (3 * Engine.Count * sizeof (UINT32));
+  if (Engine.Clients == NULL || Samples == NULL) {
+    if (Engine.Clients != NULL) {
+      FreePool (Engine.Clients);
+    }
+    if (Samples != NULL) {
+      FreePool (Samples);
+    }
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for %d DHCP clients", Engine.Count);
+    return EFI_SUCCESS;
+  }
+  Engine.OfferUs = Samples;
+  Engine.AckUs   = Samples + Engine.Count;
+  Engine.LeaseUs = Samples + 2 * Engine.Count;
+
+  Status = PktIoOpen (&Io, Nic->Handle, Nic->Snp);
+  if (EFI_ERROR (Status)) {
+    FreePool (Engine.Clients);
+    FreePool (Samples);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP load could not run: %r", Status);
+    UnicodeSPrint (Result->FailReason, sizeof (Result->FailReason),
+                   L"Raw frame I/O (SNP/MNP) unavailable");
+    return EFI_SUCCESS;
+  }
+  Engine.Io = &Io;
+
+  //
+  // A fresh xid range per run keeps late replies of an earlier run out
+  //
+  Engine.XidBase = (UINT32)UtilGetTimeUs () & 0xFFFF0000;
+
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionPrepare (&Link, "L7", "DHCP_LOAD", "");
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  L7DhcplRun (&Engine, RatePps,
+              (Config->DurationMs > 0) ? Config->DurationMs : L7_DHCPL_DEFAULT_MS);
+  PktIoClose (&Io);
+
+  SrvOffers    = 0;
+  SrvAcks      = 0;
+  SrvExhausted = 0;
+  if (LinkUp) {
+    LinkStatus = CompanionGetResult (&Link, &Report);
+    LinkUp     = !EFI_ERROR (LinkStatus) &&
+                 !EFI_ERROR (CompanionResultValue (Report, "dhcp_acks", &SrvAcks));
+    if (LinkUp) {
+      CompanionResultValue (Report, "offers", &SrvOffers);
+      CompanionResultValue (Report, "dhcp_exhausted", &SrvExhausted);
+    }
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+  }
+
+  Result->PacketsSent     = Io.TxFrames;
+  Result->PacketsReceived = Engine.Bound;
+  ElapsedUs               = (Engine.Bound > 0) ? Engine.LastAckUs - Engine.FirstTxUs : 0;
+  Result->DurationMs      = DivU64x32 (ElapsedUs, 1000);
+
+  if (Engine.Offers == 0) {
+    FreePool (Engine.Clients);
+    FreePool (Samples);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP load: no offer for %d synthetic clients (%d timed out)",
+                   Engine.Started, Engine.TimedOut);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify a DHCP server (or relay) serves this segment");
+    return EFI_SUCCESS;
+  }
+
+  UtilSortUint32 (Engine.OfferUs, Engine.Offers);
+  UtilSortUint32 (Engine.AckUs, Engine.Bound);
+  UtilSortUint32 (Engine.LeaseUs, Engine.Bound);
+
+  LeasesPerSec = (ElapsedUs > 0) ?
+                 (UINT32)DivU64x64Remainder ((UINT64)Engine.Bound * 1000000, ElapsedUs, NULL) : 0;
+
+  Result->RttMinUs    = Engine.OfferUs[0];
+  Result->RttAvgUs    = UtilPercentile (Engine.OfferUs, Engine.Offers, 50);
+  Result->RttMaxUs    = Engine.OfferUs[Engine.Offers - 1];
+  Result->RttJitterUs = UtilPercentile (Engine.OfferUs, Engine.Offers, 99) - Result->RttAvgUs;
+
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                 L"%d clients at %d/s: %d offered, %d bound, %d NAK, %d timed out, "
+                 L"%d retransmissions, %d released | offer p50=%d p90=%d p99=%d max=%d us | "
+                 L"ack p50=%d p99=%d us | DORA p50=%d p99=%d us | companion offers=%llu acks=%llu exhausted=%llu%s",
+                 Engine.Count, RatePps, Engine.Offers, Engine.Bound, Engine.Naks,
+                 Engine.TimedOut, Engine.Retransmits, Engine.Released,
+                 UtilPercentile (Engine.OfferUs, Engine.Offers, 50),
+                 UtilPercentile (Engine.OfferUs, Engine.Offers, 90),
+                 UtilPercentile (Engine.OfferUs, Engine.Offers, 99),
+                 Engine.OfferUs[Engine.Offers - 1],
+                 UtilPercentile (Engine.AckUs, Engine.Bound, 50),
+                 UtilPercentile (Engine.AckUs, Engine.Bound, 99),
+                 UtilPercentile (Engine.LeaseUs, Engine.Bound, 50),
+                 UtilPercentile (Engine.LeaseUs, Engine.Bound, 99),
+                 SrvOffers, SrvAcks, SrvExhausted,
+                 LinkUp ? L"" : L" (no companion)");
+
+  if (Engine.Bound == Engine.Count) {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP %d leases/s, %d clients bound, offer p50 %d us / p99 %d us",
+                   LeasesPerSec, Engine.Bound,
+                   UtilPercentile (Engine.OfferUs, Engine.Offers, 50),
+                   UtilPercentile (Engine.OfferUs, Engine.Offers, 99));
+  } else {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"DHCP %d leases/s, %d of %d clients bound (%d NAK, %d timed out)",
+                   LeasesPerSec, Engine.Bound, Engine.Count, Engine.Naks, Engine.TimedOut);
+    if (SrvExhausted > 0) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Companion pool exhausted: widen dhcp_pool_start..dhcp_pool_end");
+    } else if (Engine.Started < Engine.Count) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Run time cap reached: raise RatePps or DurationMs");
+    } else {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Server dropped requests at %d clients/s; lower RatePps to find its limit",
+                     RatePps);
+    }
+  }
+
+  FreePool (Engine.Clients);
+  FreePool (Samples);
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// HTTPS engine (firmware TLS behind EFI_HTTP_PROTOCOL)
+// ============================================================
+//
+
+#define L7_HTTPS_DEFAULT_PORT   443
+#define L7_HTTPS_PLAIN_PORT     80        // plain HTTP baseline and /ca.der
+#define L7_HTTPS_DEFAULT_CONNS  8
+#define L7_HTTPS_MAX_CONNS      32
+#define L7_HTTPS_DEFAULT_BYTES  (16ULL * 1024 * 1024)
+#define L7_HTTPS_PROBE_PATH     L"/bytes/64"
+#define L7_HTTPS_CA_MAX         8192
+
+//
+// Time to first byte of one small GET per new connection, and of a
+// second GET on the same (kept-alive) connection
+//
+typedef struct {
+  UINT32      FreshUs[L7_HTTPS_MAX_CONNS];  // connect (+ handshake) + request
+  UINT32      WarmUs[L7_HTTPS_MAX_CONNS];   // request only
+  UINTN       Fresh;
+  UINTN       Warm;
+  UINTN       Failed;
+  EFI_STATUS  LastError;
+} L7_HTTPS_SERIES;
+
+/**
+  Format an http:// or https:// URL to Ip, omitting the scheme's
+  default port.
+
+  @param[out]  Url      Destination.
+  @param[in]   UrlSize  Destination size in bytes.
+  @param[in]   Tls      TRUE for https.
+  @param[in]   Ip       Server address.
+  @param[in]   Port     Server port.
+  @param[in]   Path     Absolute path.
+**/
+STATIC
+VOID
+L7HttpsUrl (
+  OUT CHAR16            *Url,
+  IN  UINTN             UrlSize,
+  IN  BOOLEAN           Tls,
+  IN  EFI_IPv4_ADDRESS  *Ip,
+  IN  UINT16            Port,
+  IN  CHAR16            *Path
+  )
+{
+  if (Port == (Tls ? L7_HTTPS_DEFAULT_PORT : L7_HTTPS_PLAIN_PORT)) {
+    UnicodeSPrint (Url, UrlSize, L"%s://%d.%d.%d.%d%s", Tls ? L"https" : L"http",
+                   Ip->Addr[0], Ip->Addr[1], Ip->Addr[2], Ip->Addr[3], Path);
+  } else {
+    UnicodeSPrint (Url, UrlSize, L"%s://%d.%d.%d.%d:%d%s", Tls ? L"https" : L"http",
+                   Ip->Addr[0], Ip->Addr[1], Ip->Addr[2], Ip->Addr[3], Port, Path);
+  }
+}
+
+/**
+  Make the companion's test CA trusted by the firmware TLS stack for
+  this run. An existing TlsCaCertificate variable is the platform's
+  trust store and is left alone; only when there is none, and only
+  with Config->TrustCompanionCa set, is the CA fetched from
+  http://<target>/ca.der and set as a volatile variable, which the
+  caller deletes when done. The download is plain HTTP and is not
+  verified: whoever answers at TargetIp becomes trusted for the run.
+
+  @param[in]   Nic       NIC under test.
+  @param[in]   Config    Test configuration (TargetIp, TrustCompanionCa).
+  @param[in]   Host      Host header value.
+  @param[out]  Enrolled  TRUE if the variable was set by this call.
+
+  @retval EFI_SUCCESS      A CA list is in place (see *Enrolled).
+  @retval EFI_NOT_STARTED  No CA list, and enrolling is turned off.
+  @retval other            The CA could not be fetched or set.
+**/
+STATIC
+EFI_STATUS
+L7TlsEnrollCa (
+  IN  NIC_INFO     *Nic,
+  IN  TEST_CONFIG  *Config,
+  IN  CHAR8        *Host,
+  OUT BOOLEAN      *Enrolled
+  )
+{
+  EFI_STATUS          Status;
+  EFI_HANDLE          ChildHandle;
+  EFI_HTTP_PROTOCOL   *Http;
+  L7_HTTPDL_STATS     Stats;
+  EFI_SIGNATURE_LIST  *List;
+  EFI_SIGNATURE_DATA  *Cert;
+  CHAR16              UrlBuf[64];
+  UINT8               *Der;
+  UINTN               VarSize;
+  UINTN               ListSize;
+
+  *Enrolled = FALSE;
+  VarSize   = 0;
+  Status    = gRT->GetVariable (EFI_TLS_CA_CERTIFICATE_VARIABLE, &gEfiTlsCaCertificateGuid,
+                                NULL, &VarSize, NULL);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    return EFI_SUCCESS;
+  }
+  if (Status != EFI_NOT_FOUND) {
+    return Status;
+  }
+  if (!Config->TrustCompanionCa) {
+    return EFI_NOT_STARTED;
+  }
+
+  Der = AllocatePool (L7_HTTPS_CA_MAX);
+  if (Der == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = L7HttpOpen (Nic, &ChildHandle, &Http);
+  if (!EFI_ERROR (Status)) {
+    L7HttpsUrl (UrlBuf, sizeof (UrlBuf), FALSE, &Config->TargetIp, L7_HTTPS_PLAIN_PORT, L"/ca.der");
+    Status = L7HttpDownload (Http, UrlBuf, Host, Der, L7_HTTPS_CA_MAX, TRUE, &Stats);
+    L7DestroyHttpChild (Nic->Handle, ChildHandle, Http);
+  }
+  if (!EFI_ERROR (Status) &&
+      (Stats.HttpStatus != HTTP_STATUS_200_OK || Stats.Bytes == 0 || EFI_ERROR (Stats.EndStatus))) {
+    Status = EFI_NOT_FOUND;
+  }
+  if (EFI_ERROR (Status)) {
+    FreePool (Der);
+    return Status;
+  }
+
+  //
+  // One EFI_SIGNATURE_LIST holding the DER certificate, the format
+  // HttpDxe reads the variable in
+  //
+  ListSize = sizeof (EFI_SIGNATURE_LIST) + sizeof (EFI_GUID) + (UINTN)Stats.Bytes;
+  List     = AllocateZeroPool (ListSize);
+  if (List == NULL) {
+    FreePool (Der);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CopyGuid (&List->SignatureType, &gEfiCertX509Guid);
+  List->SignatureListSize   = (UINT32)ListSize;
+  List->SignatureHeaderSize = 0;
+  List->SignatureSize       = (UINT32)(sizeof (EFI_GUID) + Stats.Bytes);
+  Cert = (EFI_SIGNATURE_DATA *)(List + 1);
+  CopyGuid (&Cert->SignatureOwner, &gEfiCallerIdGuid);
+  CopyMem (Cert->SignatureData, Der, (UINTN)Stats.Bytes);
+
+  Status = gRT->SetVariable (EFI_TLS_CA_CERTIFICATE_VARIABLE, &gEfiTlsCaCertificateGuid,
+                             EFI_VARIABLE_BOOTSERVICE_ACCESS, ListSize, List);
+  *Enrolled = !EFI_ERROR (Status);
+
+  FreePool (List);
+  FreePool (Der);
+  return Status;
+}
+
+/**
+  Open Count new connections to Url, each on its own HTTP child, and
+  time a GET on the fresh connection and a second GET on the same one.
+
+  @param[in]   Nic      NIC under test.
+  @param[in]   Url      Small resource to GET.
+  @param[in]   Host     Host header value.
+  @param[in]   Buf      Body buffer.
+  @param[in]   Count    Connections (<= L7_HTTPS_MAX_CONNS).
+  @param[out]  Series   Per-connection timings, in connection order.
+**/
+STATIC
+VOID
+L7HttpsSeries (
+  IN  NIC_INFO         *Nic,
+  IN  CHAR16           *Url,
+  IN  CHAR8            *Host,
+  IN  UINT8            *Buf,
+  IN  UINTN            Count,
+  OUT L7_HTTPS_SERIES  *Series
+  )
+{
+  EFI_STATUS         Status;
+  EFI_HANDLE         ChildHandle;
+  EFI_HTTP_PROTOCOL  *Http;
+  L7_HTTPDL_STATS    Stats;
+  UINTN              I;
+
+  ZeroMem (Series, sizeof (L7_HTTPS_SERIES));
+  for (I = 0; I < Count; I++) {
+    Status = L7HttpOpen (Nic, &ChildHandle, &Http);
+    if (EFI_ERROR (Status)) {
+      Series->Failed++;
+      Series->LastError = Status;
+      continue;
+    }
+
+    Status = L7HttpDownload (Http, Url, Host, Buf, L7_HTTPDL_BUF_SIZE, FALSE, &Stats);
+    if (!EFI_ERROR (Status) && Stats.HttpStatus == HTTP_STATUS_200_OK) {
+      Series->FreshUs[Series->Fresh++] = (UINT32)Stats.TtfbUs;
+      Status = L7HttpDownload (Http, Url, Host, Buf, L7_HTTPDL_BUF_SIZE, FALSE, &Stats);
+      if (!EFI_ERROR (Status) && Stats.HttpStatus == HTTP_STATUS_200_OK) {
+        Series->WarmUs[Series->Warm++] = (UINT32)Stats.TtfbUs;
+      }
+    }
+    if (EFI_ERROR (Status) || Stats.HttpStatus != HTTP_STATUS_200_OK) {
+      Series->Failed++;
+      Series->LastError = EFI_ERROR (Status) ? Status : EFI_PROTOCOL_ERROR;
+    }
+
+    L7DestroyHttpChild (Nic->Handle, ChildHandle, Http);
+  }
+}
+
+/**
+  Body Mbps x10 of a download, excluding the time to first byte.
+**/
+STATIC
+UINT32
+L7HttpsMbpsX10 (
+  IN L7_HTTPDL_STATS  *Stats
+  )
+{
+  if (Stats->ElapsedUs <= Stats->TtfbUs) {
+    return 0;
+  }
+  return (UINT32)DivU64x64Remainder (Stats->Bytes * 80, Stats->ElapsedUs - Stats->TtfbUs, NULL);
+}
+
+//
+// ============================================================
+// Test T7.12: HTTPS
+// Firmware TLS cost, measured against the companion's HTTPS endpoint
+// (certificate from its locally generated test CA; with "Trust test
+// CA" on, that CA is enrolled for the run when the platform has no
+// TlsCaCertificate variable):
+//   - Config->Iterations new connections (default 8): time to first
+//     byte on each fresh connection and on a second request over it,
+//     for HTTPS and plain HTTP. Fresh-connection HTTPS minus plain
+//     HTTP is the TLS handshake.
+//   - The companion reports which handshakes resumed a session; when
+//     the firmware resumes, connections after the first give the
+//     resumed-handshake time.
+//   - Bulk GET /bytes/<N> (default 16 MB, Config->TransferBytes) over
+//     HTTPS and plain HTTP: record-layer cost in Mbps.
+//
+// PASS: Every connection and the bulk HTTPS download succeeded
+// WARN: Some requests failed, bulk truncated, no companion counts,
+//       or HTTPS blocked by policy
+// FAIL: No TLS stack, or no HTTPS connection completed
+// ============================================================
+//
+EFI_STATUS
+TestL7Https (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS         Status;
+  EFI_STATUS         CaStatus;
+  EFI_STATUS         LinkStatus;
+  COMPANION_LINK     Link;
+  BOOLEAN            LinkUp;
+  BOOLEAN            Enrolled;
+  CONST CHAR8        *Report;
+  CONST CHAR16       *CaNote;
+  VOID               *TlsSb;
+  EFI_HANDLE         ChildHandle;
+  EFI_HTTP_PROTOCOL  *Http;
+  L7_HTTPS_SERIES    Tls;
+  L7_HTTPS_SERIES    Plain;
+  L7_HTTPDL_STATS    TlsBulk;
+  L7_HTTPDL_STATS    PlainBulk;
+  EFI_STATUS         TlsBulkStatus;
+  EFI_STATUS         PlainBulkStatus;
+  UINT32             Later[L7_HTTPS_MAX_CONNS];
+  UINT8              *Buf;
+  CHAR16             UrlBuf[128];
+  CHAR16             PathBuf[40];
+  CHAR8              HostBuf[32];
+  UINT16             Port;
+  UINTN              Count;
+  UINTN              LaterCount;
+  UINTN              Used;
+  UINT64             Size;
+  UINT64             StartUs;
+  UINT64             Handshakes;
+  UINT64             Resumed;
+  UINT64             TlsFailures;
+  UINT64             FullUs;
+  UINT64             ResumedUs;
+  UINT32             TlsFresh50;
+  UINT32             TlsWarm50;
+  UINT32             PlainFresh50;
+  UINT32             HandshakeUs;
+  UINT32             TlsMbpsX10;
+  UINT32             PlainMbpsX10;
+  UINT32             FreshSum;
+  UINTN              I;
+
+  //
+  // HttpDxe finds TlsDxe by protocol, not on the NIC handle
+  //
+  if (!Nic->HasTls &&
+      EFI_ERROR (gBS->LocateProtocol (&gEfiTlsServiceBindingProtocolGuid, NULL, &TlsSb))) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No TLS service binding: firmware cannot do HTTPS");
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Build the firmware with TlsDxe (NetworkPkg NETWORK_TLS_ENABLE)");
+    return EFI_SUCCESS;
+  }
+
+  Port  = (Config->TargetPort > 0) ? Config->TargetPort : L7_HTTPS_DEFAULT_PORT;
+  Count = (Config->Iterations > 0 && Config->Iterations <= L7_HTTPS_MAX_CONNS) ?
+          Config->Iterations : L7_HTTPS_DEFAULT_CONNS;
+  Size  = (Config->TransferBytes > 0) ? Config->TransferBytes : L7_HTTPS_DEFAULT_BYTES;
+
+  Buf = AllocatePool (L7_HTTPDL_BUF_SIZE);
+  if (Buf == NULL) {
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the body buffer");
+    return EFI_SUCCESS;
+  }
+
+  AsciiSPrint (HostBuf, sizeof (HostBuf), "%d.%d.%d.%d",
+               Config->TargetIp.Addr[0], Config->TargetIp.Addr[1],
+               Config->TargetIp.Addr[2], Config->TargetIp.Addr[3]);
+
+  //
+  // Nothing between enrolling and the delete below returns early, so a
+  // CA enrolled for the run never outlives it
+  //
+  CaStatus = L7TlsEnrollCa (Nic, Config, HostBuf, &Enrolled);
+  if (Enrolled) {
+    CaNote = L"companion CA enrolled for this run (unverified)";
+  } else if (!EFI_ERROR (CaStatus)) {
+    CaNote = L"platform TlsCaCertificate";
+  } else if (CaStatus == EFI_NOT_STARTED) {
+    CaNote = L"none (Trust test CA off)";
+  } else {
+    CaNote = L"companion CA not enrolled";
+  }
+
+  //
+  // Have the companion count handshakes and resumptions for this run
+  //
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionPrepareStart (&Link, "L7", "HTTPS", "");
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  StartUs = UtilGetTimeUs ();
+
+  L7HttpsUrl (UrlBuf, sizeof (UrlBuf), FALSE, &Config->TargetIp, L7_HTTPS_PLAIN_PORT, L7_HTTPS_PROBE_PATH);
+  L7HttpsSeries (Nic, UrlBuf, HostBuf, Buf, Count, &Plain);
+  L7HttpsUrl (UrlBuf, sizeof (UrlBuf), TRUE, &Config->TargetIp, Port, L7_HTTPS_PROBE_PATH);
+  L7HttpsSeries (Nic, UrlBuf, HostBuf, Buf, Count, &Tls);
+
+  //
+  // Bulk transfer over each scheme on a fresh child
+  //
+  UnicodeSPrint (PathBuf, sizeof (PathBuf), L"/bytes/%llu", Size);
+  ZeroMem (&TlsBulk, sizeof (TlsBulk));
+  ZeroMem (&PlainBulk, sizeof (PlainBulk));
+  TlsBulkStatus   = EFI_NOT_STARTED;
+  PlainBulkStatus = EFI_NOT_STARTED;
+  if (Tls.Fresh > 0) {
+    TlsBulkStatus = L7HttpOpen (Nic, &ChildHandle, &Http);
+    if (!EFI_ERROR (TlsBulkStatus)) {
+      L7HttpsUrl (UrlBuf, sizeof (UrlBuf), TRUE, &Config->TargetIp, Port, PathBuf);
+      TlsBulkStatus = L7HttpDownload (Http, UrlBuf, HostBuf, Buf, L7_HTTPDL_BUF_SIZE, FALSE, &TlsBulk);
+      L7DestroyHttpChild (Nic->Handle, ChildHandle, Http);
+    }
+  }
+  if (Plain.Fresh > 0) {
+    PlainBulkStatus = L7HttpOpen (Nic, &ChildHandle, &Http);
+    if (!EFI_ERROR (PlainBulkStatus)) {
+      L7HttpsUrl (UrlBuf, sizeof (UrlBuf), FALSE, &Config->TargetIp, L7_HTTPS_PLAIN_PORT, PathBuf);
+      PlainBulkStatus = L7HttpDownload (Http, UrlBuf, HostBuf, Buf, L7_HTTPDL_BUF_SIZE, FALSE, &PlainBulk);
+      L7DestroyHttpChild (Nic->Handle, ChildHandle, Http);
+    }
+  }
+
+  Result->DurationMs = DivU64x32 (UtilGetTimeUs () - StartUs, 1000);
+  FreePool (Buf);
+
+  if (Enrolled) {
+    gRT->SetVariable (EFI_TLS_CA_CERTIFICATE_VARIABLE, &gEfiTlsCaCertificateGuid,
+                      EFI_VARIABLE_BOOTSERVICE_ACCESS, 0, NULL);
+  }
+
+  Handshakes  = 0;
+  Resumed     = 0;
+  TlsFailures = 0;
+  FullUs      = 0;
+  ResumedUs   = 0;
+  if (LinkUp) {
+    LinkStatus = CompanionStopResult (&Link, &Report);
+    if (!EFI_ERROR (LinkStatus)) {
+      LinkStatus = CompanionResultValue (Report, "tls_handshakes", &Handshakes);
+    }
+    if (!EFI_ERROR (LinkStatus)) {
+      CompanionResultValue (Report, "tls_resumed", &Resumed);
+      CompanionResultValue (Report, "tls_failures", &TlsFailures);
+      CompanionResultValue (Report, "tls_full_us", &FullUs);
+      CompanionResultValue (Report, "tls_resumed_us", &ResumedUs);
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+  }
+
+  Result->PacketsSent     = 2 * (Count * 2 + 1);
+  Result->PacketsReceived = Plain.Fresh + Plain.Warm + Tls.Fresh + Tls.Warm +
+                            (EFI_ERROR (TlsBulkStatus) ? 0 : 1) + (EFI_ERROR (PlainBulkStatus) ? 0 : 1);
+
+  if (Tls.Fresh == 0) {
+    if (Tls.LastError == EFI_ACCESS_DENIED) {
+      Result->StatusCode = TEST_RESULT_WARN;
+      UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                     L"HTTPS blocked by firmware security policy");
+      return EFI_SUCCESS;
+    }
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No HTTPS connection completed (%d failed, last %r)",
+                   Tls.Failed, Tls.LastError);
+    UnicodeSPrint (Result->Detail, sizeof (Result->Detail),
+                   L"CA: %s (%r) | companion: %llu handshakes, %llu failed",
+                   CaNote, CaStatus, Handshakes, TlsFailures);
+    if (CaStatus == EFI_NOT_STARTED) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Install a CA in TlsCaCertificate, or turn on [7] Trust test CA in Test Parameters");
+    } else if (EFI_ERROR (CaStatus)) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Enroll the companion CA (http://%a/ca.der) in TlsCaCertificate", HostBuf);
+    } else if (TlsFailures > 0) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Handshake rejected: TlsCaCertificate must trust the companion CA (see companion log)");
+    } else {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Verify the companion HTTPS server is running at target IP:%d", Port);
+    }
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Connections after the first are the ones that could resume
+  //
+  LaterCount = Tls.Fresh - 1;
+  CopyMem (Later, &Tls.FreshUs[1], LaterCount * sizeof (UINT32));
+  UtilSortUint32 (Later, LaterCount);
+
+  FreshSum = 0;
+  for (I = 0; I < Tls.Fresh; I++) {
+    FreshSum += Tls.FreshUs[I];
+  }
+  Result->RttAvgUs = FreshSum / (UINT32)Tls.Fresh;
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail), L"CA: %s | first HTTPS connection %d us | ",
+                 CaNote, Tls.FreshUs[0]);
+  UtilSortUint32 (Tls.FreshUs, Tls.Fresh);
+  UtilSortUint32 (Tls.WarmUs, Tls.Warm);
+  UtilSortUint32 (Plain.FreshUs, Plain.Fresh);
+  UtilSortUint32 (Plain.WarmUs, Plain.Warm);
+  Result->RttMinUs    = Tls.FreshUs[0];
+  Result->RttMaxUs    = Tls.FreshUs[Tls.Fresh - 1];
+  Result->RttJitterUs = UtilPercentile (Tls.FreshUs, Tls.Fresh, 90) - UtilPercentile (Tls.FreshUs, Tls.Fresh, 50);
+
+  TlsFresh50   = UtilPercentile (Tls.FreshUs, Tls.Fresh, 50);
+  TlsWarm50    = UtilPercentile (Tls.WarmUs, Tls.Warm, 50);
+  PlainFresh50 = UtilPercentile (Plain.FreshUs, Plain.Fresh, 50);
+
+  //
+  // Handshake = extra time of a fresh HTTPS connection over a fresh
+  // plain one; without the plain baseline, over a warm HTTPS request
+  //
+  if (Plain.Fresh > 0) {
+    HandshakeUs = (TlsFresh50 > PlainFresh50) ? TlsFresh50 - PlainFresh50 : 0;
+  } else {
+    HandshakeUs = (TlsFresh50 > TlsWarm50) ? TlsFresh50 - TlsWarm50 : 0;
+  }
+
+  TlsMbpsX10   = EFI_ERROR (TlsBulkStatus) ? 0 : L7HttpsMbpsX10 (&TlsBulk);
+  PlainMbpsX10 = EFI_ERROR (PlainBulkStatus) ? 0 : L7HttpsMbpsX10 (&PlainBulk);
+  Result->BytesReceived = TlsBulk.Bytes + PlainBulk.Bytes;
+
+  Used = StrLen (Result->Detail);
+  UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                 L"HTTPS %d/%d conns, fresh p50=%d p90=%d us, warm p50=%d us | "
+                 L"HTTP %d/%d conns, fresh p50=%d us, warm p50=%d us | handshake ~%d us | ",
+                 Tls.Fresh, Count, TlsFresh50, UtilPercentile (Tls.FreshUs, Tls.Fresh, 90), TlsWarm50,
+                 Plain.Fresh, Count, PlainFresh50, UtilPercentile (Plain.WarmUs, Plain.Warm, 50),
+                 HandshakeUs);
+
+  Used = StrLen (Result->Detail);
+  if (!LinkUp) {
+    UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                   L"resumption unknown (no companion) | ");
+  } else if (Resumed > 0) {
+    UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                   L"resumed %llu of %llu handshakes: later conns p50=%d us, server full %llu us vs resumed %llu us | ",
+                   Resumed, Handshakes, UtilPercentile (Later, LaterCount, 50),
+                   (Handshakes > Resumed) ? DivU64x64Remainder (FullUs, Handshakes - Resumed, NULL) : 0,
+                   DivU64x64Remainder (ResumedUs, Resumed, NULL));
+  } else {
+    UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                   L"no session resumed (%llu full handshakes, server avg %llu us) | ",
+                   Handshakes, (Handshakes > 0) ? DivU64x64Remainder (FullUs, Handshakes, NULL) : 0);
+  }
+
+  Used = StrLen (Result->Detail);
+  UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                 L"bulk %llu MB: HTTPS %d.%d Mbps (%r), HTTP %d.%d Mbps (%r)",
+                 RShiftU64 (Size, 20), TlsMbpsX10 / 10, TlsMbpsX10 % 10, TlsBulkStatus,
+                 PlainMbpsX10 / 10, PlainMbpsX10 % 10, PlainBulkStatus);
+
+  if (Tls.Failed > 0 || EFI_ERROR (TlsBulkStatus) || TlsBulk.HttpStatus != HTTP_STATUS_200_OK ||
+      TlsBulk.Bytes < Size || EFI_ERROR (TlsBulk.EndStatus)) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTPS handshake ~%d us, %d of %d connections failed, bulk %llu of %llu bytes",
+                   HandshakeUs, Tls.Failed, Count, TlsBulk.Bytes, Size);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Last HTTPS error %r; check the companion log for TLS alerts", Tls.LastError);
+  } else if (!LinkUp) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTPS handshake ~%d us, %d.%d Mbps (no companion count: resumption unknown)",
+                   HandshakeUs, TlsMbpsX10 / 10, TlsMbpsX10 % 10);
+  } else {
+    Result->StatusCode = TEST_RESULT_PASS;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"HTTPS handshake ~%d us (%llu/%llu resumed), %d.%d Mbps vs HTTP %d.%d Mbps",
+                   HandshakeUs, Resumed, Handshakes, TlsMbpsX10 / 10, TlsMbpsX10 % 10,
+                   PlainMbpsX10 / 10, PlainMbpsX10 % 10);
+    if (Resumed == 0 && Handshakes > 1) {
+      UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                     L"Firmware TLS does not resume sessions: every HTTPS connection pays a full handshake");
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// ============================================================
+// TFTP sweep engine (MTFTP4 ReadFile with RFC 2348/7440 options)
+// ============================================================
+//
+
+#define L7_TFTP_DEFAULT_PORT   69
+#define L7_TFTP_DEFAULT_BYTES  (4 * 1024 * 1024)
+#define L7_TFTP_MAX_BYTES      (64 * 1024 * 1024)
+#define L7_TFTP_TIMEOUT_S      2
+#define L7_TFTP_TRIES          4
+#define L7_TFTP_MAX_ROWS       16
+
+//
+// 512 is the RFC 1350 block; 1468 the largest that fits a 1500-byte
+// MTU unfragmented; 8192 needs IP fragmentation
+//
+STATIC CONST UINT16  mL7TftpBlkSizes[] = { 512, 1468, 8192 };
+STATIC CONST UINT16  mL7TftpWindows[]  = { 1, 4, 16, 64 };
+
+typedef struct {
+  UINT16      BlkSize;
+  UINT16      Window;
+  EFI_STATUS  Status;
+  UINT64      Bytes;
+  UINT64      ElapsedUs;
+  UINT32      MbpsX10;
+  UINT32      Timeouts;           // client-side MTFTP4 timeouts
+  UINT64      ServerRetx;         // blocks the companion sent again
+  UINT64      ServerBlkSize;      // options the companion ran with
+  UINT64      ServerWindow;
+  BOOLEAN     Corrupt;
+} L7_TFTP_ROW;
+
+/**
+  MTFTP4 timeout callback: count the timeout and let the driver retry.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+L7TftpTimeout (
+  IN EFI_MTFTP4_PROTOCOL  *This,
+  IN EFI_MTFTP4_TOKEN     *Token
+  )
+{
+  (*(UINT32 *)Token->Context)++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Read File into Buf (Size bytes) with the given blksize and windowsize
+  options and time it. windowsize is only sent when above 1, so a
+  lock-step row works against drivers and servers without RFC 7440.
+
+  @param[in]      Mtftp4  Configured MTFTP4 instance.
+  @param[in]      File    Remote file name.
+  @param[in]      Buf     Destination buffer.
+  @param[in]      Size    Expected file size (buffer size).
+  @param[in,out]  Row     BlkSize/Window in; results out.
+**/
+STATIC
+VOID
+L7TftpRead (
+  IN     EFI_MTFTP4_PROTOCOL  *Mtftp4,
+  IN     CHAR8                *File,
+  IN     UINT8                *Buf,
+  IN     UINT64               Size,
+  IN OUT L7_TFTP_ROW          *Row
+  )
+{
+  EFI_STATUS         Status;
+  EFI_MTFTP4_TOKEN   Token;
+  EFI_MTFTP4_OPTION  Options[2];
+  CHAR8              BlkStr[8];
+  CHAR8              WinStr[8];
+  UINT64             StartUs;
+  UINTN              I;
+
+  AsciiSPrint (BlkStr, sizeof (BlkStr), "%d", Row->BlkSize);
+  AsciiSPrint (WinStr, sizeof (WinStr), "%d", Row->Window);
+  Options[0].OptionStr = (UINT8 *)"blksize";
+  Options[0].ValueStr  = (UINT8 *)BlkStr;
+  Options[1].OptionStr = (UINT8 *)"windowsize";
+  Options[1].ValueStr  = (UINT8 *)WinStr;
+
+  ZeroMem (Buf, (UINTN)Size);
+  ZeroMem (&Token, sizeof (Token));
+  Token.Filename        = (UINT8 *)File;
+  Token.ModeStr         = (UINT8 *)"octet";
+  Token.OptionCount     = (Row->Window > 1) ? 2 : 1;
+  Token.OptionList      = Options;
+  Token.BufferSize      = Size;
+  Token.Buffer          = Buf;
+  Token.Context         = &Row->Timeouts;
+  Token.TimeoutCallback = L7TftpTimeout;
+
+  //
+  // No event: ReadFile polls the driver itself and returns when done
+  //
+  StartUs        = UtilGetTimeUs ();
+  Status         = Mtftp4->ReadFile (Mtftp4, &Token);
+  Row->ElapsedUs = UtilGetTimeUs () - StartUs;
+  Row->Status    = EFI_ERROR (Status) ? Status : Token.Status;
+  if (EFI_ERROR (Row->Status)) {
+    return;
+  }
+
+  Row->Bytes   = Token.BufferSize;
+  Row->MbpsX10 = (Row->ElapsedUs > 0) ?
+                 (UINT32)DivU64x64Remainder (Row->Bytes * 80, Row->ElapsedUs, NULL) : 0;
+  for (I = 0; I < (UINTN)Row->Bytes; I++) {
+    if (Buf[I] != (UINT8)I) {
+      Row->Corrupt = TRUE;
+      break;
+    }
+  }
+}
+
+//
+// ============================================================
+// Test T7.13: TFTP Sweep
+// Read bytes/<N> (default 4 MB, Config->TransferBytes) from the
+// companion TFTP server with EFI_MTFTP4_PROTOCOL for every blksize
+// (RFC 2348: 512, 1468, 8192; Config->DatagramSize pins one) and
+// windowsize (RFC 7440: 1, 4, 16, 64) combination. Reports Mbps and
+// time per combination, client timeouts and the blocks the server had
+// to send again, and verifies the pattern body.
+//
+// PASS: Every combination transferred the whole file intact
+// WARN: Some combinations failed, were corrupted, or the firmware or
+//       server did not honour windowsize
+// FAIL: MTFTP4 unavailable or no transfer succeeded
+// ============================================================
+//
+EFI_STATUS
+TestL7TftpSweep (
+  IN  NIC_INFO         *Nic,
+  IN  TEST_CONFIG      *Config,
+  OUT TEST_RESULT_DATA *Result
+  )
+{
+  EFI_STATUS              Status;
+  EFI_STATUS              LinkStatus;
+  COMPANION_LINK          Link;
+  BOOLEAN                 LinkUp;
+  CHAR8                   Args[32];
+  CONST CHAR8             *Report;
+  EFI_HANDLE              ChildHandle;
+  EFI_MTFTP4_PROTOCOL     *Mtftp4;
+  EFI_MTFTP4_CONFIG_DATA  TftpCfg;
+  L7_TFTP_ROW             Rows[L7_TFTP_MAX_ROWS];
+  L7_TFTP_ROW             *Row;
+  L7_TFTP_ROW             *Best;
+  UINT16                  BlkSizes[ARRAY_SIZE (mL7TftpBlkSizes)];
+  UINTN                   BlkCount;
+  UINTN                   RowCount;
+  UINTN                   Ok;
+  UINTN                   Failed;
+  UINTN                   NotHonoured;
+  UINTN                   B;
+  UINTN                   W;
+  UINTN                   R;
+  UINTN                   Used;
+  UINT64                  Transfers;
+  UINT64                  SeenTransfers;
+  UINT64                  Size;
+  UINT64                  TotalUs;
+  UINT64                  ServerRetx;
+  UINT32                  Timeouts;
+  UINT8                   *Buf;
+  CHAR8                   File[32];
+  BOOLEAN                 NoWindowSupport;
+
+  Size = (Config->TransferBytes > 0) ? MIN (Config->TransferBytes, L7_TFTP_MAX_BYTES) : L7_TFTP_DEFAULT_BYTES;
+  if (Config->DatagramSize > 0) {
+    BlkSizes[0] = (UINT16)Config->DatagramSize;
+    BlkCount    = 1;
+  } else {
+    CopyMem (BlkSizes, mL7TftpBlkSizes, sizeof (mL7TftpBlkSizes));
+    BlkCount = ARRAY_SIZE (mL7TftpBlkSizes);
+  }
+
+  Status = L7CreateMtftpChild (Nic->Handle, &ChildHandle, &Mtftp4);
+  if (EFI_ERROR (Status)) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"MTFTP4 service not available: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Load Mtftp4Dxe (NetworkPkg); PXE boot needs it");
+    return EFI_SUCCESS;
+  }
+
+  ZeroMem (&TftpCfg, sizeof (TftpCfg));
+  TftpCfg.UseDefaultSetting = FALSE;
+  CopyMem (&TftpCfg.StationIp, &Nic->Ipv4Address, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&TftpCfg.SubnetMask, &Nic->SubnetMask, sizeof (EFI_IPv4_ADDRESS));
+  CopyMem (&TftpCfg.ServerIp, &Config->TargetIp, sizeof (EFI_IPv4_ADDRESS));
+  TftpCfg.LocalPort         = 0;
+  TftpCfg.InitialServerPort = (Config->TargetPort > 0) ? Config->TargetPort : L7_TFTP_DEFAULT_PORT;
+  TftpCfg.TryCount          = L7_TFTP_TRIES;
+  TftpCfg.TimeoutValue      = L7_TFTP_TIMEOUT_S;
+
+  Status = Mtftp4->Configure (Mtftp4, &TftpCfg);
+  if (EFI_ERROR (Status)) {
+    L7DestroyMtftpChild (Nic->Handle, ChildHandle, Mtftp4);
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"MTFTP4 Configure failed: %r", Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Check the NIC IPv4 address and subnet (L3 tests)");
+    return EFI_SUCCESS;
+  }
+
+  Buf = AllocatePool ((UINTN)Size);
+  if (Buf == NULL) {
+    L7DestroyMtftpChild (Nic->Handle, ChildHandle, Mtftp4);
+    Result->StatusCode = TEST_RESULT_ERROR;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"Out of memory for the %llu-byte file", Size);
+    return EFI_SUCCESS;
+  }
+
+  AsciiSPrint (File, sizeof (File), "bytes/%llu", Size);
+
+  //
+  // The companion reports the options and resends of each transfer
+  //
+  LinkUp     = FALSE;
+  LinkStatus = CompanionAttach (&Link, Nic->Handle, &Config->TargetIp);
+  if (!EFI_ERROR (LinkStatus)) {
+    LinkStatus = CompanionConnect (&Link);
+    if (!EFI_ERROR (LinkStatus)) {
+      AsciiSPrint (Args, sizeof (Args), "size=%llu", Size);
+      LinkStatus = CompanionPrepare (&Link, "L7", "TFTP_SWEEP", Args);
+    }
+    LinkUp = !EFI_ERROR (LinkStatus);
+    if (!LinkUp) {
+      CompanionDestroy (&Link);
+    }
+  }
+
+  ZeroMem (Rows, sizeof (Rows));
+  RowCount        = 0;
+  SeenTransfers   = 0;
+  TotalUs         = 0;
+  NoWindowSupport = FALSE;
+  for (B = 0; B < BlkCount; B++) {
+    for (W = 0; W < ARRAY_SIZE (mL7TftpWindows) && RowCount < L7_TFTP_MAX_ROWS; W++) {
+      Row          = &Rows[RowCount++];
+      Row->BlkSize = BlkSizes[B];
+      Row->Window  = mL7TftpWindows[W];
+      if (Row->Window > 1 && NoWindowSupport) {
+        Row->Status = EFI_UNSUPPORTED;
+        continue;
+      }
+
+      L7TftpRead (Mtftp4, File, Buf, Size, Row);
+      TotalUs += Row->ElapsedUs;
+      if (Row->Window > 1 && Row->Status == EFI_UNSUPPORTED) {
+        //
+        // Drivers older than RFC 7440 support reject the option outright
+        //
+        NoWindowSupport = TRUE;
+      }
+
+      if (LinkUp &&
+          !EFI_ERROR (CompanionGetResult (&Link, &Report)) &&
+          !EFI_ERROR (CompanionResultValue (Report, "tftp_transfers", &Transfers)) &&
+          Transfers > SeenTransfers) {
+        SeenTransfers = Transfers;
+        CompanionResultValue (Report, "tftp_last_retx", &Row->ServerRetx);
+        CompanionResultValue (Report, "tftp_last_blksize", &Row->ServerBlkSize);
+        CompanionResultValue (Report, "tftp_last_window", &Row->ServerWindow);
+      }
+    }
+  }
+
+  if (LinkUp) {
+    CompanionDisconnect (&Link);
+    CompanionDestroy (&Link);
+  }
+  FreePool (Buf);
+  L7DestroyMtftpChild (Nic->Handle, ChildHandle, Mtftp4);
+
+  //
+  // Tally, and pick the fastest intact transfer
+  //
+  Ok          = 0;
+  Failed      = 0;
+  NotHonoured = 0;
+  Best        = NULL;
+  for (R = 0; R < RowCount; R++) {
+    Row = &Rows[R];
+    if (EFI_ERROR (Row->Status) || Row->Corrupt || Row->Bytes != Size) {
+      if (!(NoWindowSupport && Row->Window > 1 && Row->Status == EFI_UNSUPPORTED)) {
+        Failed++;
+      }
+      continue;
+    }
+    Ok++;
+    if (Row->ServerWindow != 0 &&
+        (Row->ServerWindow != Row->Window || Row->ServerBlkSize != Row->BlkSize)) {
+      NotHonoured++;
+    }
+    if (Best == NULL || Row->MbpsX10 > Best->MbpsX10) {
+      Best = Row;
+    }
+  }
+
+  Result->PacketsSent     = RowCount;
+  Result->PacketsReceived = Ok;
+  Result->BytesReceived   = MultU64x32 (Size, (UINT32)Ok);
+  Result->DurationMs      = DivU64x32 (TotalUs, 1000);
+
+  Timeouts   = 0;
+  ServerRetx = 0;
+  UnicodeSPrint (Result->Detail, sizeof (Result->Detail), L"%llu KB, blksize/window: ",
+                 RShiftU64 (Size, 10));
+  for (R = 0; R < RowCount; R++) {
+    Row         = &Rows[R];
+    Timeouts   += Row->Timeouts;
+    ServerRetx += Row->ServerRetx;
+    Used        = StrLen (Result->Detail);
+    if (!EFI_ERROR (Row->Status) && !Row->Corrupt) {
+      UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                     L"%d/%d %d.%dMbps %llums; ",
+                     Row->BlkSize, Row->Window, Row->MbpsX10 / 10, Row->MbpsX10 % 10,
+                     DivU64x32 (Row->ElapsedUs, 1000));
+    } else {
+      UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                     L"%d/%d %s; ", Row->BlkSize, Row->Window,
+                     Row->Corrupt ? L"corrupt" : (Row->Status == EFI_UNSUPPORTED ? L"unsupported" : L"failed"));
+    }
+  }
+  Used = StrLen (Result->Detail);
+  UnicodeSPrint (&Result->Detail[Used], sizeof (Result->Detail) - Used * sizeof (CHAR16),
+                 L"| %d client timeouts, %llu blocks resent by server", Timeouts, ServerRetx);
+
+  if (Best == NULL) {
+    Result->StatusCode = TEST_RESULT_FAIL;
+    UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                   L"No TFTP transfer of %a succeeded (first: %r)", File, Rows[0].Status);
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Verify the companion TFTP server (tftp_port, needs root for 69) is running");
+    return EFI_SUCCESS;
+  }
+
+  Result->StatusCode = TEST_RESULT_PASS;
+  UnicodeSPrint (Result->Summary, sizeof (Result->Summary),
+                 L"TFTP best %d.%d Mbps at blksize %d windowsize %d (%d/1: %d.%d Mbps)",
+                 Best->MbpsX10 / 10, Best->MbpsX10 % 10, Best->BlkSize, Best->Window,
+                 Rows[0].BlkSize, Rows[0].MbpsX10 / 10, Rows[0].MbpsX10 % 10);
+  if (Failed > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"%d of %d transfers failed or were corrupted; avoid those sizes on boot servers",
+                   Failed, RowCount);
+  } else if (NoWindowSupport) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Firmware MTFTP4 rejects windowsize (RFC 7440): only blksize helps");
+  } else if (NotHonoured > 0) {
+    Result->StatusCode = TEST_RESULT_WARN;
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"%d transfers ran with other options than requested", NotHonoured);
+  } else {
+    UnicodeSPrint (Result->Suggestion, sizeof (Result->Suggestion),
+                   L"Configure boot servers for blksize %d windowsize %d",
+                   Best->BlkSize, Best->Window);
+  }
+
+  return EFI_SUCCESS;
+}
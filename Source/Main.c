@@ -751,6 +751,167 @@ RunProtocolEchoTest (
   }
 }
 
+/**
+  MAC-swap loopback for RFC 2544 testing driven from an external
+  tester (or the companion frame generator). Asks which frames to loop,
+  then bounces them back with the MAC addresses swapped until ESC,
+  showing live rate and drop counters once a second.
+
+  @param[in] Nic  NIC to loop on.
+**/
+STATIC
+VOID
+RunMacSwapLoopback (
+  IN NIC_INFO  *Nic
+  )
+{
+  PKT_LOOP         Loop;
+  PKT_LOOP_FILTER  Filter;
+  EFI_INPUT_KEY    Key;
+  EFI_STATUS       Status;
+  CHAR16           MacStr[20];
+  CONST CHAR16     *FilterStr;
+  UINTN            BoxW;
+  UINT64           StartUs;
+  UINT64           LastUs;
+  UINT64           NowUs;
+  UINT64           LastLooped;
+  UINT64           LastBytes;
+  UINT64           IntervalUs;
+  UINT64           Pps;
+  UINT64           PeakPps;
+  UINT32           MbpsX10;
+
+  UiClearScreen ();
+  UiDrawHeader ();
+
+  BoxW = UiGetScreenWidth () - 2;
+  if (BoxW < 66) BoxW = 66;
+
+  UiSetColor (COLOR_HEADER, COLOR_BG);
+  UiDrawBox (1, 3, BoxW, 20, L"MAC-Swap Loopback (RFC 2544)");
+
+  if (Nic->Snp == NULL || Nic->Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    UiSetColor (COLOR_ERROR, COLOR_BG);
+    UiPrintAt (3, 5, L"  SNP not initialized on %s", Nic->Name);
+    UiDrawStatusBar (L"Press any key to return");
+    UiWaitKey ();
+    return;
+  }
+
+  UtilFormatMac (Nic->Snp->Mode->CurrentAddress.Addr, MacStr);
+  UiSetColor (COLOR_INFO, COLOR_BG);
+  UiPrintAt (3, 4, L"  NIC    : %s", Nic->Name);
+  UiPrintAt (3, 5, L"  MAC    : %s", MacStr);
+
+  UiPrintAt (3, 7,  L"  Loop which frames?");
+  UiPrintAt (3, 9,  L"  [1] Addressed to this MAC, any EtherType (tester default)");
+  UiPrintAt (3, 10, L"  [2] EtherType 0x88B5, any destination (promiscuous)");
+  UiPrintAt (3, 11, L"  [3] Addressed to this MAC, EtherType 0x88B5 only");
+  UiDrawStatusBar (L"[1-3] Start loopback  [ESC] Back");
+
+  ZeroMem (&Filter, sizeof (Filter));
+  CopyMem (Filter.DstMac, Nic->Snp->Mode->CurrentAddress.Addr, 6);
+  Key = UiWaitKey ();
+  switch (Key.UnicodeChar) {
+    case L'1':
+      Filter.MatchDstMac = TRUE;
+      FilterStr          = L"to this MAC, any EtherType";
+      break;
+    case L'2':
+      Filter.EtherType = 0x88B5;
+      FilterStr        = L"EtherType 0x88B5, any destination";
+      break;
+    case L'3':
+      Filter.MatchDstMac = TRUE;
+      Filter.EtherType   = 0x88B5;
+      FilterStr          = L"to this MAC, EtherType 0x88B5";
+      break;
+    default:
+      return;
+  }
+
+  UiClearLines (7, 21);
+  Status = PktLoopOpen (&Loop, Nic->Snp, &Filter);
+  if (EFI_ERROR (Status)) {
+    UiSetColor (COLOR_ERROR, COLOR_BG);
+    UiPrintAt (3, 7, L"  Cannot start loopback: %r", Status);
+    if (Status == EFI_UNSUPPORTED) {
+      UiPrintAt (3, 8, L"  The NIC driver does not offer promiscuous receive");
+    }
+    UiDrawStatusBar (L"Press any key to return");
+    UiWaitKey ();
+    return;
+  }
+
+  UiSetColor (COLOR_INFO, COLOR_BG);
+  UiPrintAt (3, 7, L"  Filter : %s", FilterStr);
+  UiSetColor (COLOR_HEADER, COLOR_BG);
+  UiDrawSeparator (1, 8, BoxW);
+  UiDrawStatusBar (L"[ESC] Stop loopback");
+
+  StartUs    = UtilGetTimeUs ();
+  LastUs     = StartUs;
+  LastLooped = 0;
+  LastBytes  = 0;
+  PeakPps    = 0;
+
+  for (;;) {
+    PktLoopRun (&Loop, 100000);
+
+    NowUs = UtilGetTimeUs ();
+    if (NowUs - LastUs < 1000000) {
+      continue;
+    }
+
+    IntervalUs = NowUs - LastUs;
+    Pps        = DivU64x64Remainder ((Loop.Looped - LastLooped) * 1000000, IntervalUs, NULL);
+    MbpsX10    = (UINT32)DivU64x64Remainder ((Loop.LoopedBytes - LastBytes) * 80, IntervalUs, NULL);
+    PeakPps    = MAX (PeakPps, Pps);
+    LastUs     = NowUs;
+    LastLooped = Loop.Looped;
+    LastBytes  = Loop.LoopedBytes;
+
+    UiSetColor (COLOR_INFO, COLOR_BG);
+    UiPrintAt (3, 9,  L"  Elapsed  : %d s          ",
+               (int)DivU64x32 (NowUs - StartUs, 1000000));
+    UiSetColor (COLOR_SUCCESS, COLOR_BG);
+    UiPrintAt (3, 11, L"  Rate     : %llu pps  %d.%d Mbps (frame bytes)   peak %llu pps        ",
+               Pps, MbpsX10 / 10, MbpsX10 % 10, PeakPps);
+    UiSetColor (COLOR_INFO, COLOR_BG);
+    UiPrintAt (3, 12, L"  Looped   : %llu frames  %llu bytes          ",
+               Loop.Looped, Loop.LoopedBytes);
+    UiPrintAt (3, 13, L"  Received : %llu frames  (%llu not matching the filter)          ",
+               Loop.RxFrames, Loop.Filtered);
+    UiSetColor (Loop.Oversize > 0 ? COLOR_WARNING : COLOR_INFO, COLOR_BG);
+    UiPrintAt (3, 14, L"  Oversize : %llu frames above %d bytes (drained, not looped)          ",
+               Loop.Oversize, (int)PKT_LOOP_SLOT_SIZE);
+    UiSetColor ((Loop.NoSlot + Loop.TxBusy + Loop.TxErrors) > 0 ? COLOR_WARNING : COLOR_INFO,
+                COLOR_BG);
+    UiPrintAt (3, 15, L"  Dropped  : %llu no TX slot  %llu TX queue full  %llu TX errors          ",
+               Loop.NoSlot, Loop.TxBusy, Loop.TxErrors);
+    UiSetColor (COLOR_INFO, COLOR_BG);
+    UiPrintAt (3, 16, L"  In flight: %d of %d TX slots   ",
+               (int)Loop.InUse, (int)PKT_LOOP_TX_SLOTS);
+
+    //
+    // ESC check once per refresh (non-blocking)
+    //
+    if (!EFI_ERROR (gST->ConIn->ReadKeyStroke (gST->ConIn, &Key)) &&
+        (Key.ScanCode == SCAN_ESC || Key.UnicodeChar == L'q' || Key.UnicodeChar == L'Q')) {
+      break;
+    }
+  }
+
+  PktLoopClose (&Loop);
+
+  UiSetColor (COLOR_HEADER, COLOR_BG);
+  UiPrintAt (3, 18, L"  Loopback stopped after %d s, %llu frames looped",
+             (int)DivU64x32 (UtilGetTimeUs () - StartUs, 1000000), Loop.Looped);
+  UiDrawStatusBar (L"Press any key to return");
+  UiWaitKey ();
+}
+
 /**
   Test companion connectivity on the selected NIC.
   Initializes UDP4, sends HELLO, waits for ACK, and displays result.
@@ -951,7 +1112,7 @@ ShowNetworkInterfaces (
     if (DetailView) {
       if (Selected < NicCount) {
         DrawNicDetail (&Nics[Selected]);
-        UiDrawStatusBar (L"[1-4] Echo Test  [C] Companion  [ESC] Back");
+        UiDrawStatusBar (L"[1-4] Echo Test  [L] Loopback  [C] Companion  [ESC] Back");
       } else {
         DrawPciNicDetail (&PciNics[Selected - NicCount]);
         UiDrawStatusBar (L"[ESC] Back to list");
@@ -1008,6 +1169,10 @@ ShowNetworkInterfaces (
                  Selected < NicCount) {
         TestCompanionConnection (&Nics[Selected]);
         NeedFullClear = TRUE;
+      } else if ((Key.UnicodeChar == L'l' || Key.UnicodeChar == L'L') &&
+                 Selected < NicCount) {
+        RunMacSwapLoopback (&Nics[Selected]);
+        NeedFullClear = TRUE;
       } else if (Key.UnicodeChar >= L'1' && Key.UnicodeChar <= L'4' &&
                  Selected < NicCount) {
         //
@@ -1519,6 +1684,168 @@ ExecuteTestsWithProgress (
   return EFI_SUCCESS;
 }
 
+//
+// Test parameter presets. The first entry (zero) always leaves the
+// choice to each test's own default.
+//
+STATIC CONST UINT16  mPortRangePresets[][2] = {
+  { 0, 0 }, { 1, 1024 }, { 1, 10000 }, { 1, 65535 }
+};
+STATIC CONST UINT64  mDurationPresets[] = { 0, 1000, 3000, 10000, 30000 };
+STATIC CONST UINT64  mDatagramPresets[] = { 0, 64, 512, 1024, 1468, 8192 };
+STATIC CONST UINT64  mRatePresets[]     = { 0, 100, 1000, 5000, 20000, 100000 };
+STATIC CONST UINT64  mTransferPresets[] = { 0, SIZE_1MB, SIZE_16MB, SIZE_64MB, SIZE_256MB };
+STATIC CONST UINT64  mCountPresets[]    = { 0, 1, 10, 100, 1000 };
+
+/**
+  Step a parameter to the preset after its current value.
+
+  @param[in]  Presets  Preset list, default (0) first.
+  @param[in]  Count    Number of presets.
+  @param[in]  Current  Current value.
+
+  @return The next preset; the default when Current is the last or not a preset.
+**/
+STATIC
+UINT64
+NextPreset (
+  IN CONST UINT64  *Presets,
+  IN UINTN         Count,
+  IN UINT64        Current
+  )
+{
+  UINTN  I;
+
+  for (I = 0; I < Count - 1; I++) {
+    if (Presets[I] == Current) {
+      return Presets[I + 1];
+    }
+  }
+  return Presets[0];
+}
+
+/**
+  Edit the per-test parameters of the Run Tests configuration. Each key
+  steps its parameter to the next preset; a value that is not a preset
+  steps back to the default.
+
+  @param[in,out]  Config  Test configuration to edit.
+**/
+STATIC
+VOID
+ShowTestParameters (
+  IN OUT TEST_CONFIG  *Config
+  )
+{
+  EFI_INPUT_KEY  Key;
+  UINTN          BoxW;
+  UINTN          I;
+
+  BoxW = UiGetScreenWidth () - 2;
+  if (BoxW < 76) BoxW = 76;
+
+  for (;;) {
+    UiClearLines (3, UiGetScreenHeight () - 2);
+    UiSetColor (COLOR_HEADER, COLOR_BG);
+    UiDrawBox (1, 3, BoxW, 14, L"Test Parameters");
+
+    UiSetColor (COLOR_INFO, COLOR_BG);
+    if (Config->PortRangeStart == 0) {
+      UiPrintAt (3, 5, L"[1] Port range    : default (scan 1-1024 + 3389/8080/8443)");
+    } else {
+      UiPrintAt (3, 5, L"[1] Port range    : %d-%d",
+                 Config->PortRangeStart, Config->PortRangeEnd);
+    }
+    if (Config->DurationMs == 0) {
+      UiPrintAt (3, 6, L"[2] Duration      : default (per test, 3-30 s)");
+    } else {
+      UiPrintAt (3, 6, L"[2] Duration      : %d s", Config->DurationMs / 1000);
+    }
+    if (Config->DatagramSize == 0) {
+      UiPrintAt (3, 7, L"[3] Datagram size : default (per test)");
+    } else {
+      UiPrintAt (3, 7, L"[3] Datagram size : %d B (clamped to each test's limit)", Config->DatagramSize);
+    }
+    if (Config->RatePps == 0) {
+      UiPrintAt (3, 8, L"[4] Rate          : default (per test, RX capacity unpaced)");
+    } else {
+      UiPrintAt (3, 8, L"[4] Rate          : %d pps", Config->RatePps);
+    }
+    if (Config->TransferBytes == 0) {
+      UiPrintAt (3, 9, L"[5] Transfer size : default (per test, 4-64 MB)");
+    } else {
+      UiPrintAt (3, 9, L"[5] Transfer size : %ld MB", DivU64x32 (Config->TransferBytes, SIZE_1MB));
+    }
+    if (Config->Iterations == 0) {
+      UiPrintAt (3, 10, L"[6] Count         : default (per test)");
+    } else {
+      UiPrintAt (3, 10, L"[6] Count         : %d (above a test's cap: its default)", Config->Iterations);
+    }
+    if (Config->TrustCompanionCa) {
+      UiPrintAt (3, 11, L"[7] Trust test CA : on (HTTPS enrolls <target>/ca.der unverified)");
+    } else {
+      UiPrintAt (3, 11, L"[7] Trust test CA : off (platform TlsCaCertificate only)");
+    }
+
+    UiSetColor (EFI_LIGHTGRAY, COLOR_BG);
+    UiPrintAt (3, 14, L"Each key steps to the next preset; default lets each test choose.");
+    UiDrawStatusBar (L"[1-7] Change a parameter  [0] All defaults  [ESC] Back");
+
+    Key = UiWaitKey ();
+    if (Key.ScanCode == SCAN_ESC || Key.UnicodeChar == L'q' || Key.UnicodeChar == L'Q') {
+      break;
+    }
+
+    switch (Key.UnicodeChar) {
+      case L'1':
+        for (I = 0; I < ARRAY_SIZE (mPortRangePresets) - 1; I++) {
+          if (Config->PortRangeStart == mPortRangePresets[I][0] &&
+              Config->PortRangeEnd == mPortRangePresets[I][1]) {
+            break;
+          }
+        }
+        I = (I + 1) % ARRAY_SIZE (mPortRangePresets);
+        Config->PortRangeStart = mPortRangePresets[I][0];
+        Config->PortRangeEnd   = mPortRangePresets[I][1];
+        break;
+      case L'2':
+        Config->DurationMs = (UINT32)NextPreset (mDurationPresets, ARRAY_SIZE (mDurationPresets),
+                                                 Config->DurationMs);
+        break;
+      case L'3':
+        Config->DatagramSize = (UINT16)NextPreset (mDatagramPresets, ARRAY_SIZE (mDatagramPresets),
+                                                   Config->DatagramSize);
+        break;
+      case L'4':
+        Config->RatePps = (UINT32)NextPreset (mRatePresets, ARRAY_SIZE (mRatePresets), Config->RatePps);
+        break;
+      case L'5':
+        Config->TransferBytes = NextPreset (mTransferPresets, ARRAY_SIZE (mTransferPresets),
+                                            Config->TransferBytes);
+        break;
+      case L'6':
+        Config->Iterations = (UINT32)NextPreset (mCountPresets, ARRAY_SIZE (mCountPresets),
+                                                 Config->Iterations);
+        break;
+      case L'7':
+        Config->TrustCompanionCa = !Config->TrustCompanionCa;
+        break;
+      case L'0':
+        Config->PortRangeStart = 0;
+        Config->PortRangeEnd   = 0;
+        Config->DurationMs     = 0;
+        Config->DatagramSize   = 0;
+        Config->RatePps        = 0;
+        Config->TransferBytes  = 0;
+        Config->Iterations     = 0;
+        Config->TrustCompanionCa = FALSE;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
 /**
   Show the Run Tests menu.
   Allows NIC selection, layer selection, test execution, and results viewing.
@@ -1602,7 +1929,7 @@ ShowTestMenu (
     CopyMem (&Config.Gateway, &TmpGw, sizeof (EFI_IPv4_ADDRESS));
     CopyMem (&Config.TargetIp, &TmpComp, sizeof (EFI_IPv4_ADDRESS));
     Config.TimeoutMs     = 3000;
-    Config.Iterations    = 1;
+    Config.Iterations    = 0;
     Config.TargetPort    = 0;
     Config.CompanionPort = CONTROL_CHANNEL_PORT;
   }
@@ -1661,10 +1988,10 @@ ShowTestMenu (
       UiPrintAt (5, 16, L"[A] All Layers               (36 tests)");
 
       UiSetColor (EFI_LIGHTGRAY, COLOR_BG);
-      UiPrintAt (5, 18, L"[N] Change NIC  [T] Change Target IP");
+      UiPrintAt (5, 18, L"[N] Change NIC  [T] Change Target IP  [P] Test Parameters");
       UiPrintAt (5, 19, L"[ESC] Back to main menu");
 
-      UiDrawStatusBar (L"Select layer [1/2/3/4/7/A] or [N]IC [T]arget [ESC]");
+      UiDrawStatusBar (L"Select layer [1/2/3/4/7/A] or [N]IC [T]arget [P]arams [ESC]");
 
       Key = UiWaitKey ();
 
@@ -1704,6 +2031,9 @@ ShowTestMenu (
             CopyMem (&Config.TargetIp, &TmpTarget, sizeof (EFI_IPv4_ADDRESS));
           }
           continue;
+        case L'p': case L'P':
+          ShowTestParameters (&Config);
+          continue;
         default:
           if (Key.ScanCode == SCAN_ESC || Key.UnicodeChar == L'q' || Key.UnicodeChar == L'Q') {
             Running = FALSE;
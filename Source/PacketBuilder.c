@@ -57,6 +57,33 @@ PktChecksum (
   return (UINT16)(~Sum);
 }
 
+/**
+  Update an Internet checksum for one changed 16-bit word without
+  summing the data again (RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m')).
+  Used when a header is patched in place, e.g. a TTL rewrite.
+
+  @param[in] Checksum  Current checksum, host order as PktChecksum returns it.
+  @param[in] OldWord   Word before the change, host order.
+  @param[in] NewWord   Word after the change, host order.
+
+  @return Updated checksum, host order.
+**/
+UINT16
+PktChecksumAdjust (
+  IN UINT16  Checksum,
+  IN UINT16  OldWord,
+  IN UINT16  NewWord
+  )
+{
+  UINT32  Sum;
+
+  Sum = (UINT32)(UINT16)~Checksum + (UINT16)~OldWord + NewWord;
+  Sum = (Sum & 0xFFFF) + (Sum >> 16);
+  Sum = (Sum & 0xFFFF) + (Sum >> 16);
+
+  return (UINT16)(~Sum);
+}
+
 /**
   Compute TCP/UDP checksum with IPv4 pseudo-header.
 
@@ -0,0 +1,719 @@
+/** @file
+  Raw frame I/O.
+  Transmits prebuilt Ethernet frames through SNP and receives frames
+  through a private MNP child, so raw-frame engines keep working while
+  the UEFI IP4 stack is active (MNP background polling drains
+  SNP.Receive, see TryReceiveViaMnp in Layer2DataLink.c). Falls back to
+  SNP.Receive when MNP is not present.
+
+  Also hosts the MAC-swap loopback, which bypasses MNP entirely and
+  reflects frames from SNP receive buffers without copying.
+**/
+
+#include <DDTSoftNetTest.h>
+#include <PacketDefs.h>
+
+//
+// TX retry budget when the SNP transmit queue is full
+//
+#define PKT_IO_TX_RETRIES  200
+
+//
+// Time PktLoopClose waits for SNP to hand back in-flight loop slots
+//
+#define PKT_LOOP_DRAIN_US  100000
+
+/**
+  Queue the MNP receive token (if not already queued).
+
+  @param[in,out]  Io  Packet I/O context.
+**/
+STATIC
+VOID
+PktIoQueueReceive (
+  IN OUT PKT_IO  *Io
+  )
+{
+  if (Io->Mnp == NULL || Io->RxQueued) {
+    return;
+  }
+
+  Io->RxToken.Status        = EFI_NOT_READY;
+  Io->RxToken.Packet.RxData = NULL;
+
+  if (!EFI_ERROR (Io->Mnp->Receive (Io->Mnp, &Io->RxToken))) {
+    Io->RxQueued = TRUE;
+  }
+}
+
+/**
+  Open a raw frame I/O context on a NIC.
+
+  @param[out]  Io         Context to initialize.
+  @param[in]   NicHandle  NIC handle (for the MNP service binding).
+  @param[in]   Snp        Initialized SNP instance of the NIC.
+
+  @retval EFI_SUCCESS      Context ready (Io->Mnp may be NULL: SNP RX).
+  @retval EFI_NOT_READY    SNP is missing or not initialized.
+**/
+EFI_STATUS
+PktIoOpen (
+  OUT PKT_IO                       *Io,
+  IN  EFI_HANDLE                   NicHandle,
+  IN  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_MANAGED_NETWORK_CONFIG_DATA  MnpConfig;
+
+  ZeroMem (Io, sizeof (PKT_IO));
+
+  if (Snp == NULL || Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    return EFI_NOT_READY;
+  }
+
+  Io->NicHandle = NicHandle;
+  Io->Snp       = Snp;
+  CopyMem (Io->SrcMac, Snp->Mode->CurrentAddress.Addr, 6);
+
+  Snp->ReceiveFilters (
+    Snp,
+    EFI_SIMPLE_NETWORK_RECEIVE_UNICAST |
+    EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST,
+    0, FALSE, 0, NULL
+    );
+
+  //
+  // Private MNP child receiving every EtherType. MNP hands each child
+  // its own copy, so this does not disturb IP4/ARP.
+  //
+  Status = gBS->HandleProtocol (
+                  NicHandle,
+                  &gEfiManagedNetworkServiceBindingProtocolGuid,
+                  (VOID **)&Io->MnpSb
+                  );
+  if (!EFI_ERROR (Status)) {
+    Status = Io->MnpSb->CreateChild (Io->MnpSb, &Io->MnpChild);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->HandleProtocol (
+                    Io->MnpChild,
+                    &gEfiManagedNetworkProtocolGuid,
+                    (VOID **)&Io->Mnp
+                    );
+  }
+  if (!EFI_ERROR (Status)) {
+    ZeroMem (&MnpConfig, sizeof (MnpConfig));
+    MnpConfig.ReceivedQueueTimeoutValue = 0;
+    MnpConfig.TransmitQueueTimeoutValue = 0;
+    MnpConfig.ProtocolTypeFilter        = 0;      // All EtherTypes
+    MnpConfig.EnableUnicastReceive      = TRUE;
+    MnpConfig.EnableMulticastReceive    = FALSE;
+    MnpConfig.EnableBroadcastReceive    = TRUE;
+    MnpConfig.EnablePromiscuousReceive  = FALSE;
+    MnpConfig.FlushQueuesOnReset        = TRUE;
+    MnpConfig.EnableReceiveTimestamps   = FALSE;
+    MnpConfig.DisableBackgroundPolling  = FALSE;
+
+    Status = Io->Mnp->Configure (Io->Mnp, &MnpConfig);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (0, TPL_CALLBACK, NULL, NULL, &Io->RxToken.Event);
+  }
+
+  if (EFI_ERROR (Status)) {
+    //
+    // No usable MNP — receive straight from SNP instead
+    //
+    if (Io->Mnp != NULL) {
+      Io->Mnp->Configure (Io->Mnp, NULL);
+    }
+    if (Io->MnpChild != NULL) {
+      Io->MnpSb->DestroyChild (Io->MnpSb, Io->MnpChild);
+    }
+    Io->MnpChild = NULL;
+    Io->Mnp      = NULL;
+    return EFI_SUCCESS;
+  }
+
+  PktIoQueueReceive (Io);
+  return EFI_SUCCESS;
+}
+
+/**
+  Close a raw frame I/O context and release the MNP child.
+
+  @param[in,out]  Io  Context to close.
+**/
+VOID
+PktIoClose (
+  IN OUT PKT_IO  *Io
+  )
+{
+  VOID   *TxBuf;
+  UINTN  I;
+
+  if (Io->Mnp != NULL) {
+    if (Io->RxQueued && Io->RxToken.Status == EFI_NOT_READY) {
+      Io->Mnp->Cancel (Io->Mnp, &Io->RxToken);
+    } else if (Io->RxQueued && Io->RxToken.Packet.RxData != NULL) {
+      gBS->SignalEvent (Io->RxToken.Packet.RxData->RecycleEvent);
+    }
+    Io->Mnp->Configure (Io->Mnp, NULL);
+    gBS->CloseEvent (Io->RxToken.Event);
+    Io->MnpSb->DestroyChild (Io->MnpSb, Io->MnpChild);
+    Io->Mnp      = NULL;
+    Io->MnpChild = NULL;
+  }
+
+  //
+  // Drain outstanding TX completions
+  //
+  if (Io->Snp != NULL) {
+    for (I = 0; I < 100; I++) {
+      TxBuf = NULL;
+      Io->Snp->GetStatus (Io->Snp, NULL, &TxBuf);
+      if (TxBuf == NULL) {
+        break;
+      }
+    }
+  }
+}
+
+/**
+  Transmit a complete Ethernet frame (header included).
+  Recycles completed TX buffers and retries briefly while the
+  transmit queue is full.
+
+  @param[in,out]  Io      Packet I/O context.
+  @param[in]      Frame   Frame to send.
+  @param[in]      Length  Frame length in bytes.
+
+  @retval EFI_SUCCESS    Frame queued to the NIC.
+  @retval EFI_NOT_READY  TX queue stayed full.
+  @retval other          SNP transmit error.
+**/
+EFI_STATUS
+PktIoSend (
+  IN OUT PKT_IO       *Io,
+  IN     CONST UINT8  *Frame,
+  IN     UINTN        Length
+  )
+{
+  EFI_STATUS  Status;
+  VOID        *TxBuf;
+  UINTN       Retry;
+
+  for (Retry = 0; Retry < PKT_IO_TX_RETRIES; Retry++) {
+    Status = Io->Snp->Transmit (Io->Snp, 0, Length, (VOID *)Frame, NULL, NULL, NULL);
+
+    TxBuf = NULL;
+    Io->Snp->GetStatus (Io->Snp, NULL, &TxBuf);
+
+    if (Status != EFI_NOT_READY) {
+      break;
+    }
+
+    Io->TxBusy++;
+    gBS->Stall (10);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Io->TxFrames++;
+  }
+
+  return Status;
+}
+
+/**
+  Receive one frame if available (non-blocking).
+  A frame larger than Buffer is consumed either way: it is copied up to
+  the buffer size and *Length is set to the copied length, so a drain
+  loop never stalls on it.
+
+  @param[in,out]  Io      Packet I/O context.
+  @param[out]     Buffer  Frame buffer (Ethernet header included).
+  @param[in,out]  Length  In: buffer size. Out: bytes copied to Buffer.
+
+  @retval EFI_SUCCESS           Frame copied to Buffer (truncated if larger).
+  @retval EFI_NOT_READY         No frame pending.
+  @retval EFI_OUT_OF_RESOURCES  SNP path: no scratch buffer for an
+                                oversize frame, which stays queued.
+**/
+EFI_STATUS
+PktIoReceive (
+  IN OUT PKT_IO  *Io,
+  OUT    UINT8   *Buffer,
+  IN OUT UINTN   *Length
+  )
+{
+  EFI_STATUS                        Status;
+  EFI_MANAGED_NETWORK_RECEIVE_DATA  *RxData;
+  UINTN                             HdrLen;
+  UINTN                             DataLen;
+  UINTN                             HdrSize;
+  UINTN                             BufSize;
+  UINTN                             FrameLen;
+  UINT8                             *Scratch;
+
+  if (Io->Mnp == NULL) {
+    BufSize = *Length;
+    HdrSize = 0;
+    Status  = Io->Snp->Receive (Io->Snp, &HdrSize, Length, Buffer, NULL, NULL, NULL);
+    if (!EFI_ERROR (Status)) {
+      Io->RxFrames++;
+      return EFI_SUCCESS;
+    }
+
+    //
+    // SNP leaves an oversize frame at the head of the queue; take it
+    // into scratch (rare, so allocated on demand) and hand back the head
+    //
+    if (Status == EFI_BUFFER_TOO_SMALL && *Length > BufSize) {
+      FrameLen = *Length;
+      Scratch  = AllocatePool (FrameLen);
+      if (Scratch == NULL) {
+        *Length = BufSize;
+        return EFI_OUT_OF_RESOURCES;
+      }
+      Status = Io->Snp->Receive (Io->Snp, &HdrSize, &FrameLen, Scratch, NULL, NULL, NULL);
+      if (!EFI_ERROR (Status)) {
+        CopyMem (Buffer, Scratch, BufSize);
+        FreePool (Scratch);
+        *Length = BufSize;
+        Io->RxFrames++;
+        return EFI_SUCCESS;
+      }
+      FreePool (Scratch);
+    }
+
+    *Length = BufSize;
+    return EFI_NOT_READY;
+  }
+
+  PktIoQueueReceive (Io);
+
+  if (Io->RxToken.Status == EFI_NOT_READY) {
+    Io->Mnp->Poll (Io->Mnp);
+    if (Io->RxToken.Status == EFI_NOT_READY) {
+      return EFI_NOT_READY;
+    }
+  }
+
+  Io->RxQueued = FALSE;
+  RxData       = Io->RxToken.Packet.RxData;
+  Status       = EFI_NOT_READY;
+
+  if (!EFI_ERROR (Io->RxToken.Status) && RxData != NULL) {
+    HdrLen  = MIN (RxData->HeaderLength, *Length);
+    DataLen = MIN (RxData->DataLength, *Length - HdrLen);
+
+    CopyMem (Buffer, RxData->MediaHeader, HdrLen);
+    CopyMem (Buffer + HdrLen, RxData->PacketData, DataLen);
+    *Length = HdrLen + DataLen;
+
+    gBS->SignalEvent (RxData->RecycleEvent);
+    Io->RxFrames++;
+    Status = EFI_SUCCESS;
+  }
+
+  PktIoQueueReceive (Io);
+  return Status;
+}
+
+/**
+  Resolve an IPv4 address to a MAC with a raw ARP request.
+
+  @param[in,out]  Io         Packet I/O context.
+  @param[in]      SrcIp      Our IPv4 address.
+  @param[in]      TargetIp   Address to resolve.
+  @param[out]     TargetMac  Resolved MAC (6 bytes).
+  @param[in]      TimeoutMs  Time to wait for the reply.
+
+  @retval EFI_SUCCESS  MAC resolved.
+  @retval EFI_TIMEOUT  No ARP reply.
+  @retval other        Transmit failure.
+**/
+EFI_STATUS
+PktIoResolveMac (
+  IN OUT PKT_IO       *Io,
+  IN     CONST UINT8  *SrcIp,
+  IN     CONST UINT8  *TargetIp,
+  OUT    UINT8        *TargetMac,
+  IN     UINTN        TimeoutMs
+  )
+{
+  EFI_STATUS     Status;
+  UINT8          TxBuf[64];
+  UINT8          RxBuf[MAX_ETHERNET_FRAME_SIZE];
+  UINTN          TxLen;
+  UINTN          RxLen;
+  UINT64         DeadlineUs;
+  PARSED_PACKET  Parsed;
+
+  TxLen  = PktBuildArpRequest (TxBuf, Io->SrcMac, SrcIp, TargetIp);
+  Status = PktIoSend (Io, TxBuf, TxLen);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  DeadlineUs = UtilGetTimeUs () + (UINT64)TimeoutMs * 1000;
+
+  while (UtilGetTimeUs () < DeadlineUs) {
+    RxLen = sizeof (RxBuf);
+    if (EFI_ERROR (PktIoReceive (Io, RxBuf, &RxLen))) {
+      gBS->Stall (200);
+      continue;
+    }
+
+    if (EFI_ERROR (PktParsePacket (RxBuf, RxLen, &Parsed)) || !Parsed.HasArp) {
+      continue;
+    }
+
+    if (NTOHS (Parsed.Arp->Operation) == ARP_OP_REPLY &&
+        CompareMem (Parsed.Arp->SenderIp, TargetIp, 4) == 0) {
+      CopyMem (TargetMac, Parsed.Arp->SenderMac, 6);
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_TIMEOUT;
+}
+
+/**
+  Resolve the next-hop MAC for a destination: the destination itself
+  when on-link, otherwise the gateway.
+
+  @param[in,out]  Io          Packet I/O context.
+  @param[in]      LocalIp     Our IPv4 address.
+  @param[in]      SubnetMask  Our subnet mask.
+  @param[in]      Gateway     Default gateway.
+  @param[in]      DstIp       Final destination.
+  @param[out]     NextHopMac  Resolved MAC (6 bytes).
+
+  @retval EFI_SUCCESS  MAC resolved.
+  @retval other        Resolution failed.
+**/
+EFI_STATUS
+PktIoResolveNextHop (
+  IN OUT PKT_IO       *Io,
+  IN     CONST UINT8  *LocalIp,
+  IN     CONST UINT8  *SubnetMask,
+  IN     CONST UINT8  *Gateway,
+  IN     CONST UINT8  *DstIp,
+  OUT    UINT8        *NextHopMac
+  )
+{
+  CONST UINT8  *HopIp;
+  UINTN        I;
+  UINTN        Attempt;
+  EFI_STATUS   Status;
+
+  HopIp = DstIp;
+  for (I = 0; I < 4; I++) {
+    if ((LocalIp[I] & SubnetMask[I]) != (DstIp[I] & SubnetMask[I])) {
+      HopIp = Gateway;
+      break;
+    }
+  }
+
+  Status = EFI_TIMEOUT;
+  for (Attempt = 0; Attempt < 3 && EFI_ERROR (Status); Attempt++) {
+    Status = PktIoResolveMac (Io, LocalIp, HopIp, NextHopMac, 1000);
+  }
+
+  return Status;
+}
+
+/**
+  Prepare a MAC-swap loopback on a NIC: allocate the TX slots and set
+  the receive filters the filter needs. Looping frames that are not
+  addressed to this NIC (another DstMac, or any destination) needs
+  promiscuous receive.
+
+  @param[out]  Loop    Loopback context to initialize.
+  @param[in]   Snp     Initialized SNP instance of the NIC.
+  @param[in]   Filter  Frames to loop.
+
+  @retval EFI_SUCCESS           Ready for PktLoopRun.
+  @retval EFI_NOT_READY         SNP is missing or not initialized.
+  @retval EFI_UNSUPPORTED       The filter needs promiscuous receive, which the NIC lacks.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the TX slots.
+  @retval other                 The NIC rejected the receive filters.
+**/
+EFI_STATUS
+PktLoopOpen (
+  OUT PKT_LOOP                     *Loop,
+  IN  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp,
+  IN  CONST PKT_LOOP_FILTER        *Filter
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Enable;
+
+  ZeroMem (Loop, sizeof (PKT_LOOP));
+
+  if (Snp == NULL || Snp->Mode->State != EfiSimpleNetworkInitialized) {
+    return EFI_NOT_READY;
+  }
+
+  Enable = EFI_SIMPLE_NETWORK_RECEIVE_UNICAST | EFI_SIMPLE_NETWORK_RECEIVE_BROADCAST;
+  if (!Filter->MatchDstMac ||
+      CompareMem (Filter->DstMac, Snp->Mode->CurrentAddress.Addr, 6) != 0) {
+    if ((Snp->Mode->ReceiveFilterMask & EFI_SIMPLE_NETWORK_RECEIVE_PROMISCUOUS) == 0) {
+      return EFI_UNSUPPORTED;
+    }
+    Enable |= EFI_SIMPLE_NETWORK_RECEIVE_PROMISCUOUS;
+  }
+
+  Loop->Slots = AllocatePool (PKT_LOOP_TX_SLOTS * PKT_LOOP_SLOT_SIZE);
+  Loop->Drain = AllocatePool (PKT_LOOP_DRAIN_SIZE);
+  if (Loop->Slots == NULL || Loop->Drain == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Failed;
+  }
+
+  Loop->OldFilters = Snp->Mode->ReceiveFilterSetting;
+  Status = Snp->ReceiveFilters (Snp, Enable, 0, FALSE, 0, NULL);
+  if (EFI_ERROR (Status)) {
+    goto Failed;
+  }
+
+  Loop->Snp = Snp;
+  CopyMem (&Loop->Filter, Filter, sizeof (PKT_LOOP_FILTER));
+  CopyMem (Loop->OwnMac, Snp->Mode->CurrentAddress.Addr, 6);
+  return EFI_SUCCESS;
+
+Failed:
+  if (Loop->Slots != NULL) {
+    FreePool (Loop->Slots);
+  }
+  if (Loop->Drain != NULL) {
+    FreePool (Loop->Drain);
+  }
+  ZeroMem (Loop, sizeof (PKT_LOOP));
+  return Status;
+}
+
+/**
+  Check a received frame against the loopback filter. Frames sent from
+  our own MAC are never looped: promiscuous receive can see them.
+
+  @param[in]  Loop    Loopback context.
+  @param[in]  Frame   Received Ethernet frame.
+  @param[in]  Length  Frame length.
+
+  @retval TRUE   Loop the frame.
+  @retval FALSE  Leave it.
+**/
+STATIC
+BOOLEAN
+PktLoopMatch (
+  IN CONST PKT_LOOP  *Loop,
+  IN CONST UINT8     *Frame,
+  IN UINTN           Length
+  )
+{
+  CONST ETHERNET_HEADER  *Eth;
+
+  if (Length < ETHERNET_HEADER_SIZE) {
+    return FALSE;
+  }
+
+  Eth = (CONST ETHERNET_HEADER *)Frame;
+  if (CompareMem (Eth->SrcMac, Loop->OwnMac, 6) == 0) {
+    return FALSE;
+  }
+  if (Loop->Filter.EtherType != 0 && NTOHS (Eth->EtherType) != Loop->Filter.EtherType) {
+    return FALSE;
+  }
+  if (Loop->Filter.MatchDstMac && CompareMem (Eth->DstMac, Loop->Filter.DstMac, 6) != 0) {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+  Take back the loop slots SNP has finished sending.
+
+  @param[in,out]  Loop  Loopback context.
+**/
+STATIC
+VOID
+PktLoopReclaim (
+  IN OUT PKT_LOOP  *Loop
+  )
+{
+  VOID   *TxBuf;
+  UINTN  Index;
+
+  while (Loop->InUse > 0) {
+    TxBuf = NULL;
+    if (EFI_ERROR (Loop->Snp->GetStatus (Loop->Snp, NULL, &TxBuf)) || TxBuf == NULL) {
+      return;
+    }
+    if ((UINT8 *)TxBuf < Loop->Slots) {
+      continue;
+    }
+    Index = ((UINT8 *)TxBuf - Loop->Slots) / PKT_LOOP_SLOT_SIZE;
+    if (Index < PKT_LOOP_TX_SLOTS && Loop->Busy[Index]) {
+      Loop->Busy[Index] = FALSE;
+      Loop->InUse--;
+    }
+  }
+}
+
+/**
+  Loop frames for BudgetUs. Frames are received in batches of up to
+  PKT_LOOP_RX_BATCH straight into free TX slots, get their MAC
+  addresses swapped there and are transmitted from the same buffer;
+  completed slots are taken back with GetStatus between batches. Runs
+  at TPL_CALLBACK so MNP's background poll cannot take frames away;
+  call it repeatedly and refresh the display in between. Frames larger
+  than a slot are drained into Loop->Drain and counted as Oversize so
+  they do not stay at the head of the RX queue.
+
+  @param[in,out]  Loop      Loopback context from PktLoopOpen.
+  @param[in]      BudgetUs  Time to spend before returning.
+
+  @return  Frames looped during this call.
+**/
+UINT64
+PktLoopRun (
+  IN OUT PKT_LOOP  *Loop,
+  IN     UINT64    BudgetUs
+  )
+{
+  EFI_STATUS       Status;
+  EFI_TPL          OldTpl;
+  ETHERNET_HEADER  *Eth;
+  UINT8            Scratch[PKT_LOOP_SLOT_SIZE];
+  UINT8            *Frame;
+  UINT8            Mac[6];
+  UINTN            Batch;
+  UINTN            Tries;
+  UINTN            HeaderSize;
+  UINTN            Length;
+  UINT64           Looped;
+  UINT64           EndUs;
+
+  Looped = Loop->Looped;
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  EndUs  = UtilGetTimeUs () + BudgetUs;
+
+  do {
+    for (Batch = 0; Batch < PKT_LOOP_RX_BATCH; Batch++) {
+      //
+      // Receive into the next free slot. With every slot in flight the
+      // frame still leaves the RX ring (into scratch) and is counted
+      //
+      Frame = Scratch;
+      for (Tries = 0; Tries < PKT_LOOP_TX_SLOTS; Tries++) {
+        if (!Loop->Busy[Loop->Next]) {
+          Frame = Loop->Slots + Loop->Next * PKT_LOOP_SLOT_SIZE;
+          break;
+        }
+        Loop->Next = (Loop->Next + 1) % PKT_LOOP_TX_SLOTS;
+      }
+
+      HeaderSize = 0;
+      Length     = PKT_LOOP_SLOT_SIZE;
+      Status     = Loop->Snp->Receive (Loop->Snp, &HeaderSize, &Length, Frame, NULL, NULL, NULL);
+      if (Status == EFI_BUFFER_TOO_SMALL && Length <= PKT_LOOP_DRAIN_SIZE) {
+        Status = Loop->Snp->Receive (Loop->Snp, &HeaderSize, &Length, Loop->Drain, NULL, NULL, NULL);
+        if (!EFI_ERROR (Status)) {
+          Loop->RxFrames++;
+          Loop->Oversize++;
+          continue;
+        }
+      }
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      Loop->RxFrames++;
+      if (!PktLoopMatch (Loop, Frame, Length)) {
+        Loop->Filtered++;
+        continue;
+      }
+      if (Frame == Scratch) {
+        Loop->NoSlot++;
+        continue;
+      }
+
+      //
+      // Swap in place; a group destination cannot become the source
+      //
+      Eth = (ETHERNET_HEADER *)Frame;
+      CopyMem (Mac, Eth->DstMac, 6);
+      CopyMem (Eth->DstMac, Eth->SrcMac, 6);
+      CopyMem (Eth->SrcMac, ((Mac[0] & 0x01) != 0) ? Loop->OwnMac : Mac, 6);
+
+      Status = Loop->Snp->Transmit (Loop->Snp, 0, Length, Frame, NULL, NULL, NULL);
+      if (Status == EFI_NOT_READY) {
+        PktLoopReclaim (Loop);
+        Status = Loop->Snp->Transmit (Loop->Snp, 0, Length, Frame, NULL, NULL, NULL);
+      }
+      if (EFI_ERROR (Status)) {
+        if (Status == EFI_NOT_READY) {
+          Loop->TxBusy++;
+        } else {
+          Loop->TxErrors++;
+        }
+        continue;
+      }
+
+      Loop->Busy[Loop->Next] = TRUE;
+      Loop->InUse++;
+      Loop->Next = (Loop->Next + 1) % PKT_LOOP_TX_SLOTS;
+      Loop->Looped++;
+      Loop->LoopedBytes += Length;
+    }
+
+    PktLoopReclaim (Loop);
+  } while (UtilGetTimeUs () < EndUs);
+
+  gBS->RestoreTPL (OldTpl);
+  return Loop->Looped - Looped;
+}
+
+/**
+  End a MAC-swap loopback: wait for the last looped frames to leave,
+  restore the receive filters and free the slots. Slots SNP never hands
+  back are left allocated, since the NIC may still read them.
+
+  @param[in,out]  Loop  Loopback context.
+**/
+VOID
+PktLoopClose (
+  IN OUT PKT_LOOP  *Loop
+  )
+{
+  EFI_SIMPLE_NETWORK_PROTOCOL  *Snp;
+  UINT64                       StartUs;
+
+  Snp = Loop->Snp;
+  if (Snp == NULL) {
+    return;
+  }
+
+  StartUs = UtilGetTimeUs ();
+  while (Loop->InUse > 0 && UtilGetTimeUs () - StartUs < PKT_LOOP_DRAIN_US) {
+    PktLoopReclaim (Loop);
+  }
+
+  Snp->ReceiveFilters (
+    Snp,
+    Loop->OldFilters,
+    Snp->Mode->ReceiveFilterSetting & ~Loop->OldFilters,
+    FALSE, 0, NULL
+    );
+
+  if (Loop->InUse == 0) {
+    FreePool (Loop->Slots);
+  }
+  FreePool (Loop->Drain);
+  Loop->Slots = NULL;
+  Loop->Drain = NULL;
+  Loop->Snp   = NULL;
+}
@@ -117,7 +117,7 @@ RegInitAllTests (
     );
 
   //
-  // ========== Layer 2: Data Link (7 tests) ==========
+  // ========== Layer 2: Data Link (10 tests) ==========
   //
   RegAdd (
     L"MAC Address Valid",
@@ -175,8 +175,32 @@ RegInitAllTests (
     TestL2ReceiveFilter
     );
 
+  RegAdd (
+    L"Host Discovery",
+    L"Sweep the subnet with paced raw ARP (+ICMP confirm)",
+    OsiLayerDataLink, TestTypeDiscovery, 2000,
+    FALSE, TRUE, FALSE, FALSE, FALSE, FALSE,
+    TestL2HostDiscovery
+    );
+
+  RegAdd (
+    L"RX Capacity",
+    L"DUT receive rate/loss against companion frame generator",
+    OsiLayerDataLink, TestTypePerformance, 5000,
+    TRUE, TRUE, FALSE, FALSE, TRUE, FALSE,
+    TestL2RxCapacity
+    );
+
+  RegAdd (
+    L"Bidirectional",
+    L"Full-duplex DUT and companion streams, per-direction loss",
+    OsiLayerDataLink, TestTypePerformance, 5000,
+    TRUE, TRUE, FALSE, FALSE, TRUE, FALSE,
+    TestL2Bidirectional
+    );
+
   //
-  // ========== Layer 3: Network (10 tests) ==========
+  // ========== Layer 3: Network (11 tests) ==========
   //
   RegAdd (
     L"IP Config Check",
@@ -205,7 +229,7 @@ RegInitAllTests (
   RegAdd (
     L"TTL/Hop Discovery",
     L"Trace route hops to target using incrementing TTL",
-    OsiLayerNetwork, TestTypeDiscovery, 15000,
+    OsiLayerNetwork, TestTypeDiscovery, 3000,
     TRUE, TRUE, FALSE, FALSE, FALSE, FALSE,
     TestL3TtlHopDiscovery
     );
@@ -213,7 +237,7 @@ RegInitAllTests (
   RegAdd (
     L"MTU Path Discovery",
     L"Discover path MTU using DF-bit and ICMP responses",
-    OsiLayerNetwork, TestTypePerformance, 10000,
+    OsiLayerNetwork, TestTypePerformance, 5000,
     TRUE, TRUE, FALSE, FALSE, FALSE, FALSE,
     TestL3MtuPathDiscovery
     );
@@ -252,14 +276,22 @@ RegInitAllTests (
 
   RegAdd (
     L"Duplicate IP Detection",
-    L"Check for duplicate IP addresses on the network",
-    OsiLayerNetwork, TestTypeCompliance, 5000,
+    L"RFC 5227 ARP probe check for duplicate IP addresses",
+    OsiLayerNetwork, TestTypeCompliance, 7000,
     FALSE, TRUE, FALSE, FALSE, FALSE, FALSE,
     TestL3DuplicateIp
     );
 
+  RegAdd (
+    L"Reflector",
+    L"DUT reflects companion ICMP/UDP: RTT, turnaround, max rate",
+    OsiLayerNetwork, TestTypePerformance, 15000,
+    TRUE, TRUE, FALSE, FALSE, TRUE, FALSE,
+    TestL3Reflector
+    );
+
   //
-  // ========== Layer 4: Transport (8 tests) ==========
+  // ========== Layer 4: Transport (13 tests) ==========
   //
   RegAdd (
     L"TCP Connect",
@@ -311,7 +343,7 @@ RegInitAllTests (
 
   RegAdd (
     L"Port Scan",
-    L"Scan common TCP ports on target host",
+    L"Parallel TCP scan of port range (open/closed/filtered)",
     OsiLayerTransport, TestTypeDiscovery, 30000,
     TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
     TestL4PortScan
@@ -325,8 +357,48 @@ RegInitAllTests (
     TestL4TcpStress
     );
 
+  RegAdd (
+    L"SYN Rate",
+    L"Raw SYN connection-rate ramp with setup latency",
+    OsiLayerTransport, TestTypeStress, 10000,
+    TRUE, TRUE, FALSE, FALSE, FALSE, FALSE,
+    TestL4SynRate
+    );
+
+  RegAdd (
+    L"TCP Throughput",
+    L"Bulk TCP goodput both directions (companion sink/source)",
+    OsiLayerTransport, TestTypePerformance, 15000,
+    TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
+    TestL4TcpThroughput
+    );
+
+  RegAdd (
+    L"UDP Throughput",
+    L"Sequenced UDP goodput/loss (companion accounting)",
+    OsiLayerTransport, TestTypePerformance, 10000,
+    TRUE, FALSE, FALSE, FALSE, TRUE, FALSE,
+    TestL4UdpThroughput
+    );
+
+  RegAdd (
+    L"UDP Latency",
+    L"Echo RTT with companion residence time subtracted",
+    OsiLayerTransport, TestTypePerformance, 2000,
+    TRUE, FALSE, FALSE, FALSE, TRUE, FALSE,
+    TestL4UdpLatency
+    );
+
+  RegAdd (
+    L"One-Way Delay",
+    L"Forward/reverse delay and jitter via clock offset",
+    OsiLayerTransport, TestTypePerformance, 10000,
+    TRUE, FALSE, FALSE, FALSE, TRUE, FALSE,
+    TestL4OneWayDelay
+    );
+
   //
-  // ========== Layer 7: Application (6 tests) ==========
+  // ========== Layer 7: Application (13 tests) ==========
   //
   RegAdd (
     L"DHCP Discover",
@@ -375,6 +447,62 @@ RegInitAllTests (
     TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
     TestL7HttpStatusCodes
     );
+
+  RegAdd (
+    L"HTTP Download",
+    L"Stream /bytes/<N> from companion: TTFB and Mbps",
+    OsiLayerApplication, TestTypePerformance, 15000,
+    TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
+    TestL7HttpDownload
+    );
+
+  RegAdd (
+    L"HTTP Load",
+    L"Keep-alive GETs over parallel HTTP children: req/s, latency, reuse",
+    OsiLayerApplication, TestTypePerformance, 12000,
+    TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
+    TestL7HttpLoad
+    );
+
+  RegAdd (
+    L"DNS Benchmark",
+    L"Concurrent lookups of generated names: QPS, cache miss/hit latency",
+    OsiLayerApplication, TestTypePerformance, 10000,
+    FALSE, FALSE, TRUE, FALSE, TRUE, FALSE,
+    TestL7DnsBench
+    );
+
+  RegAdd (
+    L"DHCP Lease Benchmark",
+    L"Repeated release/acquire: per-phase DORA latency and try timeouts",
+    OsiLayerApplication, TestTypePerformance, 15000,
+    FALSE, FALSE, FALSE, FALSE, FALSE, TRUE,
+    TestL7DhcpBench
+    );
+
+  RegAdd (
+    L"DHCP Load",
+    L"Raw-frame DORA for many synthetic clients: leases/s, offer latency",
+    OsiLayerApplication, TestTypePerformance, 15000,
+    FALSE, TRUE, FALSE, FALSE, FALSE, FALSE,
+    TestL7DhcpLoad
+    );
+
+  RegAdd (
+    L"HTTPS",
+    L"Firmware TLS: handshake, session resumption, HTTPS vs HTTP Mbps",
+    OsiLayerApplication, TestTypePerformance, 20000,
+    TRUE, FALSE, FALSE, TRUE, FALSE, FALSE,
+    TestL7Https
+    );
+
+  RegAdd (
+    L"TFTP Sweep",
+    L"MTFTP4 reads across blksize and windowsize: Mbps and time each",
+    OsiLayerApplication, TestTypePerformance, 60000,
+    TRUE, FALSE, FALSE, FALSE, TRUE, FALSE,
+    TestL7TftpSweep
+    );
 }
 
 /**
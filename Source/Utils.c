@@ -82,6 +82,100 @@ UtilGetTimestamp (
          (UINT64)Time.Second;
 }
 
+/**
+  Get a monotonic timestamp with microsecond resolution.
+  UtilGetTimestamp() only ticks once per second, which is useless for
+  RTT and throughput measurements. This reads the CPU time-stamp counter
+  and converts it using a rate calibrated once against gBS->Stall
+  (the first call therefore takes ~10ms).
+
+  @return  Microseconds since an arbitrary fixed origin.
+**/
+UINT64
+UtilGetTimeUs (
+  VOID
+  )
+{
+  STATIC UINT64  TscPerUs = 0;
+  UINT64         Start;
+  UINT64         End;
+
+  if (TscPerUs == 0) {
+    Start = AsmReadTsc ();
+    gBS->Stall (10000);  // 10ms calibration window
+    End   = AsmReadTsc ();
+
+    TscPerUs = DivU64x32 (End - Start, 10000);
+    if (TscPerUs == 0) {
+      TscPerUs = 1;
+    }
+  }
+
+  return DivU64x64Remainder (AsmReadTsc (), TscPerUs, NULL);
+}
+
+/**
+  Sort an array of UINT32 values in ascending order (shell sort).
+  Used for latency percentiles; no allocation, O(n^1.3) in practice.
+
+  @param[in,out]  Array  Values to sort.
+  @param[in]      Count  Number of elements.
+**/
+VOID
+UtilSortUint32 (
+  IN OUT UINT32  *Array,
+  IN     UINTN   Count
+  )
+{
+  UINTN   Gap;
+  UINTN   I;
+  UINTN   J;
+  UINT32  Tmp;
+
+  for (Gap = Count / 2; Gap > 0; Gap /= 2) {
+    for (I = Gap; I < Count; I++) {
+      Tmp = Array[I];
+      for (J = I; J >= Gap && Array[J - Gap] > Tmp; J -= Gap) {
+        Array[J] = Array[J - Gap];
+      }
+      Array[J] = Tmp;
+    }
+  }
+}
+
+/**
+  Return the given percentile of a sorted UINT32 array.
+
+  @param[in]  Sorted   Ascending array (see UtilSortUint32).
+  @param[in]  Count    Number of elements.
+  @param[in]  Percent  Percentile, 0..100.
+
+  @return  Element at the percentile (nearest rank), 0 if Count is 0.
+**/
+UINT32
+UtilPercentile (
+  IN CONST UINT32  *Sorted,
+  IN UINTN         Count,
+  IN UINTN         Percent
+  )
+{
+  UINTN  Rank;
+
+  if (Count == 0) {
+    return 0;
+  }
+
+  Rank = (Count * Percent + 99) / 100;
+  if (Rank == 0) {
+    Rank = 1;
+  }
+  if (Rank > Count) {
+    Rank = Count;
+  }
+
+  return Sorted[Rank - 1];
+}
+
 /**
   Convert an ASCII string to a Unicode (CHAR16) string.
 